@@ -0,0 +1,75 @@
+#ifndef ARENA_STORAGE_H
+#define ARENA_STORAGE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <spatialindex/SpatialIndex.h>
+
+namespace SpatialIndex {
+
+// Largest serialised node of an R-tree with the given capacity and no
+// per-entry data: type, level and child count, then per child an MBR, an id
+// and a data length, then the node MBR.
+inline uint32_t rtreeNodeBytes(uint32_t capacity, uint32_t dims = 2) {
+    const uint32_t mbr = 2 * dims * sizeof(double);
+    return 3 * sizeof(uint32_t) + capacity * (mbr + sizeof(int64_t) + sizeof(uint32_t)) + mbr;
+}
+
+// In-memory storage manager that keeps byte arrays in fixed-size slots carved
+// from large slabs instead of one heap block per page. With the slot sized
+// for the largest node, every node rewrite is copied in place (updates
+// allocate nothing); deleted slots go to a free list and page ids are
+// reused. Arrays larger than a slot get their own allocation.
+//
+// loadByteArray still has to return a new[] copy, as the tree frees what it
+// loads. Loads do not modify the manager, so concurrent readers are safe as
+// long as nobody stores or deletes at the same time.
+class ArenaStorageManager : public IStorageManager {
+public:
+    // slot_bytes: slot size (see rtreeNodeBytes); slab_bytes: memory reserved at a time
+    explicit ArenaStorageManager(uint32_t slot_bytes, size_t slab_bytes = 1 << 20);
+    ~ArenaStorageManager() override;
+
+    ArenaStorageManager(const ArenaStorageManager&) = delete;
+    ArenaStorageManager& operator=(const ArenaStorageManager&) = delete;
+
+    uint64_t pages() const { return live_pages_; }
+    uint64_t bytesLive() const { return live_bytes_; }          // Sum of the stored lengths
+    uint64_t bytesReserved() const { return reserved_bytes_; }  // Slabs plus large arrays
+
+    // IStorageManager interface
+    void loadByteArray(const id_type page, uint32_t& len, uint8_t** data) override;
+    void storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) override;
+    void deleteByteArray(const id_type page) override;
+    void flush() override {}
+
+private:
+    enum Kind : uint8_t { FREE, SLOT, LARGE };
+
+    struct Entry {
+        uint8_t* ptr;
+        uint32_t len;
+        Kind kind;
+    };
+
+    uint8_t* allocate(Kind kind, uint32_t len);
+    void release(const Entry& e);
+    const Entry& entryOf(id_type page) const;
+
+    uint32_t slot_bytes_;
+    size_t slab_bytes_;
+    std::vector<std::unique_ptr<uint8_t[]>> slabs_;
+    std::vector<uint8_t*> free_slots_;
+    uint8_t* bump_;       // Next unused slot of the newest slab
+    uint8_t* bump_end_;
+    std::vector<Entry> entries_;  // Indexed by page id
+    std::vector<id_type> free_ids_;
+    uint64_t live_pages_;
+    uint64_t live_bytes_;
+    uint64_t reserved_bytes_;
+};
+
+} // namespace SpatialIndex
+
+#endif // ARENA_STORAGE_H
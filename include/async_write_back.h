@@ -0,0 +1,86 @@
+#ifndef ASYNC_WRITE_BACK_H
+#define ASYNC_WRITE_BACK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <spatialindex/SpatialIndex.h>
+#include "direct_storage.h"
+
+namespace SpatialIndex {
+
+// Storage-manager layer placed under a page buffer that takes dirty page
+// write-backs off the inserting thread. Rewrites of existing pages are
+// parked in a bounded dirty set (a newer version of a parked page replaces
+// it) and written by a background flusher thread in ascending page-id order,
+// so adjacent pages go out as one sequential run (and as a single batch when
+// the storage manager below takes batches). Once the dirty set reaches
+// its limit, storeByteArray blocks until the flusher frees room.
+//
+// New pages are stored synchronously, since the inner manager assigns their
+// id. Loads see parked pages; a batched load passes the others down as one
+// batch. flush() is a barrier: it returns once every page stored before the
+// call has reached the inner manager, and then flushes that manager.
+class AsyncWriteBackStorageManager : public IBatchStorageManager {
+public:
+    // dirty_limit: pages parked at most; the flusher starts once half are used
+    AsyncWriteBackStorageManager(IStorageManager& inner, size_t dirty_limit);
+    ~AsyncWriteBackStorageManager() override;
+
+    AsyncWriteBackStorageManager(const AsyncWriteBackStorageManager&) = delete;
+    AsyncWriteBackStorageManager& operator=(const AsyncWriteBackStorageManager&) = delete;
+
+    size_t dirtyLimit() const { return dirty_limit_; }
+    uint64_t stalls() const { return stalls_.load(std::memory_order_relaxed); }     // Stores that waited for room
+    uint64_t absorbed() const { return absorbed_.load(std::memory_order_relaxed); } // Rewrites of a parked page
+    uint64_t pagesWritten() const { return pages_written_.load(std::memory_order_relaxed); }
+    uint64_t runs() const { return runs_.load(std::memory_order_relaxed); }         // Runs of consecutive page ids
+
+    // IStorageManager interface
+    void loadByteArray(const id_type page, uint32_t& len, uint8_t** data) override;
+    void storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) override;
+    void deleteByteArray(const id_type page) override;
+    void flush() override;
+
+    // IBatchStorageManager interface
+    void loadByteArrays(size_t n, const id_type* pages, uint32_t* lens, uint8_t** data) override;
+    void storeByteArrays(size_t n, const id_type* pages, const uint32_t* lens,
+                         const uint8_t* const* data) override;
+
+private:
+    typedef std::map<id_type, std::vector<uint8_t>> PageMap;  // Ordered by page id
+
+    void flusherLoop();
+    void rethrowError();
+    // Copy of a parked page (called with mutex_ held); false if it is not parked
+    bool loadParked(id_type page, uint32_t& len, uint8_t** data) const;
+
+    IStorageManager& inner_;
+    size_t dirty_limit_;
+
+    std::mutex io_mutex_;          // Serialises calls into inner_ (not thread-safe)
+    std::mutex mutex_;             // Guards everything below
+    std::condition_variable work_cv_;
+    std::condition_variable room_cv_;
+    PageMap dirty_;                // Waiting for the flusher
+    PageMap in_flight_;            // Taken by the flusher, being written
+    size_t flush_waiters_;         // Threads inside flush(): drain below the trigger too
+    bool stop_;
+    std::exception_ptr error_;
+
+    std::atomic<uint64_t> stalls_;
+    std::atomic<uint64_t> absorbed_;
+    std::atomic<uint64_t> pages_written_;
+    std::atomic<uint64_t> runs_;
+
+    std::thread flusher_;
+};
+
+} // namespace SpatialIndex
+
+#endif // ASYNC_WRITE_BACK_H
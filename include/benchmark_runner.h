@@ -1,20 +1,42 @@
 #ifndef BENCHMARK_RUNNER_H
 #define BENCHMARK_RUNNER_H
 
+#include <iostream>
 #include <string>
 #include <spatialindex/SpatialIndex.h>
 #include "rtree_helpers.h"
 #include "workload_generator.h"
 #include "tree_setup.h"
+#include "tree_counters.h"
+#include "io_stats.h"
+#include "instrumentation.h"
+#include "perf_counters.h"
+#include "query_runner.h"
 
 namespace SpatialIndex {
 
-// Run benchmark with given tree and workload generator
-void runBenchmark(
+// Run benchmark with given tree and workload generator.
+// Points have workload_gen.dims() coordinates (the tree must match).
+// If the generator's mix includes queries, num_insertions counts all operations
+// and per-query results go to a separate "<output>_queries.csv".
+// With a recorder, no per-operation CSV lines are written: latencies go into
+// per-phase histograms (summary in "<output>_latency.csv") and the optional trace,
+// from which trace_to_csv --inserts rebuilds the per-insert rows.
+// Buffer and storage I/O counters are sampled at every progress milestone into
+// "<output>_io.csv": Ops/Inserts are cumulative, the I/O columns cover the interval.
+// With a profiler, hardware counters are read around every timed operation and
+// summed per phase (split vs non-split inserts, range, kNN) into "<output>_perf.csv".
+// Progress and summaries go to log. Returns the per-type totals of the timed operations.
+RunSummary runBenchmark(
     ISpatialIndex* tree,
+    const CountingStorageManager& counters,
+    const IoMonitor& io,
     WorkloadGenerator& workload_gen,
     int num_insertions,
-    const std::string& output_csv
+    const std::string& output_csv,
+    LatencyRecorder* recorder = nullptr,
+    PerfProfiler* profiler = nullptr,
+    std::ostream& log = std::cout
 );
 
 } // namespace SpatialIndex
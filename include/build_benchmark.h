@@ -0,0 +1,25 @@
+#ifndef BUILD_BENCHMARK_H
+#define BUILD_BENCHMARK_H
+
+#include <string>
+#include "workload_generator.h"
+#include "tree_setup.h"
+
+namespace SpatialIndex {
+
+// Build the same point set incrementally, with STR and with Hilbert ordering,
+// then run the same queries against each tree. One CSV row per build mode:
+// build time, node count, height, fill and follow-up query cost.
+// The generator is reset before every build; seed drives the query sequence.
+void runBuildBenchmark(
+    const TreeConfig& base_config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const WorkloadMix& query_mix,
+    int num_queries,
+    const std::string& output_csv
+);
+
+} // namespace SpatialIndex
+
+#endif // BUILD_BENCHMARK_H
@@ -0,0 +1,82 @@
+#ifndef BULK_LOAD_H
+#define BULK_LOAD_H
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <spatialindex/SpatialIndex.h>
+#include <spatialindex/RTree.h>
+#include "workload_generator.h"
+#include "tree_setup.h"
+
+namespace SpatialIndex {
+
+// Sequential source of points for bulk loading
+class PointSource {
+public:
+    virtual ~PointSource() {}
+    // Fetch the next point; false when exhausted
+    virtual bool next(double coords[2], id_type& id) = 0;
+    // Start again from the first point
+    virtual void rewind() = 0;
+};
+
+// First `count` inserts of a workload generator (ids 0..count-1 unless replayed);
+// the generator's later inserts continue after them
+class GeneratorPointSource : public PointSource {
+public:
+    GeneratorPointSource(WorkloadGenerator& gen, uint64_t count)
+        : gen_(gen), count_(count), produced_(0) {}
+
+    bool next(double coords[2], id_type& id) override;
+    void rewind() override;
+
+private:
+    WorkloadGenerator& gen_;
+    uint64_t count_;
+    uint64_t produced_;
+};
+
+// Text file with one point per line: "x,y" or "id,x,y" (a non-numeric first line is skipped)
+class CsvPointSource : public PointSource {
+public:
+    explicit CsvPointSource(const std::string& path);
+
+    bool next(double coords[2], id_type& id) override;
+    void rewind() override;
+
+private:
+    std::string path_;
+    std::ifstream in_;
+    id_type next_id_;
+};
+
+// Adapts a PointSource to the IDataStream consumed by libspatialindex's bulk loader
+class PointDataStream : public IDataStream {
+public:
+    explicit PointDataStream(PointSource& source);
+
+    IData* getNext() override;
+    bool hasNext() override { return has_next_; }
+    uint32_t size() override { return static_cast<uint32_t>(count_); }
+    void rewind() override;
+
+private:
+    void advance();
+
+    PointSource& source_;
+    double coords_[2];
+    id_type id_;
+    bool has_next_;
+    uint64_t count_; // Points handed out so far
+};
+
+// Build a tree over `source` into `sm` using config.build_mode ("STR" or "HILBERT").
+// STR uses libspatialindex's packer; HILBERT sorts by Hilbert key with a parallel
+// external sort and packs the sorted run bottom-up at config.bulk_fill_factor.
+ISpatialIndex* bulkLoadTree(const TreeConfig& config, IStorageManager& sm,
+                            PointSource& source, id_type& index_id);
+
+} // namespace SpatialIndex
+
+#endif // BULK_LOAD_H
@@ -0,0 +1,38 @@
+#ifndef CODEC_BENCHMARK_H
+#define CODEC_BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include "workload_generator.h"
+#include "tree_setup.h"
+#include "leaf_codec.h"
+
+namespace SpatialIndex {
+
+// "NONE", "Q16", "Q32" or "COMPARE" (all three); throws on anything else
+std::vector<LeafCodec> getLeafCodecs(const std::string& name);
+
+// Leaf page formats on the same points and queries. Every codec gets a fresh
+// on-disk tree, built by inserting the points one by one, whose leaves fill
+// one page (config.leaf_capacity overrides this); index nodes keep
+// config.M_capacity. Quantised trees answer through a refine step against
+// the exact points in "<base>_points.bin": range candidates whose cell box
+// straddles the window are checked, kNN takes the k nearest cell boxes as a
+// bound and rechecks every point within it.
+// One CSV row per codec: fanout, nodes, index size on disk, page I/O per
+// insert and per query, refine reads, encode / decode time and the number
+// of queries whose result count differs from the first codec's.
+// Per-query rows go to "<output>_queries.csv".
+void runLeafCodecBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const std::vector<LeafCodec>& codecs,
+    int num_queries,
+    int num_insertions,
+    const std::string& output_csv
+);
+
+} // namespace SpatialIndex
+
+#endif // CODEC_BENCHMARK_H
@@ -0,0 +1,56 @@
+#ifndef CONCURRENT_BENCHMARK_H
+#define CONCURRENT_BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "workload_generator.h"
+#include "tree_setup.h"
+#include "sharded_index.h"
+
+namespace SpatialIndex {
+
+// How readers and writers share the index. Queries on one libspatialindex
+// tree are fully serialised with its inserts (see LockedIndex); only
+// SHARDED_LATCH (other shards) and SNAPSHOT (another structure) let reads
+// overlap writes.
+enum class ConcurrencyScheme {
+    GLOBAL_LOCK,   // One tree behind one lock held by every operation (LockedIndex)
+    SHARDED_LATCH, // Spatial partitions, each tree behind its own latch (latched ShardedIndex)
+    SNAPSHOT       // Writers on one locked tree; readers on the last published read-only
+                   // PackedRTree, rebuilt by a publisher thread as inserts land
+};
+
+ConcurrencyScheme getConcurrencyScheme(const std::string& scheme_str);
+const char* concurrencySchemeName(ConcurrencyScheme scheme);
+
+struct ConcurrentOptions {
+    ConcurrencyScheme scheme = ConcurrencyScheme::GLOBAL_LOCK;
+    uint32_t writers = 1;
+    std::vector<uint32_t> reader_counts = {0, 1, 2, 4, 8};
+    // SHARDED_LATCH only
+    uint32_t shards = 16;
+    ShardPartition partition = ShardPartition::KD;
+    // SNAPSHOT only: publish once at least this many new points are in the tree
+    uint64_t snapshot_inserts = 10000;
+};
+
+// For every reader count, build a fresh index and let `writers` threads insert
+// num_insertions points while that many reader threads issue window / kNN
+// queries (by the generator's mix) until the writers finish. The reader-free
+// run always goes first, whether or not reader_counts lists 0. One CSV row per
+// reader count: the read path (SERIALISED, SHARD_LATCH or SNAPSHOT), shard
+// count, writer throughput and slowdown against the reader-free run, reader
+// throughput and latency percentiles, and for SNAPSHOT the number of
+// snapshots published and how many inserted points a query missed on average.
+void runConcurrentBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    const ConcurrentOptions& options,
+    int num_insertions,
+    const std::string& output_csv
+);
+
+} // namespace SpatialIndex
+
+#endif // CONCURRENT_BENCHMARK_H
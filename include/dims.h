@@ -0,0 +1,34 @@
+#ifndef DIMS_H
+#define DIMS_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace SpatialIndex {
+
+// Highest point dimension the workloads and runners are instantiated for
+constexpr uint32_t kMaxDims = 4;
+
+template <uint32_t D>
+using DimTag = std::integral_constant<uint32_t, D>;
+
+// Call f(DimTag<D>()) with the run-time dimension turned into a compile-time
+// constant, so the code inside f loops over a fixed number of coordinates.
+// Only 2-, 3- and 4-D are instantiated.
+template <typename F>
+auto dispatchDims(uint32_t dims, F&& f) -> decltype(f(DimTag<2>())) {
+    switch (dims) {
+        case 2: return f(DimTag<2>());
+        case 3: return f(DimTag<3>());
+        case 4: return f(DimTag<4>());
+        default:
+            throw std::invalid_argument("Unsupported dimension: " + std::to_string(dims) +
+                                        ". Use 2, 3 or 4.");
+    }
+}
+
+} // namespace SpatialIndex
+
+#endif // DIMS_H
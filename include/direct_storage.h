@@ -0,0 +1,111 @@
+#ifndef DIRECT_STORAGE_H
+#define DIRECT_STORAGE_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <spatialindex/SpatialIndex.h>
+
+namespace SpatialIndex {
+
+// Storage managers that can move many pages per call. The helpers below use
+// the batch path when a manager implements it and fall back to one call per
+// page otherwise, so callers never need to know what is underneath.
+class IBatchStorageManager : public IStorageManager {
+public:
+    // Load n pages; data[i] is allocated with new[] like loadByteArray
+    virtual void loadByteArrays(size_t n, const id_type* pages, uint32_t* lens, uint8_t** data) = 0;
+    // Rewrite n existing pages
+    virtual void storeByteArrays(size_t n, const id_type* pages, const uint32_t* lens,
+                                 const uint8_t* const* data) = 0;
+};
+
+void loadPages(IStorageManager& sm, size_t n, const id_type* pages, uint32_t* lens, uint8_t** data);
+void storePages(IStorageManager& sm, size_t n, const id_type* pages, const uint32_t* lens,
+                const uint8_t* const* data);
+
+// How DirectStorageManager issues I/O
+enum class IoEngine {
+    AUTO,    // io_uring if the kernel allows it, otherwise THREADS
+    URING,   // io_uring (raw system calls, no liburing needed)
+    THREADS  // pread/pwrite; batches are spread over a thread pool
+};
+
+IoEngine getIoEngine(const std::string& engine_str);
+const char* ioEngineName(IoEngine engine);
+
+struct DirectStorageOptions {
+    uint32_t page_size = 4096;  // Must be a multiple of 512 for O_DIRECT
+    bool direct = true;         // O_DIRECT, bypassing the page cache (falls back if unsupported)
+    IoEngine engine = IoEngine::AUTO;
+    uint32_t queue_depth = 64;  // io_uring entries
+    uint32_t io_threads = 4;    // THREADS: pool size for batches
+    std::ostream* log = &std::cerr;  // Fallback warnings
+};
+
+class PageIo;
+
+// Disk storage manager for Linux doing page-aligned I/O on "<base>.dat",
+// with the page table in "<base>.idx" (written by flush()). Each byte array
+// occupies a run of whole pages; rewrites of the same size stay in place.
+// Batches are submitted together (one io_uring submission, or one task per
+// page for the thread pool), so reads and writes of many pages overlap on
+// the device. Like libspatialindex's disk manager it is not thread-safe.
+class DirectStorageManager : public IBatchStorageManager {
+public:
+    // open_existing: reopen the files left by a previous flush() instead of truncating them
+    DirectStorageManager(const std::string& base_name, const DirectStorageOptions& options,
+                         bool open_existing = false);
+    ~DirectStorageManager() override;
+
+    DirectStorageManager(const DirectStorageManager&) = delete;
+    DirectStorageManager& operator=(const DirectStorageManager&) = delete;
+
+    IoEngine engine() const { return engine_; }
+    bool direct() const { return direct_; }
+    uint64_t filePages() const { return next_file_page_; }
+
+    // IStorageManager interface
+    void loadByteArray(const id_type page, uint32_t& len, uint8_t** data) override;
+    void storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) override;
+    void deleteByteArray(const id_type page) override;
+    void flush() override;
+
+    // IBatchStorageManager interface
+    void loadByteArrays(size_t n, const id_type* pages, uint32_t* lens, uint8_t** data) override;
+    void storeByteArrays(size_t n, const id_type* pages, const uint32_t* lens,
+                         const uint8_t* const* data) override;
+
+private:
+    struct Extent {
+        uint64_t first_page;
+        uint32_t pages;   // 0 for a free id
+        uint32_t len;
+    };
+
+    uint32_t pagesFor(uint32_t len) const;
+    uint64_t allocatePages(uint32_t pages);
+    void freePages(const Extent& e);
+    const Extent& extentOf(id_type page) const;
+    void writeIndex();
+    void readIndex();
+
+    std::string base_name_;
+    DirectStorageOptions options_;
+    IoEngine engine_;
+    bool direct_;
+    int fd_;
+    std::unique_ptr<PageIo> io_;
+
+    std::vector<Extent> extents_;                          // Indexed by page id
+    std::vector<id_type> free_ids_;
+    std::map<uint32_t, std::vector<uint64_t>> free_runs_;  // Run length -> first file pages
+    uint64_t next_file_page_;
+};
+
+} // namespace SpatialIndex
+
+#endif // DIRECT_STORAGE_H
@@ -0,0 +1,49 @@
+#ifndef EXPERIMENT_H
+#define EXPERIMENT_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace SpatialIndex {
+
+// One run_rtree invocation: the ten positional arguments plus the key=value
+// options (see run_rtree.cpp for the full list)
+struct ExperimentArgs {
+    std::string run_type;          // "mem", "disk" or "generate"
+    int M = 16;
+    double fill_factor = 0.5;
+    int num_insertions = 0;
+    std::string buffer_type = "NONE";
+    int buffer_pages = 0;
+    std::string tree_variant = "LINEAR";
+    std::string data_type = "RANDOM";
+    int page_size = 4096;
+    std::string output_file;
+    std::map<std::string, std::string> options;
+    std::string disk_base_name = "disk_tree_data";  // Prefix of every file the run creates
+};
+
+// Throughput and latency the single-tree runners (serial, pipelined, SWARE)
+// measured inside their timed operations; setup, bulk loads and CSV output
+// are not included. Runners that write one row per configuration (builds,
+// shards, readers, engines, ...) leave ops at 0.
+struct ExperimentResult {
+    uint64_t ops = 0;            // Inserted points plus queries
+    double timed_s = 0.0;        // Time inside the timed operations
+    double avg_insert_us = 0.0;  // Per inserted point (SWARE: flush time spread over its points)
+    double avg_query_us = 0.0;   // Range and kNN queries
+
+    double opsPerSec() const { return timed_s > 0.0 ? ops / timed_s : 0.0; }
+};
+
+// Build the workload and tree an experiment describes and run the benchmark
+// its options select, writing progress and summaries to log. Throws
+// std::invalid_argument for bad options and std::runtime_error (or what the
+// benchmark throws) on failure.
+ExperimentResult runExperiment(const ExperimentArgs& args, std::ostream& log = std::cout);
+
+} // namespace SpatialIndex
+
+#endif // EXPERIMENT_H
@@ -0,0 +1,70 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <spatialindex/SpatialIndex.h>
+
+namespace SpatialIndex {
+
+// A point tagged with its sort key (e.g. a Hilbert key)
+struct SortRecord {
+    uint64_t key;
+    double coords[2];
+    id_type id;
+
+    bool operator<(const SortRecord& o) const { return key < o.key; }
+};
+
+// Sorts an arbitrarily long stream of records by key. Up to memory_items
+// records are held in memory; each full buffer is sorted with several
+// threads and spilled as a run file, and next() k-way merges the runs.
+// If nothing was spilled the in-memory buffer is returned directly.
+class ParallelExternalSorter {
+public:
+    ParallelExternalSorter(size_t memory_items, unsigned threads, const std::string& tmp_prefix);
+    ~ParallelExternalSorter();
+
+    ParallelExternalSorter(const ParallelExternalSorter&) = delete;
+    ParallelExternalSorter& operator=(const ParallelExternalSorter&) = delete;
+
+    void add(const SortRecord& rec);
+    // Sort what is left and prepare the merge; no add() afterwards
+    void finish();
+    // Next record in key order; false when exhausted
+    bool next(SortRecord& out);
+
+    uint64_t size() const { return total_; }
+    size_t runs() const { return runs_.size(); }
+
+private:
+    struct Run {
+        std::string path;
+        std::FILE* file = nullptr;
+        std::vector<SortRecord> buf;
+        size_t pos = 0;
+    };
+
+    void sortBuffer();
+    void spill();
+    bool refill(Run& run);
+
+    size_t memory_items_;
+    unsigned threads_;
+    std::string tmp_prefix_;
+    std::vector<SortRecord> buffer_;
+    size_t buffer_pos_;
+    std::vector<Run> runs_;
+    std::vector<std::pair<uint64_t, size_t>> heap_; // (key, run), min-heap
+    uint64_t total_;
+    bool finished_;
+};
+
+// Sort records in place using up to `threads` threads
+void parallelSort(std::vector<SortRecord>& records, unsigned threads);
+
+} // namespace SpatialIndex
+
+#endif // EXTERNAL_SORT_H
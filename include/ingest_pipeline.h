@@ -0,0 +1,45 @@
+#ifndef INGEST_PIPELINE_H
+#define INGEST_PIPELINE_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <spatialindex/SpatialIndex.h>
+#include "workload_generator.h"
+#include "tree_counters.h"
+#include "io_stats.h"
+#include "instrumentation.h"
+#include "query_runner.h"
+
+namespace SpatialIndex {
+
+struct IngestPipelineOptions {
+    size_t ring_items = 65536;  // Preallocated operations between generator and insert stage
+    size_t batch_items = 256;   // Operations the insert stage takes off the ring at a time
+    size_t log_items = 16384;   // Records between insert stage and logging stage
+};
+
+// runBenchmark split into three stages connected by lock-free SPSC rings:
+//   1. a generator thread drawing operations (or replaying a workload file),
+//   2. the calling thread draining operation batches into the tree through
+//      PointInserter (queries run in stream order between the inserts),
+//   3. a logging thread formatting the CSV lines / feeding the recorder.
+// Output files and per-operation measurements match runBenchmark. Ring
+// waits are reported at the end: generator stalls mean the tree is the
+// bottleneck, insert-stage waits mean the generator is. The logging thread
+// writes progress to log. Returns the same per-type totals as runBenchmark.
+RunSummary runPipelinedBenchmark(
+    ISpatialIndex* tree,
+    const CountingStorageManager& counters,
+    const IoMonitor& io,
+    WorkloadGenerator& workload_gen,
+    int num_insertions,
+    const std::string& output_csv,
+    const IngestPipelineOptions& options,
+    LatencyRecorder* recorder = nullptr,
+    std::ostream& log = std::cout
+);
+
+} // namespace SpatialIndex
+
+#endif // INGEST_PIPELINE_H
@@ -0,0 +1,117 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <thread>
+#include "latency_histogram.h"
+#include "spsc_ring.h"
+
+namespace SpatialIndex {
+
+// Timed phases. SPLIT is an insert that split at least one node.
+enum class LatencyPhase : uint8_t {
+    INSERT = 0,
+    SPLIT = 1,
+    RANGE_QUERY = 2,
+    KNN_QUERY = 3,
+    FLUSH = 4,
+    COUNT = 5
+};
+
+const char* latencyPhaseName(LatencyPhase phase);
+
+// Flags stored in TraceRecord::flags
+constexpr uint8_t kTraceDidSplit = 0x1;
+constexpr uint8_t kTraceRootSplit = 0x2;
+
+// One fixed-size record per operation in the binary trace
+struct TraceRecord {
+    uint64_t op_idx;
+    uint64_t latency_ns;
+    uint32_t nodes;    // Nodes visited (queries) or node writes (inserts)
+    uint8_t phase;     // LatencyPhase
+    uint8_t flags;
+    uint16_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord layout is part of the file format");
+
+// File header: magic, format version, record size
+constexpr char kTraceMagic[8] = {'R', 'T', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr uint32_t kTraceVersion = 1;
+
+// Writes TraceRecords to a file from a background thread. The timed thread
+// only copies a record into a lock-free ring; if the ring is full it spins
+// (counted as a stall) rather than dropping records.
+class TraceWriter {
+public:
+    TraceWriter(const std::string& path, size_t ring_capacity = 1 << 16);
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    void push(const TraceRecord& rec) {
+        while (!ring_.tryPush(rec)) {
+            stalls_.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::yield();
+        }
+    }
+
+    // Drain the ring, stop the writer thread and close the file.
+    // Throws std::runtime_error if any write to the trace failed.
+    void close();
+
+    uint64_t stalls() const { return stalls_.load(std::memory_order_relaxed); }
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+
+private:
+    void writerLoop();
+    [[noreturn]] void fail();
+
+    std::string path_;
+    std::FILE* file_;
+    SpscRing<TraceRecord> ring_;
+    std::atomic<bool> stop_;
+    std::atomic<bool> write_failed_;  // Set by the writer thread; records are then discarded
+    std::atomic<uint64_t> stalls_;
+    std::atomic<uint64_t> written_;
+    std::thread writer_;
+};
+
+// Per-phase latency histograms with an optional binary per-op trace.
+// Used by the runners in place of per-operation CSV lines.
+class LatencyRecorder {
+public:
+    // An empty trace_path disables the per-op trace
+    explicit LatencyRecorder(const std::string& trace_path = "");
+    ~LatencyRecorder();
+
+    void record(LatencyPhase phase, uint64_t op_idx, uint64_t latency_ns,
+                uint32_t nodes = 0, uint8_t flags = 0) {
+        histograms_[static_cast<int>(phase)].record(latency_ns);
+        if (trace_) trace_->push({op_idx, latency_ns, nodes, static_cast<uint8_t>(phase), flags, 0});
+    }
+
+    const LatencyHistogram& histogram(LatencyPhase phase) const {
+        return histograms_[static_cast<int>(phase)];
+    }
+
+    // Flush and close the trace (if any); throws if writing it failed
+    void finish();
+
+    // Phase,Count,Min_ns,P50_ns,P99_ns,P999_ns,Max_ns,Mean_ns
+    bool writeSummary(const std::string& csv_path) const;
+    void printSummary(std::ostream& os) const;
+
+private:
+    LatencyHistogram histograms_[static_cast<int>(LatencyPhase::COUNT)];
+    TraceWriter* trace_;
+};
+
+} // namespace SpatialIndex
+
+#endif // INSTRUMENTATION_H
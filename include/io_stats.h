@@ -0,0 +1,110 @@
+#ifndef IO_STATS_H
+#define IO_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <spatialindex/SpatialIndex.h>
+#include "direct_storage.h"
+
+namespace SpatialIndex {
+
+class AsyncWriteBackStorageManager;
+
+// Plain copy of the I/O counters at one instant (or the difference of two)
+struct IoSnapshot {
+    // Storage manager level: with a buffer in place these are the page
+    // transfers the buffer could not absorb
+    uint64_t page_reads = 0;
+    uint64_t page_writes = 0;   // Existing pages rewritten
+    uint64_t page_allocs = 0;   // New pages
+    uint64_t page_deletes = 0;
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    uint64_t load_ns = 0;       // Time inside loadByteArray
+    uint64_t store_ns = 0;      // Time inside storeByteArray
+
+    // Buffer level (zero without a buffer)
+    bool buffered = false;
+    uint64_t hits = 0;          // IBuffer::getHits(): loads and updates served by the buffer
+    uint64_t misses = 0;        // Loads the buffer passed down
+    uint64_t write_backs = 0;   // Dirty pages the buffer wrote on eviction or flush
+    bool evictions_known = false;  // libspatialindex's own buffers do not report evictions
+    uint64_t evictions = 0;
+    uint64_t write_back_stalls = 0;  // Stores blocked on a full asynchronous dirty set
+
+    double hitRatio() const {
+        return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0;
+    }
+};
+
+// Counters accumulated since `earlier`
+IoSnapshot ioDelta(const IoSnapshot& later, const IoSnapshot& earlier);
+
+// Storage-manager layer placed directly on top of the memory or disk storage
+// manager: counts page transfers and bytes, and times every load and store.
+// Counters are relaxed atomics, readable at any time from any thread.
+// Batches are passed on as batches (timed as one call).
+class IoStatsStorageManager : public IBatchStorageManager {
+public:
+    explicit IoStatsStorageManager(IStorageManager& inner);
+
+    IoSnapshot snapshot() const;
+
+    // IStorageManager interface
+    void loadByteArray(const id_type page, uint32_t& len, uint8_t** data) override;
+    void storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) override;
+    void deleteByteArray(const id_type page) override;
+    void flush() override;
+
+    // IBatchStorageManager interface
+    void loadByteArrays(size_t n, const id_type* pages, uint32_t* lens, uint8_t** data) override;
+    void storeByteArrays(size_t n, const id_type* pages, const uint32_t* lens,
+                         const uint8_t* const* data) override;
+
+private:
+    IStorageManager& inner_;
+    std::atomic<uint64_t> page_reads_;
+    std::atomic<uint64_t> page_writes_;
+    std::atomic<uint64_t> page_allocs_;
+    std::atomic<uint64_t> page_deletes_;
+    std::atomic<uint64_t> bytes_read_;
+    std::atomic<uint64_t> bytes_written_;
+    std::atomic<uint64_t> load_ns_;
+    std::atomic<uint64_t> store_ns_;
+};
+
+// Combined view of the storage counters and the buffer above them.
+// Misses and write-backs are counted at the buffer's lower edge: by
+// `boundary` when layers (the write-back set) sit between the buffer and
+// `storage`, otherwise by `storage` itself.
+class IoMonitor {
+public:
+    IoMonitor() : storage_(nullptr), buffer_(nullptr), write_back_(nullptr), boundary_(nullptr) {}
+    IoMonitor(const IoStatsStorageManager* storage, StorageManager::IBuffer* buffer,
+              const AsyncWriteBackStorageManager* write_back = nullptr,
+              const IoStatsStorageManager* boundary = nullptr)
+        : storage_(storage), buffer_(buffer), write_back_(write_back), boundary_(boundary) {}
+
+    IoSnapshot snapshot() const;
+
+private:
+    const IoStatsStorageManager* storage_;
+    StorageManager::IBuffer* buffer_;
+    const AsyncWriteBackStorageManager* write_back_;
+    const IoStatsStorageManager* boundary_;
+};
+
+// CSV helpers shared by the benchmark runners (fields are comma-prefixed;
+// Evictions is left empty when the buffer does not report it)
+void writeIoCsvHeader(std::ostream& out);
+void writeIoCsvFields(std::ostream& out, const IoSnapshot& s);
+void printIoSummary(std::ostream& out, const IoSnapshot& s);
+
+// Size of a file on disk, 0 if it cannot be opened
+uint64_t fileBytes(const std::string& path);
+
+} // namespace SpatialIndex
+
+#endif // IO_STATS_H
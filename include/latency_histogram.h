@@ -0,0 +1,61 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace SpatialIndex {
+
+// Monotonic nanosecond timestamp
+inline uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// HDR-style log-linear histogram of nanosecond values. Values below 2^kSubBits
+// are exact; larger values keep their top kSubBits bits (< 1% relative error).
+// Recording is a couple of shifts and an increment.
+class LatencyHistogram {
+public:
+    static constexpr uint32_t kSubBits = 8;
+
+    LatencyHistogram();
+
+    void record(uint64_t value_ns) {
+        ++counts_[bucketOf(value_ns)];
+        ++count_;
+        sum_ += value_ns;
+        if (value_ns < min_) min_ = value_ns;
+        if (value_ns > max_) max_ = value_ns;
+    }
+
+    void merge(const LatencyHistogram& other);
+    void clear();
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0.0; }
+    // Highest value equivalent to the given percentile (0-100), capped at max()
+    uint64_t percentile(double p) const;
+
+private:
+    static uint32_t bucketOf(uint64_t v) {
+        if (v < (1ull << kSubBits)) return static_cast<uint32_t>(v);
+        const uint32_t mag = 63u - static_cast<uint32_t>(__builtin_clzll(v));
+        const uint32_t shift = mag - kSubBits + 1;
+        return shift * (1u << (kSubBits - 1)) + static_cast<uint32_t>(v >> shift);
+    }
+    static uint64_t bucketHigh(uint32_t idx);
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+} // namespace SpatialIndex
+
+#endif // LATENCY_HISTOGRAM_H
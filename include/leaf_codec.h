@@ -0,0 +1,92 @@
+#ifndef LEAF_CODEC_H
+#define LEAF_CODEC_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <spatialindex/SpatialIndex.h>
+
+namespace SpatialIndex {
+
+// On-page format of leaf nodes
+enum class LeafCodec {
+    NONE,  // libspatialindex's own: double low / high per entry, 64-bit id, data length
+    Q16,   // Coordinates as 16-bit cells of the leaf MBR, delta-encoded ids
+    Q32    // Same with 32-bit cells
+};
+
+// Node type field of compact leaf pages (libspatialindex writes 1 for index
+// nodes and 2 for leaves); the level stays in the second field
+constexpr uint32_t kCompactLeafType = 0x51430002;
+
+// "NONE", "Q16" or "Q32"; throws on anything else
+LeafCodec getLeafCodec(const std::string& name);
+const char* leafCodecName(LeafCodec codec);
+
+// Leaf entries that fit one page, assuming id gaps below 2^28 within a leaf
+// (larger gaps only make a leaf spill onto a second page)
+uint32_t leafPageCapacity(LeafCodec codec, uint32_t dims, uint32_t page_size);
+
+// Running totals of a LeafCodecStorageManager
+struct LeafCodecStats {
+    uint64_t leaves_encoded = 0;
+    uint64_t entries_encoded = 0;
+    uint64_t raw_bytes = 0;      // Leaf pages as the tree wrote them
+    uint64_t encoded_bytes = 0;  // Same pages as stored
+    uint64_t encode_ns = 0;
+    uint64_t leaves_decoded = 0;
+    uint64_t decode_ns = 0;
+};
+
+// Storage-manager layer between the tree counters and the buffer that stores
+// point leaves compactly: every coordinate becomes a 16- or 32-bit cell index
+// of the leaf MBR (kept exactly in the page), ids are sorted and stored as
+// varint deltas. Decoding hands the tree the cell box of each entry, which
+// always contains the original point, so queries return a superset that a
+// refine step against the exact points turns into the exact answer. Pages
+// that are not point leaves (index nodes, the tree header, entries with a
+// payload) pass through unchanged.
+//
+// The tree sees cell boxes rather than points: deleteData needs the exact
+// entry MBR and so only works with NONE. When a leaf MBR changes, boxes are
+// requantised outward and can grow by up to one cell.
+class LeafCodecStorageManager : public IStorageManager {
+public:
+    LeafCodecStorageManager(IStorageManager& inner, LeafCodec codec, uint32_t dims,
+                            id_type header_page = StorageManager::NewPage);
+
+    // Pass the tree's header page through from now on
+    void attach(id_type header_page) { header_page_ = header_page; }
+
+    LeafCodec codec() const { return codec_; }
+    LeafCodecStats stats() const;
+
+    // IStorageManager interface
+    void loadByteArray(const id_type page, uint32_t& len, uint8_t** data) override;
+    void storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) override;
+    void deleteByteArray(const id_type page) override;
+    void flush() override;
+
+private:
+    // Compact form of a raw point leaf in out (false: store raw)
+    bool encode(const uint8_t* data, uint32_t len, std::string& out) const;
+    void decode(const uint8_t* data, uint32_t len, uint32_t& raw_len, uint8_t** raw) const;
+
+    IStorageManager& inner_;
+    LeafCodec codec_;
+    uint32_t dims_;
+    uint32_t bits_;
+    id_type header_page_;
+
+    std::atomic<uint64_t> leaves_encoded_;
+    std::atomic<uint64_t> entries_encoded_;
+    std::atomic<uint64_t> raw_bytes_;
+    std::atomic<uint64_t> encoded_bytes_;
+    std::atomic<uint64_t> encode_ns_;
+    std::atomic<uint64_t> leaves_decoded_;
+    std::atomic<uint64_t> decode_ns_;
+};
+
+} // namespace SpatialIndex
+
+#endif // LEAF_CODEC_H
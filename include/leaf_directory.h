@@ -0,0 +1,77 @@
+#ifndef LEAF_DIRECTORY_H
+#define LEAF_DIRECTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <spatialindex/SpatialIndex.h>
+
+namespace SpatialIndex {
+
+// Outcome of LeafDirectory::movePoint
+enum class MoveResult {
+    IN_LEAF,   // New position inside the leaf MBR: the entry was rewritten in place
+    ENLARGED,  // Leaf MBR grown inside its parent's MBR: leaf and parent entry rewritten
+    MISSED     // Unknown entry or the point leaves the parent: delete and reinsert instead
+};
+
+// Storage-manager layer directly under the R-tree (above the counters) that
+// watches node pages go by and remembers which leaf page holds each data id
+// and which index page holds each node. movePoint() then updates a point
+// bottom-up: rewrite its leaf entry when the new position stays inside the
+// leaf MBR, or grow the leaf MBR when it stays inside the parent's MBR,
+// without the root-down search of deleteData. Rewritten pages go through the
+// layers below like the tree's own writes, so buffers stay coherent and the
+// counters see the I/O.
+//
+// Relies on libspatialindex's node page layout: uint32 type, level and child
+// count, per child low[dims], high[dims], id, uint32 data length and data,
+// then the node MBR. A grown or vacated leaf MBR stays a valid cover but is
+// no longer tight: queries, deletes and inserts handle that, only
+// isIndexValid() (which insists on tight MBRs) reports such nodes. The
+// directory only holds hints; each one is checked against the page first.
+class LeafDirectory : public IStorageManager {
+public:
+    LeafDirectory(IStorageManager& inner, uint32_t dims);
+
+    // Skip the tree's header page (the tree's index identifier) from now on
+    void attach(id_type header_page);
+
+    // Move data entry `id` from point `from` to point `to` if its leaf allows it
+    MoveResult movePoint(id_type id, const double* from, const double* to);
+
+    size_t trackedEntries() const { return leaf_of_.size(); }
+
+    // IStorageManager interface
+    void loadByteArray(const id_type page, uint32_t& len, uint8_t** data) override;
+    void storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) override;
+    void deleteByteArray(const id_type page) override;
+    void flush() override;
+
+private:
+    // A loaded node page and where its fields sit
+    struct NodePage {
+        std::unique_ptr<uint8_t[]> data;
+        uint32_t len = 0;
+        uint32_t level = 0;
+        std::vector<size_t> entries;  // Offset of each child's low[]
+        size_t mbr = 0;               // Offset of the node MBR's low[]
+    };
+
+    bool parse(const uint8_t* data, uint32_t len, NodePage& out) const;
+    bool load(id_type page, NodePage& out);
+    void record(id_type page, const uint8_t* data, uint32_t len);
+    id_type entryId(const NodePage& node, size_t e) const;
+
+    IStorageManager& inner_;
+    uint32_t dims_;
+    id_type header_page_;
+    std::unordered_map<id_type, id_type> leaf_of_;    // Data id -> leaf page
+    std::unordered_map<id_type, id_type> parent_of_;  // Node page -> parent page
+};
+
+} // namespace SpatialIndex
+
+#endif // LEAF_DIRECTORY_H
@@ -0,0 +1,40 @@
+#ifndef LOCKED_INDEX_H
+#define LOCKED_INDEX_H
+
+#include <mutex>
+#include <spatialindex/SpatialIndex.h>
+
+namespace SpatialIndex {
+
+// One coarse lock around another ISpatialIndex, held for every operation.
+// Queries take it exclusively as well: the RTree reads nodes through shared
+// pointer pools and bumps shared statistics without locking, so two queries
+// on one tree must not overlap.
+class LockedIndex : public ISpatialIndex {
+public:
+    explicit LockedIndex(ISpatialIndex& tree) : tree_(tree) {}
+
+    // ISpatialIndex interface
+    void insertData(uint32_t len, const uint8_t* pData, const IShape& shape, id_type shapeIdentifier) override;
+    bool deleteData(const IShape& shape, id_type shapeIdentifier) override;
+    void containsWhatQuery(const IShape& query, IVisitor& v) override;
+    void intersectsWithQuery(const IShape& query, IVisitor& v) override;
+    void pointLocationQuery(const Point& query, IVisitor& v) override;
+    void nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc) override;
+    void nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v) override;
+    void selfJoinQuery(const IShape& s, IVisitor& v) override;
+    void queryStrategy(IQueryStrategy& qs) override;
+    void getIndexProperties(Tools::PropertySet& out) const override;
+    void addCommand(ICommand* in, CommandType ct) override;
+    bool isIndexValid() override;
+    void getStatistics(IStatistics** out) const override;
+    void flush() override;
+
+private:
+    ISpatialIndex& tree_;
+    mutable std::mutex lock_;
+};
+
+} // namespace SpatialIndex
+
+#endif // LOCKED_INDEX_H
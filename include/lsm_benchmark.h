@@ -0,0 +1,28 @@
+#ifndef LSM_BENCHMARK_H
+#define LSM_BENCHMARK_H
+
+#include <string>
+#include "workload_generator.h"
+#include "tree_setup.h"
+#include "lsm_index.h"
+
+namespace SpatialIndex {
+
+// Ingest the same num_insertions points into an incremental LINEAR tree, an
+// incremental RSTAR tree and an LsmIndex built from `config`, then run the same
+// queries against each. One CSV row per engine: insert throughput and latency
+// (avg / p99 / max), the time to settle afterwards (tree flush, or waiting for
+// the LSM's flushes and merges), bytes written and write amplification over the
+// raw points, and query latency (avg / p99) with the components each query probed.
+void runLsmBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    const LsmOptions& options,
+    int num_insertions,
+    int num_queries,
+    const std::string& output_csv
+);
+
+} // namespace SpatialIndex
+
+#endif // LSM_BENCHMARK_H
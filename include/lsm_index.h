@@ -0,0 +1,170 @@
+#ifndef LSM_INDEX_H
+#define LSM_INDEX_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <spatialindex/SpatialIndex.h>
+#include "tree_setup.h"
+
+namespace SpatialIndex {
+
+struct Neighbor;
+
+struct LsmOptions {
+    size_t memtable_items = 100000;  // Points held in memory before the memtable is flushed
+    uint32_t fanout = 4;             // Runs per tier; a full tier merges into one run of the next
+    uint32_t max_immutable = 2;      // Frozen memtables awaiting a flush before inserts stall
+    bool background = true;          // Flush and compact on a background thread (false: inline)
+};
+
+// Log-structured index for 2-D points. Inserts go to a small in-memory R-tree
+// (the memtable). A full memtable is frozen and flushed into an immutable,
+// bulk-loaded run (STR, or Hilbert order with build_mode HILBERT) stored as
+// config.run_type says. Runs are tiered: once a tier holds `fanout` runs they
+// are merged into a single run of the next tier, so each point is rewritten
+// about once per tier.
+//
+// Queries fan out to the memtable, the frozen memtables and every run whose
+// data MBR can match; kNN visits components closest-first. Deletes of points
+// that already left the memtable leave a tombstone that hides one copy until
+// a merge drops it.
+//
+// Each run also keeps its points as a flat array (a ".pts" file next to disk
+// runs), so merges never read the trees that queries are using. One thread
+// inserts, deletes and queries; flushes and merges run on the background thread.
+class LsmIndex : public ISpatialIndex {
+public:
+    // config: memtable shape (M, fill factor, variant) and run storage
+    // (run_type, storage, buffer split across `fanout` runs, build_mode)
+    LsmIndex(const TreeConfig& config, const LsmOptions& options);
+    ~LsmIndex() override;
+
+    LsmIndex(const LsmIndex&) = delete;
+    LsmIndex& operator=(const LsmIndex&) = delete;
+
+    // Wait until every frozen memtable is flushed and no tier is full
+    void drain();
+
+    uint64_t flushes() const { return flushes_.load(std::memory_order_relaxed); }
+    uint64_t compactions() const { return compactions_.load(std::memory_order_relaxed); }
+    size_t runCount() const;
+    uint64_t tombstoneCount() const;
+    uint64_t insertStalls() const { return insert_stalls_; }
+    uint64_t stallNs() const { return stall_ns_; }
+    // Points written into runs by flushes and merges; over the inserts this is the write amplification
+    uint64_t pointsWritten() const { return points_written_.load(std::memory_order_relaxed); }
+    uint64_t bytesWritten() const { return bytes_written_.load(std::memory_order_relaxed); }
+    // Memtables and runs searched by queries, after the MBR filter
+    uint64_t componentsProbed() const { return components_probed_.load(std::memory_order_relaxed); }
+
+    // ISpatialIndex interface (payloads are not stored)
+    void insertData(uint32_t len, const uint8_t* pData, const IShape& shape, id_type shapeIdentifier) override;
+    bool deleteData(const IShape& shape, id_type shapeIdentifier) override;
+    void containsWhatQuery(const IShape& query, IVisitor& v) override;
+    void intersectsWithQuery(const IShape& query, IVisitor& v) override;
+    void pointLocationQuery(const Point& query, IVisitor& v) override;
+    void nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc) override;
+    void nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v) override;
+    void selfJoinQuery(const IShape& s, IVisitor& v) override;
+    void queryStrategy(IQueryStrategy& qs) override;
+    void getIndexProperties(Tools::PropertySet& out) const override;
+    void addCommand(ICommand* in, CommandType ct) override;
+    bool isIndexValid() override;
+    void getStatistics(IStatistics** out) const override;
+    // Flushes the memtable as well, then waits for the merges
+    void flush() override;
+
+private:
+    // A tombstone names one copy of a point
+    struct Key {
+        id_type id;
+        double x, y;
+        bool operator<(const Key& o) const {
+            if (id != o.id) return id < o.id;
+            if (x != o.x) return x < o.x;
+            return y < o.y;
+        }
+    };
+
+    struct Entry {
+        double coords[2];
+        id_type id;
+    };
+
+    // The memtable, a frozen memtable or a run
+    struct Component {
+        ~Component();
+        bool mayMatch(const IShape& query) const;
+
+        TreeResources resources;
+        uint64_t count = 0;
+        double low[2] = {0.0, 0.0};   // Data MBR (empty while count is 0)
+        double high[2] = {0.0, 0.0};
+        bool memtable = true;
+        uint32_t tier = 0;             // Runs only
+        std::vector<Entry> points;     // Memtables and in-memory runs
+        std::map<Key, uint32_t> removed;  // Memtables: entries deleted from the tree
+        std::string base_name;         // Disk runs: tree files and "<base>.pts"
+    };
+
+    using TombstoneMap = std::map<Key, uint32_t>;
+
+    std::unique_ptr<Component> newMemtable() const;
+    void extend(Component& c, const double coords[2]) const;
+    void freeze();
+    bool pendingWork() const;
+    bool doWork();
+    void workerLoop();
+    void readPoints(const Component& c, TombstoneMap& drop, TombstoneMap& dropped,
+                    std::vector<Entry>& out) const;
+    std::unique_ptr<Component> buildRun(std::vector<Entry>& points, uint32_t tier);
+    void rethrowWorkerError();
+    template <typename Fn>
+    void forEachComponent(const IShape& query, Fn fn);
+    void filteredQuery(const IShape& query, IVisitor& v,
+                       void (ISpatialIndex::*op)(const IShape&, IVisitor&));
+    // Appends c's k nearest copies that tombstones leave visible (plus the
+    // hidden ones met on the way); asks for more only when tombstones hide some
+    void componentNeighbors(Component& c, uint32_t k, const IShape& query, IVisitor& v,
+                            INearestNeighborComparator* nnc, std::vector<Neighbor>& out);
+    void reportNeighbors(std::vector<Neighbor>& candidates, uint32_t k, IVisitor& v) const;
+
+    TreeConfig config_;
+    LsmOptions options_;
+    std::string base_name_;
+
+    std::unique_ptr<Component> memtable_;               // Touched by the caller only
+    std::vector<std::unique_ptr<Component>> immutable_; // Frozen memtables, oldest first
+    std::vector<std::unique_ptr<Component>> runs_;      // Oldest first
+    TombstoneMap tombstones_;
+    uint64_t tombstone_total_;
+
+    // Queries hold it shared; deletes, freezes and the component swaps exclusively
+    mutable std::shared_mutex state_;
+    std::condition_variable_any work_cv_;
+    std::condition_variable_any done_cv_;
+    bool stop_;
+    std::exception_ptr worker_error_;
+    std::thread worker_;
+
+    uint64_t next_run_;
+    uint64_t insert_stalls_;
+    uint64_t stall_ns_;
+    std::atomic<uint64_t> flushes_;
+    std::atomic<uint64_t> compactions_;
+    std::atomic<uint64_t> points_written_;
+    std::atomic<uint64_t> bytes_written_;
+    std::atomic<uint64_t> components_probed_;
+};
+
+} // namespace SpatialIndex
+
+#endif // LSM_INDEX_H
@@ -0,0 +1,27 @@
+#ifndef PACKED_BENCHMARK_H
+#define PACKED_BENCHMARK_H
+
+#include <string>
+#include "workload_generator.h"
+#include "tree_setup.h"
+
+namespace SpatialIndex {
+
+// Bulk load the same points into the libspatialindex tree (STR, or HILBERT
+// when config.build_mode says so) and into a PackedRTree with the same node
+// capacity, then run the same window and kNN queries against both. One CSV
+// row per engine; the packed tree runs once per kernel set the CPU supports.
+// Every kernel set's answers are cross-checked against libspatialindex outside
+// the timed runs; its differences are reported in its row's Mismatches column.
+void runPackedBenchmark(
+    const TreeConfig& base_config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const WorkloadMix& query_mix,
+    int num_queries,
+    const std::string& output_csv
+);
+
+} // namespace SpatialIndex
+
+#endif // PACKED_BENCHMARK_H
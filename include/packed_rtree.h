@@ -0,0 +1,94 @@
+#ifndef PACKED_RTREE_H
+#define PACKED_RTREE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include <spatialindex/SpatialIndex.h>
+#include "query_runner.h"
+
+namespace SpatialIndex {
+
+// Batch MBR kernels used by PackedRTree, fastest first
+enum class SimdLevel { AVX2, SSE2, SCALAR };
+
+// Best kernel set this CPU runs
+SimdLevel bestSimdLevel();
+bool simdSupported(SimdLevel level);
+const char* simdLevelName(SimdLevel level);
+
+// Kernel table for one SimdLevel (defined in packed_rtree.cpp)
+struct PackedKernels;
+
+// Entry order of the packed leaves: STR tiles or Hilbert curve order
+enum class PackOrder { STR, HILBERT };
+
+// Read-only R-tree over points, packed bottom-up from a bulk load into flat
+// structure-of-arrays levels. Level 0 holds the points (x, y, id); level l > 0
+// holds the MBRs of the level-l nodes as separate minx / miny / maxx / maxy
+// arrays. Node j of level l + 1 covers entries [j * B, (j + 1) * B) of level l,
+// so there are no child pointers and a node's coordinates are B contiguous
+// doubles per array, each array 64-byte aligned and padded to whole nodes.
+//
+// Nodes are tested a whole node at a time with AVX2 / SSE2 kernels (scalar
+// fallback), selected at run time. Queries do not modify the tree, so any
+// number of threads may query concurrently.
+class PackedRTree {
+public:
+    // coords: n (x, y) pairs; ids: n identifiers, or nullptr for 0..n-1.
+    // node_size is rounded up to a multiple of 8 (one cache line of doubles), at most 64.
+    PackedRTree(const double* coords, const id_type* ids, size_t n,
+                uint32_t node_size = 16, PackOrder order = PackOrder::HILBERT);
+
+    PackedRTree(const PackedRTree&) = delete;
+    PackedRTree& operator=(const PackedRTree&) = delete;
+
+    // Pick the kernels; levels the CPU lacks fall back to the next one down
+    void setSimd(SimdLevel level);
+    SimdLevel simd() const { return simd_; }
+
+    // Points inside [low, high] (bounds inclusive), appended to out. Returns the match count.
+    uint64_t rangeQuery(const double low[2], const double high[2], std::vector<id_type>& out,
+                        uint64_t* nodes_visited = nullptr) const;
+
+    // The k points nearest to q, closest first (dist is the Euclidean distance)
+    void nearestNeighbors(const double q[2], uint32_t k, std::vector<Neighbor>& out,
+                          uint64_t* nodes_visited = nullptr) const;
+
+    size_t size() const { return n_; }
+    uint32_t nodeSize() const { return b_; }
+    uint32_t height() const { return static_cast<uint32_t>(levels_.size()); } // Root included
+    uint64_t nodes() const;                // Root included
+    uint64_t memoryBytes() const;
+
+private:
+    struct FreeDeleter {
+        void operator()(void* p) const { std::free(p); }
+    };
+    template <typename T>
+    using AlignedArray = std::unique_ptr<T[], FreeDeleter>;
+
+    struct Level {
+        size_t count = 0;               // Entries on this level
+        AlignedArray<double> minx, miny; // Level 0: the points
+        AlignedArray<double> maxx, maxy; // Level 0: unused
+    };
+
+    template <typename T>
+    static AlignedArray<T> allocate(size_t count);
+
+    void pack(const double* coords, const id_type* ids, PackOrder order);
+
+    size_t n_;
+    uint32_t b_;
+    std::vector<Level> levels_;  // [0] points, back() root entries (at most B)
+    AlignedArray<id_type> ids_;
+    SimdLevel simd_;
+    const PackedKernels* kernels_;
+};
+
+} // namespace SpatialIndex
+
+#endif // PACKED_RTREE_H
@@ -0,0 +1,109 @@
+#ifndef PAGE_BUFFER_H
+#define PAGE_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <spatialindex/SpatialIndex.h>
+
+namespace SpatialIndex {
+
+// Replacement policies of PageBuffer (libspatialindex ships RANDOM, FIFO and LRU)
+enum class BufferPolicy {
+    CLOCK,  // Second chance over a circular frame list
+    TWO_Q,  // 2Q: FIFO probation queue, LRU main queue, ghost list of probation evictions
+    ARC,    // Adaptive Replacement Cache (recency / frequency lists with ghosts)
+    LRU_K,  // Evict the largest backward K-distance (pages seen < K times first)
+    LEVEL   // Tree-level aware: evict from the lowest cached node level first (LRU within a level)
+};
+
+// True if buffer_type names one of the policies above ("CLOCK", "2Q", "ARC", "LRUK"/"LRU-K", "LEVEL")
+bool getBufferPolicy(const std::string& buffer_type, BufferPolicy& out);
+const char* bufferPolicyName(BufferPolicy policy);
+
+struct PageBufferOptions {
+    uint32_t lru_k = 2;              // LRU_K: references tracked per page
+    uint32_t pin_levels = 0;         // LEVEL: top levels pinned (0 = strict priority by level)
+    double two_q_in_fraction = 0.25; // 2Q: probation queue share of the capacity (Kin)
+    double two_q_out_fraction = 0.5; // 2Q: ghost entries relative to the capacity (Kout)
+};
+
+// Page cache between the tree and a storage manager with a pluggable
+// replacement policy. Semantics follow libspatialindex's own buffers: new
+// pages are written through to obtain their id, updates stay dirty in the
+// buffer until evicted or flushed (unless write-through), and getHits()
+// counts loads served from the buffer.
+class PageBuffer : public StorageManager::IBuffer {
+public:
+    PageBuffer(IStorageManager& inner, uint32_t capacity, bool write_through);
+    ~PageBuffer() override;
+
+    PageBuffer(const PageBuffer&) = delete;
+    PageBuffer& operator=(const PageBuffer&) = delete;
+
+    uint32_t capacity() const { return capacity_; }
+    size_t size() const { return pages_.size(); }
+    bool contains(id_type page) const { return pages_.count(page) != 0; }
+
+    uint64_t misses() const { return misses_; }
+    uint64_t evictions() const { return evictions_; }
+    uint64_t writeBacks() const { return write_backs_; }
+
+    // Read the uncached pages among `pages` from the inner manager as one
+    // batch and cache them clean (at most the capacity; counted as misses)
+    void prefetch(size_t n, const id_type* pages);
+
+    // IBuffer interface
+    uint64_t getHits() override { return hits_; }
+    void clear() override;
+
+    // IStorageManager interface
+    void loadByteArray(const id_type page, uint32_t& len, uint8_t** data) override;
+    void storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) override;
+    void deleteByteArray(const id_type page) override;
+    void flush() override;
+
+protected:
+    // Policy hooks. onMiss runs before a page is admitted (and before any
+    // victim is chosen for it); chooseVictim must return a cached page.
+    virtual void onMiss(id_type) {}
+    virtual void onAdmit(id_type page, const uint8_t* data, uint32_t len) = 0;
+    virtual void onHit(id_type page) = 0;
+    // A cached page was rewritten (default: counts as a hit)
+    virtual void onUpdate(id_type page, const uint8_t*, uint32_t) { onHit(page); }
+    virtual id_type chooseVictim() = 0;
+    // evicted = false when the page was deleted or the buffer cleared
+    virtual void onRemove(id_type page, bool evicted) = 0;
+    // An uncached page was deleted: drop any ghost or history kept for it
+    virtual void onForget(id_type) {}
+    virtual void resetPolicy() = 0;
+
+private:
+    struct Page {
+        std::vector<uint8_t> data;
+        bool dirty;
+    };
+
+    void admit(id_type page, const uint8_t* data, uint32_t len, bool dirty);
+    void evictOne();
+    void writeBack(id_type page, Page& p);
+
+    IStorageManager& inner_;
+    uint32_t capacity_;
+    bool write_through_;
+    std::unordered_map<id_type, Page> pages_;
+
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t evictions_;
+    uint64_t write_backs_;
+};
+
+// Create a PageBuffer with the given policy on top of `inner` (capacity in pages)
+PageBuffer* createPageBuffer(BufferPolicy policy, IStorageManager& inner, uint32_t capacity,
+                             bool write_through, const PageBufferOptions& options = PageBufferOptions());
+
+} // namespace SpatialIndex
+
+#endif // PAGE_BUFFER_H
@@ -0,0 +1,95 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "instrumentation.h"
+
+namespace SpatialIndex {
+
+// Hardware (and one software) events read around timed regions
+enum class PerfEvent : uint8_t {
+    TASK_CLOCK = 0,    // ns on the CPU; wall time minus this is time blocked (I/O, scheduling)
+    CYCLES = 1,
+    INSTRUCTIONS = 2,
+    L1D_MISSES = 3,    // L1 data cache read misses
+    LLC_MISSES = 4,    // Last-level cache misses
+    DTLB_MISSES = 5,   // Data TLB read misses
+    BRANCH_MISSES = 6,
+    COUNT = 7
+};
+
+constexpr int kPerfEventCount = static_cast<int>(PerfEvent::COUNT);
+
+const char* perfEventName(PerfEvent event);
+
+struct PerfSample {
+    uint64_t values[kPerfEventCount] = {};
+};
+
+// perf_event_open counters of the calling thread, opened as one group so a
+// single read() returns all of them. Events the kernel or CPU does not offer
+// are left out; if the group cannot be scheduled it is shrunk until it can,
+// and without permission for kernel counting only user space is counted.
+// Never throws: available() is false when no event could be opened (non-Linux,
+// containers without a PMU, perf_event_paranoid) and status() says why.
+// Threads started after construction are not counted.
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return leader_fd_ >= 0; }
+    bool has(PerfEvent event) const { return fds_[static_cast<int>(event)] >= 0; }
+    bool kernelCounted() const { return kernel_; }
+    const std::string& status() const { return status_; }
+
+    // Cumulative counts since construction, scaled if the group was multiplexed
+    void read(PerfSample& out) const;
+
+private:
+    bool open(bool kernel, int max_events);
+    void close();
+
+    int fds_[kPerfEventCount];
+    int slot_[kPerfEventCount];  // Position of each event in the group read
+    int leader_fd_;
+    int opened_;
+    bool kernel_;
+    std::string status_;
+};
+
+// Per-phase sums of counter deltas around timed regions. The caller brackets
+// each operation with start() / stop() and then attributes it with record()
+// once the phase is known (e.g. whether the insert split a node).
+class PerfProfiler {
+public:
+    PerfProfiler();
+
+    bool available() const { return counters_.available(); }
+    const PerfCounters& counters() const { return counters_; }
+
+    void start() { counters_.read(start_); }
+    void stop() { counters_.read(stop_); }
+    void record(LatencyPhase phase, uint64_t wall_ns);
+
+    // Phase,Ops,Wall_ns,<event totals>,IPC,OffCpu_pct (unavailable events empty)
+    bool writeSummary(const std::string& csv_path) const;
+    void printSummary(std::ostream& os) const;
+
+private:
+    PerfCounters counters_;
+    PerfSample start_;
+    PerfSample stop_;
+    uint64_t ops_[static_cast<int>(LatencyPhase::COUNT)];
+    uint64_t wall_ns_[static_cast<int>(LatencyPhase::COUNT)];
+    uint64_t totals_[static_cast<int>(LatencyPhase::COUNT)][kPerfEventCount];
+};
+
+} // namespace SpatialIndex
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,129 @@
+#ifndef QUERY_RUNNER_H
+#define QUERY_RUNNER_H
+
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <vector>
+#include <spatialindex/SpatialIndex.h>
+#include "workload_generator.h"
+
+namespace SpatialIndex {
+
+// Visitor that only counts what a query touches
+class CountingVisitor : public IVisitor {
+public:
+    uint64_t nodes_visited = 0;
+    uint64_t results = 0;
+
+    void visitNode(const INode&) override { ++nodes_visited; }
+    void visitData(const IData&) override { ++results; }
+    void visitData(std::vector<const IData*>& v) override { results += v.size(); }
+};
+
+// Bare point handed to visitors by indexes that answer from their own storage
+class PointData : public IData {
+public:
+    PointData(id_type id, const double* coords, uint32_t dims = 2) : id_(id), dims_(dims) {
+        for (uint32_t d = 0; d < dims; ++d) coords_[d] = coords[d];
+    }
+    PointData* clone() override { return new PointData(*this); }
+    id_type getIdentifier() const override { return id_; }
+    void getShape(IShape** out) const override { *out = new Point(coords_, dims_); }
+    void getData(uint32_t& len, uint8_t** data) const override {
+        len = 0;
+        *data = nullptr;
+    }
+
+private:
+    id_type id_;
+    uint32_t dims_;
+    double coords_[kMaxDims];
+};
+
+// kNN candidate gathered from one of several sources
+struct Neighbor {
+    double dist;
+    id_type id;
+    double coords[kMaxDims];
+    bool operator<(const Neighbor& o) const { return dist < o.dist; }
+};
+
+// Records kNN answers (with distances) and forwards node visits.
+// Distances come from nnc when given, otherwise from the query shape.
+class NeighborCollector : public IVisitor {
+public:
+    NeighborCollector(const IShape& query, IVisitor& forward, INearestNeighborComparator* nnc = nullptr)
+        : query_(query), forward_(forward), nnc_(nnc) {}
+
+    void visitNode(const INode& n) override { forward_.visitNode(n); }
+    void visitData(const IData& d) override {
+        IShape* shape = nullptr;
+        d.getShape(&shape);
+        Point centre;
+        shape->getCenter(centre);
+        Neighbor nb;
+        nb.dist = nnc_ ? nnc_->getMinimumDistance(query_, d) : query_.getMinimumDistance(*shape);
+        nb.id = d.getIdentifier();
+        for (uint32_t d = 0; d < centre.m_dimension && d < kMaxDims; ++d) {
+            nb.coords[d] = centre.m_pCoords[d];
+        }
+        delete shape;
+        found.push_back(nb);
+    }
+    void visitData(std::vector<const IData*>& v) override {
+        for (const IData* d : v) visitData(*d);
+    }
+
+    std::vector<Neighbor> found;
+
+private:
+    const IShape& query_;
+    IVisitor& forward_;
+    INearestNeighborComparator* nnc_;
+};
+
+// Outcome of one executed query
+struct QueryResult {
+    int64_t time_us = 0;
+    uint64_t time_ns = 0;
+    uint64_t nodes_visited = 0;
+    uint64_t results = 0;
+};
+
+// Running totals for one operation type
+struct OpTypeStats {
+    uint64_t count = 0;
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+    uint64_t total_ns = 0;
+    uint64_t total_nodes = 0;
+    uint64_t total_results = 0;
+
+    void add(uint64_t ns, uint64_t nodes, uint64_t results);
+};
+
+// What a single-tree runner measured inside its timed operations
+struct RunSummary {
+    OpTypeStats stats[3];  // Indexed by OpType
+    uint64_t inserts = 0;  // Points inserted (SWARE: stats[INSERT] counts flushed batches)
+};
+
+// Run a RANGE_QUERY or KNN_QUERY operation against the tree and time it
+QueryResult runQuery(ISpatialIndex* tree, const Operation& op, uint32_t knn_k, uint32_t dims = 2);
+
+// Build the window region for a RANGE_QUERY operation
+Region queryWindow(const Operation& op, uint32_t dims = 2);
+
+// Derive a companion CSV name from the main output CSV ("x.csv" + "_latency" -> "x_latency.csv")
+std::string derivedCsvName(const std::string& output_csv, const std::string& suffix);
+
+// Derive the per-query CSV name from the main output CSV ("x.csv" -> "x_queries.csv")
+std::string queryCsvName(const std::string& output_csv);
+
+// Print one summary line per operation type that occurred
+void printOpSummary(std::ostream& os, const OpTypeStats stats[3]);
+
+} // namespace SpatialIndex
+
+#endif // QUERY_RUNNER_H
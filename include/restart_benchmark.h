@@ -0,0 +1,48 @@
+#ifndef RESTART_BENCHMARK_H
+#define RESTART_BENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include "workload_generator.h"
+#include "tree_setup.h"
+
+namespace SpatialIndex {
+
+// Where the index that gets reopened comes from
+enum class RestartMode {
+    BUILD,  // Build it (incrementally or with config.build_mode), close it, reopen it
+    REOPEN  // Reuse the files an earlier BUILD left under the same disk base name
+};
+
+// "BUILD" or "REOPEN"; throws on anything else
+RestartMode getRestartMode(const std::string& name);
+const char* restartModeName(RestartMode mode);
+
+struct RestartOptions {
+    RestartMode mode = RestartMode::BUILD;
+    uint32_t prewarm_levels = 0;  // Top levels read into the buffer right after opening
+    uint32_t queries = 1000;      // Queries per pass (cold, then the same ones warm)
+    bool drop_cache = true;       // Evict the index files from the OS page cache before reopening
+};
+
+// Warm restart of an on-disk tree. After the (optional) build the tree is
+// closed, its files are dropped from the OS page cache and it is reopened
+// through loadRTree. Phases, one CSV row each with the I/O they caused:
+// BUILD, OPEN (storage manager and tree header), PREWARM, FIRST_QUERY (its
+// Time_ms is the time from the start of OPEN to the first answer), COLD
+// (the query set right after opening) and WARM (the same queries again).
+// Per-query latency and page reads go to "<output>_queries.csv". Queries use
+// the generator's mix (range windows when it has none), spread over the
+// root MBR, which is read as part of the first query's startup.
+void runRestartBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const RestartOptions& options,
+    int num_insertions,
+    const std::string& output_csv
+);
+
+} // namespace SpatialIndex
+
+#endif // RESTART_BENCHMARK_H
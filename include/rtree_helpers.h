@@ -4,6 +4,10 @@
 #include <spatialindex/SpatialIndex.h>
 #include <spatialindex/rtree/IRTreeStatistics.h>
 #include <cstdint>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "dims.h"
 
 namespace SpatialIndex {
 
@@ -38,6 +42,86 @@ inline uint32_t rtree_nodes(ISpatialIndex& idx) {
     return n;
 }
 
+// Batch insert entry point: inserts points through one reused Point, so a
+// batch costs no Point construction (and coordinate allocation) per item
+class PointInserter {
+public:
+    PointInserter(ISpatialIndex& tree, uint32_t dims) : tree_(tree) {
+        const double origin[kMaxDims] = {};
+        point_ = Point(origin, dims);
+    }
+
+    void insert(const double* coords, id_type id) {
+        std::copy(coords, coords + point_.m_dimension, point_.m_pCoords);
+        tree_.insertData(0, nullptr, point_, id);
+    }
+
+private:
+    ISpatialIndex& tree_;
+    Point point_;
+};
+
+// Node and entry counts per level (index 0 = leaves) plus the data extent
+struct TreeShape {
+    std::vector<uint64_t> nodes_per_level;
+    std::vector<uint64_t> entries_per_level;
+    uint64_t data = 0;
+    double low[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    double high[2] = {-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+
+    uint32_t height() const { return static_cast<uint32_t>(nodes_per_level.size()); }
+    uint64_t totalNodes() const {
+        uint64_t n = 0;
+        for (uint64_t c : nodes_per_level) n += c;
+        return n;
+    }
+    // Average entries per node on a level relative to the node capacity
+    double fill(uint32_t level, uint32_t capacity) const {
+        if (level >= height() || nodes_per_level[level] == 0 || capacity == 0) return 0.0;
+        return static_cast<double>(entries_per_level[level]) / (nodes_per_level[level] * capacity);
+    }
+};
+
+class TreeShapeVisitor : public IVisitor {
+public:
+    TreeShape shape;
+
+    void visitNode(const INode& n) override {
+        const uint32_t level = n.getLevel();
+        if (shape.nodes_per_level.size() <= level) {
+            shape.nodes_per_level.resize(level + 1, 0);
+            shape.entries_per_level.resize(level + 1, 0);
+        }
+        ++shape.nodes_per_level[level];
+        shape.entries_per_level[level] += n.getChildrenCount();
+    }
+    void visitData(const IData& d) override {
+        IShape* s = nullptr;
+        d.getShape(&s);
+        Region mbr;
+        s->getMBR(mbr);
+        delete s;
+        for (uint32_t i = 0; i < 2 && i < mbr.m_dimension; ++i) {
+            shape.low[i] = std::min(shape.low[i], mbr.m_pLow[i]);
+            shape.high[i] = std::max(shape.high[i], mbr.m_pHigh[i]);
+        }
+        ++shape.data;
+    }
+    void visitData(std::vector<const IData*>& v) override {
+        for (const IData* d : v) visitData(*d);
+    }
+};
+
+// Walk the whole tree once (expensive; use for end-of-build reports only)
+inline TreeShape rtree_shape(ISpatialIndex& idx) {
+    const double lo[2] = {-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+    const double hi[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    Region everything(lo, hi, 2);
+    TreeShapeVisitor v;
+    idx.intersectsWithQuery(everything, v);
+    return v.shape;
+}
+
 } // namespace SpatialIndex
 
 #endif // RTREE_HELPERS_H
@@ -0,0 +1,30 @@
+#ifndef SHARDED_BENCHMARK_H
+#define SHARDED_BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "workload_generator.h"
+#include "tree_setup.h"
+#include "sharded_index.h"
+
+namespace SpatialIndex {
+
+// Ingest the same num_insertions points into a fresh ShardedIndex for every
+// writer thread count, then run the same queries against it. options.shards = 0
+// gives one shard per thread. One CSV row per thread count: aggregate insert
+// throughput, shard imbalance, queue stalls and query latency (avg / p99) with
+// the number of shards each query touched.
+void runShardedBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    const ShardedIndexOptions& options,
+    const std::vector<uint32_t>& thread_counts,
+    int num_insertions,
+    int num_queries,
+    const std::string& output_csv
+);
+
+} // namespace SpatialIndex
+
+#endif // SHARDED_BENCHMARK_H
@@ -0,0 +1,147 @@
+#ifndef SHARDED_INDEX_H
+#define SHARDED_INDEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <spatialindex/SpatialIndex.h>
+#include "spsc_ring.h"
+#include "tree_setup.h"
+
+namespace SpatialIndex {
+
+// How space is split into shards
+enum class ShardPartition {
+    GRID,    // Equal-sized cells over the sample extent
+    KD,      // Recursive sample-median splits on the wider axis
+    HILBERT  // Equal-count ranges of the Hilbert key over the sample
+};
+
+ShardPartition getShardPartition(const std::string& partition_str);
+const char* shardPartitionName(ShardPartition partition);
+
+struct ShardedIndexOptions {
+    uint32_t shards = 4;
+    // Writer threads; shard s is owned by thread s % threads.
+    // 0 selects latched mode: no queues, callers insert and query under per-shard latches.
+    uint32_t threads = 4;
+    ShardPartition partition = ShardPartition::GRID;
+    size_t queue_items = 1 << 14;  // Capacity of each shard's insert queue
+};
+
+// Spatially partitioned index: one R-tree with its own storage manager per
+// shard. Point inserts are routed by the calling thread (the single producer)
+// into per-shard lock-free queues and applied by writer threads, each owning
+// a fixed set of shards, so no tree is ever touched by two threads. The one
+// routing thread caps ingest once the writers keep up with it; queueStallNs()
+// tells the two cases apart.
+// Queries drain the queues first and then fan out only to shards whose data
+// MBR can match; kNN visits shards closest-first and stops once no shard can
+// beat the k-th distance.
+//
+// In latched mode (threads = 0) any number of threads may insert and query
+// concurrently: each shard has its own latch, held for one tree operation, so
+// operations on different shards never wait for each other.
+class ShardedIndex : public ISpatialIndex {
+public:
+    // sample: flattened (x, y) points used to place the shard boundaries
+    ShardedIndex(const TreeConfig& config, const ShardedIndexOptions& options,
+                 const std::vector<double>& sample);
+    ~ShardedIndex() override;
+
+    ShardedIndex(const ShardedIndex&) = delete;
+    ShardedIndex& operator=(const ShardedIndex&) = delete;
+
+    // Sharding-specific API
+    uint32_t shardOf(const double coords[2]) const;
+    // Queue a point insert for its shard's writer (waits while that queue is full).
+    // In latched mode the insert is applied directly under the shard latch.
+    void enqueue(const double coords[2], id_type id);
+    // Wait until every queued insert has been applied (no-op in latched mode)
+    void drain();
+    bool latched() const { return options_.threads == 0; }
+
+    uint32_t shardCount() const { return static_cast<uint32_t>(shards_.size()); }
+    uint64_t shardSize(uint32_t s) const { return shards_[s]->enqueued; }
+    // Largest shard relative to the mean (1.0 = perfectly balanced)
+    double imbalance() const;
+    uint64_t queueStalls() const { return queue_stalls_; }
+    // Time enqueue spent waiting on full queues; the rest of the ingest is routing
+    uint64_t queueStallNs() const { return queue_stall_ns_; }
+    uint64_t shardsProbed() const { return shards_probed_.load(std::memory_order_relaxed); }
+    // Storage counters summed over all shards
+    TreeCounterSnapshot counters() const;
+
+    // ISpatialIndex interface
+    void insertData(uint32_t len, const uint8_t* pData, const IShape& shape, id_type shapeIdentifier) override;
+    bool deleteData(const IShape& shape, id_type shapeIdentifier) override;
+    void containsWhatQuery(const IShape& query, IVisitor& v) override;
+    void intersectsWithQuery(const IShape& query, IVisitor& v) override;
+    void pointLocationQuery(const Point& query, IVisitor& v) override;
+    void nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc) override;
+    void nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v) override;
+    void selfJoinQuery(const IShape& s, IVisitor& v) override;
+    void queryStrategy(IQueryStrategy& qs) override;
+    void getIndexProperties(Tools::PropertySet& out) const override;
+    void addCommand(ICommand* in, CommandType ct) override;
+    bool isIndexValid() override;
+    void getStatistics(IStatistics** out) const override;
+    void flush() override;
+
+private:
+    struct InsertItem {
+        double coords[2];
+        id_type id;
+    };
+    struct Shard {
+        explicit Shard(size_t queue_items) : queue(queue_items), enqueued(0), applied(0) {
+            low[0] = low[1] = 0.0;
+            high[0] = high[1] = -1.0;
+        }
+        TreeResources resources;
+        SpscRing<InsertItem> queue;
+        std::mutex latch;               // Latched mode only
+        uint64_t enqueued;              // Producer side only (under the latch in latched mode)
+        std::atomic<uint64_t> applied;  // Written by the owning writer
+        double low[2];                  // MBR of the data routed here (empty while low > high)
+        double high[2];
+    };
+    struct KdNode {
+        int axis;        // -1 for a leaf
+        double split;
+        int left, right; // Child node indexes
+        uint32_t shard;  // Leaf only
+    };
+
+    void buildPartition(const std::vector<double>& sample);
+    int buildKd(std::vector<double>& pts, size_t begin, size_t end, uint32_t first_shard, uint32_t count);
+    void writerLoop(uint32_t thread_idx);
+    bool shardMayMatch(const Shard& s, const IShape& query) const;
+    void extendMbr(Shard& s, const double coords[2]);
+    std::unique_lock<std::mutex> lockShard(Shard& s) const;
+    bool shardMbr(Shard& s, Region& out) const;
+
+    ShardedIndexOptions options_;
+    std::vector<Shard*> shards_;
+    std::vector<std::thread> writers_;
+    std::atomic<bool> stop_;
+
+    // Partition state
+    double domain_low_[2];
+    double domain_high_[2];
+    uint32_t grid_cols_;
+    uint32_t grid_rows_;
+    std::vector<KdNode> kd_nodes_;
+    std::vector<uint64_t> hilbert_bounds_; // Upper key bound (exclusive) of every shard but the last
+
+    uint64_t queue_stalls_;
+    uint64_t queue_stall_ns_;
+    std::atomic<uint64_t> shards_probed_;
+};
+
+} // namespace SpatialIndex
+
+#endif // SHARDED_INDEX_H
@@ -0,0 +1,119 @@
+#ifndef SPACE_FILLING_CURVE_H
+#define SPACE_FILLING_CURVE_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace SpatialIndex {
+
+// Bits per dimension used when mapping coordinates onto a curve
+constexpr uint32_t kCurveOrder = 16;
+
+// Map v in [lo, hi] onto the integer grid [0, 2^order - 1] (clamped)
+inline uint32_t quantizeCoord(double v, double lo, double hi, uint32_t order = kCurveOrder) {
+    const double cells = static_cast<double>((1u << order) - 1);
+    double t = (hi > lo) ? (v - lo) / (hi - lo) : 0.0;
+    t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+    return static_cast<uint32_t>(t * cells);
+}
+
+// Spread the low 32 bits of v so that bit i lands on bit 2i
+inline uint64_t spreadBits(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8))  & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2))  & 0x3333333333333333ull;
+    x = (x | (x << 1))  & 0x5555555555555555ull;
+    return x;
+}
+
+// Z-order (Morton) key: x bits on even positions, y bits on odd positions
+inline uint64_t mortonKey(uint32_t x, uint32_t y) {
+    return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+// Hilbert curve index of (x, y) on a 2^order x 2^order grid.
+// Branch-free per bit so the loop can be unrolled and vectorised.
+inline uint64_t hilbertKey(uint32_t x, uint32_t y, uint32_t order = kCurveOrder) {
+    const uint32_t n_mask = (order >= 32) ? 0xFFFFFFFFu : ((1u << order) - 1);
+    uint64_t d = 0;
+    for (uint32_t bit = order; bit-- > 0;) {
+        const uint32_t rx = (x >> bit) & 1u;
+        const uint32_t ry = (y >> bit) & 1u;
+        d = (d << 2) | ((3u * rx) ^ ry);
+        // Reflect when (rx, ry) == (1, 0), then swap when ry == 0
+        const uint32_t flip = 0u - (rx & (ry ^ 1u));
+        x ^= flip & n_mask;
+        y ^= flip & n_mask;
+        const uint32_t swap = (x ^ y) & (0u - (ry ^ 1u));
+        x ^= swap;
+        y ^= swap;
+    }
+    return d;
+}
+
+// Order-preserving integer image of a double (for sorting on a single coordinate)
+inline uint64_t orderedDoubleKey(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return (bits & 0x8000000000000000ull) ? ~bits : (bits | 0x8000000000000000ull);
+}
+
+// Z-order key of a D-dimensional cell: bit b of coordinate d lands on bit
+// b * D + d. 2-D keys are identical to mortonKey.
+template <uint32_t D>
+inline uint64_t mortonKeyN(const uint32_t* q, uint32_t order = kCurveOrder) {
+    if (D == 2) return mortonKey(q[0], q[1]);
+    uint64_t key = 0;
+    for (uint32_t bit = order; bit-- > 0;) {
+        for (uint32_t d = D; d-- > 0;) {
+            key = (key << 1) | ((q[d] >> bit) & 1u);
+        }
+    }
+    return key;
+}
+
+// Hilbert index of a D-dimensional cell on a 2^order grid per coordinate
+// (Skilling's transpose algorithm); order * D must not exceed 64.
+// 2-D keys are identical to hilbertKey.
+template <uint32_t D>
+inline uint64_t hilbertKeyN(const uint32_t* q, uint32_t order = kCurveOrder) {
+    if (D == 2) return hilbertKey(q[0], q[1], order);
+    const uint32_t n_mask = (order >= 32) ? 0xFFFFFFFFu : ((1u << order) - 1);
+    uint32_t x[D];
+    for (uint32_t d = 0; d < D; ++d) x[d] = q[d] & n_mask;
+
+    // Undo excess work, then Gray encode
+    for (uint32_t m = 1u << (order - 1); m > 1; m >>= 1) {
+        const uint32_t p = m - 1;
+        for (uint32_t d = 0; d < D; ++d) {
+            if (x[d] & m) {
+                x[0] ^= p;
+            } else {
+                const uint32_t t = (x[0] ^ x[d]) & p;
+                x[0] ^= t;
+                x[d] ^= t;
+            }
+        }
+    }
+    for (uint32_t d = 1; d < D; ++d) x[d] ^= x[d - 1];
+    uint32_t t = 0;
+    for (uint32_t m = 1u << (order - 1); m > 1; m >>= 1) {
+        if (x[D - 1] & m) t ^= m - 1;
+    }
+    for (uint32_t d = 0; d < D; ++d) x[d] ^= t;
+
+    // Interleave the transposed bits, most significant first
+    uint64_t key = 0;
+    for (uint32_t bit = order; bit-- > 0;) {
+        for (uint32_t d = 0; d < D; ++d) {
+            key = (key << 1) | ((x[d] >> bit) & 1u);
+        }
+    }
+    return key;
+}
+
+} // namespace SpatialIndex
+
+#endif // SPACE_FILLING_CURVE_H
@@ -0,0 +1,67 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace SpatialIndex {
+
+// Bounded lock-free ring for exactly one producer and one consumer thread.
+// Capacity is rounded up to a power of two.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : head_(0), tail_(0) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        slots_.resize(cap);
+        mask_ = cap - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side; false if the ring is full
+    bool tryPush(const T& item) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_) return false;
+        slots_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; false if the ring is empty
+    bool tryPop(T& out) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        out = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: pop up to max_items into out, returns the count
+    size_t popBatch(T* out, size_t max_items) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t avail = tail_.load(std::memory_order_acquire) - head;
+        const size_t n = avail < max_items ? avail : max_items;
+        for (size_t i = 0; i < n; ++i) out[i] = slots_[(head + i) & mask_];
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    std::vector<T> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+};
+
+} // namespace SpatialIndex
+
+#endif // SPSC_RING_H
@@ -1,17 +1,31 @@
 #pragma once
 
+#include <iostream>
 #include <string>
 #include "workload_generator.h"
 #include "tree_setup.h"
+#include "sware_buffer.h"
+#include "tree_counters.h"
+#include "io_stats.h"
+#include "instrumentation.h"
+#include "perf_counters.h"
+#include "query_runner.h"
 
 namespace SpatialIndex {
 
-void run_sware_benchmark(
+// Progress and summaries go to log. Returns the timed flushes and queries;
+// inserts counts the buffered points
+RunSummary run_sware_benchmark(
     ISpatialIndex* tree,
+    const CountingStorageManager& counters,
+    const IoMonitor& io,
     WorkloadGenerator& workload_gen,
     int num_insertions,
-    int items_per_batch,
-    const std::string& output_csv
+    const SwareBufferOptions& buffer_options,
+    const std::string& output_csv,
+    LatencyRecorder* recorder = nullptr,
+    PerfProfiler* profiler = nullptr,
+    std::ostream& log = std::cout
 );
 
 } // namespace SpatialIndex
@@ -0,0 +1,182 @@
+#ifndef SWARE_BUFFER_H
+#define SWARE_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <spatialindex/SpatialIndex.h>
+#include "dims.h"
+
+namespace SpatialIndex {
+
+// Order in which buffered points are kept and moved to the tree
+enum class SwareOrder {
+    X,       // x coordinate only
+    HILBERT, // Hilbert curve key over the buffer domain
+    MORTON   // Z-order key over the buffer domain
+};
+
+SwareOrder getSwareOrder(const std::string& order_str);
+const char* swareOrderName(SwareOrder order);
+
+// When the buffer moves items into the tree
+enum class SwareFlushPolicy {
+    FIXED,    // Whenever capacity items are buffered
+    ADAPTIVE  // Early when waiting would not save node touches, at capacity otherwise
+};
+
+SwareFlushPolicy getSwareFlushPolicy(const std::string& policy_str);
+const char* swareFlushPolicyName(SwareFlushPolicy policy);
+
+struct SwareBufferOptions {
+    size_t capacity = 10000;      // Items held before a flush is due
+    size_t budget_bytes = 0;      // > 0: derive capacity from this memory budget (entries + zonemaps)
+    size_t page_items = 256;      // Items per buffer page (one zonemap each)
+    double flush_fraction = 0.5;  // Share of the sorted buffer moved out per flush
+    SwareOrder order = SwareOrder::X;
+    SwareFlushPolicy policy = SwareFlushPolicy::FIXED;
+    size_t leaf_items = 16;       // Tree leaf capacity, used by the node-touch model
+    double min_gain = 0.1;        // ADAPTIVE: keep buffering only while that saves this share of touches
+    // Domain the curve keys are computed over (points outside are clamped)
+    double domain_low[kMaxDims] = {0.0, 0.0, 0.0, 0.0};
+    double domain_high[kMaxDims] = {1000.0, 1000.0, 1000.0, 1000.0};
+};
+
+enum class SwareFlushReason {
+    FULL,   // Capacity reached
+    EARLY,  // ADAPTIVE: a full buffer would not touch fewer nodes per item
+    DRAIN   // Everything moved out (end of input, non-point operations)
+};
+
+const char* swareFlushReasonName(SwareFlushReason reason);
+
+// Why a flush happened and what the node-touch model saw at that point.
+// Buffered items whose keys fall inside the key range already flushed land
+// in existing leaves: a batch of n of them over L leaves touches about
+// L * (1 - exp(-n / L)) leaves. Arrivals in in-order runs fill leaves
+// sequentially: a run of r items counts as r / min(r, leaf_items) placements.
+// Items beyond that range extend the tree at its edge and touch one leaf per
+// leaf_items items, however long they wait. Before the first flush there is
+// no key range, and ADAPTIVE only flushes early while the buffer is one run.
+struct SwareFlushDecision {
+    SwareFlushReason reason = SwareFlushReason::FULL;
+    size_t buffered = 0;        // Items in the buffer
+    double run_length = 0.0;    // Mean in-order arrival run since the last flush
+    double overlap = 0.0;       // Share of buffered items inside the flushed key range
+    double touches_now = 0.0;   // Predicted leaf touches per item flushing now
+    double touches_full = 0.0;  // ... and after waiting for a full buffer
+};
+
+// Outcome of one (partial) flush
+struct SwareFlushStats {
+    size_t items = 0;          // Items moved into the tree
+    size_t remaining = 0;      // Items left in the buffer
+    size_t unsorted_items = 0; // Items outside the in-order prefix when the flush began
+    int64_t sort_us = 0;
+    int64_t insert_us = 0;
+    SwareFlushDecision decision;
+};
+
+// Sortedness-aware write buffer layered in front of another ISpatialIndex.
+// Point inserts are appended to the buffer; arrivals in key order take an
+// append-only fast path. Every page of page_items entries keeps an MBR
+// (zonemap) so queries only scan pages that can match. Flushes sort just the
+// out-of-order tail, merge it into the in-order prefix and move the smallest
+// keys into the tree as an ordered insert stream. Queries merge buffer and tree.
+// The ADAPTIVE policy tracks arrival runs and key overlap with the tree online
+// and flushes a batch early when sortedness means waiting saves no node touches.
+//
+// Non-point inserts and operations the buffer cannot answer on its own
+// (self joins, query strategies, commands) flush everything first and are
+// forwarded to the underlying index.
+//
+// D is the point dimension; instantiated for 2, 3 and 4 (see dims.h).
+template <uint32_t D>
+class BasicSwareBuffer : public ISpatialIndex {
+public:
+    BasicSwareBuffer(ISpatialIndex& tree, const SwareBufferOptions& options);
+    ~BasicSwareBuffer() override;
+
+    // Buffer-specific API
+    bool full() const { return items_.size() >= options_.capacity; }
+    size_t size() const { return items_.size(); }
+    size_t sortedPrefix() const { return sorted_prefix_; }
+    const SwareBufferOptions& getOptions() const { return options_; }
+
+    // Whether the flush policy wants a flushBatch() now
+    bool flushDue() const;
+    // Node-touch model for the current buffer contents
+    SwareFlushDecision evaluate(SwareFlushReason reason) const;
+
+    // Append without flushing (caller checks flushDue() and calls flushBatch)
+    void append(const double* coords, id_type id);
+    // Move the sorted prefix (or everything) into the tree
+    SwareFlushStats flushBatch(bool everything = false);
+
+    uint64_t pagesScanned() const { return pages_scanned_; }
+    uint64_t pagesSkipped() const { return pages_skipped_; }
+    uint64_t inOrderAppends() const { return in_order_appends_; }
+    uint64_t outOfOrderAppends() const { return out_of_order_appends_; }
+
+    // ISpatialIndex interface
+    void insertData(uint32_t len, const uint8_t* pData, const IShape& shape, id_type shapeIdentifier) override;
+    bool deleteData(const IShape& shape, id_type shapeIdentifier) override;
+    void containsWhatQuery(const IShape& query, IVisitor& v) override;
+    void intersectsWithQuery(const IShape& query, IVisitor& v) override;
+    void pointLocationQuery(const Point& query, IVisitor& v) override;
+    void nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc) override;
+    void nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v) override;
+    void selfJoinQuery(const IShape& s, IVisitor& v) override;
+    void queryStrategy(IQueryStrategy& qs) override;
+    void getIndexProperties(Tools::PropertySet& out) const override;
+    void addCommand(ICommand* in, CommandType ct) override;
+    bool isIndexValid() override;
+    void getStatistics(IStatistics** out) const override;
+    void flush() override;
+
+private:
+    struct Entry {
+        uint64_t key;
+        double coords[D];
+        id_type id;
+    };
+    struct Zone {
+        double low[D];
+        double high[D];
+    };
+    uint64_t sortKey(const double* coords) const;
+    void rebuildZones();
+    void extendZone(size_t idx);
+    void queryBuffer(const IShape& query, bool contains, IVisitor& v);
+    bool inFlushedRange(uint64_t key) const;
+
+    ISpatialIndex& tree_;
+    SwareBufferOptions options_;
+    std::vector<Entry> items_;
+    std::vector<Zone> zones_;
+    size_t sorted_prefix_;
+
+    // Sortedness of the arrivals since the last flush and the keys already flushed
+    uint64_t last_key_;
+    size_t appends_since_flush_;
+    size_t runs_since_flush_;
+    size_t overlap_items_;
+    uint64_t flushed_items_;
+    uint64_t flushed_low_key_;
+    uint64_t flushed_high_key_;
+
+    uint64_t pages_scanned_;
+    uint64_t pages_skipped_;
+    uint64_t in_order_appends_;
+    uint64_t out_of_order_appends_;
+};
+
+extern template class BasicSwareBuffer<2>;
+extern template class BasicSwareBuffer<3>;
+extern template class BasicSwareBuffer<4>;
+
+using SwareBuffer = BasicSwareBuffer<2>;
+
+} // namespace SpatialIndex
+
+#endif // SWARE_BUFFER_H
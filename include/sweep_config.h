@@ -0,0 +1,44 @@
+#ifndef SWEEP_CONFIG_H
+#define SWEEP_CONFIG_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "experiment.h"
+
+namespace SpatialIndex {
+
+// One point of a section's parameter grid
+struct SweepExperiment {
+    size_t index = 0;
+    std::string section;
+    ExperimentArgs args;
+    std::vector<std::pair<std::string, std::string>> grid;  // Swept keys and their values here
+    bool keep_files = false;  // Leave the index files for later runs instead of removing them
+};
+
+struct SweepConfig {
+    std::map<std::string, std::string> settings;  // The [sweep] table (driver settings)
+    std::vector<SweepExperiment> experiments;
+    std::vector<std::string> skipped;             // Enabled sections of unknown type
+};
+
+// Read config.toml the way run_experiments.py does and expand parameter grids.
+// Globals (num_insertions, tree_variant, data_type, page_size_bytes and any
+// run_rtree option) apply to every section with run = true whose name holds
+// "on_disk" or "in_memory"; section values override them. Any of these keys,
+// and M_capacity, fill_factor, buffer_type and buffer_size_mb, may be an array:
+// a section then runs once per combination (the cartesian product). Output
+// names match run_experiments.py, plus a "_<key><value>" suffix for swept keys
+// the name does not already carry. Each experiment gets its own disk files,
+// removed once it finishes, unless it sets disk_base_name or uses restart or
+// open_existing: those keep their files (by default run_rtree's
+// "disk_tree_data"), and experiments sharing a base name run one after another
+// in config order.
+SweepConfig loadSweepConfig(const std::string& path);
+
+} // namespace SpatialIndex
+
+#endif // SWEEP_CONFIG_H
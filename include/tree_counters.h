@@ -0,0 +1,81 @@
+#ifndef TREE_COUNTERS_H
+#define TREE_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <spatialindex/SpatialIndex.h>
+
+namespace SpatialIndex {
+
+// Plain copy of the counters at one instant
+struct TreeCounterSnapshot {
+    uint64_t node_reads = 0;   // Node pages loaded by the tree
+    uint64_t node_writes = 0;  // Existing node pages rewritten
+    uint64_t node_allocs = 0;  // New node pages
+    uint64_t node_deletes = 0; // Node pages freed (condense after delete)
+    uint64_t splits = 0;       // Node splits, including root splits
+    uint64_t root_splits = 0;  // Root splits (height changes)
+    uint64_t nodes = 0;        // Live nodes
+    uint32_t height = 0;
+};
+
+// Level of a serialised node page, or -1 if the page does not look like a node
+int64_t nodeLevel(const uint8_t* data, uint32_t len);
+
+// Storage-manager layer placed directly under the R-tree. Every node access
+// passes through it, so it keeps monotonic atomic counters for node reads,
+// writes, allocations, splits and height changes (per level too) that can be
+// read at any time without allocating or asking the tree for statistics.
+//
+// It relies on libspatialindex's node page layout: a uint32 node type
+// followed by the uint32 level. A split allocates one new page at the split
+// node's level; a root split allocates two and rewrites the root page one
+// level higher. The tree header page is excluded once attach() is called.
+class CountingStorageManager : public IStorageManager {
+public:
+    static constexpr uint32_t kMaxLevels = 32;
+
+    explicit CountingStorageManager(IStorageManager& inner);
+
+    // Align the counters with an existing tree (bulk-loaded or reopened) and
+    // zero the access counts. `header_page` is the tree's index identifier.
+    void attach(ISpatialIndex& tree, id_type header_page);
+
+    TreeCounterSnapshot snapshot() const;
+
+    uint64_t nodeReads() const { return node_reads_.load(std::memory_order_relaxed); }
+    uint64_t nodeWrites() const { return node_writes_.load(std::memory_order_relaxed); }
+    uint64_t splits() const { return splits_base_ + node_allocs_.load(std::memory_order_relaxed) -
+                                     root_splits_.load(std::memory_order_relaxed); }
+    uint64_t nodes() const { return nodes_base_ + node_allocs_.load(std::memory_order_relaxed) -
+                                    node_deletes_.load(std::memory_order_relaxed); }
+    uint32_t height() const { return height_.load(std::memory_order_relaxed); }
+    uint64_t splitsAtLevel(uint32_t level) const;
+
+    // IStorageManager interface
+    void loadByteArray(const id_type page, uint32_t& len, uint8_t** data) override;
+    void storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) override;
+    void deleteByteArray(const id_type page) override;
+    void flush() override;
+
+private:
+    IStorageManager& inner_;
+    id_type header_page_;
+
+    std::atomic<uint64_t> node_reads_;
+    std::atomic<uint64_t> node_writes_;
+    std::atomic<uint64_t> node_allocs_;
+    std::atomic<uint64_t> node_deletes_;
+    std::atomic<uint64_t> root_splits_;
+    std::atomic<uint32_t> height_;
+    std::atomic<uint64_t> allocs_per_level_[kMaxLevels];
+    std::atomic<uint64_t> root_splits_per_level_[kMaxLevels];
+
+    // Tree totals at attach() time
+    uint64_t nodes_base_;
+    uint64_t splits_base_;
+};
+
+} // namespace SpatialIndex
+
+#endif // TREE_COUNTERS_H
@@ -1,40 +1,111 @@
 #ifndef TREE_SETUP_H
 #define TREE_SETUP_H
 
+#include <iostream>
 #include <string>
+#include <cstdint>
 #include <spatialindex/SpatialIndex.h>
 #include <spatialindex/RTree.h>
+#include "tree_counters.h"
+#include "io_stats.h"
+#include "async_write_back.h"
+#include "leaf_directory.h"
+#include "leaf_codec.h"
 
 namespace SpatialIndex {
 
+class WorkloadGenerator;
+class PointSource;
+
 // Structure to hold tree setup configuration
 struct TreeConfig {
     std::string run_type;// "mem" or "disk"
     int M_capacity;
     double fill_factor;
-    std::string buffer_type;// "NONE", "RANDOM", "LRU"
+    uint32_t dims = 2; // Point dimension: 2, 3 or 4
+    std::string buffer_type;// "NONE", "RANDOM", "FIFO", "LRU", "CLOCK", "2Q", "ARC", "LRUK", "LEVEL"
     int buffer_pages;
+    uint32_t buffer_lru_k = 2;      // LRUK buffer: references tracked per page
+    uint32_t buffer_pin_levels = 0; // LEVEL buffer: top levels pinned, 0 = evict lowest level first
+    size_t async_dirty_pages = 0;   // Disk: > 0 writes dirty pages back on a background thread
     RTree::RTreeVariant tree_variant;
     int page_size;
     std::string disk_base_name; // For disk storage manager
+    // Storage backend: "DEFAULT" (libspatialindex's memory / disk manager),
+    // "ARENA" (mem: slab-allocated pages, see arena_storage.h) or
+    // "DIRECT" (disk: O_DIRECT with io_uring / pread threads, see direct_storage.h)
+    std::string storage = "DEFAULT";
+    std::string io_engine = "AUTO";  // DIRECT: AUTO, URING or THREADS
+    uint32_t io_queue_depth = 64;
+    uint32_t io_threads = 4;
+
+    // Initial build: "INCREMENTAL" starts empty, "STR" / "HILBERT" bulk load
+    std::string build_mode = "INCREMENTAL";
+    uint64_t bulk_points = 0;           // Points drawn from the workload generator
+    std::string bulk_data_file;         // "x,y" / "id,x,y" point file (overrides the generator)
+    double bulk_fill_factor = 0.9;      // Node fill of the packed tree (STR also keeps it as fill factor)
+    size_t sort_memory_items = 4000000; // Records sorted in memory before spilling a run
+    unsigned sort_threads = 0;          // Sort threads, 0 = hardware concurrency
+
+    bool quiet = false;  // No setup messages (trees built on background threads)
+    std::ostream* log = &std::cout;  // Setup messages and the benchmarks' progress and summaries
+    bool leaf_directory = false;  // Track leaf / parent pages for in-place point moves
+    // Leaf page format: "NONE" (libspatialindex's doubles), "Q16" / "Q32"
+    // (quantised cells of the leaf MBR and delta ids, see leaf_codec.h)
+    std::string leaf_codec = "NONE";
+    int leaf_capacity = 0;  // Leaf entries per node, 0 = M_capacity
+
+    int leafCapacity() const { return leaf_capacity > 0 ? leaf_capacity : M_capacity; }
+
+    // Disk: reopen the tree left in disk_base_name by an earlier run (its index
+    // id is kept in "<base>.tree") instead of deleting the files and building
+    bool open_existing = false;
+    uint32_t prewarm_levels = 0;  // Read the top levels into the buffer after setup (0 = off)
 };
 
 // Structure to hold created tree resources
 struct TreeResources {
     ISpatialIndex* tree;
     IStorageManager* storage_manager;
+    IoStatsStorageManager* io_stats;  // Directly on top of storage_manager
+    AsyncWriteBackStorageManager* write_back; // Between io_stats and the buffer (optional)
+    IoStatsStorageManager* buffer_io; // Between write_back and the buffer: what the buffer asks for
     StorageManager::IBuffer* buffer;
+    CountingStorageManager* counters; // Sits between the tree and buffer/storage
+    LeafCodecStorageManager* codec;   // Between the counters and the buffer (optional)
+    LeafDirectory* directory;         // Between the tree and the counters (optional)
     id_type index_id;
     
-    TreeResources() : tree(nullptr), storage_manager(nullptr), 
-                     buffer(nullptr), index_id(0) {}
+    TreeResources() : tree(nullptr), storage_manager(nullptr), io_stats(nullptr),
+                     write_back(nullptr), buffer_io(nullptr), buffer(nullptr), counters(nullptr),
+                     codec(nullptr), directory(nullptr), index_id(0) {}
 };
 
 // Convert string to RTree variant
 RTree::RTreeVariant getRTreeVariant(const std::string& variant_str);
 
-// Setup tree based on configuration
-TreeResources setupTree(const TreeConfig& config);
+// Setup tree based on configuration. Bulk builds read config.bulk_data_file
+// or, if that is empty, the first config.bulk_points points of `source`.
+TreeResources setupTree(const TreeConfig& config, WorkloadGenerator* source = nullptr);
+// Same, but bulk builds read `bulk_source` (config.bulk_data_file is ignored)
+TreeResources setupTree(const TreeConfig& config, PointSource& bulk_source);
+
+// Outcome of prewarmTree
+struct PrewarmStats {
+    uint32_t levels = 0;  // Levels read (capped at the tree height)
+    uint64_t pages = 0;
+    uint64_t time_us = 0;
+};
+
+// Read the top `levels` levels of the tree once, level by level and in page
+// id order within a level (file order for the disk managers), so the pages
+// land in the buffer (or the OS page cache) through one sequential pass.
+// With one of our PageBuffer policies as `buffer`, each level below the root
+// is first fetched into it as one batched read.
+PrewarmStats prewarmTree(ISpatialIndex& tree, uint32_t levels, StorageManager::IBuffer* buffer = nullptr);
+
+// I/O counters of the storage manager and buffer
+IoMonitor ioMonitor(const TreeResources& resources);
 
 // Cleanup tree resources
 void cleanupTree(TreeResources& resources);
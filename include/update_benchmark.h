@@ -0,0 +1,50 @@
+#ifndef UPDATE_BENCHMARK_H
+#define UPDATE_BENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "workload_generator.h"
+#include "tree_setup.h"
+
+namespace SpatialIndex {
+
+// How a moving object's new position reaches the tree
+enum class UpdatePath {
+    DELETE_INSERT,  // deleteData (root-down search) then insertData
+    IN_PLACE        // LeafDirectory::movePoint, falling back to delete + insert
+};
+
+// "DELETE_INSERT" / "IN_PLACE" (one path) or "COMPARE" (both); throws on anything else
+std::vector<UpdatePath> getUpdatePaths(const std::string& name);
+const char* updatePathName(UpdatePath path);
+
+struct UpdateOptions {
+    uint32_t ticks = 10;     // Rounds of movement
+    double fraction = 1.0;   // Share of the objects that move in a tick
+    double step = 5.0;       // Std. deviation of a move per axis (the WALK generator's step)
+    uint32_t probes = 200;   // Range queries measuring the tree after every tick
+};
+
+// Moving-object workload over a fixed fleet of num_objects 2-D points: the
+// objects are placed with the generator's distribution (loaded incrementally
+// or with config.build_mode), then each tick moves a share of them by a
+// random step (drawn from `seed`), reflected at the edges of the initial
+// data extent. Every path replays the same moves on a fresh tree. One CSV
+// row per path and tick (tick 0 = after loading): update throughput and
+// latency, how the updates were applied, node I/O, and the tree's quality -
+// leaf count and fill, total leaf MBR area, its slack over the tight MBRs of
+// the leaf entries, and the nodes a fixed set of probe windows visits.
+void runUpdateBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const std::vector<UpdatePath>& paths,
+    const UpdateOptions& options,
+    int num_objects,
+    const std::string& output_csv
+);
+
+} // namespace SpatialIndex
+
+#endif // UPDATE_BENCHMARK_H
@@ -0,0 +1,76 @@
+#ifndef WORKLOAD_FILE_H
+#define WORKLOAD_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "workload_generator.h"
+
+namespace SpatialIndex {
+
+// Flat binary workload: a header followed by `count` fixed-size records.
+// Written by "run_rtree generate ..." and replayed through an mmap.
+constexpr char kWorkloadMagic[8] = {'R', 'T', 'W', 'K', 'L', 'D', '0', '1'};
+constexpr uint32_t kWorkloadVersion = 1;
+
+struct WorkloadFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    char data_type[16];        // Source distribution ("CSV" for imported data), NUL padded
+    double insert_ratio;       // Mix the operations were drawn with
+    double range_ratio;
+    double knn_ratio;
+    double range_selectivity;
+    uint32_t knn_k;
+    uint32_t reserved;
+};
+static_assert(sizeof(WorkloadFileHeader) == 80, "WorkloadFileHeader layout is part of the file format");
+
+struct WorkloadRecord {
+    uint8_t type;              // OpType
+    uint8_t reserved[7];
+    uint64_t id;               // Data id for inserts, operation index for queries
+    double coords[2];
+    double half_extent[2];     // RANGE_QUERY only
+};
+static_assert(sizeof(WorkloadRecord) == 48, "WorkloadRecord layout is part of the file format");
+
+// Write the next `count` operations of the generator (with its current mix).
+// Returns the number of records written; throws on I/O errors.
+uint64_t writeWorkloadFile(const std::string& path, WorkloadGenerator& gen, uint64_t count);
+
+// Convert a point file ("x,y" or "id,x,y" lines) into an insert-only workload.
+// max_points = 0 imports every point.
+uint64_t importCsvWorkload(const std::string& csv_path, const std::string& path,
+                           uint64_t max_points = 0);
+
+// Read-only memory mapping of a workload file. Pages are prefaulted on open
+// so replay does not take page faults inside the timed loop.
+class MappedWorkload {
+public:
+    explicit MappedWorkload(const std::string& path);
+    ~MappedWorkload();
+
+    MappedWorkload(const MappedWorkload&) = delete;
+    MappedWorkload& operator=(const MappedWorkload&) = delete;
+
+    const WorkloadFileHeader& header() const { return *static_cast<const WorkloadFileHeader*>(base_); }
+    uint64_t size() const { return header().count; }
+    const WorkloadRecord* records() const { return records_; }
+    const WorkloadRecord& operator[](uint64_t i) const { return records_[i]; }
+
+    // Data type and mix recorded in the header
+    std::string dataType() const;
+    WorkloadMix mix() const;
+
+private:
+    void* base_;
+    size_t length_;
+    const WorkloadRecord* records_;
+};
+
+} // namespace SpatialIndex
+
+#endif // WORKLOAD_FILE_H
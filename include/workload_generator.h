@@ -3,36 +3,147 @@
 
 #include <string>
 #include <random>
+#include <cstdint>
+#include <vector>
+#include <memory>
 #include <spatialindex/SpatialIndex.h>
+#include "dims.h"
 
 namespace SpatialIndex {
 
-// Workload generator class for generating points based on distribution type
+// Kind of operation produced by WorkloadGenerator::nextOperation
+enum class OpType {
+    INSERT = 0,
+    RANGE_QUERY = 1,
+    KNN_QUERY = 2
+};
+
+const char* opTypeName(OpType type);
+
+// Read/write mix of a workload. Ratios are relative weights and need not sum to 1.
+struct WorkloadMix {
+    double insert_ratio = 1.0;
+    double range_ratio = 0.0;
+    double knn_ratio = 0.0;
+    double range_selectivity = 0.001; // Fraction of the data extent's area covered by a window
+    uint32_t knn_k = 10;
+
+    bool insertOnly() const { return range_ratio <= 0.0 && knn_ratio <= 0.0; }
+};
+
+// Parameters of the synthetic distributions. All data lies in [0, 1000)^dims.
+struct DistributionParams {
+    // Point dimension: 2, 3 or 4
+    uint32_t dims = 2;
+    // SORTED / NEARLY_SORTED: number of points materialised and ordered along a Hilbert curve
+    uint64_t stream_length = 1000000;
+    // NEARLY_SORTED: K% of items out of order, each displaced by at most L positions
+    double sort_k_pct = 10.0;
+    uint64_t sort_l = 100;
+    // CLUSTERED: Gaussian mixture with equally weighted components
+    uint32_t clusters = 10;
+    double cluster_stddev = 20.0;
+    // ZIPF: hotspot ranks drawn from Zipf(zipf_s), points spread normally around each hotspot
+    uint32_t hotspots = 100;
+    double zipf_s = 1.0;
+    double hotspot_radius = 5.0;
+};
+
+class MappedWorkload;
+struct WorkloadRecord;
+
+// A single workload operation
+struct Operation {
+    OpType type;
+    uint64_t id;           // Data id (INSERT only)
+    double coords[kMaxDims];      // Insert point, window centre or kNN query point
+    double half_extent[kMaxDims]; // Window half-size per dimension (RANGE_QUERY only)
+};
+
+// Workload generator class for generating points based on distribution type.
+// Supported types: RANDOM, WALK, SORTED, NEARLY_SORTED, CLUSTERED, ZIPF.
+// Every type is fully determined by the seed.
+// Points have params.dims coordinates; the per-point code is instantiated per
+// dimension and picked once at construction. 2-D streams are unchanged by this.
+// After replay(), operations come from a pre-generated (2-D) workload file instead.
 class WorkloadGenerator {
 public:
-    WorkloadGenerator(const std::string& data_type, unsigned int seed = 42);
-    
-    // Generate the next point coordinates (fills coords array)
-    void generateNextPoint(double coords[2]);
-    
+    WorkloadGenerator(const std::string& data_type, unsigned int seed = 42,
+                      const DistributionParams& params = DistributionParams());
+
+    // Generate the next point (fills dims() coordinates)
+    void generateNextPoint(double* coords) { (this->*next_point_)(coords); }
+
+    // Next point as an insert: returns its data id, so inserts issued later
+    // by nextOperation() continue after it (bulk loads draw their points here)
+    id_type nextInsert(double* coords);
+
+    // Generate the next operation according to the configured mix.
+    // Queries are only issued once at least one point has been generated.
+    Operation nextOperation();
+
     // Reset the generator state
     void reset();
-    
+
+    // Replay the operations of a mapped workload file; reading past its end throws.
+    // Data type and mix are taken from the file.
+    void replay(std::shared_ptr<const MappedWorkload> workload);
+    bool replaying() const { return dist_ == Distribution::REPLAY; }
+
     // Get the distribution type
     std::string getDataType() const { return data_type_; }
+    const DistributionParams& getParams() const { return params_; }
+    uint32_t dims() const { return params_.dims; }
+
+    void setMix(const WorkloadMix& mix) { mix_ = mix; }
+    const WorkloadMix& getMix() const { return mix_; }
 
 private:
+    enum class Distribution { RANDOM, WALK, SORTED, NEARLY_SORTED, CLUSTERED, ZIPF, REPLAY };
+
     std::string data_type_;
+    Distribution dist_;
+    DistributionParams params_;
+    unsigned int seed_;
     std::mt19937 gen_;
+    std::mt19937 op_gen_; // Separate stream so the inserted points match insert-only runs
     std::uniform_real_distribution<double> uni_rand_;
     std::normal_distribution<double> walk_dist_;
-    double current_coords_[2];
+    double current_coords_[kMaxDims];
     bool initialized_;
-    
+
+    // SORTED / NEARLY_SORTED: pre-ordered stream, replayed in order (wraps around)
+    std::vector<double> stream_coords_;
+    size_t stream_pos_;
+    // CLUSTERED cluster centres / ZIPF hotspot centres, flattened (dims per centre)
+    std::vector<double> centres_;
+    std::discrete_distribution<uint32_t> zipf_rank_;
+    // REPLAY: mapped records, read in place
+    std::shared_ptr<const MappedWorkload> replay_;
+    uint64_t replay_pos_;
+    uint64_t replay_inserts_;
+    uint64_t inserts_; // Insert operations issued since reset (their data ids)
+
+    WorkloadMix mix_;
+    // Bounding box of all generated points, used to place queries over the data
+    double data_low_[kMaxDims];
+    double data_high_[kMaxDims];
+    bool has_data_;
+
+    // Instantiations for the configured dimension
+    void (WorkloadGenerator::*next_point_)(double*);
+    void (WorkloadGenerator::*next_query_)(Operation&);
+    void (WorkloadGenerator::*build_sorted_stream_)();
+
     void initialize();
+    void setupDistribution();
+    template <uint32_t D> void nextPoint(double* coords);
+    template <uint32_t D> void nextQuery(Operation& op);
+    template <uint32_t D> void buildSortedStream();
+    template <uint32_t D> void trackPoint(const double* coords);
+    const WorkloadRecord& nextReplayRecord();
 };
 
 } // namespace SpatialIndex
 
 #endif // WORKLOAD_GENERATOR_H
-
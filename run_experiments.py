@@ -5,6 +5,22 @@ import os
 # --- Configuration ---
 CONFIG_FILE = 'config.toml'
 CPP_EXECUTABLE = './build/run_rtree' # Path to your compiled program
+# Optional settings forwarded as key=value arguments (section value overrides global)
+OPTION_KEYS = ['insert_ratio', 'range_ratio', 'knn_ratio', 'selectivity', 'knn_k',
+               'seed', 'sort_k', 'sort_l', 'clusters', 'cluster_stddev',
+               'hotspots', 'zipf_s', 'hotspot_radius', 'sware_order',
+               'sware_items', 'sware_page_items', 'sware_flush_fraction',
+               'sware_budget_kb', 'sware_policy', 'sware_min_gain', 'sware_page_buffer',
+               'build', 'bulk_points', 'bulk_file', 'bulk_fill', 'sort_memory_items',
+               'sort_threads', 'build_queries', 'timing', 'trace_file', 'perf',
+               'workload_file', 'index', 'shard_threads', 'shards', 'shard_partition',
+               'shard_queue_items', 'shard_queries', 'concurrency', 'writers', 'readers',
+               'snapshot_inserts', 'lru_k', 'pin_levels', 'async_dirty_pages', 'storage', 'io_engine',
+               'io_depth', 'io_threads', 'packed_queries', 'dims', 'ingest', 'ingest_ring',
+               'ingest_batch', 'lsm_memtable', 'lsm_fanout', 'lsm_background', 'lsm_queries',
+               'updates', 'update_ticks', 'update_fraction', 'update_step', 'update_probes',
+               'open_existing', 'prewarm', 'restart', 'restart_queries', 'drop_cache',
+               'leaf_codec', 'leaf_capacity', 'codec_queries', 'disk_base_name']
 # ---------------------
 
 def main():
@@ -58,10 +74,64 @@ def main():
             if buffer_mb > 0 and page_size > 0:
                 buffer_pages = (buffer_mb * 1024 * 1024) // page_size
         
+        options = {}
+        for key in OPTION_KEYS:
+            if key in settings:
+                options[key] = settings[key]
+            elif key in config and not isinstance(config[key], dict):
+                options[key] = config[key]
+        mixed = options.get('range_ratio', 0) > 0 or options.get('knn_ratio', 0) > 0
+
         # Auto-generate output filename
         output_file = f"{run_type}_M{M}_fill{int(fill*100)}_N{N}_{data_type.lower()}"
+        if data_type.upper() == 'NEARLY_SORTED':
+            output_file += f"_K{options.get('sort_k', 10)}_L{options.get('sort_l', 100)}"
+        if options.get('dims', 2) != 2:
+            output_file += f"_d{options['dims']}"
+        if run_type == 'mem' and str(options.get('storage', 'DEFAULT')).upper() == 'ARENA':
+            output_file += "_arena"
         if run_type == 'disk':
             output_file += f"_buf{buffer_type}_{buffer_mb}MB"
+            if buffer_type == 'SWARE':
+                output_file += f"_{str(options.get('sware_order', 'X')).lower()}"
+                if str(options.get('sware_policy', 'FIXED')).upper() == 'ADAPTIVE':
+                    output_file += "_adaptive"
+                if str(options.get('sware_page_buffer', 'NONE')).upper() != 'NONE':
+                    output_file += f"_{str(options['sware_page_buffer']).lower()}"
+            if str(options.get('storage', 'DEFAULT')).upper() == 'DIRECT':
+                output_file += f"_direct_{str(options.get('io_engine', 'AUTO')).lower()}"
+            if str(options.get('leaf_codec', 'NONE')).upper() != 'NONE':
+                output_file += f"_leaf{str(options['leaf_codec']).lower()}"
+            if options.get('async_dirty_pages', 0) > 0:
+                output_file += f"_async{options['async_dirty_pages']}"
+            if buffer_type == 'LRUK':
+                output_file += f"_k{options.get('lru_k', 2)}"
+            elif buffer_type == 'LEVEL' and options.get('pin_levels', 0) > 0:
+                output_file += f"_pin{options['pin_levels']}"
+        build = str(options.get('build', 'INCREMENTAL')).upper()
+        if build != 'INCREMENTAL':
+            output_file += f"_build{build}"
+        index = str(options.get('index', 'SINGLE')).upper()
+        if index == 'SHARDED':
+            output_file += f"_sharded_{str(options.get('shard_partition', 'GRID')).lower()}"
+        elif index == 'CONCURRENT':
+            output_file += f"_concurrent_{str(options.get('concurrency', 'GLOBAL_LOCK')).lower()}"
+        elif index == 'PACKED':
+            output_file += "_packed"
+        elif index == 'LSM':
+            output_file += f"_lsm_f{options.get('lsm_fanout', 4)}"
+        elif options.get('restart'):
+            output_file += f"_restart_{str(options['restart']).lower()}"
+            if options.get('prewarm', 0) > 0:
+                output_file += f"_prewarm{options['prewarm']}"
+        elif options.get('updates'):
+            output_file += f"_updates_{str(options['updates']).lower()}"
+        elif str(options.get('ingest', 'SERIAL')).upper() == 'PIPELINE':
+            output_file += "_pipeline"
+        if mixed:
+            output_file += "_mixed"
+        if options.get('workload_file'):
+            output_file += f"_replay_{os.path.splitext(os.path.basename(str(options['workload_file'])))[0]}"
         output_file += ".csv"
 
         # Build the command as a list of strings
@@ -77,7 +147,7 @@ def main():
             data_type,
             str(page_size),
             output_file
-        ]
+        ] + [f"{key}={value}" for key, value in options.items()]
         
         print(f"Executing: {' '.join(command)}")
 
@@ -0,0 +1,105 @@
+#include "arena_storage.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace SpatialIndex {
+
+ArenaStorageManager::ArenaStorageManager(uint32_t slot_bytes, size_t slab_bytes)
+    // Slots stay 8-byte aligned
+    : slot_bytes_((std::max<uint32_t>(slot_bytes, 8) + 7) & ~7u), slab_bytes_(slab_bytes),
+      bump_(nullptr), bump_end_(nullptr), live_pages_(0), live_bytes_(0), reserved_bytes_(0) {}
+
+ArenaStorageManager::~ArenaStorageManager() {
+    for (const Entry& e : entries_) {
+        if (e.kind == LARGE) delete[] e.ptr;
+    }
+}
+
+uint8_t* ArenaStorageManager::allocate(Kind kind, uint32_t len) {
+    if (kind == LARGE) {
+        reserved_bytes_ += len;
+        return new uint8_t[len];
+    }
+    if (!free_slots_.empty()) {
+        uint8_t* p = free_slots_.back();
+        free_slots_.pop_back();
+        return p;
+    }
+    if (bump_ == bump_end_) {
+        // At least 16 slots per slab, whole slots only
+        const size_t bytes = std::max<size_t>(16, slab_bytes_ / slot_bytes_) * slot_bytes_;
+        slabs_.emplace_back(new uint8_t[bytes]);
+        reserved_bytes_ += bytes;
+        bump_ = slabs_.back().get();
+        bump_end_ = bump_ + bytes;
+    }
+    uint8_t* p = bump_;
+    bump_ += slot_bytes_;
+    return p;
+}
+
+void ArenaStorageManager::release(const Entry& e) {
+    if (e.kind == LARGE) {
+        reserved_bytes_ -= e.len;
+        delete[] e.ptr;
+    } else {
+        free_slots_.push_back(e.ptr);
+    }
+}
+
+const ArenaStorageManager::Entry& ArenaStorageManager::entryOf(id_type page) const {
+    if (page < 0 || static_cast<size_t>(page) >= entries_.size() || entries_[page].kind == FREE) {
+        throw std::runtime_error("ArenaStorageManager: invalid page " + std::to_string(page));
+    }
+    return entries_[page];
+}
+
+void ArenaStorageManager::loadByteArray(const id_type page, uint32_t& len, uint8_t** data) {
+    const Entry& e = entryOf(page);
+    len = e.len;
+    *data = new uint8_t[len];
+    std::memcpy(*data, e.ptr, len);
+}
+
+void ArenaStorageManager::storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) {
+    const Kind kind = len <= slot_bytes_ ? SLOT : LARGE;
+
+    if (page == StorageManager::NewPage) {
+        if (!free_ids_.empty()) {
+            page = free_ids_.back();
+            free_ids_.pop_back();
+        } else {
+            page = static_cast<id_type>(entries_.size());
+            entries_.push_back(Entry{nullptr, 0, FREE});
+        }
+        entries_[page] = Entry{allocate(kind, len), len, kind};
+        ++live_pages_;
+    } else {
+        entryOf(page);
+        Entry& e = entries_[page];
+        live_bytes_ -= e.len;
+        // A slot takes any array that fits; large arrays are only reused at the same size
+        if (kind != e.kind || (kind == LARGE && len != e.len)) {
+            release(e);
+            e.ptr = allocate(kind, len);
+            e.kind = kind;
+        }
+        e.len = len;
+    }
+    live_bytes_ += len;
+    std::memcpy(entries_[page].ptr, data, len);
+}
+
+void ArenaStorageManager::deleteByteArray(const id_type page) {
+    entryOf(page);
+    Entry& e = entries_[page];
+    live_bytes_ -= e.len;
+    release(e);
+    e = Entry{nullptr, 0, FREE};
+    free_ids_.push_back(page);
+    --live_pages_;
+}
+
+} // namespace SpatialIndex
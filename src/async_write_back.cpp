@@ -0,0 +1,195 @@
+#include "async_write_back.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace SpatialIndex {
+
+AsyncWriteBackStorageManager::AsyncWriteBackStorageManager(IStorageManager& inner, size_t dirty_limit)
+    : inner_(inner), dirty_limit_(std::max<size_t>(dirty_limit, 1)),
+      flush_waiters_(0), stop_(false),
+      stalls_(0), absorbed_(0), pages_written_(0), runs_(0) {
+    flusher_ = std::thread(&AsyncWriteBackStorageManager::flusherLoop, this);
+}
+
+AsyncWriteBackStorageManager::~AsyncWriteBackStorageManager() {
+    try {
+        flush();
+    } catch (...) {
+        // Nothing sensible left to do with a failed write in a destructor
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    flusher_.join();
+}
+
+// Called with mutex_ held
+void AsyncWriteBackStorageManager::rethrowError() {
+    if (error_) {
+        std::exception_ptr e = error_;
+        error_ = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void AsyncWriteBackStorageManager::flusherLoop() {
+    const size_t trigger = std::max<size_t>(dirty_limit_ / 2, 1);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_cv_.wait(lock, [&] {
+            return stop_ || dirty_.size() >= trigger || (flush_waiters_ > 0 && !dirty_.empty());
+        });
+        if (dirty_.empty()) {
+            if (stop_) break;
+            continue;
+        }
+
+        // Take the whole dirty set; stores can refill it meanwhile
+        in_flight_.swap(dirty_);
+        lock.unlock();
+        room_cv_.notify_all();
+
+        try {
+            std::vector<id_type> pages;
+            std::vector<uint32_t> lens;
+            std::vector<const uint8_t*> data;
+            id_type prev = StorageManager::NewPage;
+            for (auto& entry : in_flight_) {
+                if (prev == StorageManager::NewPage || entry.first != prev + 1) {
+                    runs_.fetch_add(1, std::memory_order_relaxed);
+                }
+                pages.push_back(entry.first);
+                lens.push_back(static_cast<uint32_t>(entry.second.size()));
+                data.push_back(entry.second.data());
+                prev = entry.first;
+            }
+            std::lock_guard<std::mutex> io(io_mutex_);
+            storePages(inner_, pages.size(), pages.data(), lens.data(), data.data());
+            pages_written_.fetch_add(pages.size(), std::memory_order_relaxed);
+        } catch (...) {
+            lock.lock();
+            error_ = std::current_exception();
+            lock.unlock();
+        }
+
+        lock.lock();
+        in_flight_.clear();
+        room_cv_.notify_all();
+    }
+}
+
+bool AsyncWriteBackStorageManager::loadParked(id_type page, uint32_t& len, uint8_t** data) const {
+    auto it = dirty_.find(page);
+    if (it == dirty_.end()) {
+        it = in_flight_.find(page);
+        if (it == in_flight_.end()) return false;
+    }
+    len = static_cast<uint32_t>(it->second.size());
+    *data = new uint8_t[len];
+    std::memcpy(*data, it->second.data(), len);
+    return true;
+}
+
+void AsyncWriteBackStorageManager::loadByteArray(const id_type page, uint32_t& len, uint8_t** data) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (loadParked(page, len, data)) return;
+    }
+    // Not parked, so the inner manager holds the latest version
+    std::lock_guard<std::mutex> io(io_mutex_);
+    inner_.loadByteArray(page, len, data);
+}
+
+void AsyncWriteBackStorageManager::loadByteArrays(size_t n, const id_type* pages, uint32_t* lens, uint8_t** data) {
+    std::vector<size_t> rest;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < n; ++i) {
+            if (!loadParked(pages[i], lens[i], &data[i])) rest.push_back(i);
+        }
+    }
+    if (rest.empty()) return;
+
+    std::vector<id_type> rest_pages(rest.size());
+    std::vector<uint32_t> rest_lens(rest.size());
+    std::vector<uint8_t*> rest_data(rest.size(), nullptr);
+    for (size_t j = 0; j < rest.size(); ++j) rest_pages[j] = pages[rest[j]];
+    {
+        std::lock_guard<std::mutex> io(io_mutex_);
+        loadPages(inner_, rest.size(), rest_pages.data(), rest_lens.data(), rest_data.data());
+    }
+    for (size_t j = 0; j < rest.size(); ++j) {
+        lens[rest[j]] = rest_lens[j];
+        data[rest[j]] = rest_data[j];
+    }
+}
+
+void AsyncWriteBackStorageManager::storeByteArrays(size_t n, const id_type* pages, const uint32_t* lens,
+                                                   const uint8_t* const* data) {
+    // Parked one by one: the flusher batches them on the way down
+    for (size_t i = 0; i < n; ++i) {
+        id_type page = pages[i];
+        storeByteArray(page, lens[i], data[i]);
+    }
+}
+
+void AsyncWriteBackStorageManager::storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) {
+    if (page == StorageManager::NewPage) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rethrowError();
+        }
+        std::lock_guard<std::mutex> io(io_mutex_);
+        inner_.storeByteArray(page, len, data);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    rethrowError();
+    auto it = dirty_.find(page);
+    if (it != dirty_.end()) {
+        it->second.assign(data, data + len);
+        absorbed_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Back-pressure: wait for the flusher to take the current dirty set
+    if (dirty_.size() >= dirty_limit_) {
+        stalls_.fetch_add(1, std::memory_order_relaxed);
+        work_cv_.notify_one();
+        room_cv_.wait(lock, [&] { return dirty_.size() < dirty_limit_ || error_; });
+        rethrowError();
+    }
+    dirty_[page].assign(data, data + len);
+    if (dirty_.size() >= std::max<size_t>(dirty_limit_ / 2, 1)) work_cv_.notify_one();
+}
+
+void AsyncWriteBackStorageManager::deleteByteArray(const id_type page) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        rethrowError();
+        dirty_.erase(page);
+        // A write landing after the delete would bring the page back
+        room_cv_.wait(lock, [&] { return in_flight_.count(page) == 0; });
+    }
+    std::lock_guard<std::mutex> io(io_mutex_);
+    inner_.deleteByteArray(page);
+}
+
+void AsyncWriteBackStorageManager::flush() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++flush_waiters_;
+        work_cv_.notify_one();
+        room_cv_.wait(lock, [&] { return (dirty_.empty() && in_flight_.empty()) || error_; });
+        --flush_waiters_;
+        rethrowError();
+    }
+    std::lock_guard<std::mutex> io(io_mutex_);
+    inner_.flush();
+}
+
+} // namespace SpatialIndex
@@ -1,80 +1,193 @@
 #include "benchmark_runner.h"
+#include "query_runner.h"
 #include <fstream>
 #include <iostream>
-#include <chrono>
 
 namespace SpatialIndex {
 
-void runBenchmark(
+namespace {
+
+// The benchmark loop for D-dimensional points
+template <uint32_t D>
+RunSummary runBenchmarkDims(
     ISpatialIndex* tree,
+    const CountingStorageManager& counters,
+    const IoMonitor& io,
     WorkloadGenerator& workload_gen,
     int num_insertions,
-    const std::string& output_csv
+    const std::string& output_csv,
+    LatencyRecorder* recorder,
+    PerfProfiler* profiler,
+    std::ostream& log
 ) {
-    std::ofstream f(output_csv);
-    if (!f.is_open()) {
-        std::cerr << "Error: Could not open output file: " << output_csv << std::endl;
-        return;
+    // Per-operation CSV lines are only written without a recorder
+    std::ofstream f;
+    if (!recorder) {
+        f.open(output_csv);
+        if (!f.is_open()) {
+            log << "Error: Could not open output file: " << output_csv << std::endl;
+            return RunSummary();
+        }
+        // Write CSV header
+        f << "InsertIdx,Time_us,DidSplit,IsRootSplit,NodesBefore,NodesAfter,"
+             "HeightBefore,HeightAfter,SplitsBefore,SplitsAfter,NodeReads,NodeWrites,Time_ns\n";
     }
+
+    const WorkloadMix& mix = workload_gen.getMix();
+    std::ofstream fq;
+    if (!recorder && !mix.insertOnly()) {
+        fq.open(queryCsvName(output_csv));
+        if (!fq.is_open()) {
+            log << "Error: Could not open query output file: " << queryCsvName(output_csv) << std::endl;
+            return RunSummary();
+        }
+        fq << "OpIdx,OpType,Time_us,NodesVisited,Results,Time_ns\n";
+    }
+
+    RunSummary summary;
+    OpTypeStats* const op_stats = summary.stats;
+    int insert_idx = 0;
+
+    const std::string io_csv = derivedCsvName(output_csv, "_io");
+    std::ofstream fio(io_csv);
+    if (!fio.is_open()) {
+        log << "Error: Could not open I/O output file: " << io_csv << std::endl;
+        return RunSummary();
+    }
+    fio << "Ops,Inserts";
+    writeIoCsvHeader(fio);
+    fio << "\n";
+    const IoSnapshot io_start = io.snapshot();
+    IoSnapshot io_last = io_start;
+    auto sample_io = [&](int ops_done) {
+        const IoSnapshot now = io.snapshot();
+        fio << ops_done << "," << insert_idx;
+        writeIoCsvFields(fio, ioDelta(now, io_last));
+        fio << "\n";
+        io_last = now;
+    };
     
-    std::cout << "Starting benchmark: " << num_insertions << " insertions (" 
-              << workload_gen.getDataType() << " data) -> " << output_csv << std::endl;
-    
-    // Write CSV header
-    f << "InsertIdx,Time_us,DidSplit,IsRootSplit,NodesBefore,NodesAfter,"
-         "HeightBefore,HeightAfter,SplitsBefore,SplitsAfter\n";
+    log << "Starting benchmark: " << num_insertions
+        << (mix.insertOnly() ? " insertions (" : " operations (")
+        << workload_gen.getDataType() << " data, " << D << "-D) -> " << output_csv << std::endl;
     
     int progress_milestone = num_insertions / 10;
     if (progress_milestone == 0) progress_milestone = 1;
-    
+
+
     for (int i = 0; i < num_insertions; ++i) {
-        // Get statistics before insertion
-        const uint32_t nodes_before = rtree_nodes(*tree);
-        const uint32_t h_before = rtree_height(*tree);
-        const uint64_t sp_before = rtree_splits(*tree);
-        
-        // Generate point coordinates and measure insertion time
-        double coords[2];
-        workload_gen.generateNextPoint(coords);
-        Point p(coords, 2);
-        auto t0 = std::chrono::high_resolution_clock::now();
-        tree->insertData(0, nullptr, p, static_cast<id_type>(i));
-        auto t1 = std::chrono::high_resolution_clock::now();
-        
-        // Get statistics after insertion
-        const uint32_t nodes_after = rtree_nodes(*tree);
-        uint32_t h_after = h_before;
-        uint64_t sp_after = sp_before;
-        
-        // Only query height and splits if node count changed (optimization)
-        if (nodes_after > nodes_before) {
-            h_after = rtree_height(*tree);
-            sp_after = rtree_splits(*tree);
+        const Operation op = workload_gen.nextOperation();
+
+        if (op.type != OpType::INSERT) {
+            const LatencyPhase phase = op.type == OpType::RANGE_QUERY ? LatencyPhase::RANGE_QUERY
+                                                                      : LatencyPhase::KNN_QUERY;
+            if (profiler) profiler->start();
+            const QueryResult qr = runQuery(tree, op, mix.knn_k, D);
+            if (profiler) {
+                profiler->stop();
+                profiler->record(phase, qr.time_ns);
+            }
+            op_stats[static_cast<int>(op.type)].add(qr.time_ns, qr.nodes_visited, qr.results);
+            if (recorder) {
+                recorder->record(phase, i, qr.time_ns, static_cast<uint32_t>(qr.nodes_visited));
+            } else {
+                fq << i << "," << opTypeName(op.type) << "," << qr.time_us << ","
+                   << qr.nodes_visited << "," << qr.results << "," << qr.time_ns << "\n";
+            }
+        } else {
+            // Counter snapshots are plain atomic loads, kept outside the timed region
+            const TreeCounterSnapshot before = counters.snapshot();
+            
+            // Measure insertion time
+            Point p(op.coords, D);
+            if (profiler) profiler->start();
+            const uint64_t t0 = nowNs();
+            tree->insertData(0, nullptr, p, static_cast<id_type>(op.id));
+            const uint64_t dur_ns = nowNs() - t0;
+            if (profiler) profiler->stop();
+            
+            const TreeCounterSnapshot after = counters.snapshot();
+            const bool did_split = after.splits > before.splits;
+            const bool root_split = after.height > before.height;
+            const uint64_t node_writes = after.node_writes + after.node_allocs -
+                                         before.node_writes - before.node_allocs;
+            const auto dur_us = static_cast<int64_t>(dur_ns / 1000);
+            op_stats[static_cast<int>(OpType::INSERT)].add(dur_ns, 0, 0);
+            if (profiler) profiler->record(did_split ? LatencyPhase::SPLIT : LatencyPhase::INSERT, dur_ns);
+            
+            if (recorder) {
+                const uint8_t flags = (did_split ? kTraceDidSplit : 0) | (root_split ? kTraceRootSplit : 0);
+                recorder->record(did_split ? LatencyPhase::SPLIT : LatencyPhase::INSERT,
+                                 insert_idx, dur_ns, static_cast<uint32_t>(node_writes), flags);
+            } else {
+                // Write to CSV
+                f << insert_idx << "," << dur_us << "," << (did_split ? 1 : 0) << "," 
+                  << (root_split ? 1 : 0) << ","
+                  << before.nodes << "," << after.nodes << ","
+                  << before.height << "," << after.height << ","
+                  << before.splits << "," << after.splits << ","
+                  << (after.node_reads - before.node_reads) << ","
+                  << node_writes << "," << dur_ns << "\n";
+            }
+            ++insert_idx;
         }
         
-        const bool did_split = (nodes_after > nodes_before) || (sp_after > sp_before);
-        const bool root_split = (h_after > h_before);
-        const auto dur_us = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
-        
-        // Write to CSV
-        f << i << "," << dur_us << "," << (did_split ? 1 : 0) << "," 
-          << (root_split ? 1 : 0) << ","
-          << nodes_before << "," << nodes_after << ","
-          << h_before << "," << h_after << ","
-          << sp_before << "," << sp_after << "\n";
-        
         // Progress reporting
         if ((i + 1) % progress_milestone == 0) {
-            int percentage = static_cast<int>(((i + 1) * 100) / num_insertions);
-            std::cout << "  ... Progress for " << output_csv << ": "
-                      << percentage << "% completed ("
-                      << (i + 1) << " insertions)\n";
+            sample_io(i + 1);
+            int percentage = static_cast<int>((static_cast<int64_t>(i + 1) * 100) / num_insertions);
+            log << "  ... Progress for " << output_csv << ": "
+                << percentage << "% completed ("
+                << (i + 1) << (mix.insertOnly() ? " insertions)\n" : " operations)\n");
         }
     }
     
-    f.close();
-    std::cout << "Benchmark finished for " << output_csv << "." << std::endl;
+    if (num_insertions % progress_milestone != 0) sample_io(num_insertions);
+    
+    if (f.is_open()) f.close();
+    if (fq.is_open()) fq.close();
+    fio.close();
+    printOpSummary(log, op_stats);
+    printIoSummary(log, ioDelta(io.snapshot(), io_start));
+    if (recorder) {
+        recorder->finish();
+        const std::string latency_csv = derivedCsvName(output_csv, "_latency");
+        if (!recorder->writeSummary(latency_csv)) {
+            log << "Error: Could not open latency output file: " << latency_csv << std::endl;
+        }
+        log << "  Latency percentiles (" << latency_csv << "):\n";
+        recorder->printSummary(log);
+    }
+    if (profiler) {
+        const std::string perf_csv = derivedCsvName(output_csv, "_perf");
+        if (!profiler->writeSummary(perf_csv)) {
+            log << "Error: Could not open perf output file: " << perf_csv << std::endl;
+        }
+        log << "  Hardware counters (" << perf_csv << "):\n";
+        profiler->printSummary(log);
+    }
+    log << "Benchmark finished for " << output_csv << "." << std::endl;
+    summary.inserts = static_cast<uint64_t>(insert_idx);
+    return summary;
 }
 
-} // namespace SpatialIndex
+} // namespace
 
+RunSummary runBenchmark(
+    ISpatialIndex* tree,
+    const CountingStorageManager& counters,
+    const IoMonitor& io,
+    WorkloadGenerator& workload_gen,
+    int num_insertions,
+    const std::string& output_csv,
+    LatencyRecorder* recorder,
+    PerfProfiler* profiler,
+    std::ostream& log
+) {
+    return dispatchDims(workload_gen.dims(), [&](auto dim) {
+        return runBenchmarkDims<decltype(dim)::value>(tree, counters, io, workload_gen,
+                                                      num_insertions, output_csv, recorder, profiler, log);
+    });
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,124 @@
+#include "build_benchmark.h"
+#include "bulk_load.h"
+#include "query_runner.h"
+#include "rtree_helpers.h"
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+namespace SpatialIndex {
+
+void runBuildBenchmark(
+    const TreeConfig& base_config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const WorkloadMix& query_mix,
+    int num_queries,
+    const std::string& output_csv
+) {
+    std::ostream& log = *base_config.log;
+    std::ofstream f(output_csv);
+    if (!f.is_open()) {
+        log << "Error: Could not open output file: " << output_csv << std::endl;
+        return;
+    }
+
+    log << "Starting build benchmark: "
+        << (base_config.bulk_data_file.empty() ? std::to_string(base_config.bulk_points) + " points ("
+                                                        + gen.getDataType() + " data)"
+                                                      : base_config.bulk_data_file)
+              << " -> " << output_csv << std::endl;
+
+    f << "BuildMode,Points,BuildTime_ms,Nodes,Height,LeafNodes,AvgLeafFill,AvgIndexFill,"
+         "RangeQueries,AvgRange_us,AvgRangeNodes,KnnQueries,AvgKnn_us,AvgKnnNodes\n";
+
+    // Queries only; an insert-only mix falls back to half window, half kNN
+    double range_w = query_mix.range_ratio;
+    double knn_w = query_mix.knn_ratio;
+    if (range_w <= 0.0 && knn_w <= 0.0) range_w = knn_w = 1.0;
+
+    const char* modes[3] = {"INCREMENTAL", "STR", "HILBERT"};
+    for (const char* mode : modes) {
+        TreeConfig config = base_config;
+        config.build_mode = mode;
+
+        // Every mode sees the same points: the generator restarts from its seed
+        gen.reset();
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+        TreeResources resources = setupTree(config, &gen);
+        uint64_t points = config.bulk_points;
+        if (config.build_mode == "INCREMENTAL") {
+            std::unique_ptr<PointSource> source;
+            if (!config.bulk_data_file.empty()) {
+                source.reset(new CsvPointSource(config.bulk_data_file));
+            } else {
+                source.reset(new GeneratorPointSource(gen, config.bulk_points));
+            }
+            double coords[2];
+            id_type id;
+            points = 0;
+            while (source->next(coords, id)) {
+                resources.tree->insertData(0, nullptr, Point(coords, 2), id);
+                ++points;
+            }
+        }
+        resources.tree->flush();
+        auto t1 = std::chrono::high_resolution_clock::now();
+        const auto build_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+
+        const TreeShape shape = rtree_shape(*resources.tree);
+        if (!config.bulk_data_file.empty()) points = shape.data;
+        double index_fill = 0.0;
+        uint64_t index_nodes = 0;
+        for (uint32_t l = 1; l < shape.height(); ++l) {
+            index_fill += shape.fill(l, config.M_capacity) * shape.nodes_per_level[l];
+            index_nodes += shape.nodes_per_level[l];
+        }
+        if (index_nodes > 0) index_fill /= index_nodes;
+
+        // Identical query sequence for every mode, spread over the data extent
+        std::mt19937 qgen(seed ^ 0x5bd1e995u);
+        std::uniform_real_distribution<double> pick(0.0, range_w + knn_w);
+        const double side_frac = std::sqrt(std::max(0.0, query_mix.range_selectivity));
+        OpTypeStats stats[3];
+        for (int q = 0; q < num_queries && shape.data > 0; ++q) {
+            Operation op;
+            op.type = pick(qgen) < range_w ? OpType::RANGE_QUERY : OpType::KNN_QUERY;
+            for (int d = 0; d < 2; ++d) {
+                op.coords[d] = std::uniform_real_distribution<double>(shape.low[d], shape.high[d])(qgen);
+                op.half_extent[d] = 0.5 * side_frac * (shape.high[d] - shape.low[d]);
+            }
+            const QueryResult qr = runQuery(resources.tree, op, query_mix.knn_k);
+            stats[static_cast<int>(op.type)].add(qr.time_ns, qr.nodes_visited, qr.results);
+        }
+        cleanupTree(resources);
+
+        auto avg = [](uint64_t total, uint64_t count) {
+            return count ? static_cast<double>(total) / count : 0.0;
+        };
+        const OpTypeStats& rs = stats[static_cast<int>(OpType::RANGE_QUERY)];
+        const OpTypeStats& ks = stats[static_cast<int>(OpType::KNN_QUERY)];
+
+        f << mode << "," << points << "," << build_ms << ","
+          << shape.totalNodes() << "," << shape.height() << ","
+          << (shape.height() ? shape.nodes_per_level[0] : 0) << ","
+          << shape.fill(0, config.M_capacity) << "," << index_fill << ","
+          << rs.count << "," << avg(rs.total_us, rs.count) << "," << avg(rs.total_nodes, rs.count) << ","
+          << ks.count << "," << avg(ks.total_us, ks.count) << "," << avg(ks.total_nodes, ks.count) << "\n";
+
+        log << "  " << mode << ": built in " << build_ms << " ms, "
+            << shape.totalNodes() << " nodes, height " << shape.height()
+            << ", leaf fill " << shape.fill(0, config.M_capacity) << std::endl;
+        printOpSummary(log, stats);
+    }
+
+    f.close();
+    log << "Build benchmark finished for " << output_csv << "." << std::endl;
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,338 @@
+#include "bulk_load.h"
+#include "external_sort.h"
+#include "space_filling_curve.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace SpatialIndex {
+
+bool GeneratorPointSource::next(double coords[2], id_type& id) {
+    if (produced_ >= count_) return false;
+    id = gen_.nextInsert(coords);
+    ++produced_;
+    return true;
+}
+
+void GeneratorPointSource::rewind() {
+    gen_.reset();
+    produced_ = 0;
+}
+
+CsvPointSource::CsvPointSource(const std::string& path)
+    : path_(path), in_(path), next_id_(0) {
+    if (!in_.is_open()) {
+        throw std::runtime_error("Could not open point file: " + path);
+    }
+}
+
+bool CsvPointSource::next(double coords[2], id_type& id) {
+    std::string line;
+    while (std::getline(in_, line)) {
+        if (line.empty()) continue;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        std::vector<double> values;
+        double v;
+        while (fields >> v) values.push_back(v);
+        if (values.size() == 2) {
+            coords[0] = values[0];
+            coords[1] = values[1];
+            id = next_id_++;
+            return true;
+        }
+        if (values.size() >= 3) {
+            id = static_cast<id_type>(values[0]);
+            coords[0] = values[1];
+            coords[1] = values[2];
+            ++next_id_;
+            return true;
+        }
+        // Header or malformed line
+    }
+    return false;
+}
+
+void CsvPointSource::rewind() {
+    in_.clear();
+    in_.seekg(0);
+    next_id_ = 0;
+}
+
+PointDataStream::PointDataStream(PointSource& source)
+    : source_(source), id_(0), has_next_(false), count_(0) {
+    advance();
+}
+
+void PointDataStream::advance() {
+    has_next_ = source_.next(coords_, id_);
+}
+
+IData* PointDataStream::getNext() {
+    if (!has_next_) return nullptr;
+    Region r(coords_, coords_, 2);
+    RTree::Data* d = new RTree::Data(0, nullptr, r, id_);
+    ++count_;
+    advance();
+    return d;
+}
+
+void PointDataStream::rewind() {
+    source_.rewind();
+    count_ = 0;
+    advance();
+}
+
+namespace {
+
+// Entry of a node being packed: child page (or point id) and its MBR
+struct PackedEntry {
+    id_type id;
+    double low[2];
+    double high[2];
+};
+
+// Writes one node page in libspatialindex's layout: type (1 index, 2 leaf),
+// level, child count, per child low / high / id / data length, then the
+// node MBR. The new page id and the node MBR go to `mbr`.
+void writeNode(IStorageManager& sm, uint32_t level, const std::vector<PackedEntry>& entries, PackedEntry& mbr) {
+    const uint32_t header[3] = {level == 0 ? 2u : 1u, level, static_cast<uint32_t>(entries.size())};
+    const size_t entry_bytes = 4 * sizeof(double) + sizeof(id_type) + sizeof(uint32_t);
+    std::vector<uint8_t> page(sizeof(header) + entries.size() * entry_bytes + 4 * sizeof(double));
+    uint8_t* p = page.data();
+    std::memcpy(p, header, sizeof(header));
+    p += sizeof(header);
+
+    for (int d = 0; d < 2; ++d) {
+        mbr.low[d] = std::numeric_limits<double>::max();
+        mbr.high[d] = -std::numeric_limits<double>::max();
+    }
+    const uint32_t data_len = 0;
+    for (const PackedEntry& e : entries) {
+        std::memcpy(p, e.low, sizeof(e.low));
+        std::memcpy(p + sizeof(e.low), e.high, sizeof(e.high));
+        std::memcpy(p + 4 * sizeof(double), &e.id, sizeof(id_type));
+        std::memcpy(p + 4 * sizeof(double) + sizeof(id_type), &data_len, sizeof(uint32_t));
+        p += entry_bytes;
+        for (int d = 0; d < 2; ++d) {
+            mbr.low[d] = std::min(mbr.low[d], e.low[d]);
+            mbr.high[d] = std::max(mbr.high[d], e.high[d]);
+        }
+    }
+    std::memcpy(p, mbr.low, sizeof(mbr.low));
+    std::memcpy(p + sizeof(mbr.low), mbr.high, sizeof(mbr.high));
+
+    id_type page_id = StorageManager::NewPage;
+    sm.storeByteArray(page_id, static_cast<uint32_t>(page.size()), page.data());
+    mbr.id = page_id;
+}
+
+// Records the root page of a tree
+class RootIdStrategy : public IQueryStrategy {
+public:
+    id_type root = -1;
+
+    void getNextEntry(const IEntry& entry, id_type&, bool& fetch_next) override {
+        root = entry.getIdentifier();
+        fetch_next = false;
+    }
+};
+
+// Packs the Hilbert-ordered run bottom-up: leaves take bulk_fill of the leaf
+// capacity in curve order, every index level bulk_fill of M over the level
+// below. libspatialindex has no API for writing packed nodes, so the pages
+// are written directly and the header of a freshly created tree is patched
+// with the new root and statistics before the tree is reloaded.
+ISpatialIndex* packHilbertRun(const TreeConfig& config, IStorageManager& sm, ParallelExternalSorter& sorter,
+                              uint64_t n, id_type& index_id) {
+    const double fill = std::min(1.0, std::max(0.0, config.bulk_fill_factor));
+    const size_t leaf_fill = std::max<size_t>(1, static_cast<size_t>(config.leafCapacity() * fill));
+    const size_t index_fill = std::max<size_t>(2, static_cast<size_t>(config.M_capacity * fill));
+
+    // A fresh tree provides the header in the library's own format
+    ISpatialIndex* fresh = RTree::createNewRTree(
+        sm, config.fill_factor, config.M_capacity, config.leafCapacity(),
+        2, config.tree_variant, index_id
+    );
+    RootIdStrategy empty_root;
+    fresh->queryStrategy(empty_root);
+    delete fresh;
+
+    std::vector<uint32_t> nodes_in_level;
+    std::vector<PackedEntry> level, node;
+    level.reserve(static_cast<size_t>(n / leaf_fill + 1));
+    node.reserve(std::max(leaf_fill, index_fill));
+    PackedEntry mbr;
+    SortRecord rec;
+    while (sorter.next(rec)) {
+        PackedEntry e;
+        e.id = rec.id;
+        for (int d = 0; d < 2; ++d) e.low[d] = e.high[d] = rec.coords[d];
+        node.push_back(e);
+        if (node.size() == leaf_fill) {
+            writeNode(sm, 0, node, mbr);
+            level.push_back(mbr);
+            node.clear();
+        }
+    }
+    if (!node.empty()) {
+        writeNode(sm, 0, node, mbr);
+        level.push_back(mbr);
+        node.clear();
+    }
+    nodes_in_level.push_back(static_cast<uint32_t>(level.size()));
+
+    std::vector<PackedEntry> parents;
+    while (level.size() > 1) {
+        const uint32_t node_level = static_cast<uint32_t>(nodes_in_level.size());
+        parents.clear();
+        for (size_t i = 0; i < level.size(); i += index_fill) {
+            node.assign(level.begin() + i, level.begin() + std::min(level.size(), i + index_fill));
+            writeNode(sm, node_level, node, mbr);
+            parents.push_back(mbr);
+        }
+        level.swap(parents);
+        nodes_in_level.push_back(static_cast<uint32_t>(level.size()));
+    }
+    const id_type root = level.front().id;
+
+    // Header: root id first, then variant, fill factor, capacities, split and
+    // reinsert parameters, dimension and tight-MBR flag (53 bytes), then the
+    // statistics: nodes, data, height and nodes per level
+    uint32_t header_len = 0;
+    uint8_t* header_bytes = nullptr;
+    sm.loadByteArray(index_id, header_len, &header_bytes);
+    std::vector<uint8_t> header(header_bytes, header_bytes + header_len);
+    delete[] header_bytes;
+
+    const size_t stats_at = 53;
+    const size_t fresh_stats = 3 * sizeof(uint32_t) + sizeof(uint64_t);
+    id_type header_root;
+    uint32_t fresh_nodes = 0, fresh_height = 0;
+    uint64_t fresh_data = 1;
+    if (header.size() >= stats_at + fresh_stats) {
+        std::memcpy(&header_root, header.data(), sizeof(id_type));
+        std::memcpy(&fresh_nodes, header.data() + stats_at, sizeof(uint32_t));
+        std::memcpy(&fresh_data, header.data() + stats_at + sizeof(uint32_t), sizeof(uint64_t));
+        std::memcpy(&fresh_height, header.data() + stats_at + sizeof(uint32_t) + sizeof(uint64_t), sizeof(uint32_t));
+    }
+    if (header.size() < stats_at + fresh_stats || header_root != empty_root.root ||
+        fresh_nodes != 1 || fresh_data != 0 || fresh_height != 1) {
+        throw std::runtime_error("Hilbert bulk load: unrecognised R-tree header layout.");
+    }
+
+    std::vector<uint8_t> patched(header.begin(), header.begin() + stats_at);
+    auto append = [&patched](const void* v, size_t bytes) {
+        const uint8_t* b = static_cast<const uint8_t*>(v);
+        patched.insert(patched.end(), b, b + bytes);
+    };
+    uint32_t total_nodes = 0;
+    for (uint32_t c : nodes_in_level) total_nodes += c;
+    const uint32_t height = static_cast<uint32_t>(nodes_in_level.size());
+    std::memcpy(patched.data(), &root, sizeof(id_type));
+    append(&total_nodes, sizeof(uint32_t));
+    append(&n, sizeof(uint64_t));
+    append(&height, sizeof(uint32_t));
+    append(nodes_in_level.data(), nodes_in_level.size() * sizeof(uint32_t));
+    // Anything the library keeps after the statistics stays as it was
+    patched.insert(patched.end(), header.begin() + stats_at + fresh_stats, header.end());
+
+    sm.storeByteArray(index_id, static_cast<uint32_t>(patched.size()), patched.data());
+    sm.deleteByteArray(empty_root.root);
+    return RTree::loadRTree(sm, index_id);
+}
+
+ISpatialIndex* loadSTR(const TreeConfig& config, IStorageManager& sm, PointSource& source, id_type& index_id) {
+    PointDataStream stream(source);
+    if (!stream.hasNext()) {
+        throw std::runtime_error("Bulk load: the point source is empty.");
+    }
+
+    Tools::PropertySet ps;
+    Tools::Variant var;
+
+    var.m_varType = Tools::VT_LONG;
+    var.m_val.lVal = config.tree_variant;
+    ps.setProperty("TreeVariant", var);
+
+    var.m_varType = Tools::VT_DOUBLE;
+    var.m_val.dblVal = config.bulk_fill_factor;
+    ps.setProperty("FillFactor", var);
+
+    var.m_varType = Tools::VT_ULONG;
+    var.m_val.ulVal = config.M_capacity;
+    ps.setProperty("IndexCapacity", var);
+    var.m_val.ulVal = config.leafCapacity();
+    ps.setProperty("LeafCapacity", var);
+
+    var.m_val.ulVal = 2;
+    ps.setProperty("Dimension", var);
+
+    // libspatialindex's external sorter keeps PageSize * TotalPages records in memory
+    const uint32_t sort_page = 10000;
+    var.m_val.ulVal = sort_page;
+    ps.setProperty("ExternalSortBufferPageSize", var);
+    var.m_val.ulVal = static_cast<uint32_t>(std::max<size_t>(1, config.sort_memory_items / sort_page));
+    ps.setProperty("ExternalSortBufferTotalPages", var);
+
+    return RTree::createAndBulkLoadNewRTree(RTree::BLM_STR, stream, sm, ps, index_id);
+}
+
+ISpatialIndex* loadHilbert(const TreeConfig& config, IStorageManager& sm, PointSource& source, id_type& index_id) {
+    ParallelExternalSorter sorter(config.sort_memory_items, config.sort_threads,
+                                  (config.disk_base_name.empty() ? std::string("bulk") : config.disk_base_name) + "_sort");
+
+    // First pass: find the extent so keys use the full curve resolution
+    double low[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    double high[2] = {-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+    double coords[2];
+    id_type id;
+    uint64_t n = 0;
+    while (source.next(coords, id)) {
+        for (int d = 0; d < 2; ++d) {
+            low[d] = std::min(low[d], coords[d]);
+            high[d] = std::max(high[d], coords[d]);
+        }
+        ++n;
+    }
+    if (n == 0) {
+        throw std::runtime_error("Bulk load: the point source is empty.");
+    }
+
+    source.rewind();
+    while (source.next(coords, id)) {
+        SortRecord rec;
+        rec.key = hilbertKey(quantizeCoord(coords[0], low[0], high[0]),
+                             quantizeCoord(coords[1], low[1], high[1]));
+        rec.coords[0] = coords[0];
+        rec.coords[1] = coords[1];
+        rec.id = id;
+        sorter.add(rec);
+    }
+    sorter.finish();
+    if (sorter.runs() > 0 && !config.quiet) {
+        *config.log << "  Hilbert sort spilled " << sorter.runs() << " runs." << std::endl;
+    }
+
+    return packHilbertRun(config, sm, sorter, n, index_id);
+}
+
+} // namespace
+
+ISpatialIndex* bulkLoadTree(const TreeConfig& config, IStorageManager& sm,
+                            PointSource& source, id_type& index_id) {
+    std::string mode = config.build_mode;
+    std::transform(mode.begin(), mode.end(), mode.begin(), ::toupper);
+
+    if (mode == "STR") return loadSTR(config, sm, source, index_id);
+    if (mode == "HILBERT") return loadHilbert(config, sm, source, index_id);
+    throw std::runtime_error("Unknown build_mode: " + config.build_mode +
+                             ". Use 'INCREMENTAL', 'STR' or 'HILBERT'.");
+}
+
+} // namespace SpatialIndex
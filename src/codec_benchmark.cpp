@@ -0,0 +1,366 @@
+#include "codec_benchmark.h"
+#include "query_runner.h"
+#include "latency_histogram.h"
+#include "rtree_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace SpatialIndex {
+
+std::vector<LeafCodec> getLeafCodecs(const std::string& name) {
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "COMPARE") return {LeafCodec::NONE, LeafCodec::Q16, LeafCodec::Q32};
+    return {getLeafCodec(name)};
+}
+
+namespace {
+
+// Exact coordinates by id in a flat file (removed again on destruction)
+class PointFile {
+public:
+    PointFile(const std::string& path, uint32_t dims) : path_(path), dims_(dims), reads_(0) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) throw std::runtime_error("Cannot create " + path);
+    }
+    ~PointFile() {
+        ::close(fd_);
+        std::remove(path_.c_str());
+    }
+
+    PointFile(const PointFile&) = delete;
+    PointFile& operator=(const PointFile&) = delete;
+
+    // Points 0..n-1, dims coordinates each
+    void write(const std::vector<double>& coords) {
+        const size_t bytes = coords.size() * sizeof(double);
+        if (::pwrite(fd_, coords.data(), bytes, 0) != static_cast<ssize_t>(bytes)) {
+            throw std::runtime_error("Failed writing " + path_);
+        }
+    }
+
+    void read(id_type id, double* coords) {
+        const size_t bytes = dims_ * sizeof(double);
+        if (::pread(fd_, coords, bytes, static_cast<off_t>(id * bytes)) != static_cast<ssize_t>(bytes)) {
+            throw std::runtime_error("Failed reading point " + std::to_string(id) + " from " + path_);
+        }
+        ++reads_;
+    }
+
+    uint64_t reads() const { return reads_; }
+
+private:
+    std::string path_;
+    uint32_t dims_;
+    int fd_;
+    uint64_t reads_;
+};
+
+// Counts range results, reading the exact point of candidates that are not
+// certain hits (cell box inside the window)
+class RefineVisitor : public IVisitor {
+public:
+    RefineVisitor(const Region& window, PointFile& points, uint32_t dims)
+        : window_(window), points_(points), dims_(dims) {}
+
+    uint64_t nodes_visited = 0;
+    uint64_t results = 0;
+
+    void visitNode(const INode&) override { ++nodes_visited; }
+    void visitData(const IData& d) override {
+        IShape* shape = nullptr;
+        d.getShape(&shape);
+        Region cell;
+        shape->getMBR(cell);
+        delete shape;
+        if (window_.containsRegion(cell)) {
+            ++results;
+            return;
+        }
+        double coords[kMaxDims];
+        points_.read(d.getIdentifier(), coords);
+        if (window_.containsPoint(Point(coords, dims_))) ++results;
+    }
+    void visitData(std::vector<const IData*>& v) override {
+        for (const IData* d : v) visitData(*d);
+    }
+
+private:
+    const Region& window_;
+    PointFile& points_;
+    uint32_t dims_;
+};
+
+// Exact distances of the data entries a query reports; entries whose cell
+// box is farther than limit are skipped without reading their point
+class ExactDistanceVisitor : public IVisitor {
+public:
+    ExactDistanceVisitor(const Point& query, PointFile& points, uint32_t dims,
+                         double limit = std::numeric_limits<double>::infinity())
+        : query_(query), points_(points), dims_(dims), limit_(limit) {}
+
+    uint64_t nodes_visited = 0;
+    std::vector<double> distances;
+
+    void visitNode(const INode&) override { ++nodes_visited; }
+    void visitData(const IData& d) override {
+        IShape* shape = nullptr;
+        d.getShape(&shape);
+        const double bound = query_.getMinimumDistance(*shape);
+        delete shape;
+        if (bound > limit_) return;
+        double coords[kMaxDims];
+        points_.read(d.getIdentifier(), coords);
+        distances.push_back(query_.getMinimumDistance(Point(coords, dims_)));
+    }
+    void visitData(std::vector<const IData*>& v) override {
+        for (const IData* d : v) visitData(*d);
+    }
+
+private:
+    const Point& query_;
+    PointFile& points_;
+    uint32_t dims_;
+    double limit_;
+};
+
+QueryResult runRefinedQuery(ISpatialIndex& tree, const Operation& op, uint32_t knn_k, uint32_t dims,
+                            PointFile& points) {
+    QueryResult res;
+    if (op.type == OpType::RANGE_QUERY) {
+        Region window = queryWindow(op, dims);
+        RefineVisitor visitor(window, points, dims);
+        const uint64_t t0 = nowNs();
+        tree.intersectsWithQuery(window, visitor);
+        res.time_ns = nowNs() - t0;
+        res.nodes_visited = visitor.nodes_visited;
+        res.results = visitor.results;
+    } else {
+        // libspatialindex ranks data entries by their cell box, so the k
+        // nearest boxes only bound the answer: their k-th exact distance D
+        // is at least the true one. A second pass over the square of radius
+        // D around q finds every point within D; the answer is the k
+        // nearest of those plus ties, as the tree reports them.
+        Point q(op.coords, dims);
+        const uint64_t t0 = nowNs();
+        ExactDistanceVisitor candidates(q, points, dims);
+        tree.nearestNeighborQuery(knn_k, q, candidates);
+        res.nodes_visited = candidates.nodes_visited;
+        std::vector<double>& near = candidates.distances;
+        if (!near.empty() && knn_k > 0) {
+            const size_t k = std::min<size_t>(knn_k, near.size());
+            std::nth_element(near.begin(), near.begin() + (k - 1), near.end());
+            const double radius = near[k - 1];
+
+            double low[kMaxDims], high[kMaxDims];
+            for (uint32_t d = 0; d < dims; ++d) {
+                low[d] = op.coords[d] - radius;
+                high[d] = op.coords[d] + radius;
+            }
+            ExactDistanceVisitor within(q, points, dims, radius);
+            tree.intersectsWithQuery(Region(low, high, dims), within);
+            res.nodes_visited += within.nodes_visited;
+
+            std::vector<double>& exact = within.distances;
+            exact.erase(std::remove_if(exact.begin(), exact.end(), [radius](double x) { return x > radius; }),
+                        exact.end());
+            if (!exact.empty()) {
+                const size_t kth = std::min<size_t>(knn_k, exact.size()) - 1;
+                std::nth_element(exact.begin(), exact.begin() + kth, exact.end());
+                const double cutoff = exact[kth];
+                res.results = std::count_if(exact.begin(), exact.end(), [cutoff](double x) { return x <= cutoff; });
+            }
+        }
+        res.time_ns = nowNs() - t0;
+    }
+    res.time_us = static_cast<int64_t>(res.time_ns / 1000);
+    return res;
+}
+
+double perOp(double total, uint64_t ops) {
+    return ops > 0 ? total / ops : 0.0;
+}
+
+} // namespace
+
+void runLeafCodecBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const std::vector<LeafCodec>& codecs,
+    int num_queries,
+    int num_insertions,
+    const std::string& output_csv
+) {
+    std::ostream& log = *config.log;
+    if (config.run_type != "disk") throw std::invalid_argument("The leaf codec benchmark needs run_type 'disk'.");
+
+    std::ofstream f(output_csv);
+    if (!f.is_open()) {
+        log << "Error: Could not open output file: " << output_csv << std::endl;
+        return;
+    }
+    std::ofstream qf(queryCsvName(output_csv));
+    if (!qf.is_open()) {
+        log << "Error: Could not open output file: " << queryCsvName(output_csv) << std::endl;
+        return;
+    }
+
+    // Same points (and their extent) for every codec
+    const uint32_t dims = gen.dims();
+    const size_t n = static_cast<size_t>(std::max(0, num_insertions));
+    gen.reset();
+    std::vector<double> coords(dims * n);
+    double low[kMaxDims], high[kMaxDims];
+    for (size_t i = 0; i < n; ++i) {
+        gen.generateNextPoint(&coords[dims * i]);
+        for (uint32_t d = 0; d < dims; ++d) {
+            low[d] = i == 0 ? coords[dims * i + d] : std::min(low[d], coords[dims * i + d]);
+            high[d] = i == 0 ? coords[dims * i + d] : std::max(high[d], coords[dims * i + d]);
+        }
+    }
+    const std::string base_name = config.disk_base_name.empty() ? "disk_tree_data" : config.disk_base_name;
+    PointFile points(base_name + "_points.bin", dims);
+    points.write(coords);
+
+    // Identical query sequence for every codec, spread over the data extent
+    const WorkloadMix& mix = gen.getMix();
+    double range_w = mix.range_ratio;
+    double knn_w = mix.knn_ratio;
+    if (range_w <= 0.0 && knn_w <= 0.0) range_w = knn_w = 1.0;
+    std::mt19937 qgen(seed ^ 0x5bd1e995u);
+    std::uniform_real_distribution<double> pick(0.0, range_w + knn_w);
+    const double side_frac = std::sqrt(std::max(0.0, mix.range_selectivity));
+    std::vector<Operation> queries(n > 0 ? static_cast<size_t>(std::max(0, num_queries)) : 0);
+    for (Operation& op : queries) {
+        op.type = pick(qgen) < range_w ? OpType::RANGE_QUERY : OpType::KNN_QUERY;
+        op.id = 0;
+        for (uint32_t d = 0; d < dims; ++d) {
+            op.coords[d] = std::uniform_real_distribution<double>(low[d], high[d])(qgen);
+            op.half_extent[d] = 0.5 * side_frac * (high[d] - low[d]);
+        }
+    }
+
+    log << "Starting leaf codec benchmark: " << n << " points (" << gen.getDataType() << "), "
+        << queries.size() << " queries, page size " << config.page_size << " -> " << output_csv << std::endl;
+
+    f << "Codec,LeafCapacity,IndexCapacity,Points,Nodes,Height,IndexBytes,LeafBytesPerEntry,Insert_ms,"
+         "AvgInsert_us,PageReadsPerInsert,PageWritesPerInsert,BytesWrittenPerInsert,Queries,AvgQuery_us,"
+         "P99Query_us,NodesPerQuery,PageReadsPerQuery,BytesReadPerQuery,Results,RefineReadsPerQuery,"
+         "Mismatches,EncodeNsPerLeaf,DecodeNsPerLeaf,DecodeShare_pct\n";
+    qf << "Codec,OpIdx,OpType,Time_us,NodesVisited,Results,PageReads,RefineReads,Time_ns\n";
+
+    std::vector<uint64_t> reference;
+    for (LeafCodec codec : codecs) {
+        const char* name = leafCodecName(codec);
+        TreeConfig tree_config = config;
+        tree_config.leaf_codec = name;
+        tree_config.leaf_capacity = config.leaf_capacity > 0 ? config.leaf_capacity :
+            static_cast<int>(leafPageCapacity(codec, dims, static_cast<uint32_t>(config.page_size)));
+        tree_config.build_mode = "INCREMENTAL";
+        tree_config.open_existing = false;
+        tree_config.prewarm_levels = 0;
+        if (tree_config.leaf_capacity < 4) {
+            throw std::invalid_argument("Page size " + std::to_string(config.page_size) + " is too small for " +
+                                        name + " leaves.");
+        }
+
+        TreeResources resources = setupTree(tree_config);
+        ISpatialIndex& tree = *resources.tree;
+        const IoMonitor io = ioMonitor(resources);
+        const LeafCodecStats codec_start = resources.codec ? resources.codec->stats() : LeafCodecStats();
+
+        // Inserts (the final flush is part of their I/O, not their time)
+        const IoSnapshot insert_start = io.snapshot();
+        PointInserter inserter(tree, dims);
+        const uint64_t insert_t0 = nowNs();
+        for (size_t i = 0; i < n; ++i) inserter.insert(&coords[dims * i], static_cast<id_type>(i));
+        const uint64_t insert_ns = nowNs() - insert_t0;
+        tree.flush();
+        const IoSnapshot inserted = ioDelta(io.snapshot(), insert_start);
+        const LeafCodecStats codec_built = resources.codec ? resources.codec->stats() : LeafCodecStats();
+
+        // Queries, refined unless the leaves hold exact points
+        LatencyHistogram latency;
+        uint64_t nodes = 0, results = 0, mismatches = 0, query_ns = 0;
+        const uint64_t refine_start = points.reads();
+        const IoSnapshot query_start = io.snapshot();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const IoSnapshot q0 = io.snapshot();
+            const uint64_t r0 = points.reads();
+            const QueryResult qr = codec == LeafCodec::NONE ?
+                runQuery(&tree, queries[i], mix.knn_k, dims) :
+                runRefinedQuery(tree, queries[i], mix.knn_k, dims, points);
+            const IoSnapshot q1 = io.snapshot();
+            latency.record(qr.time_ns);
+            query_ns += qr.time_ns;
+            nodes += qr.nodes_visited;
+            results += qr.results;
+            if (reference.size() < queries.size()) {
+                reference.push_back(qr.results);
+            } else if (reference[i] != qr.results) {
+                ++mismatches;
+            }
+            qf << name << "," << i << "," << opTypeName(queries[i].type) << "," << qr.time_us << ","
+               << qr.nodes_visited << "," << qr.results << "," << q1.page_reads - q0.page_reads << ","
+               << points.reads() - r0 << "," << qr.time_ns << "\n";
+        }
+        const IoSnapshot queried = ioDelta(io.snapshot(), query_start);
+        const uint64_t refine_reads = points.reads() - refine_start;
+        const LeafCodecStats codec_end = resources.codec ? resources.codec->stats() : LeafCodecStats();
+
+        const uint64_t tree_nodes = resources.counters->nodes();
+        const uint32_t height = resources.counters->height();
+        cleanupTree(resources);
+        const uint64_t index_bytes = fileBytes(base_name + ".dat");
+
+        const uint64_t encoded = codec_built.leaves_encoded - codec_start.leaves_encoded;
+        const uint64_t decoded = codec_end.leaves_decoded - codec_built.leaves_decoded;
+        const uint64_t decode_ns = codec_end.decode_ns - codec_built.decode_ns;
+        const double entry_bytes = codec == LeafCodec::NONE ?
+            static_cast<double>(2 * dims * sizeof(double) + sizeof(id_type) + sizeof(uint32_t)) :
+            perOp(static_cast<double>(codec_end.encoded_bytes - codec_start.encoded_bytes),
+                  codec_end.entries_encoded - codec_start.entries_encoded);
+        const double decode_share = query_ns > 0 ? 100.0 * decode_ns / query_ns : 0.0;
+
+        f << name << "," << tree_config.leaf_capacity << "," << config.M_capacity << "," << n << ","
+          << tree_nodes << "," << height << "," << index_bytes << "," << entry_bytes << ","
+          << insert_ns / 1e6 << "," << perOp(insert_ns / 1e3, n) << ","
+          << perOp(static_cast<double>(inserted.page_reads), n) << ","
+          << perOp(static_cast<double>(inserted.page_writes + inserted.page_allocs), n) << ","
+          << perOp(static_cast<double>(inserted.bytes_written), n) << ","
+          << latency.count() << "," << latency.mean() / 1000.0 << "," << latency.percentile(99) / 1000.0 << ","
+          << perOp(static_cast<double>(nodes), latency.count()) << ","
+          << perOp(static_cast<double>(queried.page_reads), latency.count()) << ","
+          << perOp(static_cast<double>(queried.bytes_read), latency.count()) << ","
+          << results << "," << perOp(static_cast<double>(refine_reads), latency.count()) << ","
+          << mismatches << ","
+          << perOp(static_cast<double>(codec_built.encode_ns - codec_start.encode_ns), encoded) << ","
+          << perOp(static_cast<double>(decode_ns), decoded) << "," << decode_share << "\n";
+
+        log << "  " << name << ": leaf capacity " << tree_config.leaf_capacity << " ("
+            << entry_bytes << " B/entry), " << tree_nodes << " nodes, height " << height << ", "
+            << index_bytes / (1024.0 * 1024.0) << " MB on disk\n"
+            << "    inserts: " << perOp(insert_ns / 1e3, n) << " us avg, "
+            << perOp(static_cast<double>(inserted.page_reads), n) << " page reads / "
+            << perOp(static_cast<double>(inserted.page_writes + inserted.page_allocs), n)
+            << " page writes per insert\n"
+            << "    queries: " << latency.mean() / 1000.0 << " us avg, "
+            << perOp(static_cast<double>(queried.page_reads), latency.count()) << " page reads, "
+            << perOp(static_cast<double>(refine_reads), latency.count()) << " refine reads per query, "
+            << decode_share << "% decoding";
+        if (mismatches > 0) log << ", " << mismatches << " result counts differ";
+        log << std::endl;
+    }
+}
+
+} // namespace SpatialIndex
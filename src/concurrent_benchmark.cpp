@@ -0,0 +1,309 @@
+#include "concurrent_benchmark.h"
+#include "locked_index.h"
+#include "packed_rtree.h"
+#include "query_runner.h"
+#include "latency_histogram.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace SpatialIndex {
+
+ConcurrencyScheme getConcurrencyScheme(const std::string& scheme_str) {
+    std::string upper = scheme_str;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "SHARDED_LATCH") return ConcurrencyScheme::SHARDED_LATCH;
+    if (upper == "SNAPSHOT") return ConcurrencyScheme::SNAPSHOT;
+    return ConcurrencyScheme::GLOBAL_LOCK; // Default
+}
+
+const char* concurrencySchemeName(ConcurrencyScheme scheme) {
+    switch (scheme) {
+        case ConcurrencyScheme::SHARDED_LATCH: return "SHARDED_LATCH";
+        case ConcurrencyScheme::SNAPSHOT: return "SNAPSHOT";
+        default: return "GLOBAL_LOCK";
+    }
+}
+
+namespace {
+
+// What a query can overlap with under each scheme
+const char* readPathName(ConcurrencyScheme scheme) {
+    switch (scheme) {
+        case ConcurrencyScheme::SHARDED_LATCH: return "SHARD_LATCH"; // Writes to other shards
+        case ConcurrencyScheme::SNAPSHOT: return "SNAPSHOT";         // All writes
+        default: return "SERIALISED";                                // Nothing
+    }
+}
+
+// One query against a packed snapshot; returns its latency
+uint64_t runSnapshotQuery(const PackedRTree& tree, const Operation& op, uint32_t k,
+                          std::vector<id_type>& ids, std::vector<Neighbor>& nn) {
+    const uint64_t t0 = nowNs();
+    if (op.type == OpType::RANGE_QUERY) {
+        const double low[2] = {op.coords[0] - op.half_extent[0], op.coords[1] - op.half_extent[1]};
+        const double high[2] = {op.coords[0] + op.half_extent[0], op.coords[1] + op.half_extent[1]};
+        ids.clear();
+        tree.rangeQuery(low, high, ids);
+    } else {
+        tree.nearestNeighbors(op.coords, k, nn);
+    }
+    return nowNs() - t0;
+}
+
+} // namespace
+
+void runConcurrentBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    const ConcurrentOptions& options,
+    int num_insertions,
+    const std::string& output_csv
+) {
+    std::ostream& log = *config.log;
+    std::ofstream f(output_csv);
+    if (!f.is_open()) {
+        log << "Error: Could not open output file: " << output_csv << std::endl;
+        return;
+    }
+
+    // Materialise the insert stream so writers only pay for the index
+    gen.reset();
+    const size_t n = static_cast<size_t>(std::max(0, num_insertions));
+    std::vector<double> points(2 * n);
+    double low[2] = {0.0, 0.0}, high[2] = {0.0, 0.0};
+    for (size_t i = 0; i < n; ++i) {
+        gen.generateNextPoint(&points[2 * i]);
+        for (int d = 0; d < 2; ++d) {
+            low[d] = i == 0 ? points[2 * i + d] : std::min(low[d], points[2 * i + d]);
+            high[d] = i == 0 ? points[2 * i + d] : std::max(high[d], points[2 * i + d]);
+        }
+    }
+    std::vector<double> sample;
+    const size_t sample_n = std::min<size_t>(n, 100000);
+    for (size_t s = 0; s < sample_n; ++s) {
+        sample.push_back(points[2 * (s * n / sample_n)]);
+        sample.push_back(points[2 * (s * n / sample_n) + 1]);
+    }
+
+    // Pre-drawn queries over the final data extent; readers cycle through them
+    const WorkloadMix& mix = gen.getMix();
+    double range_w = mix.range_ratio;
+    double knn_w = mix.knn_ratio;
+    if (range_w <= 0.0 && knn_w <= 0.0) range_w = knn_w = 1.0;
+    const double side_frac = std::sqrt(std::max(0.0, mix.range_selectivity));
+    std::vector<Operation> queries(10000);
+    std::mt19937 qgen(0x5bd1e995u);
+    std::uniform_real_distribution<double> pick(0.0, range_w + knn_w);
+    for (Operation& op : queries) {
+        op.type = pick(qgen) < range_w ? OpType::RANGE_QUERY : OpType::KNN_QUERY;
+        op.id = 0;
+        for (int d = 0; d < 2; ++d) {
+            op.coords[d] = std::uniform_real_distribution<double>(low[d], high[d])(qgen);
+            op.half_extent[d] = 0.5 * side_frac * (high[d] - low[d]);
+        }
+    }
+
+    const uint32_t writers = std::max<uint32_t>(1, options.writers);
+    const uint32_t shards = options.scheme == ConcurrencyScheme::SHARDED_LATCH ?
+        std::max<uint32_t>(1, options.shards) : 1;
+
+    // The reader-free run first: it is the baseline of the writer slowdown
+    std::vector<uint32_t> reader_counts = {0};
+    for (uint32_t readers : options.reader_counts) {
+        if (readers > 0) reader_counts.push_back(readers);
+    }
+
+    log << "Starting concurrent benchmark: " << n << " insertions by " << writers
+        << " writer(s), " << concurrencySchemeName(options.scheme) << " with " << shards
+        << " shard(s) (" << gen.getDataType() << " data) -> " << output_csv << std::endl;
+
+    // ReadPath: SERIALISED when queries and inserts take turns on one tree
+    f << "Scheme,ReadPath,Shards,Writers,Readers,Points,WriterTime_ms,InsertsPerSec,WriterSlowdown,"
+         "Queries,ReaderQPS,AvgQuery_us,P50Query_us,P99Query_us,P999Query_us,MaxQuery_us,"
+         "Snapshots,AvgSnapshotLag\n";
+
+    double baseline_ms = 0.0;
+    for (uint32_t readers : reader_counts) {
+        TreeResources resources;
+        std::unique_ptr<ISpatialIndex> index;
+        if (options.scheme == ConcurrencyScheme::SHARDED_LATCH) {
+            ShardedIndexOptions shard_options;
+            shard_options.shards = shards;
+            shard_options.threads = 0; // Latched: callers work on the trees directly
+            shard_options.partition = options.partition;
+            index.reset(new ShardedIndex(config, shard_options, sample));
+        } else {
+            resources = setupTree(config);
+            index.reset(new LockedIndex(*resources.tree));
+        }
+
+        std::atomic<bool> go(false);
+        std::atomic<uint32_t> writers_left(writers);
+        std::atomic<bool> done(false); // Set by the last writer; stops the readers
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        auto fail = [&](std::exception_ptr e) {
+            std::lock_guard<std::mutex> guard(error_mutex);
+            if (!error) error = e;
+            done.store(true, std::memory_order_release);
+        };
+
+        // SNAPSHOT: points each writer has inserted (writer w inserts w, w + writers, ...)
+        // and the last published packed tree over them
+        const bool snapshots = options.scheme == ConcurrencyScheme::SNAPSHOT;
+        std::unique_ptr<std::atomic<size_t>[]> progress(new std::atomic<size_t>[writers]);
+        for (uint32_t w = 0; w < writers; ++w) progress[w].store(0, std::memory_order_relaxed);
+        auto inserted = [&]() {
+            size_t total = 0;
+            for (uint32_t w = 0; w < writers; ++w) total += progress[w].load(std::memory_order_acquire);
+            return total;
+        };
+        std::shared_ptr<const PackedRTree> snapshot;
+        uint64_t published = 0;
+
+        std::vector<std::thread> threads;
+        std::vector<uint64_t> writer_end(writers, 0);
+        for (uint32_t w = 0; w < writers; ++w) {
+            threads.emplace_back([&, w]() {
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                try {
+                    // Writers interleave over the stream so each sees the same distribution
+                    for (size_t i = w; i < n; i += writers) {
+                        index->insertData(0, nullptr, Point(&points[2 * i], 2), static_cast<id_type>(i));
+                        progress[w].fetch_add(1, std::memory_order_release);
+                    }
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+                writer_end[w] = nowNs();
+                if (writers_left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    done.store(true, std::memory_order_release);
+                }
+            });
+        }
+
+        // Also runs without readers, so the baseline pays for publishing too
+        if (snapshots) {
+            threads.emplace_back([&]() {
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                try {
+                    const uint64_t every = std::max<uint64_t>(1, options.snapshot_inserts);
+                    size_t covered = 0;
+                    std::vector<double> coords;
+                    std::vector<id_type> ids;
+                    while (!done.load(std::memory_order_acquire)) {
+                        if (inserted() < covered + every) {
+                            std::this_thread::sleep_for(std::chrono::microseconds(100));
+                            continue;
+                        }
+                        // Each writer's prefix of its share of the stream
+                        coords.clear();
+                        ids.clear();
+                        for (uint32_t w = 0; w < writers; ++w) {
+                            const size_t count = progress[w].load(std::memory_order_acquire);
+                            for (size_t j = 0; j < count; ++j) {
+                                const size_t i = w + j * writers;
+                                coords.push_back(points[2 * i]);
+                                coords.push_back(points[2 * i + 1]);
+                                ids.push_back(static_cast<id_type>(i));
+                            }
+                        }
+                        covered = ids.size();
+                        std::shared_ptr<const PackedRTree> next(new PackedRTree(
+                            coords.data(), ids.data(), ids.size(), static_cast<uint32_t>(config.M_capacity)));
+                        std::atomic_store(&snapshot, next);
+                        ++published;
+                    }
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            });
+        }
+
+        std::vector<LatencyHistogram> latency(readers);
+        std::vector<uint64_t> lag(readers, 0); // SNAPSHOT: inserted points the queries missed
+        for (uint32_t r = 0; r < readers; ++r) {
+            threads.emplace_back([&, r]() {
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                try {
+                    size_t q = (r * queries.size()) / std::max<uint32_t>(1, readers);
+                    std::vector<id_type> ids;
+                    std::vector<Neighbor> nn;
+                    while (!done.load(std::memory_order_acquire)) {
+                        if (snapshots) {
+                            const std::shared_ptr<const PackedRTree> snap = std::atomic_load(&snapshot);
+                            if (!snap) {
+                                std::this_thread::yield();
+                                continue;
+                            }
+                            lag[r] += inserted() - snap->size();
+                            latency[r].record(runSnapshotQuery(*snap, queries[q], mix.knn_k, ids, nn));
+                        } else {
+                            const QueryResult qr = runQuery(index.get(), queries[q], mix.knn_k);
+                            latency[r].record(qr.time_ns);
+                        }
+                        if (++q == queries.size()) q = 0;
+                    }
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            });
+        }
+
+        const uint64_t t0 = nowNs();
+        go.store(true, std::memory_order_release);
+        for (auto& t : threads) t.join();
+        if (error) {
+            index.reset();
+            cleanupTree(resources);
+            std::rethrow_exception(error);
+        }
+
+        const uint64_t t1 = *std::max_element(writer_end.begin(), writer_end.end());
+        const double writer_ms = (t1 - t0) / 1e6;
+        if (readers == 0) baseline_ms = writer_ms;
+
+        LatencyHistogram all;
+        for (const LatencyHistogram& h : latency) all.merge(h);
+        uint64_t total_lag = 0;
+        for (uint64_t l : lag) total_lag += l;
+        const double avg_lag = all.count() > 0 ? static_cast<double>(total_lag) / all.count() : 0.0;
+        const double inserts_per_s = writer_ms > 0.0 ? n / (writer_ms / 1e3) : 0.0;
+        const double reader_qps = writer_ms > 0.0 ? all.count() / (writer_ms / 1e3) : 0.0;
+
+        f << concurrencySchemeName(options.scheme) << "," << readPathName(options.scheme) << ","
+          << shards << "," << writers << "," << readers << ","
+          << n << "," << writer_ms << "," << inserts_per_s << ","
+          << (baseline_ms > 0.0 ? writer_ms / baseline_ms : 1.0) << ","
+          << all.count() << "," << reader_qps << "," << all.mean() / 1000.0 << ","
+          << all.percentile(50.0) / 1000.0 << "," << all.percentile(99.0) / 1000.0 << ","
+          << all.percentile(99.9) / 1000.0 << "," << all.max() / 1000.0 << ","
+          << published << "," << avg_lag << "\n";
+
+        log << "  " << readers << " readers: " << static_cast<uint64_t>(inserts_per_s)
+            << " inserts/s (slowdown " << (baseline_ms > 0.0 ? writer_ms / baseline_ms : 1.0)
+            << "x), " << static_cast<uint64_t>(reader_qps) << " queries/s, p99 "
+            << all.percentile(99.0) / 1000.0 << " us";
+        if (snapshots) log << ", " << published << " snapshots, avg lag " << avg_lag << " points";
+        log << std::endl;
+
+        index.reset();
+        cleanupTree(resources);
+    }
+
+    f.close();
+    log << "Concurrent benchmark finished for " << output_csv << "." << std::endl;
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,601 @@
+#include "direct_storage.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+namespace SpatialIndex {
+
+void loadPages(IStorageManager& sm, size_t n, const id_type* pages, uint32_t* lens, uint8_t** data) {
+    if (IBatchStorageManager* batch = dynamic_cast<IBatchStorageManager*>(&sm)) {
+        batch->loadByteArrays(n, pages, lens, data);
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) sm.loadByteArray(pages[i], lens[i], &data[i]);
+}
+
+void storePages(IStorageManager& sm, size_t n, const id_type* pages, const uint32_t* lens,
+                const uint8_t* const* data) {
+    if (IBatchStorageManager* batch = dynamic_cast<IBatchStorageManager*>(&sm)) {
+        batch->storeByteArrays(n, pages, lens, data);
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        id_type page = pages[i];
+        sm.storeByteArray(page, lens[i], data[i]);
+    }
+}
+
+IoEngine getIoEngine(const std::string& engine_str) {
+    std::string upper = engine_str;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "URING" || upper == "IO_URING") return IoEngine::URING;
+    if (upper == "THREADS" || upper == "PREAD") return IoEngine::THREADS;
+    return IoEngine::AUTO; // Default
+}
+
+const char* ioEngineName(IoEngine engine) {
+    switch (engine) {
+        case IoEngine::AUTO: return "AUTO";
+        case IoEngine::URING: return "URING";
+        case IoEngine::THREADS: return "THREADS";
+    }
+    return "UNKNOWN";
+}
+
+// One page-aligned transfer
+struct IoRequest {
+    bool write;
+    uint8_t* buf;
+    size_t len;
+    uint64_t offset;
+};
+
+// Runs a batch of transfers to completion; throws on the first failure
+class PageIo {
+public:
+    virtual ~PageIo() {}
+    virtual void run(int fd, IoRequest* reqs, size_t n) = 0;
+};
+
+namespace {
+
+[[noreturn]] void throwErrno(const std::string& what, int err) {
+    throw std::runtime_error(what + ": " + std::strerror(err));
+}
+
+// Blocking pread/pwrite of a whole request (retries short transfers)
+void transferAll(int fd, const IoRequest& r) {
+    size_t done = 0;
+    while (done < r.len) {
+        const ssize_t got = r.write
+            ? ::pwrite(fd, r.buf + done, r.len - done, static_cast<off_t>(r.offset + done))
+            : ::pread(fd, r.buf + done, r.len - done, static_cast<off_t>(r.offset + done));
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throwErrno(r.write ? "pwrite failed" : "pread failed", errno);
+        }
+        if (got == 0) throw std::runtime_error("pread hit the end of the data file");
+        done += static_cast<size_t>(got);
+    }
+}
+
+// Memory from posix_memalign, as O_DIRECT needs aligned buffers
+struct AlignedBuffer {
+    explicit AlignedBuffer(size_t size) : data(nullptr) {
+        void* p = nullptr;
+        if (posix_memalign(&p, 4096, std::max<size_t>(size, 1)) != 0) throw std::bad_alloc();
+        data = static_cast<uint8_t*>(p);
+    }
+    ~AlignedBuffer() { std::free(data); }
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    uint8_t* data;
+};
+
+// io_uring through the raw system calls: one submission per batch (split
+// only if the batch exceeds the ring), completions reaped as they arrive.
+// At most as many requests are in flight as the completion ring holds.
+class UringIo : public PageIo {
+public:
+    // nullptr if the kernel (or a seccomp filter) does not allow io_uring
+    static UringIo* create(uint32_t entries) {
+        std::unique_ptr<UringIo> io(new UringIo());
+        return io->init(std::max<uint32_t>(entries, 1)) ? io.release() : nullptr;
+    }
+
+    ~UringIo() override {
+        if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_len_);
+        if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_len_);
+        if (sq_ptr_ != MAP_FAILED) munmap(sq_ptr_, sq_len_);
+        if (ring_fd_ >= 0) ::close(ring_fd_);
+    }
+
+    void run(int fd, IoRequest* reqs, size_t n) override {
+        std::vector<iovec> iov(n);
+        std::vector<size_t> pending(n);
+        for (size_t i = 0; i < n; ++i) {
+            iov[i].iov_base = reqs[i].buf;
+            iov[i].iov_len = reqs[i].len;
+            pending[i] = n - 1 - i;  // Submitted from the back: keeps the caller's order
+        }
+
+        size_t inflight = 0;
+        size_t completed = 0;
+        unsigned unsubmitted = 0;  // Queued in the ring, not yet accepted by the kernel
+        int error = 0;
+        while (completed < n) {
+            // Queue as much as the ring takes
+            unsigned tail = *sq_tail_;
+            const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            while (!pending.empty() && tail - head < sq_entries_ && inflight < cq_entries_) {
+                const size_t i = pending.back();
+                pending.pop_back();
+                const unsigned idx = tail & *sq_mask_;
+                io_uring_sqe* sqe = &sqes_[idx];
+                std::memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = reqs[i].write ? IORING_OP_WRITEV : IORING_OP_READV;
+                sqe->fd = fd;
+                sqe->addr = reinterpret_cast<uint64_t>(&iov[i]);
+                sqe->len = 1;
+                sqe->off = reqs[i].offset + (reinterpret_cast<uint8_t*>(iov[i].iov_base) - reqs[i].buf);
+                sqe->user_data = i;
+                sq_array_[idx] = idx;
+                ++tail;
+                ++unsubmitted;
+                ++inflight;
+            }
+            __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+            const int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, unsubmitted, 1,
+                                                     IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (ret < 0) {
+                if (errno != EINTR) throwErrno("io_uring_enter failed", errno);
+            } else {
+                unsubmitted -= std::min<unsigned>(unsubmitted, static_cast<unsigned>(ret));
+            }
+
+            // Reap completions; short transfers are queued again for the rest
+            unsigned chead = *cq_head_;
+            const unsigned ctail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            while (chead != ctail) {
+                const io_uring_cqe& cqe = cqes_[chead & *cq_mask_];
+                const size_t i = static_cast<size_t>(cqe.user_data);
+                ++chead;
+                --inflight;
+                if (cqe.res < 0) {
+                    error = -cqe.res;
+                    ++completed;
+                } else if (cqe.res == 0) {
+                    error = EIO;
+                    ++completed;
+                } else if (static_cast<size_t>(cqe.res) < iov[i].iov_len) {
+                    iov[i].iov_base = static_cast<uint8_t*>(iov[i].iov_base) + cqe.res;
+                    iov[i].iov_len -= static_cast<size_t>(cqe.res);
+                    pending.push_back(i);
+                } else {
+                    ++completed;
+                }
+            }
+            __atomic_store_n(cq_head_, chead, __ATOMIC_RELEASE);
+            if (error != 0 && inflight == 0) break;
+        }
+        if (error != 0) throwErrno("io_uring transfer failed", error);
+    }
+
+private:
+    UringIo()
+        : ring_fd_(-1), sq_ptr_(MAP_FAILED), cq_ptr_(MAP_FAILED), sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+          sq_len_(0), cq_len_(0), sqes_len_(0), sq_entries_(0), cq_entries_(0) {}
+
+    bool init(uint32_t entries) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (ring_fd_ < 0) return false;
+
+        sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+
+        sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) return false;
+        cq_ptr_ = single_mmap ? sq_ptr_
+                              : mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                     ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) return false;
+        sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) return false;
+
+        uint8_t* sq = static_cast<uint8_t*>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        uint8_t* cq = static_cast<uint8_t*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        sq_entries_ = p.sq_entries;
+        cq_entries_ = p.cq_entries;
+        return true;
+    }
+
+    int ring_fd_;
+    void* sq_ptr_;
+    void* cq_ptr_;
+    io_uring_sqe* sqes_;
+    size_t sq_len_;
+    size_t cq_len_;
+    size_t sqes_len_;
+    unsigned sq_entries_;
+    unsigned cq_entries_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    io_uring_cqe* cqes_;
+};
+
+// pread/pwrite fallback. Single transfers run on the calling thread; the
+// requests of a batch are shared between the caller and the pool threads.
+class ThreadPoolIo : public PageIo {
+public:
+    explicit ThreadPoolIo(uint32_t threads)
+        : fd_(-1), reqs_(nullptr), n_(0), next_(0), remaining_(0), active_(0), generation_(0), stop_(false) {
+        for (uint32_t t = 1; t < threads; ++t) {
+            workers_.emplace_back(&ThreadPoolIo::workerLoop, this);
+        }
+    }
+
+    ~ThreadPoolIo() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    void run(int fd, IoRequest* reqs, size_t n) override {
+        if (n == 1 || workers_.empty()) {
+            for (size_t i = 0; i < n; ++i) transferAll(fd, reqs[i]);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fd_ = fd;
+            reqs_ = reqs;
+            n_ = n;
+            next_.store(0, std::memory_order_relaxed);
+            remaining_ = n;
+            error_.clear();
+            ++generation_;
+        }
+        work_cv_.notify_all();
+        work(fd, reqs, n);
+
+        // No worker may still be inside work() when the next batch starts
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [&] { return remaining_ == 0 && active_ == 0; });
+        reqs_ = nullptr;
+        if (!error_.empty()) throw std::runtime_error(error_);
+    }
+
+private:
+    void workerLoop() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            work_cv_.wait(lock, [&] { return stop_ || (generation_ != seen && reqs_ != nullptr); });
+            if (stop_) return;
+            seen = generation_;
+            const int fd = fd_;
+            IoRequest* reqs = reqs_;
+            const size_t n = n_;
+            ++active_;
+            lock.unlock();
+            work(fd, reqs, n);
+            lock.lock();
+            --active_;
+            done_cv_.notify_all();
+        }
+    }
+
+    void work(int fd, IoRequest* reqs, size_t n) {
+        size_t i;
+        while ((i = next_.fetch_add(1, std::memory_order_relaxed)) < n) {
+            std::string failure;
+            try {
+                transferAll(fd, reqs[i]);
+            } catch (const std::exception& e) {
+                failure = e.what();
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!failure.empty() && error_.empty()) error_ = failure;
+            if (--remaining_ == 0) done_cv_.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    int fd_;
+    IoRequest* reqs_;   // Current batch, nullptr between batches
+    size_t n_;
+    std::atomic<size_t> next_;
+    size_t remaining_;
+    uint32_t active_;
+    uint64_t generation_;
+    bool stop_;
+    std::string error_;
+};
+
+const char kIndexMagic[8] = {'R', 'T', 'D', 'I', 'R', 'I', 'D', 'X'};
+const uint32_t kIndexVersion = 1;
+
+} // namespace
+
+DirectStorageManager::DirectStorageManager(const std::string& base_name, const DirectStorageOptions& options,
+                                           bool open_existing)
+    : base_name_(base_name), options_(options), engine_(options.engine), direct_(false), fd_(-1),
+      next_file_page_(0) {
+    if (options_.page_size == 0) throw std::runtime_error("DirectStorageManager: page size must be positive.");
+
+    const std::string dat = base_name_ + ".dat";
+    const int flags = O_RDWR | O_CREAT | (open_existing ? 0 : O_TRUNC);
+    if (options_.direct && options_.page_size % 512 == 0) {
+        fd_ = ::open(dat.c_str(), flags | O_DIRECT, 0644);
+        direct_ = fd_ >= 0;
+        if (fd_ < 0 && errno != EINVAL) throwErrno("Cannot open " + dat, errno);
+    }
+    if (fd_ < 0) {
+        if (options_.direct) {
+            *options_.log << "  Warning: O_DIRECT not available for " << dat
+                          << " (page size " << options_.page_size << "), using the page cache." << std::endl;
+        }
+        fd_ = ::open(dat.c_str(), flags, 0644);
+        if (fd_ < 0) throwErrno("Cannot open " + dat, errno);
+    }
+
+    if (engine_ != IoEngine::THREADS) {
+        io_.reset(UringIo::create(options_.queue_depth));
+        if (io_) {
+            engine_ = IoEngine::URING;
+        } else {
+            *options_.log << "  Warning: io_uring unavailable, falling back to pread/pwrite threads." << std::endl;
+        }
+    }
+    if (!io_) {
+        engine_ = IoEngine::THREADS;
+        io_.reset(new ThreadPoolIo(std::max<uint32_t>(options_.io_threads, 1)));
+    }
+
+    if (open_existing) {
+        readIndex();
+    } else {
+        std::remove((base_name_ + ".idx").c_str());
+    }
+}
+
+DirectStorageManager::~DirectStorageManager() {
+    try {
+        flush();
+    } catch (...) {
+        // Nothing sensible left to do with a failed write in a destructor
+    }
+    io_.reset();
+    if (fd_ >= 0) ::close(fd_);
+}
+
+uint32_t DirectStorageManager::pagesFor(uint32_t len) const {
+    return std::max<uint32_t>(1, (len + options_.page_size - 1) / options_.page_size);
+}
+
+uint64_t DirectStorageManager::allocatePages(uint32_t pages) {
+    auto it = free_runs_.find(pages);
+    if (it != free_runs_.end()) {
+        const uint64_t first = it->second.back();
+        it->second.pop_back();
+        if (it->second.empty()) free_runs_.erase(it);
+        return first;
+    }
+    const uint64_t first = next_file_page_;
+    next_file_page_ += pages;
+    return first;
+}
+
+void DirectStorageManager::freePages(const Extent& e) {
+    free_runs_[e.pages].push_back(e.first_page);
+}
+
+const DirectStorageManager::Extent& DirectStorageManager::extentOf(id_type page) const {
+    if (page < 0 || static_cast<size_t>(page) >= extents_.size() || extents_[page].pages == 0) {
+        throw std::runtime_error("DirectStorageManager: invalid page " + std::to_string(page));
+    }
+    return extents_[page];
+}
+
+void DirectStorageManager::loadByteArray(const id_type page, uint32_t& len, uint8_t** data) {
+    loadByteArrays(1, &page, &len, data);
+}
+
+void DirectStorageManager::storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) {
+    if (page == StorageManager::NewPage) {
+        if (!free_ids_.empty()) {
+            page = free_ids_.back();
+            free_ids_.pop_back();
+        } else {
+            page = static_cast<id_type>(extents_.size());
+            extents_.push_back(Extent{0, 0, 0});
+        }
+        // Give it an extent so storeByteArrays sees an existing page
+        const uint32_t pages = pagesFor(len);
+        extents_[page] = Extent{allocatePages(pages), pages, len};
+    }
+    storeByteArrays(1, &page, &len, &data);
+}
+
+void DirectStorageManager::loadByteArrays(size_t n, const id_type* pages, uint32_t* lens, uint8_t** data) {
+    if (n == 0) return;
+    std::vector<IoRequest> reqs(n);
+    std::vector<size_t> offsets(n);
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const Extent& e = extentOf(pages[i]);
+        offsets[i] = total;
+        total += static_cast<size_t>(e.pages) * options_.page_size;
+    }
+    AlignedBuffer buffer(total);
+    for (size_t i = 0; i < n; ++i) {
+        const Extent& e = extents_[pages[i]];
+        reqs[i] = IoRequest{false, buffer.data + offsets[i],
+                            static_cast<size_t>(e.pages) * options_.page_size,
+                            e.first_page * options_.page_size};
+    }
+    io_->run(fd_, reqs.data(), n);
+
+    for (size_t i = 0; i < n; ++i) {
+        lens[i] = extents_[pages[i]].len;
+        data[i] = new uint8_t[lens[i]];
+        std::memcpy(data[i], buffer.data + offsets[i], lens[i]);
+    }
+}
+
+void DirectStorageManager::storeByteArrays(size_t n, const id_type* pages, const uint32_t* lens,
+                                           const uint8_t* const* data) {
+    if (n == 0) return;
+    // Place every array first (a size change moves it to another run)
+    std::vector<size_t> offsets(n);
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        extentOf(pages[i]);
+        Extent& e = extents_[pages[i]];
+        const uint32_t needed = pagesFor(lens[i]);
+        if (needed != e.pages) {
+            freePages(e);
+            e.first_page = allocatePages(needed);
+            e.pages = needed;
+        }
+        e.len = lens[i];
+        offsets[i] = total;
+        total += static_cast<size_t>(needed) * options_.page_size;
+    }
+
+    AlignedBuffer buffer(total);
+    std::vector<IoRequest> reqs(n);
+    for (size_t i = 0; i < n; ++i) {
+        const Extent& e = extents_[pages[i]];
+        const size_t bytes = static_cast<size_t>(e.pages) * options_.page_size;
+        uint8_t* dst = buffer.data + offsets[i];
+        std::memcpy(dst, data[i], lens[i]);
+        std::memset(dst + lens[i], 0, bytes - lens[i]);
+        reqs[i] = IoRequest{true, dst, bytes, e.first_page * options_.page_size};
+    }
+    // Ascending file offsets let the device merge neighbouring writes
+    std::sort(reqs.begin(), reqs.end(),
+              [](const IoRequest& a, const IoRequest& b) { return a.offset < b.offset; });
+    io_->run(fd_, reqs.data(), n);
+}
+
+void DirectStorageManager::deleteByteArray(const id_type page) {
+    extentOf(page);
+    freePages(extents_[page]);
+    extents_[page] = Extent{0, 0, 0};
+    free_ids_.push_back(page);
+}
+
+void DirectStorageManager::flush() {
+    writeIndex();
+    if (::fdatasync(fd_) != 0) throwErrno("fdatasync failed", errno);
+}
+
+void DirectStorageManager::writeIndex() {
+    const std::string idx = base_name_ + ".idx";
+    std::ofstream out(idx, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot write " + idx);
+    const uint64_t count = extents_.size();
+    out.write(kIndexMagic, sizeof(kIndexMagic));
+    out.write(reinterpret_cast<const char*>(&kIndexVersion), sizeof(kIndexVersion));
+    out.write(reinterpret_cast<const char*>(&options_.page_size), sizeof(options_.page_size));
+    out.write(reinterpret_cast<const char*>(&next_file_page_), sizeof(next_file_page_));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const Extent& e : extents_) {
+        out.write(reinterpret_cast<const char*>(&e.first_page), sizeof(e.first_page));
+        out.write(reinterpret_cast<const char*>(&e.pages), sizeof(e.pages));
+        out.write(reinterpret_cast<const char*>(&e.len), sizeof(e.len));
+    }
+    if (!out) throw std::runtime_error("Failed writing " + idx);
+}
+
+void DirectStorageManager::readIndex() {
+    const std::string idx = base_name_ + ".idx";
+    std::ifstream in(idx, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open " + idx);
+    char magic[sizeof(kIndexMagic)];
+    uint32_t version = 0, page_size = 0;
+    uint64_t count = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&page_size), sizeof(page_size));
+    in.read(reinterpret_cast<char*>(&next_file_page_), sizeof(next_file_page_));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0 || version != kIndexVersion) {
+        throw std::runtime_error(idx + " is not a direct storage page table.");
+    }
+    if (page_size != options_.page_size) {
+        throw std::runtime_error(idx + " was written with page size " + std::to_string(page_size));
+    }
+
+    extents_.resize(count);
+    for (Extent& e : extents_) {
+        in.read(reinterpret_cast<char*>(&e.first_page), sizeof(e.first_page));
+        in.read(reinterpret_cast<char*>(&e.pages), sizeof(e.pages));
+        in.read(reinterpret_cast<char*>(&e.len), sizeof(e.len));
+    }
+    if (!in) throw std::runtime_error(idx + " is truncated.");
+
+    // Free ids and the gaps between used runs
+    std::vector<std::pair<uint64_t, uint32_t>> used;
+    for (size_t id = 0; id < extents_.size(); ++id) {
+        if (extents_[id].pages == 0) {
+            free_ids_.push_back(static_cast<id_type>(id));
+        } else {
+            used.emplace_back(extents_[id].first_page, extents_[id].pages);
+        }
+    }
+    std::sort(used.begin(), used.end());
+    uint64_t cursor = 0;
+    for (const auto& run : used) {
+        if (run.first > cursor) free_runs_[static_cast<uint32_t>(run.first - cursor)].push_back(cursor);
+        cursor = run.first + run.second;
+    }
+    if (next_file_page_ > cursor) free_runs_[static_cast<uint32_t>(next_file_page_ - cursor)].push_back(cursor);
+}
+
+} // namespace SpatialIndex
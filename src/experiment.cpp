@@ -0,0 +1,420 @@
+#include "experiment.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "rtree_helpers.h"
+#include "workload_generator.h"
+#include "tree_setup.h"
+#include "benchmark_runner.h"
+#include "sware_benchmark.h"
+#include "build_benchmark.h"
+#include "instrumentation.h"
+#include "perf_counters.h"
+#include "workload_file.h"
+#include "sharded_benchmark.h"
+#include "concurrent_benchmark.h"
+#include "packed_benchmark.h"
+#include "ingest_pipeline.h"
+#include "lsm_benchmark.h"
+#include "update_benchmark.h"
+#include "restart_benchmark.h"
+#include "codec_benchmark.h"
+
+namespace SpatialIndex {
+
+// Comma-separated list of unsigned values, e.g. "1,2,4,8"
+static std::vector<uint32_t> parseList(const std::string& list) {
+    std::vector<uint32_t> values;
+    size_t start = 0;
+    while (start <= list.size()) {
+        const size_t comma = std::min(list.find(',', start), list.size());
+        if (comma > start) values.push_back(static_cast<uint32_t>(std::stoul(list.substr(start, comma - start))));
+        start = comma + 1;
+    }
+    return values;
+}
+
+static std::string getOpt(const std::map<std::string, std::string>& opts,
+                          const std::string& key, const std::string& def) {
+    auto it = opts.find(key);
+    return it == opts.end() ? def : it->second;
+}
+
+static ExperimentResult toResult(const RunSummary& summary) {
+    const OpTypeStats& ins = summary.stats[static_cast<int>(OpType::INSERT)];
+    const OpTypeStats& range = summary.stats[static_cast<int>(OpType::RANGE_QUERY)];
+    const OpTypeStats& knn = summary.stats[static_cast<int>(OpType::KNN_QUERY)];
+    const uint64_t queries = range.count + knn.count;
+    ExperimentResult result;
+    result.ops = summary.inserts + queries;
+    result.timed_s = (ins.total_ns + range.total_ns + knn.total_ns) / 1e9;
+    if (summary.inserts > 0) result.avg_insert_us = ins.total_ns / 1e3 / summary.inserts;
+    if (queries > 0) result.avg_query_us = (range.total_ns + knn.total_ns) / 1e3 / queries;
+    return result;
+}
+
+ExperimentResult runExperiment(const ExperimentArgs& args, std::ostream& log) {
+    const std::string& run_type = args.run_type;
+    const int M = args.M;
+    const double fill_factor = args.fill_factor;
+    const int num_insertions = args.num_insertions;
+    const std::string& buffer_type = args.buffer_type;
+    const int buffer_capacity = args.buffer_pages;
+    const std::string& tree_variant_str = args.tree_variant;
+    const std::string& data_type = args.data_type;
+    const int page_size = args.page_size;
+    const std::string& output_file = args.output_file;
+    const std::map<std::string, std::string>& opts = args.options;
+
+
+    WorkloadMix mix;
+    mix.insert_ratio = std::stod(getOpt(opts, "insert_ratio", "1.0"));
+    mix.range_ratio = std::stod(getOpt(opts, "range_ratio", "0.0"));
+    mix.knn_ratio = std::stod(getOpt(opts, "knn_ratio", "0.0"));
+    mix.range_selectivity = std::stod(getOpt(opts, "selectivity", "0.001"));
+    mix.knn_k = static_cast<uint32_t>(std::stoul(getOpt(opts, "knn_k", "10")));
+
+    DistributionParams dist_params;
+    dist_params.stream_length = static_cast<uint64_t>(std::max(1, num_insertions));
+    dist_params.sort_k_pct = std::stod(getOpt(opts, "sort_k", "10"));
+    dist_params.sort_l = std::stoull(getOpt(opts, "sort_l", "100"));
+    dist_params.clusters = static_cast<uint32_t>(std::stoul(getOpt(opts, "clusters", "10")));
+    dist_params.cluster_stddev = std::stod(getOpt(opts, "cluster_stddev", "20"));
+    dist_params.hotspots = static_cast<uint32_t>(std::stoul(getOpt(opts, "hotspots", "100")));
+    dist_params.zipf_s = std::stod(getOpt(opts, "zipf_s", "1.0"));
+    dist_params.hotspot_radius = std::stod(getOpt(opts, "hotspot_radius", "5"));
+    const unsigned int seed = static_cast<unsigned int>(std::stoul(getOpt(opts, "seed", "42")));
+    dist_params.dims = static_cast<uint32_t>(std::stoul(getOpt(opts, "dims", "2")));
+    if (dist_params.dims != 2) {
+        std::string index_opt = getOpt(opts, "index", "SINGLE");
+        std::string build_opt = getOpt(opts, "build", "INCREMENTAL");
+        std::transform(index_opt.begin(), index_opt.end(), index_opt.begin(), ::toupper);
+        std::transform(build_opt.begin(), build_opt.end(), build_opt.begin(), ::toupper);
+        if (run_type == "generate" || index_opt != "SINGLE" || build_opt != "INCREMENTAL" ||
+            !getOpt(opts, "workload_file", "").empty() || !getOpt(opts, "updates", "").empty()) {
+            throw std::invalid_argument("dims=" + std::to_string(dist_params.dims) +
+                " needs index=SINGLE, build=INCREMENTAL, no workload files and no updates (2-D only).");
+        }
+    }
+
+    RTree::RTreeVariant tree_variant = getRTreeVariant(tree_variant_str);
+
+    TreeConfig config;
+    config.run_type = run_type;
+    config.M_capacity = M;
+    config.fill_factor = fill_factor;
+    config.dims = dist_params.dims;
+    config.buffer_type = buffer_type;
+    config.buffer_pages = buffer_capacity;
+    config.buffer_lru_k = static_cast<uint32_t>(std::stoul(getOpt(opts, "lru_k", "2")));
+    config.buffer_pin_levels = static_cast<uint32_t>(std::stoul(getOpt(opts, "pin_levels", "0")));
+    config.async_dirty_pages = std::stoul(getOpt(opts, "async_dirty_pages", "0"));
+    config.storage = getOpt(opts, "storage", "DEFAULT");
+    config.io_engine = getOpt(opts, "io_engine", "AUTO");
+    config.io_queue_depth = static_cast<uint32_t>(std::stoul(getOpt(opts, "io_depth", "64")));
+    config.io_threads = static_cast<uint32_t>(std::stoul(getOpt(opts, "io_threads", "4")));
+    config.tree_variant = tree_variant;
+    config.page_size = page_size;
+    config.log = &log;
+    config.disk_base_name = args.disk_base_name;
+    config.build_mode = getOpt(opts, "build", "INCREMENTAL");
+    std::transform(config.build_mode.begin(), config.build_mode.end(),
+                   config.build_mode.begin(), ::toupper);
+    config.bulk_points = std::stoull(getOpt(opts, "bulk_points", std::to_string(num_insertions)));
+    config.bulk_data_file = getOpt(opts, "bulk_file", "");
+    config.bulk_fill_factor = std::stod(getOpt(opts, "bulk_fill", "0.9"));
+    config.sort_memory_items = std::stoull(getOpt(opts, "sort_memory_items", "4000000"));
+    config.sort_threads = static_cast<unsigned>(std::stoul(getOpt(opts, "sort_threads", "0")));
+    config.open_existing = std::stoi(getOpt(opts, "open_existing", "0")) != 0;
+    config.prewarm_levels = static_cast<uint32_t>(std::stoul(getOpt(opts, "prewarm", "0")));
+    std::string leaf_codec = getOpt(opts, "leaf_codec", "NONE");
+    std::transform(leaf_codec.begin(), leaf_codec.end(), leaf_codec.begin(), ::toupper);
+    // Quantised leaves only answer exactly through the codec benchmark's refine
+    // step, and deletes cannot match their cell boxes: any codec but NONE
+    // selects that benchmark, whose trees pick their own leaf format
+    const std::vector<LeafCodec> leaf_codecs = getLeafCodecs(leaf_codec);
+    const bool codec_benchmark = leaf_codec != "NONE";
+    config.leaf_capacity = std::stoi(getOpt(opts, "leaf_capacity", "0"));
+
+    // A generated bulk load ahead of the insert benchmark reads its points from
+    // the same stream, so the sorted streams must hold both
+    std::string index_opt = getOpt(opts, "index", "SINGLE");
+    std::transform(index_opt.begin(), index_opt.end(), index_opt.begin(), ::toupper);
+    const bool bulk_then_inserts = (config.build_mode == "STR" || config.build_mode == "HILBERT") &&
+        config.bulk_data_file.empty() && index_opt == "SINGLE" && !codec_benchmark &&
+        getOpt(opts, "restart", "").empty() && getOpt(opts, "updates", "").empty();
+    if (bulk_then_inserts) dist_params.stream_length += config.bulk_points;
+
+    WorkloadGenerator workload_gen(data_type, seed, dist_params);
+    workload_gen.setMix(mix);
+
+    if (run_type == "generate") {
+        const std::string import_csv = getOpt(opts, "import_csv", "");
+        const uint64_t written = import_csv.empty()
+            ? writeWorkloadFile(output_file, workload_gen, static_cast<uint64_t>(std::max(0, num_insertions)))
+            : importCsvWorkload(import_csv, output_file, static_cast<uint64_t>(std::max(0, num_insertions)));
+        log << "Wrote " << written << " operations ("
+            << (import_csv.empty() ? workload_gen.getDataType() + " data" : import_csv)
+            << ") to " << output_file << std::endl;
+        return ExperimentResult();
+    }
+
+    const std::string workload_file = getOpt(opts, "workload_file", "");
+    if (!workload_file.empty()) {
+        auto workload = std::make_shared<const MappedWorkload>(workload_file);
+        // A generated bulk load takes its points from the replay first
+        uint64_t bulk_records = 0;
+        if (config.bulk_data_file.empty() && (config.build_mode == "STR" || config.build_mode == "HILBERT" ||
+                                              config.build_mode == "COMPARE")) {
+            uint64_t found = 0;
+            while (found < config.bulk_points && bulk_records < workload->size()) {
+                if ((*workload)[bulk_records++].type == static_cast<uint8_t>(OpType::INSERT)) ++found;
+            }
+            if (found < config.bulk_points) {
+                throw std::invalid_argument(workload_file + " holds " + std::to_string(found) +
+                                            " inserts; the bulk load needs bulk_points=" +
+                                            std::to_string(config.bulk_points) + ".");
+            }
+        }
+        const uint64_t skipped = bulk_then_inserts ? bulk_records : 0;
+        if (static_cast<uint64_t>(num_insertions) + skipped > workload->size()) {
+            throw std::invalid_argument(workload_file + " holds " + std::to_string(workload->size()) +
+                                        " operations; cannot replay " + std::to_string(num_insertions) +
+                                        (skipped ? " after the " + std::to_string(skipped) +
+                                                   " records the bulk load reads" : std::string()) + ".");
+        }
+        workload_gen.replay(workload);
+        log << "Replaying " << workload->size() << " operations ("
+            << workload_gen.getDataType() << " data) from " << workload_file << std::endl;
+    }
+
+    std::string timing = getOpt(opts, "timing", "CSV");
+    std::transform(timing.begin(), timing.end(), timing.begin(), ::toupper);
+    const std::string trace_file = getOpt(opts, "trace_file", "");
+    if (timing != "CSV" && timing != "HDR") {
+        throw std::invalid_argument("Unknown timing mode: " + timing);
+    }
+    std::unique_ptr<LatencyRecorder> recorder;
+    if (timing == "HDR" || !trace_file.empty()) {
+        recorder.reset(new LatencyRecorder(trace_file));
+    }
+    // Hardware counters around the timed operations of the serial and SWARE runners
+    std::unique_ptr<PerfProfiler> profiler;
+    if (std::stoi(getOpt(opts, "perf", "0")) != 0) {
+        profiler.reset(new PerfProfiler());
+        if (!profiler->available()) {
+            log << "Warning: hardware counters unavailable (" << profiler->counters().status()
+                << "); running without perf profiling." << std::endl;
+            profiler.reset();
+        } else if (!profiler->counters().status().empty()) {
+            log << "Hardware counters: " << profiler->counters().status() << std::endl;
+        }
+    }
+
+    // auto t_start = std::chrono::high_resolution_clock::now();
+    // TreeResources resources = setupTree(config);
+
+    std::string index_mode = getOpt(opts, "index", "SINGLE");
+    std::transform(index_mode.begin(), index_mode.end(), index_mode.begin(), ::toupper);
+    ExperimentResult result;
+    if (codec_benchmark) {
+        std::string ingest = getOpt(opts, "ingest", "SERIAL");
+        std::transform(ingest.begin(), ingest.end(), ingest.begin(), ::toupper);
+        if (index_mode != "SINGLE" || !getOpt(opts, "restart", "").empty() || !getOpt(opts, "updates", "").empty() ||
+            config.build_mode == "COMPARE" || config.buffer_type == "SWARE" || ingest != "SERIAL") {
+            throw std::invalid_argument("leaf_codec=" + leaf_codec + " runs the leaf codec benchmark only; "
+                                        "other runners need leaf_codec=NONE.");
+        }
+    }
+
+    if (index_mode == "SHARDED") {
+        ShardedIndexOptions shard_options;
+        shard_options.shards = static_cast<uint32_t>(std::stoul(getOpt(opts, "shards", "0")));
+        shard_options.partition = getShardPartition(getOpt(opts, "shard_partition", "GRID"));
+        shard_options.queue_items = std::stoul(getOpt(opts, "shard_queue_items", "16384"));
+        const std::vector<uint32_t> thread_counts = parseList(getOpt(opts, "shard_threads", "1,2,4,8"));
+        const int shard_queries = std::stoi(getOpt(opts, "shard_queries", "1000"));
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        runShardedBenchmark(config, workload_gen, shard_options, thread_counts,
+                            num_insertions, shard_queries, output_file);
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        log << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
+
+    } else if (index_mode == "CONCURRENT") {
+        ConcurrentOptions concurrent_options;
+        concurrent_options.scheme = getConcurrencyScheme(getOpt(opts, "concurrency", "GLOBAL_LOCK"));
+        concurrent_options.writers = static_cast<uint32_t>(std::stoul(getOpt(opts, "writers", "1")));
+        concurrent_options.reader_counts = parseList(getOpt(opts, "readers", "0,1,2,4,8"));
+        concurrent_options.shards = static_cast<uint32_t>(std::stoul(getOpt(opts, "shards", "16")));
+        concurrent_options.partition = getShardPartition(getOpt(opts, "shard_partition", "KD"));
+        concurrent_options.snapshot_inserts = std::stoull(getOpt(opts, "snapshot_inserts", "10000"));
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        runConcurrentBenchmark(config, workload_gen, concurrent_options, num_insertions, output_file);
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        log << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
+
+    } else if (index_mode == "PACKED") {
+        const int packed_queries = std::stoi(getOpt(opts, "packed_queries", "10000"));
+        auto t_start = std::chrono::high_resolution_clock::now();
+        runPackedBenchmark(config, workload_gen, seed, workload_gen.getMix(), packed_queries, output_file);
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        log << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
+
+    } else if (index_mode == "LSM") {
+        LsmOptions lsm_options;
+        lsm_options.memtable_items = std::stoul(getOpt(opts, "lsm_memtable", "100000"));
+        lsm_options.fanout = static_cast<uint32_t>(std::stoul(getOpt(opts, "lsm_fanout", "4")));
+        lsm_options.background = std::stoi(getOpt(opts, "lsm_background", "1")) != 0;
+        const int lsm_queries = std::stoi(getOpt(opts, "lsm_queries", "1000"));
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        runLsmBenchmark(config, workload_gen, lsm_options, num_insertions, lsm_queries, output_file);
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        log << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
+
+    } else if (!getOpt(opts, "restart", "").empty()) {
+        if (config.run_type != "disk") {
+            throw std::invalid_argument("restart needs run_type 'disk'.");
+        }
+        RestartOptions restart_options;
+        restart_options.mode = getRestartMode(getOpt(opts, "restart", ""));
+        restart_options.prewarm_levels = config.prewarm_levels;
+        restart_options.queries = static_cast<uint32_t>(std::stoul(getOpt(opts, "restart_queries", "1000")));
+        restart_options.drop_cache = std::stoi(getOpt(opts, "drop_cache", "1")) != 0;
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        runRestartBenchmark(config, workload_gen, seed, restart_options, num_insertions, output_file);
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        log << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
+
+    } else if (codec_benchmark) {
+        if (config.run_type != "disk") {
+            throw std::invalid_argument("leaf_codec=" + leaf_codec + " needs run_type 'disk'.");
+        }
+        const int codec_queries = std::stoi(getOpt(opts, "codec_queries", "1000"));
+        auto t_start = std::chrono::high_resolution_clock::now();
+        runLeafCodecBenchmark(config, workload_gen, seed, leaf_codecs, codec_queries,
+                              num_insertions, output_file);
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        log << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
+
+    } else if (!getOpt(opts, "updates", "").empty()) {
+        const std::vector<UpdatePath> paths = getUpdatePaths(getOpt(opts, "updates", ""));
+        UpdateOptions update_options;
+        update_options.ticks = static_cast<uint32_t>(std::stoul(getOpt(opts, "update_ticks", "10")));
+        update_options.fraction = std::stod(getOpt(opts, "update_fraction", "1.0"));
+        update_options.step = std::stod(getOpt(opts, "update_step", "5.0"));
+        update_options.probes = static_cast<uint32_t>(std::stoul(getOpt(opts, "update_probes", "200")));
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        runUpdateBenchmark(config, workload_gen, seed, paths, update_options, num_insertions, output_file);
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        log << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
+
+    } else if (config.build_mode == "COMPARE") {
+        const int build_queries = std::stoi(getOpt(opts, "build_queries", "1000"));
+        auto t_start = std::chrono::high_resolution_clock::now();
+        runBuildBenchmark(config, workload_gen, seed, workload_gen.getMix(), build_queries, output_file);
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        log << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
+
+    } else if (config.buffer_type == "SWARE") {
+        log << "--- Setting up SWARE Benchmark ---" << std::endl;
+        // SWARE must be on-disk to be meaningful
+        config.run_type = "disk"; 
+        
+        // SWARE can use a page buffer (LRU/FIFO/...) *underneath* it, sized by buffer_pages
+        std::string page_buffer = getOpt(opts, "sware_page_buffer", "NONE");
+        std::transform(page_buffer.begin(), page_buffer.end(), page_buffer.begin(), ::toupper);
+        config.buffer_type = page_buffer;
+        if (page_buffer == "NONE") config.buffer_pages = 0;
+        
+        SwareBufferOptions sware_options;
+        sware_options.capacity = std::stoul(getOpt(opts, "sware_items", "10000"));
+        sware_options.budget_bytes = std::stoul(getOpt(opts, "sware_budget_kb", "0")) * 1024;
+        sware_options.page_items = std::stoul(getOpt(opts, "sware_page_items", "256"));
+        sware_options.flush_fraction = std::stod(getOpt(opts, "sware_flush_fraction", "0.5"));
+        sware_options.order = getSwareOrder(getOpt(opts, "sware_order", "X"));
+        sware_options.policy = getSwareFlushPolicy(getOpt(opts, "sware_policy", "FIXED"));
+        sware_options.min_gain = std::stod(getOpt(opts, "sware_min_gain", "0.1"));
+        sware_options.leaf_items = config.M_capacity;
+        
+        TreeResources resources = setupTree(config, &workload_gen);
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        result = toResult(run_sware_benchmark(
+            resources.tree, 
+            *resources.counters,
+            ioMonitor(resources),
+            workload_gen, 
+            num_insertions, 
+            sware_options,
+            output_file,
+            recorder.get(),
+            profiler.get(),
+            log
+        ));
+        auto t_end = std::chrono::high_resolution_clock::now();
+        
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        log << "Total time for SWARE " << output_file << ": " << dur_s << " seconds.\n\n";
+
+        cleanupTree(resources);
+
+    } else {
+        std::string ingest = getOpt(opts, "ingest", "SERIAL");
+        std::transform(ingest.begin(), ingest.end(), ingest.begin(), ::toupper);
+        if (ingest != "SERIAL" && ingest != "PIPELINE") {
+            throw std::invalid_argument("Unknown ingest mode: " + ingest);
+        }
+        IngestPipelineOptions pipeline_options;
+        pipeline_options.ring_items = std::stoul(getOpt(opts, "ingest_ring", "65536"));
+        pipeline_options.batch_items = std::stoul(getOpt(opts, "ingest_batch", "256"));
+
+        TreeResources resources = setupTree(config, &workload_gen);
+        // WorkloadGenerator workload_gen(data_type, 42);
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        if (ingest == "PIPELINE") {
+            result = toResult(runPipelinedBenchmark(resources.tree, *resources.counters, ioMonitor(resources),
+                                                    workload_gen, num_insertions, output_file,
+                                                    pipeline_options, recorder.get(), log));
+        } else {
+            result = toResult(runBenchmark(resources.tree, *resources.counters, ioMonitor(resources), workload_gen,
+                                           num_insertions, output_file, recorder.get(), profiler.get(), log));
+        }
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        cleanupTree(resources);
+        
+        auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
+        const double dur_sec = std::chrono::duration<double>(t_end - t_start).count();
+        log << "Total time for " << output_file << ": " << dur_s << " seconds ("
+            << (dur_sec > 0 ? num_insertions / dur_sec : 0.0) << " ops/s).\n\n";
+    }
+    return result;
+}
+
+} // namespace SpatialIndex
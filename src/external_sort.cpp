@@ -0,0 +1,134 @@
+#include "external_sort.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+namespace SpatialIndex {
+
+void parallelSort(std::vector<SortRecord>& records, unsigned threads) {
+    const size_t n = records.size();
+    if (threads <= 1 || n < 2 * static_cast<size_t>(threads) * 1024) {
+        std::sort(records.begin(), records.end());
+        return;
+    }
+
+    // Sort equal slices concurrently, then merge neighbouring slices pairwise
+    std::vector<size_t> bounds(threads + 1);
+    for (unsigned t = 0; t <= threads; ++t) bounds[t] = n * t / threads;
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&records, &bounds, t]() {
+            std::sort(records.begin() + bounds[t], records.begin() + bounds[t + 1]);
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    for (size_t width = 1; width < threads; width *= 2) {
+        workers.clear();
+        for (size_t t = 0; t + width < threads; t += 2 * width) {
+            const size_t lo = bounds[t];
+            const size_t mid = bounds[t + width];
+            const size_t hi = bounds[std::min<size_t>(t + 2 * width, threads)];
+            workers.emplace_back([&records, lo, mid, hi]() {
+                std::inplace_merge(records.begin() + lo, records.begin() + mid, records.begin() + hi);
+            });
+        }
+        for (auto& w : workers) w.join();
+    }
+}
+
+ParallelExternalSorter::ParallelExternalSorter(size_t memory_items, unsigned threads,
+                                               const std::string& tmp_prefix)
+    : memory_items_(std::max<size_t>(1024, memory_items)),
+      threads_(threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads),
+      tmp_prefix_(tmp_prefix), buffer_pos_(0), total_(0), finished_(false) {
+    buffer_.reserve(memory_items_);
+}
+
+ParallelExternalSorter::~ParallelExternalSorter() {
+    for (auto& run : runs_) {
+        if (run.file) std::fclose(run.file);
+        std::remove(run.path.c_str());
+    }
+}
+
+void ParallelExternalSorter::add(const SortRecord& rec) {
+    if (finished_) throw std::logic_error("ParallelExternalSorter: add() after finish()");
+    buffer_.push_back(rec);
+    ++total_;
+    if (buffer_.size() >= memory_items_) spill();
+}
+
+void ParallelExternalSorter::sortBuffer() {
+    parallelSort(buffer_, threads_);
+}
+
+void ParallelExternalSorter::spill() {
+    sortBuffer();
+    Run run;
+    run.path = tmp_prefix_ + ".run" + std::to_string(runs_.size());
+    std::FILE* out = std::fopen(run.path.c_str(), "wb");
+    if (!out) throw std::runtime_error("Could not create sort run file: " + run.path);
+    const size_t written = std::fwrite(buffer_.data(), sizeof(SortRecord), buffer_.size(), out);
+    std::fclose(out);
+    if (written != buffer_.size()) throw std::runtime_error("Short write to sort run file: " + run.path);
+    runs_.push_back(std::move(run));
+    buffer_.clear();
+}
+
+bool ParallelExternalSorter::refill(Run& run) {
+    run.buf.resize(std::max<size_t>(1, memory_items_ / runs_.size()));
+    const size_t got = std::fread(run.buf.data(), sizeof(SortRecord), run.buf.size(), run.file);
+    run.buf.resize(got);
+    run.pos = 0;
+    return got > 0;
+}
+
+void ParallelExternalSorter::finish() {
+    if (finished_) return;
+    finished_ = true;
+
+    if (runs_.empty()) {
+        // Everything fit in memory
+        sortBuffer();
+        buffer_pos_ = 0;
+        return;
+    }
+    if (!buffer_.empty()) spill();
+    buffer_.shrink_to_fit();
+
+    for (size_t r = 0; r < runs_.size(); ++r) {
+        Run& run = runs_[r];
+        run.file = std::fopen(run.path.c_str(), "rb");
+        if (!run.file) throw std::runtime_error("Could not reopen sort run file: " + run.path);
+        if (refill(run)) heap_.emplace_back(run.buf[0].key, r);
+    }
+    std::make_heap(heap_.begin(), heap_.end(), std::greater<std::pair<uint64_t, size_t>>());
+}
+
+bool ParallelExternalSorter::next(SortRecord& out) {
+    if (!finished_) finish();
+
+    if (runs_.empty()) {
+        if (buffer_pos_ >= buffer_.size()) return false;
+        out = buffer_[buffer_pos_++];
+        return true;
+    }
+
+    if (heap_.empty()) return false;
+    std::pop_heap(heap_.begin(), heap_.end(), std::greater<std::pair<uint64_t, size_t>>());
+    const size_t r = heap_.back().second;
+    heap_.pop_back();
+
+    Run& run = runs_[r];
+    out = run.buf[run.pos++];
+    if (run.pos < run.buf.size() || refill(run)) {
+        heap_.emplace_back(run.buf[run.pos].key, r);
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<std::pair<uint64_t, size_t>>());
+    }
+    return true;
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,294 @@
+#include "ingest_pipeline.h"
+#include "query_runner.h"
+#include "rtree_helpers.h"
+#include "spsc_ring.h"
+#include "dims.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace SpatialIndex {
+
+namespace {
+
+// What the insert stage hands to the logging stage
+struct LogRecord {
+    enum Kind : uint8_t { OP, MILESTONE, END };
+    Kind kind = OP;
+    OpType type = OpType::INSERT;
+    int op_idx = 0;                // MILESTONE: operations done
+    int insert_idx = 0;            // MILESTONE: inserts done
+    uint64_t time_ns = 0;
+    uint64_t nodes_visited = 0;    // Queries
+    uint64_t results = 0;          // Queries
+    TreeCounterSnapshot before;    // Inserts
+    TreeCounterSnapshot after;     // Inserts
+    IoSnapshot io;                 // MILESTONE: interval I/O
+};
+
+// Push onto a ring, yielding while it is full; returns the number of waits
+template <typename T>
+uint64_t pushBlocking(SpscRing<T>& ring, const T& item) {
+    uint64_t waits = 0;
+    while (!ring.tryPush(item)) {
+        ++waits;
+        std::this_thread::yield();
+    }
+    return waits;
+}
+
+// The pipelined benchmark loop for D-dimensional points
+template <uint32_t D>
+RunSummary runPipelinedBenchmarkDims(
+    ISpatialIndex* tree,
+    const CountingStorageManager& counters,
+    const IoMonitor& io,
+    WorkloadGenerator& workload_gen,
+    int num_insertions,
+    const std::string& output_csv,
+    const IngestPipelineOptions& options,
+    LatencyRecorder* recorder,
+    std::ostream& log
+) {
+    // Output files exactly as runBenchmark writes them
+    std::ofstream f;
+    if (!recorder) {
+        f.open(output_csv);
+        if (!f.is_open()) {
+            log << "Error: Could not open output file: " << output_csv << std::endl;
+            return RunSummary();
+        }
+        f << "InsertIdx,Time_us,DidSplit,IsRootSplit,NodesBefore,NodesAfter,"
+             "HeightBefore,HeightAfter,SplitsBefore,SplitsAfter,NodeReads,NodeWrites,Time_ns\n";
+    }
+
+    const WorkloadMix& mix = workload_gen.getMix();
+    std::ofstream fq;
+    if (!recorder && !mix.insertOnly()) {
+        fq.open(queryCsvName(output_csv));
+        if (!fq.is_open()) {
+            log << "Error: Could not open query output file: " << queryCsvName(output_csv) << std::endl;
+            return RunSummary();
+        }
+        fq << "OpIdx,OpType,Time_us,NodesVisited,Results,Time_ns\n";
+    }
+
+    const std::string io_csv = derivedCsvName(output_csv, "_io");
+    std::ofstream fio(io_csv);
+    if (!fio.is_open()) {
+        log << "Error: Could not open I/O output file: " << io_csv << std::endl;
+        return RunSummary();
+    }
+    fio << "Ops,Inserts";
+    writeIoCsvHeader(fio);
+    fio << "\n";
+
+    const size_t batch_items = std::max<size_t>(1, options.batch_items);
+    SpscRing<Operation> op_ring(std::max(options.ring_items, batch_items));
+    SpscRing<LogRecord> log_ring(std::max<size_t>(options.log_items, 2));
+
+    log << "Starting pipelined benchmark: " << num_insertions
+        << (mix.insertOnly() ? " insertions (" : " operations (")
+        << workload_gen.getDataType() << " data, " << D << "-D, ring " << op_ring.capacity()
+        << ", batch " << batch_items << ") -> " << output_csv << std::endl;
+
+    int progress_milestone = num_insertions / 10;
+    if (progress_milestone == 0) progress_milestone = 1;
+
+    // Stage 1: generator. Stops early if it throws or the insert stage gives up.
+    std::atomic<bool> producer_failed(false);
+    std::atomic<bool> abort(false);
+    std::exception_ptr producer_error;
+    uint64_t generator_stalls = 0;
+    std::thread producer([&]() {
+        try {
+            for (int i = 0; i < num_insertions; ++i) {
+                const Operation op = workload_gen.nextOperation();
+                while (!op_ring.tryPush(op)) {
+                    if (abort.load(std::memory_order_relaxed)) return;
+                    ++generator_stalls;
+                    std::this_thread::yield();
+                }
+            }
+        } catch (...) {
+            producer_error = std::current_exception();
+            producer_failed.store(true, std::memory_order_release);
+        }
+    });
+
+    // Stage 3: logging, formatting and statistics
+    RunSummary summary;
+    OpTypeStats* const op_stats = summary.stats;
+    std::thread logger([&]() {
+        std::vector<LogRecord> records(std::min<size_t>(log_ring.capacity(), 1024));
+        for (;;) {
+            const size_t n = log_ring.popBatch(records.data(), records.size());
+            if (n == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t r = 0; r < n; ++r) {
+                const LogRecord& rec = records[r];
+                if (rec.kind == LogRecord::END) return;
+                if (rec.kind == LogRecord::MILESTONE) {
+                    fio << rec.op_idx << "," << rec.insert_idx;
+                    writeIoCsvFields(fio, rec.io);
+                    fio << "\n";
+                    if (rec.op_idx % progress_milestone == 0) {
+                        int percentage = static_cast<int>((static_cast<int64_t>(rec.op_idx) * 100) / num_insertions);
+                        log << "  ... Progress for " << output_csv << ": "
+                            << percentage << "% completed ("
+                            << rec.op_idx << (mix.insertOnly() ? " insertions)\n" : " operations)\n");
+                    }
+                } else if (rec.type != OpType::INSERT) {
+                    const auto time_us = static_cast<int64_t>(rec.time_ns / 1000);
+                    op_stats[static_cast<int>(rec.type)].add(rec.time_ns, rec.nodes_visited, rec.results);
+                    if (recorder) {
+                        recorder->record(rec.type == OpType::RANGE_QUERY ? LatencyPhase::RANGE_QUERY
+                                                                         : LatencyPhase::KNN_QUERY,
+                                         rec.op_idx, rec.time_ns, static_cast<uint32_t>(rec.nodes_visited));
+                    } else {
+                        fq << rec.op_idx << "," << opTypeName(rec.type) << "," << time_us << ","
+                           << rec.nodes_visited << "," << rec.results << "," << rec.time_ns << "\n";
+                    }
+                } else {
+                    const TreeCounterSnapshot& before = rec.before;
+                    const TreeCounterSnapshot& after = rec.after;
+                    const bool did_split = after.splits > before.splits;
+                    const bool root_split = after.height > before.height;
+                    const uint64_t node_writes = after.node_writes + after.node_allocs -
+                                                 before.node_writes - before.node_allocs;
+                    const auto dur_us = static_cast<int64_t>(rec.time_ns / 1000);
+                    op_stats[static_cast<int>(OpType::INSERT)].add(rec.time_ns, 0, 0);
+                    if (recorder) {
+                        const uint8_t flags = (did_split ? kTraceDidSplit : 0) | (root_split ? kTraceRootSplit : 0);
+                        recorder->record(did_split ? LatencyPhase::SPLIT : LatencyPhase::INSERT,
+                                         rec.insert_idx, rec.time_ns, static_cast<uint32_t>(node_writes), flags);
+                    } else {
+                        f << rec.insert_idx << "," << dur_us << "," << (did_split ? 1 : 0) << ","
+                          << (root_split ? 1 : 0) << ","
+                          << before.nodes << "," << after.nodes << ","
+                          << before.height << "," << after.height << ","
+                          << before.splits << "," << after.splits << ","
+                          << (after.node_reads - before.node_reads) << ","
+                          << node_writes << "," << rec.time_ns << "\n";
+                    }
+                }
+            }
+        }
+    });
+
+    // Stage 2 (this thread): drain batches into the tree
+    const IoSnapshot io_start = io.snapshot();
+    IoSnapshot io_last = io_start;
+    uint64_t insert_waits = 0;
+    uint64_t log_stalls = 0;
+    int done = 0;
+    int insert_idx = 0;
+    std::exception_ptr insert_error;
+    try {
+        PointInserter inserter(*tree, D);
+        std::vector<Operation> batch(batch_items);
+        auto milestone = [&]() {
+            const IoSnapshot now = io.snapshot();
+            LogRecord rec;
+            rec.kind = LogRecord::MILESTONE;
+            rec.op_idx = done;
+            rec.insert_idx = insert_idx;
+            rec.io = ioDelta(now, io_last);
+            io_last = now;
+            log_stalls += pushBlocking(log_ring, rec);
+        };
+        while (done < num_insertions) {
+            // Never take operations past the next milestone, so I/O intervals line up with runBenchmark
+            const int to_milestone = progress_milestone - done % progress_milestone;
+            const size_t want = std::min<size_t>(batch_items, static_cast<size_t>(std::min(to_milestone, num_insertions - done)));
+            const size_t n = op_ring.popBatch(batch.data(), want);
+            if (n == 0) {
+                if (producer_failed.load(std::memory_order_acquire) && op_ring.empty()) break;
+                ++insert_waits;
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t b = 0; b < n; ++b, ++done) {
+                const Operation& op = batch[b];
+                LogRecord rec;
+                rec.type = op.type;
+                rec.op_idx = done;
+                if (op.type != OpType::INSERT) {
+                    const QueryResult qr = runQuery(tree, op, mix.knn_k, D);
+                    rec.time_ns = qr.time_ns;
+                    rec.nodes_visited = qr.nodes_visited;
+                    rec.results = qr.results;
+                } else {
+                    rec.insert_idx = insert_idx++;
+                    rec.before = counters.snapshot();
+                    const uint64_t t0 = nowNs();
+                    inserter.insert(op.coords, static_cast<id_type>(op.id));
+                    rec.time_ns = nowNs() - t0;
+                    rec.after = counters.snapshot();
+                }
+                log_stalls += pushBlocking(log_ring, rec);
+            }
+            if (done % progress_milestone == 0) milestone();
+        }
+        if (done > 0 && done % progress_milestone != 0) milestone();
+    } catch (...) {
+        insert_error = std::current_exception();
+        abort.store(true, std::memory_order_relaxed);
+    }
+
+    LogRecord end;
+    end.kind = LogRecord::END;
+    log_stalls += pushBlocking(log_ring, end);
+    producer.join();
+    logger.join();
+    if (insert_error) std::rethrow_exception(insert_error);
+    if (producer_error) std::rethrow_exception(producer_error);
+
+    if (f.is_open()) f.close();
+    if (fq.is_open()) fq.close();
+    fio.close();
+    printOpSummary(log, op_stats);
+    printIoSummary(log, ioDelta(io.snapshot(), io_start));
+    log << "  Pipeline: " << generator_stalls << " generator stalls (tree-bound), "
+        << insert_waits << " insert-stage waits (generator-bound), "
+        << log_stalls << " logging stalls" << std::endl;
+    if (recorder) {
+        recorder->finish();
+        const std::string latency_csv = derivedCsvName(output_csv, "_latency");
+        if (!recorder->writeSummary(latency_csv)) {
+            log << "Error: Could not open latency output file: " << latency_csv << std::endl;
+        }
+        log << "  Latency percentiles (" << latency_csv << "):\n";
+        recorder->printSummary(log);
+    }
+    log << "Benchmark finished for " << output_csv << "." << std::endl;
+    summary.inserts = op_stats[static_cast<int>(OpType::INSERT)].count;
+    return summary;
+}
+
+} // namespace
+
+RunSummary runPipelinedBenchmark(
+    ISpatialIndex* tree,
+    const CountingStorageManager& counters,
+    const IoMonitor& io,
+    WorkloadGenerator& workload_gen,
+    int num_insertions,
+    const std::string& output_csv,
+    const IngestPipelineOptions& options,
+    LatencyRecorder* recorder,
+    std::ostream& log
+) {
+    return dispatchDims(workload_gen.dims(), [&](auto dim) {
+        return runPipelinedBenchmarkDims<decltype(dim)::value>(tree, counters, io, workload_gen, num_insertions,
+                                                               output_csv, options, recorder, log);
+    });
+}
+
+} // namespace SpatialIndex
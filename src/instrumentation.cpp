@@ -0,0 +1,120 @@
+#include "instrumentation.h"
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace SpatialIndex {
+
+const char* latencyPhaseName(LatencyPhase phase) {
+    switch (phase) {
+        case LatencyPhase::INSERT: return "INSERT";
+        case LatencyPhase::SPLIT: return "SPLIT";
+        case LatencyPhase::RANGE_QUERY: return "RANGE";
+        case LatencyPhase::KNN_QUERY: return "KNN";
+        case LatencyPhase::FLUSH: return "FLUSH";
+        default: return "UNKNOWN";
+    }
+}
+
+TraceWriter::TraceWriter(const std::string& path, size_t ring_capacity)
+    : path_(path), file_(std::fopen(path.c_str(), "wb")), ring_(ring_capacity),
+      stop_(false), write_failed_(false), stalls_(0), written_(0) {
+    if (!file_) throw std::runtime_error("Could not open trace file: " + path);
+
+    const uint32_t version = kTraceVersion;
+    const uint32_t record_size = sizeof(TraceRecord);
+    if (std::fwrite(kTraceMagic, 1, sizeof(kTraceMagic), file_) != sizeof(kTraceMagic) ||
+        std::fwrite(&version, sizeof(version), 1, file_) != 1 ||
+        std::fwrite(&record_size, sizeof(record_size), 1, file_) != 1) {
+        std::fclose(file_);
+        file_ = nullptr;
+        fail();
+    }
+
+    writer_ = std::thread(&TraceWriter::writerLoop, this);
+}
+
+TraceWriter::~TraceWriter() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // Callers that care about the trace call close() themselves
+    }
+}
+
+void TraceWriter::fail() {
+    throw std::runtime_error("Error writing trace file: " + path_);
+}
+
+void TraceWriter::writerLoop() {
+    std::vector<TraceRecord> batch(4096);
+    for (;;) {
+        const bool stopping = stop_.load(std::memory_order_acquire);
+        const size_t n = ring_.popBatch(batch.data(), batch.size());
+        if (n > 0) {
+            // After a failed write keep draining so push() never blocks, but drop the records
+            if (!write_failed_.load(std::memory_order_relaxed)) {
+                if (std::fwrite(batch.data(), sizeof(TraceRecord), n, file_) == n) {
+                    written_.fetch_add(n, std::memory_order_relaxed);
+                } else {
+                    write_failed_.store(true, std::memory_order_relaxed);
+                }
+            }
+            continue;
+        }
+        // Only stop once the ring was seen empty after the stop request
+        if (stopping) break;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+void TraceWriter::close() {
+    if (!file_) return;
+    stop_.store(true, std::memory_order_release);
+    if (writer_.joinable()) writer_.join();
+    const bool closed = std::fclose(file_) == 0;
+    file_ = nullptr;
+    if (!closed || write_failed_.load(std::memory_order_relaxed)) fail();
+}
+
+LatencyRecorder::LatencyRecorder(const std::string& trace_path)
+    : trace_(trace_path.empty() ? nullptr : new TraceWriter(trace_path)) {}
+
+LatencyRecorder::~LatencyRecorder() {
+    delete trace_;
+}
+
+void LatencyRecorder::finish() {
+    if (trace_) trace_->close();
+}
+
+bool LatencyRecorder::writeSummary(const std::string& csv_path) const {
+    std::ofstream f(csv_path);
+    if (!f.is_open()) return false;
+    f << "Phase,Count,Min_ns,P50_ns,P99_ns,P999_ns,Max_ns,Mean_ns\n";
+    for (int p = 0; p < static_cast<int>(LatencyPhase::COUNT); ++p) {
+        const LatencyHistogram& h = histograms_[p];
+        if (h.count() == 0) continue;
+        f << latencyPhaseName(static_cast<LatencyPhase>(p)) << "," << h.count() << ","
+          << h.min() << "," << h.percentile(50.0) << "," << h.percentile(99.0) << ","
+          << h.percentile(99.9) << "," << h.max() << "," << h.mean() << "\n";
+    }
+    return true;
+}
+
+void LatencyRecorder::printSummary(std::ostream& os) const {
+    for (int p = 0; p < static_cast<int>(LatencyPhase::COUNT); ++p) {
+        const LatencyHistogram& h = histograms_[p];
+        if (h.count() == 0) continue;
+        os << "  " << latencyPhaseName(static_cast<LatencyPhase>(p)) << ": " << h.count()
+           << " ops, p50 " << h.percentile(50.0) << " ns, p99 " << h.percentile(99.0)
+           << " ns, p99.9 " << h.percentile(99.9) << " ns, max " << h.max() << " ns\n";
+    }
+    if (trace_) {
+        os << "  Trace: " << trace_->written() << " records, " << trace_->stalls()
+           << " producer stalls\n";
+    }
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,143 @@
+#include "io_stats.h"
+#include "latency_histogram.h"
+#include "page_buffer.h"
+#include "async_write_back.h"
+#include <fstream>
+
+namespace SpatialIndex {
+
+IoSnapshot ioDelta(const IoSnapshot& later, const IoSnapshot& earlier) {
+    IoSnapshot d = later;
+    d.page_reads -= earlier.page_reads;
+    d.page_writes -= earlier.page_writes;
+    d.page_allocs -= earlier.page_allocs;
+    d.page_deletes -= earlier.page_deletes;
+    d.bytes_read -= earlier.bytes_read;
+    d.bytes_written -= earlier.bytes_written;
+    d.load_ns -= earlier.load_ns;
+    d.store_ns -= earlier.store_ns;
+    d.hits -= earlier.hits;
+    d.misses -= earlier.misses;
+    d.write_backs -= earlier.write_backs;
+    d.evictions -= earlier.evictions;
+    d.write_back_stalls -= earlier.write_back_stalls;
+    return d;
+}
+
+IoStatsStorageManager::IoStatsStorageManager(IStorageManager& inner)
+    : inner_(inner), page_reads_(0), page_writes_(0), page_allocs_(0), page_deletes_(0),
+      bytes_read_(0), bytes_written_(0), load_ns_(0), store_ns_(0) {}
+
+IoSnapshot IoStatsStorageManager::snapshot() const {
+    IoSnapshot s;
+    s.page_reads = page_reads_.load(std::memory_order_relaxed);
+    s.page_writes = page_writes_.load(std::memory_order_relaxed);
+    s.page_allocs = page_allocs_.load(std::memory_order_relaxed);
+    s.page_deletes = page_deletes_.load(std::memory_order_relaxed);
+    s.bytes_read = bytes_read_.load(std::memory_order_relaxed);
+    s.bytes_written = bytes_written_.load(std::memory_order_relaxed);
+    s.load_ns = load_ns_.load(std::memory_order_relaxed);
+    s.store_ns = store_ns_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void IoStatsStorageManager::loadByteArray(const id_type page, uint32_t& len, uint8_t** data) {
+    const uint64_t t0 = nowNs();
+    inner_.loadByteArray(page, len, data);
+    load_ns_.fetch_add(nowNs() - t0, std::memory_order_relaxed);
+    page_reads_.fetch_add(1, std::memory_order_relaxed);
+    bytes_read_.fetch_add(len, std::memory_order_relaxed);
+}
+
+void IoStatsStorageManager::storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) {
+    const bool is_new = (page == StorageManager::NewPage);
+    const uint64_t t0 = nowNs();
+    inner_.storeByteArray(page, len, data);
+    store_ns_.fetch_add(nowNs() - t0, std::memory_order_relaxed);
+    (is_new ? page_allocs_ : page_writes_).fetch_add(1, std::memory_order_relaxed);
+    bytes_written_.fetch_add(len, std::memory_order_relaxed);
+}
+
+void IoStatsStorageManager::deleteByteArray(const id_type page) {
+    inner_.deleteByteArray(page);
+    page_deletes_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IoStatsStorageManager::flush() {
+    inner_.flush();
+}
+
+void IoStatsStorageManager::loadByteArrays(size_t n, const id_type* pages, uint32_t* lens, uint8_t** data) {
+    const uint64_t t0 = nowNs();
+    loadPages(inner_, n, pages, lens, data);
+    load_ns_.fetch_add(nowNs() - t0, std::memory_order_relaxed);
+    page_reads_.fetch_add(n, std::memory_order_relaxed);
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < n; ++i) bytes += lens[i];
+    bytes_read_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void IoStatsStorageManager::storeByteArrays(size_t n, const id_type* pages, const uint32_t* lens,
+                                            const uint8_t* const* data) {
+    const uint64_t t0 = nowNs();
+    storePages(inner_, n, pages, lens, data);
+    store_ns_.fetch_add(nowNs() - t0, std::memory_order_relaxed);
+    page_writes_.fetch_add(n, std::memory_order_relaxed);
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < n; ++i) bytes += lens[i];
+    bytes_written_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+IoSnapshot IoMonitor::snapshot() const {
+    IoSnapshot s;
+    if (storage_) s = storage_->snapshot();
+    if (write_back_) s.write_back_stalls = write_back_->stalls();
+    if (buffer_) {
+        s.buffered = true;
+        s.hits = buffer_->getHits();
+        // Every load the buffer misses goes down, and the buffers cache
+        // updates, so rewrites just below them are write-backs
+        const IoSnapshot edge = boundary_ ? boundary_->snapshot() : s;
+        s.misses = edge.page_reads;
+        s.write_backs = edge.page_writes;
+        if (const PageBuffer* pb = dynamic_cast<const PageBuffer*>(buffer_)) {
+            s.evictions_known = true;
+            s.evictions = pb->evictions();
+        }
+    }
+    return s;
+}
+
+void writeIoCsvHeader(std::ostream& out) {
+    out << ",Hits,Misses,HitRatio,Evictions,WriteBacks,PageReads,PageWrites,PageAllocs,"
+           "BytesRead,BytesWritten,LoadTime_us,StoreTime_us,WriteBackStalls";
+}
+
+void writeIoCsvFields(std::ostream& out, const IoSnapshot& s) {
+    out << "," << s.hits << "," << s.misses << "," << s.hitRatio() << ",";
+    if (s.evictions_known) out << s.evictions;
+    out << "," << s.write_backs << "," << s.page_reads << "," << s.page_writes << ","
+        << s.page_allocs << "," << s.bytes_read << "," << s.bytes_written << ","
+        << s.load_ns / 1000 << "," << s.store_ns / 1000 << "," << s.write_back_stalls;
+}
+
+void printIoSummary(std::ostream& out, const IoSnapshot& s) {
+    out << "  I/O: " << s.page_reads << " page reads, " << (s.page_writes + s.page_allocs)
+        << " page writes (" << s.page_allocs << " new), "
+        << s.bytes_read / (1024 * 1024) << " MB read, " << s.bytes_written / (1024 * 1024) << " MB written, "
+        << s.load_ns / 1000000 << " ms loading, " << s.store_ns / 1000000 << " ms storing\n";
+    if (s.buffered) {
+        out << "  Buffer: " << s.hits << " hits, " << s.misses << " misses ("
+            << 100.0 * s.hitRatio() << "% hit ratio), " << s.write_backs << " write-backs";
+        if (s.evictions_known) out << ", " << s.evictions << " evictions";
+        if (s.write_back_stalls > 0) out << ", " << s.write_back_stalls << " stalls on the dirty limit";
+        out << "\n";
+    }
+}
+
+uint64_t fileBytes(const std::string& path) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    return f.is_open() ? static_cast<uint64_t>(f.tellg()) : 0;
+}
+
+} // namespace SpatialIndex
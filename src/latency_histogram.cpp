@@ -0,0 +1,48 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace SpatialIndex {
+
+LatencyHistogram::LatencyHistogram()
+    : counts_((64 - kSubBits + 2) * (1u << (kSubBits - 1)) + (1u << kSubBits), 0),
+      count_(0), sum_(0), min_(std::numeric_limits<uint64_t>::max()), max_(0) {}
+
+uint64_t LatencyHistogram::bucketHigh(uint32_t idx) {
+    if (idx < (1u << kSubBits)) return idx;
+    const uint32_t half = 1u << (kSubBits - 1);
+    const uint32_t shift = idx / half - 1;
+    const uint64_t top = idx - static_cast<uint64_t>(shift) * half;
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::clear() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    sum_ = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (count_ == 0) return 0;
+    p = std::min(100.0, std::max(0.0, p));
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * count_)));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= rank) return std::min(bucketHigh(i), max_);
+    }
+    return max_;
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,342 @@
+#include "leaf_codec.h"
+#include "latency_histogram.h"
+#include "dims.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace SpatialIndex {
+
+LeafCodec getLeafCodec(const std::string& name) {
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "NONE") return LeafCodec::NONE;
+    if (upper == "Q16") return LeafCodec::Q16;
+    if (upper == "Q32") return LeafCodec::Q32;
+    throw std::invalid_argument("Unknown leaf codec: " + name + " (NONE, Q16 or Q32)");
+}
+
+const char* leafCodecName(LeafCodec codec) {
+    switch (codec) {
+        case LeafCodec::Q16: return "Q16";
+        case LeafCodec::Q32: return "Q32";
+        default: return "NONE";
+    }
+}
+
+namespace {
+
+// Raw leaf: uint32 type, level, child count; per child low[dims], high[dims],
+// id, uint32 data length (and data); then the node MBR
+constexpr size_t kNodeHeaderBytes = 3 * sizeof(uint32_t);
+// Compact leaf: the same three fields, uint8 cell bits, the node MBR, a bitmap
+// of entries stored as two cells per dimension, then per entry (by id) the
+// varint id delta and the cell indexes
+constexpr size_t kCompactHeaderBytes = kNodeHeaderBytes + 1;
+constexpr size_t kIdDeltaBytes = 4;  // Varint of a gap below 2^28
+
+uint32_t cellBits(LeafCodec codec) {
+    return codec == LeafCodec::Q16 ? 16 : 32;
+}
+
+// Cells of one leaf MBR dimension; cell q covers [low(q), high(q)]
+class CellGrid {
+public:
+    CellGrid(double lo, double hi, uint32_t bits)
+        : lo_(lo), hi_(hi), last_((uint64_t(1) << bits) - 1),
+          step_((hi - lo) / (static_cast<double>(last_) + 1.0)) {}
+
+    double low(uint64_t q) const { return q == 0 ? lo_ : lo_ + q * step_; }
+    double high(uint64_t q) const { return q == last_ ? hi_ : lo_ + (q + 1) * step_; }
+
+    // Largest cell with low(q) <= x, for x in [lo, hi]
+    uint64_t lowCell(double x) const {
+        if (!(step_ > 0.0)) return 0;
+        uint64_t q = guess(x);
+        while (q > 0 && low(q) > x) --q;
+        while (q < last_ && low(q + 1) <= x) ++q;
+        return q;
+    }
+
+    // Smallest cell with high(q) >= x, for x in [lo, hi]
+    uint64_t highCell(double x) const {
+        if (!(step_ > 0.0)) return 0;
+        uint64_t q = guess(x);
+        while (q < last_ && high(q) < x) ++q;
+        while (q > 0 && high(q - 1) >= x) --q;
+        return q;
+    }
+
+private:
+    uint64_t guess(double x) const {
+        const double q = std::floor((x - lo_) / step_);
+        if (!(q > 0.0)) return 0;
+        return q >= static_cast<double>(last_) ? last_ : static_cast<uint64_t>(q);
+    }
+
+    double lo_;
+    double hi_;
+    uint64_t last_;
+    double step_;
+};
+
+void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uint8_t b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+template <typename T>
+void put(std::string& out, T v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+} // namespace
+
+uint32_t leafPageCapacity(LeafCodec codec, uint32_t dims, uint32_t page_size) {
+    const size_t box = 2 * dims * sizeof(double);
+    if (codec == LeafCodec::NONE) {
+        const size_t entry = box + sizeof(id_type) + sizeof(uint32_t);
+        return page_size > kNodeHeaderBytes + box ?
+            static_cast<uint32_t>((page_size - kNodeHeaderBytes - box) / entry) : 0;
+    }
+    // Bytes in eighths: one bitmap bit per entry
+    const size_t entry_bits = 8 * (dims * cellBits(codec) / 8 + kIdDeltaBytes) + 1;
+    return page_size > kCompactHeaderBytes + box ?
+        static_cast<uint32_t>(8 * (page_size - kCompactHeaderBytes - box) / entry_bits) : 0;
+}
+
+LeafCodecStorageManager::LeafCodecStorageManager(IStorageManager& inner, LeafCodec codec, uint32_t dims,
+                                                 id_type header_page)
+    : inner_(inner), codec_(codec), dims_(dims), bits_(cellBits(codec)), header_page_(header_page),
+      leaves_encoded_(0), entries_encoded_(0), raw_bytes_(0), encoded_bytes_(0), encode_ns_(0),
+      leaves_decoded_(0), decode_ns_(0) {}
+
+LeafCodecStats LeafCodecStorageManager::stats() const {
+    LeafCodecStats s;
+    s.leaves_encoded = leaves_encoded_.load(std::memory_order_relaxed);
+    s.entries_encoded = entries_encoded_.load(std::memory_order_relaxed);
+    s.raw_bytes = raw_bytes_.load(std::memory_order_relaxed);
+    s.encoded_bytes = encoded_bytes_.load(std::memory_order_relaxed);
+    s.encode_ns = encode_ns_.load(std::memory_order_relaxed);
+    s.leaves_decoded = leaves_decoded_.load(std::memory_order_relaxed);
+    s.decode_ns = decode_ns_.load(std::memory_order_relaxed);
+    return s;
+}
+
+bool LeafCodecStorageManager::encode(const uint8_t* data, uint32_t len, std::string& out) const {
+    const size_t box = 2 * dims_ * sizeof(double);
+    if (len < kNodeHeaderBytes + box) return false;
+    uint32_t type, level, children;
+    std::memcpy(&type, data, sizeof(uint32_t));
+    std::memcpy(&level, data + sizeof(uint32_t), sizeof(uint32_t));
+    std::memcpy(&children, data + 2 * sizeof(uint32_t), sizeof(uint32_t));
+    if (type != 2 || level != 0 || children == 0) return false;
+
+    // Point leaves only: entries without a payload
+    std::vector<std::pair<id_type, size_t>> entries;
+    entries.reserve(children);
+    size_t offset = kNodeHeaderBytes;
+    for (uint32_t c = 0; c < children; ++c) {
+        if (offset + box + sizeof(id_type) + sizeof(uint32_t) > len) return false;
+        id_type id;
+        uint32_t data_len;
+        std::memcpy(&id, data + offset + box, sizeof(id_type));
+        std::memcpy(&data_len, data + offset + box + sizeof(id_type), sizeof(uint32_t));
+        if (data_len != 0) return false;
+        entries.emplace_back(id, offset);
+        offset += box + sizeof(id_type) + sizeof(uint32_t);
+    }
+    if (offset + box != len) return false;
+
+    double mbr[2 * kMaxDims];
+    std::memcpy(mbr, data + offset, box);
+    std::vector<CellGrid> grid;
+    grid.reserve(dims_);
+    for (uint32_t d = 0; d < dims_; ++d) {
+        if (!(mbr[d] <= mbr[dims_ + d]) || !std::isfinite(mbr[d]) || !std::isfinite(mbr[dims_ + d])) return false;
+        grid.emplace_back(mbr[d], mbr[dims_ + d], bits_);
+    }
+    std::sort(entries.begin(), entries.end());
+
+    // Cells of every entry first: the bitmap precedes them
+    std::vector<uint32_t> cells(2 * dims_ * children);
+    std::string bitmap((children + 7) / 8, '\0');
+    for (uint32_t e = 0; e < children; ++e) {
+        double lo[kMaxDims], hi[kMaxDims];
+        std::memcpy(lo, data + entries[e].second, dims_ * sizeof(double));
+        std::memcpy(hi, data + entries[e].second + dims_ * sizeof(double), dims_ * sizeof(double));
+        bool single = true;
+        for (uint32_t d = 0; d < dims_; ++d) {
+            if (!(lo[d] >= mbr[d] && hi[d] <= mbr[dims_ + d] && lo[d] <= hi[d])) return false;
+            const uint64_t low_cell = grid[d].lowCell(lo[d]);
+            const uint64_t high_cell = std::max(low_cell, grid[d].highCell(hi[d]));
+            cells[2 * dims_ * e + d] = static_cast<uint32_t>(low_cell);
+            cells[2 * dims_ * e + dims_ + d] = static_cast<uint32_t>(high_cell);
+            single = single && high_cell == low_cell;
+        }
+        if (!single) bitmap[e / 8] = static_cast<char>(bitmap[e / 8] | (1 << (e % 8)));
+    }
+
+    out.clear();
+    out.reserve(kCompactHeaderBytes + box + bitmap.size() + children * (dims_ * bits_ / 8 + kIdDeltaBytes));
+    put<uint32_t>(out, kCompactLeafType);
+    put<uint32_t>(out, 0);
+    put<uint32_t>(out, children);
+    put<uint8_t>(out, static_cast<uint8_t>(bits_));
+    out.append(reinterpret_cast<const char*>(mbr), box);
+    out.append(bitmap);
+    uint64_t prev = 0;
+    for (uint32_t e = 0; e < children; ++e) {
+        // Sorted ids: every delta after the first is a small non-negative gap
+        const uint64_t id = static_cast<uint64_t>(entries[e].first);
+        putVarint(out, id - prev);
+        prev = id;
+        const bool single = !(bitmap[e / 8] & (1 << (e % 8)));
+        for (uint32_t d = 0; d < (single ? dims_ : 2 * dims_); ++d) {
+            const uint32_t cell = cells[2 * dims_ * e + d];
+            if (bits_ == 16) {
+                put<uint16_t>(out, static_cast<uint16_t>(cell));
+            } else {
+                put<uint32_t>(out, cell);
+            }
+        }
+    }
+    return true;
+}
+
+void LeafCodecStorageManager::decode(const uint8_t* data, uint32_t len, uint32_t& raw_len, uint8_t** raw) const {
+    const size_t box = 2 * dims_ * sizeof(double);
+    uint32_t children;
+    std::memcpy(&children, data + 2 * sizeof(uint32_t), sizeof(uint32_t));
+    const uint32_t bits = data[kNodeHeaderBytes];
+    const size_t cell_bytes = bits / 8;
+    const uint8_t* mbr_bytes = data + kCompactHeaderBytes;
+    const uint8_t* bitmap = mbr_bytes + box;
+    if (len < kCompactHeaderBytes + box + (children + 7) / 8 || (bits != 16 && bits != 32)) {
+        throw std::runtime_error("LeafCodecStorageManager: corrupt compact leaf page.");
+    }
+
+    double mbr[2 * kMaxDims];
+    std::memcpy(mbr, mbr_bytes, box);
+    std::vector<CellGrid> grid;
+    grid.reserve(dims_);
+    for (uint32_t d = 0; d < dims_; ++d) grid.emplace_back(mbr[d], mbr[dims_ + d], bits);
+
+    const size_t entry = box + sizeof(id_type) + sizeof(uint32_t);
+    raw_len = static_cast<uint32_t>(kNodeHeaderBytes + children * entry + box);
+    uint8_t* out = new uint8_t[raw_len];
+    const uint32_t type = 2, level = 0, data_len = 0;
+    std::memcpy(out, &type, sizeof(uint32_t));
+    std::memcpy(out + sizeof(uint32_t), &level, sizeof(uint32_t));
+    std::memcpy(out + 2 * sizeof(uint32_t), &children, sizeof(uint32_t));
+
+    const uint8_t* p = bitmap + (children + 7) / 8;
+    const uint8_t* end = data + len;
+    uint8_t* o = out + kNodeHeaderBytes;
+    uint64_t id = 0;
+    for (uint32_t e = 0; e < children; ++e) {
+        const bool single = !(bitmap[e / 8] & (1 << (e % 8)));
+        uint64_t delta;
+        if (!getVarint(p, end, delta) || p + (single ? 1 : 2) * dims_ * cell_bytes > end) {
+            delete[] out;
+            throw std::runtime_error("LeafCodecStorageManager: truncated compact leaf page.");
+        }
+        id += delta;
+        uint32_t cells[2 * kMaxDims];
+        for (uint32_t d = 0; d < (single ? dims_ : 2 * dims_); ++d) {
+            if (bits == 16) {
+                uint16_t c;
+                std::memcpy(&c, p, sizeof(c));
+                cells[d] = c;
+            } else {
+                std::memcpy(&cells[d], p, sizeof(uint32_t));
+            }
+            p += cell_bytes;
+        }
+        double lo[kMaxDims], hi[kMaxDims];
+        for (uint32_t d = 0; d < dims_; ++d) {
+            lo[d] = grid[d].low(cells[d]);
+            hi[d] = grid[d].high(single ? cells[d] : cells[dims_ + d]);
+        }
+        const id_type signed_id = static_cast<id_type>(id);
+        std::memcpy(o, lo, dims_ * sizeof(double));
+        std::memcpy(o + dims_ * sizeof(double), hi, dims_ * sizeof(double));
+        std::memcpy(o + box, &signed_id, sizeof(id_type));
+        std::memcpy(o + box + sizeof(id_type), &data_len, sizeof(uint32_t));
+        o += entry;
+    }
+    std::memcpy(o, mbr, box);
+    *raw = out;
+}
+
+void LeafCodecStorageManager::loadByteArray(const id_type page, uint32_t& len, uint8_t** data) {
+    inner_.loadByteArray(page, len, data);
+    if (page == header_page_ || len < kCompactHeaderBytes) return;
+    uint32_t type;
+    std::memcpy(&type, *data, sizeof(uint32_t));
+    if (type != kCompactLeafType) return;
+
+    const uint64_t t0 = nowNs();
+    uint8_t* raw = nullptr;
+    uint32_t raw_len = 0;
+    try {
+        decode(*data, len, raw_len, &raw);
+    } catch (...) {
+        delete[] *data;
+        *data = nullptr;
+        throw;
+    }
+    delete[] *data;
+    *data = raw;
+    len = raw_len;
+    leaves_decoded_.fetch_add(1, std::memory_order_relaxed);
+    decode_ns_.fetch_add(nowNs() - t0, std::memory_order_relaxed);
+}
+
+void LeafCodecStorageManager::storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) {
+    if (codec_ == LeafCodec::NONE || (page != StorageManager::NewPage && page == header_page_)) {
+        inner_.storeByteArray(page, len, data);
+        return;
+    }
+    const uint64_t t0 = nowNs();
+    std::string compact;
+    if (!encode(data, len, compact)) {
+        inner_.storeByteArray(page, len, data);
+        return;
+    }
+    uint32_t children;
+    std::memcpy(&children, data + 2 * sizeof(uint32_t), sizeof(uint32_t));
+    leaves_encoded_.fetch_add(1, std::memory_order_relaxed);
+    entries_encoded_.fetch_add(children, std::memory_order_relaxed);
+    raw_bytes_.fetch_add(len, std::memory_order_relaxed);
+    encoded_bytes_.fetch_add(compact.size(), std::memory_order_relaxed);
+    encode_ns_.fetch_add(nowNs() - t0, std::memory_order_relaxed);
+    inner_.storeByteArray(page, static_cast<uint32_t>(compact.size()),
+                          reinterpret_cast<const uint8_t*>(compact.data()));
+}
+
+void LeafCodecStorageManager::deleteByteArray(const id_type page) {
+    inner_.deleteByteArray(page);
+}
+
+void LeafCodecStorageManager::flush() {
+    inner_.flush();
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,149 @@
+#include "leaf_directory.h"
+#include <algorithm>
+#include <cstring>
+
+namespace SpatialIndex {
+
+LeafDirectory::LeafDirectory(IStorageManager& inner, uint32_t dims)
+    : inner_(inner), dims_(dims), header_page_(StorageManager::NewPage) {}
+
+void LeafDirectory::attach(id_type header_page) {
+    header_page_ = header_page;
+}
+
+bool LeafDirectory::parse(const uint8_t* data, uint32_t len, NodePage& out) const {
+    const size_t box = 2 * dims_ * sizeof(double);
+    if (len < 3 * sizeof(uint32_t) + box) return false;
+    uint32_t type, level, children;
+    std::memcpy(&type, data, sizeof(uint32_t));
+    std::memcpy(&level, data + sizeof(uint32_t), sizeof(uint32_t));
+    std::memcpy(&children, data + 2 * sizeof(uint32_t), sizeof(uint32_t));
+    // PersistentIndex = 1 (level > 0), PersistentLeaf = 2 (level 0)
+    if (!((type == 2 && level == 0) || (type == 1 && level > 0))) return false;
+
+    out.level = level;
+    out.entries.clear();
+    size_t offset = 3 * sizeof(uint32_t);
+    for (uint32_t c = 0; c < children; ++c) {
+        if (offset + box + sizeof(id_type) + sizeof(uint32_t) > len) return false;
+        out.entries.push_back(offset);
+        uint32_t data_len;
+        std::memcpy(&data_len, data + offset + box + sizeof(id_type), sizeof(uint32_t));
+        offset += box + sizeof(id_type) + sizeof(uint32_t) + data_len;
+    }
+    out.mbr = offset;
+    return offset + box == len;
+}
+
+bool LeafDirectory::load(id_type page, NodePage& out) {
+    uint8_t* data = nullptr;
+    uint32_t len = 0;
+    try {
+        inner_.loadByteArray(page, len, &data);
+    } catch (InvalidPageException&) {
+        return false;
+    }
+    out.data.reset(data);
+    out.len = len;
+    return parse(data, len, out);
+}
+
+id_type LeafDirectory::entryId(const NodePage& node, size_t e) const {
+    id_type id;
+    std::memcpy(&id, node.data.get() + node.entries[e] + 2 * dims_ * sizeof(double), sizeof(id_type));
+    return id;
+}
+
+void LeafDirectory::record(id_type page, const uint8_t* data, uint32_t len) {
+    NodePage node;
+    if (!parse(data, len, node)) return;
+    auto& owner = node.level == 0 ? leaf_of_ : parent_of_;
+    for (size_t e = 0; e < node.entries.size(); ++e) {
+        id_type id;
+        std::memcpy(&id, data + node.entries[e] + 2 * dims_ * sizeof(double), sizeof(id_type));
+        owner[id] = page;
+    }
+}
+
+MoveResult LeafDirectory::movePoint(id_type id, const double* from, const double* to) {
+    const auto it = leaf_of_.find(id);
+    if (it == leaf_of_.end()) return MoveResult::MISSED;
+    id_type leaf_page = it->second;
+
+    NodePage leaf;
+    if (!load(leaf_page, leaf) || leaf.level != 0) return MoveResult::MISSED;
+    const size_t point_bytes = dims_ * sizeof(double);
+    size_t entry = leaf.entries.size();
+    for (size_t e = 0; e < leaf.entries.size(); ++e) {
+        if (entryId(leaf, e) != id) continue;
+        const uint8_t* low = leaf.data.get() + leaf.entries[e];
+        if (std::memcmp(low, from, point_bytes) == 0 && std::memcmp(low + point_bytes, from, point_bytes) == 0) {
+            entry = e;
+            break;
+        }
+    }
+    if (entry == leaf.entries.size()) return MoveResult::MISSED;
+
+    std::vector<double> mbr(2 * dims_);
+    std::memcpy(mbr.data(), leaf.data.get() + leaf.mbr, 2 * point_bytes);
+    bool inside = true;
+    for (uint32_t d = 0; d < dims_; ++d) inside = inside && to[d] >= mbr[d] && to[d] <= mbr[dims_ + d];
+
+    uint8_t* point = leaf.data.get() + leaf.entries[entry];
+    if (inside) {
+        std::memcpy(point, to, point_bytes);
+        std::memcpy(point + point_bytes, to, point_bytes);
+        inner_.storeByteArray(leaf_page, leaf.len, leaf.data.get());
+        return MoveResult::IN_LEAF;
+    }
+
+    // Grow the leaf, as long as its parent still covers the new position
+    const auto pit = parent_of_.find(leaf_page);
+    if (pit == parent_of_.end()) return MoveResult::MISSED;
+    id_type parent_page = pit->second;
+    NodePage parent;
+    if (!load(parent_page, parent) || parent.level != 1) return MoveResult::MISSED;
+    size_t child = parent.entries.size();
+    for (size_t e = 0; e < parent.entries.size(); ++e) {
+        if (entryId(parent, e) == leaf_page) {
+            child = e;
+            break;
+        }
+    }
+    if (child == parent.entries.size()) return MoveResult::MISSED;
+    std::vector<double> cover(2 * dims_);
+    std::memcpy(cover.data(), parent.data.get() + parent.mbr, 2 * point_bytes);
+    for (uint32_t d = 0; d < dims_; ++d) {
+        if (to[d] < cover[d] || to[d] > cover[dims_ + d]) return MoveResult::MISSED;
+        mbr[d] = std::min(mbr[d], to[d]);
+        mbr[dims_ + d] = std::max(mbr[dims_ + d], to[d]);
+    }
+
+    std::memcpy(point, to, point_bytes);
+    std::memcpy(point + point_bytes, to, point_bytes);
+    std::memcpy(leaf.data.get() + leaf.mbr, mbr.data(), 2 * point_bytes);
+    std::memcpy(parent.data.get() + parent.entries[child], mbr.data(), 2 * point_bytes);
+    inner_.storeByteArray(leaf_page, leaf.len, leaf.data.get());
+    inner_.storeByteArray(parent_page, parent.len, parent.data.get());
+    return MoveResult::ENLARGED;
+}
+
+void LeafDirectory::loadByteArray(const id_type page, uint32_t& len, uint8_t** data) {
+    inner_.loadByteArray(page, len, data);
+}
+
+void LeafDirectory::storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) {
+    inner_.storeByteArray(page, len, data);
+    if (page != header_page_) record(page, data, len);
+}
+
+void LeafDirectory::deleteByteArray(const id_type page) {
+    inner_.deleteByteArray(page);
+    parent_of_.erase(page);
+}
+
+void LeafDirectory::flush() {
+    inner_.flush();
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,75 @@
+#include "locked_index.h"
+
+namespace SpatialIndex {
+
+void LockedIndex::insertData(uint32_t len, const uint8_t* pData, const IShape& shape, id_type shapeIdentifier) {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.insertData(len, pData, shape, shapeIdentifier);
+}
+
+bool LockedIndex::deleteData(const IShape& shape, id_type shapeIdentifier) {
+    std::lock_guard<std::mutex> guard(lock_);
+    return tree_.deleteData(shape, shapeIdentifier);
+}
+
+void LockedIndex::containsWhatQuery(const IShape& query, IVisitor& v) {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.containsWhatQuery(query, v);
+}
+
+void LockedIndex::intersectsWithQuery(const IShape& query, IVisitor& v) {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.intersectsWithQuery(query, v);
+}
+
+void LockedIndex::pointLocationQuery(const Point& query, IVisitor& v) {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.pointLocationQuery(query, v);
+}
+
+void LockedIndex::nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc) {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.nearestNeighborQuery(k, query, v, nnc);
+}
+
+void LockedIndex::nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v) {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.nearestNeighborQuery(k, query, v);
+}
+
+void LockedIndex::selfJoinQuery(const IShape& s, IVisitor& v) {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.selfJoinQuery(s, v);
+}
+
+void LockedIndex::queryStrategy(IQueryStrategy& qs) {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.queryStrategy(qs);
+}
+
+void LockedIndex::getIndexProperties(Tools::PropertySet& out) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.getIndexProperties(out);
+}
+
+void LockedIndex::addCommand(ICommand* in, CommandType ct) {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.addCommand(in, ct);
+}
+
+bool LockedIndex::isIndexValid() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return tree_.isIndexValid();
+}
+
+void LockedIndex::getStatistics(IStatistics** out) const {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.getStatistics(out);
+}
+
+void LockedIndex::flush() {
+    std::lock_guard<std::mutex> guard(lock_);
+    tree_.flush();
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,162 @@
+#include "lsm_benchmark.h"
+#include "query_runner.h"
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace SpatialIndex {
+
+void runLsmBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    const LsmOptions& options,
+    int num_insertions,
+    int num_queries,
+    const std::string& output_csv
+) {
+    std::ostream& log = *config.log;
+    std::ofstream f(output_csv);
+    if (!f.is_open()) {
+        log << "Error: Could not open output file: " << output_csv << std::endl;
+        return;
+    }
+
+    // Materialise the insert stream once so generation stays out of the timed ingest
+    gen.reset();
+    const size_t n = static_cast<size_t>(std::max(0, num_insertions));
+    std::vector<double> points(2 * n);
+    double low[2] = {0.0, 0.0}, high[2] = {0.0, 0.0};
+    for (size_t i = 0; i < n; ++i) {
+        gen.generateNextPoint(&points[2 * i]);
+        for (int d = 0; d < 2; ++d) {
+            low[d] = i == 0 ? points[2 * i + d] : std::min(low[d], points[2 * i + d]);
+            high[d] = i == 0 ? points[2 * i + d] : std::max(high[d], points[2 * i + d]);
+        }
+    }
+
+    log << "Starting LSM benchmark: " << n << " insertions (" << gen.getDataType()
+        << " data), memtable " << options.memtable_items << ", fanout " << options.fanout
+        << (options.background ? ", background" : ", inline") << " compaction -> "
+        << output_csv << std::endl;
+
+    f << "Engine,Points,InsertTime_ms,InsertsPerSec,AvgInsert_us,P99Insert_us,MaxInsert_us,"
+         "SettleTime_ms,Runs,Flushes,Compactions,InsertStalls,BytesWritten_MB,WriteAmp,"
+         "RangeQueries,AvgRange_us,P99Range_us,KnnQueries,AvgKnn_us,P99Knn_us,AvgComponents\n";
+
+    // Queries only; an insert-only mix falls back to half window, half kNN
+    const WorkloadMix& mix = gen.getMix();
+    double range_w = mix.range_ratio;
+    double knn_w = mix.knn_ratio;
+    if (range_w <= 0.0 && knn_w <= 0.0) range_w = knn_w = 1.0;
+    const double side_frac = std::sqrt(std::max(0.0, mix.range_selectivity));
+    const double raw_bytes = static_cast<double>(n) * (2 * sizeof(double) + sizeof(id_type));
+
+    // Ingest, settle, then query one engine; `describe` supplies the engine's counters
+    auto measure = [&](const char* engine, ISpatialIndex& index, auto settle, auto describe) {
+        LatencyHistogram insert_latency;
+        const uint64_t t0 = nowNs();
+        for (size_t i = 0; i < n; ++i) {
+            Point p(&points[2 * i], 2);
+            const uint64_t s = nowNs();
+            index.insertData(0, nullptr, p, static_cast<id_type>(i));
+            insert_latency.record(nowNs() - s);
+        }
+        const uint64_t ingest_ns = nowNs() - t0;
+        const uint64_t settle_t0 = nowNs();
+        settle();
+        const uint64_t settle_ns = nowNs() - settle_t0;
+
+        // Identical query sequence for every engine
+        std::mt19937 qgen(0x5bd1e995u);
+        std::uniform_real_distribution<double> pick(0.0, range_w + knn_w);
+        LatencyHistogram latency[3];
+        uint64_t probed = 0;
+        for (int q = 0; q < num_queries && n > 0; ++q) {
+            Operation op;
+            op.type = pick(qgen) < range_w ? OpType::RANGE_QUERY : OpType::KNN_QUERY;
+            op.id = 0;
+            for (int d = 0; d < 2; ++d) {
+                op.coords[d] = std::uniform_real_distribution<double>(low[d], high[d])(qgen);
+                op.half_extent[d] = 0.5 * side_frac * (high[d] - low[d]);
+            }
+            const uint64_t probed_before = describe.probed();
+            const QueryResult qr = runQuery(&index, op, mix.knn_k);
+            latency[static_cast<int>(op.type)].record(qr.time_ns);
+            probed += describe.probed() - probed_before;
+        }
+
+        const LatencyHistogram& rl = latency[static_cast<int>(OpType::RANGE_QUERY)];
+        const LatencyHistogram& kl = latency[static_cast<int>(OpType::KNN_QUERY)];
+        const uint64_t queries = rl.count() + kl.count();
+        const double ingest_s = ingest_ns / 1e9;
+        const double inserts_per_s = ingest_s > 0.0 ? n / ingest_s : 0.0;
+        const uint64_t bytes = describe.bytesWritten();
+
+        f << engine << "," << n << "," << ingest_ns / 1e6 << "," << inserts_per_s << ","
+          << insert_latency.mean() / 1000.0 << "," << insert_latency.percentile(99.0) / 1000.0 << ","
+          << insert_latency.max() / 1000.0 << "," << settle_ns / 1e6 << ","
+          << describe.runs() << "," << describe.flushes() << "," << describe.compactions() << ","
+          << describe.stalls() << "," << bytes / (1024.0 * 1024.0) << ","
+          << (raw_bytes > 0.0 ? bytes / raw_bytes : 0.0) << ","
+          << rl.count() << "," << rl.mean() / 1000.0 << "," << rl.percentile(99.0) / 1000.0 << ","
+          << kl.count() << "," << kl.mean() / 1000.0 << "," << kl.percentile(99.0) / 1000.0 << ","
+          << (describe.single() ? 1.0 : queries ? static_cast<double>(probed) / queries : 0.0) << "\n";
+
+        log << "  " << engine << ": " << static_cast<uint64_t>(inserts_per_s) << " inserts/s (p99 "
+            << insert_latency.percentile(99.0) / 1000.0 << " us), settled in " << settle_ns / 1e6
+            << " ms, write amp " << (raw_bytes > 0.0 ? bytes / raw_bytes : 0.0) << ", range avg "
+            << rl.mean() / 1000.0 << " us, kNN avg " << kl.mean() / 1000.0 << " us" << std::endl;
+    };
+
+    // What a single tree reports: one component, no flushes or merges
+    struct TreeDescription {
+        const TreeResources& resources;
+        bool single() const { return true; }
+        uint64_t probed() const { return 0; }
+        uint64_t runs() const { return 1; }
+        uint64_t flushes() const { return 0; }
+        uint64_t compactions() const { return 0; }
+        uint64_t stalls() const { return 0; }
+        uint64_t bytesWritten() const { return ioMonitor(resources).snapshot().bytes_written; }
+    };
+    struct LsmDescription {
+        const LsmIndex& lsm;
+        bool single() const { return false; }
+        uint64_t probed() const { return lsm.componentsProbed(); }
+        uint64_t runs() const { return lsm.runCount(); }
+        uint64_t flushes() const { return lsm.flushes(); }
+        uint64_t compactions() const { return lsm.compactions(); }
+        uint64_t stalls() const { return lsm.insertStalls(); }
+        uint64_t bytesWritten() const { return lsm.bytesWritten(); }
+    };
+
+    const RTree::RTreeVariant baselines[2] = {RTree::RV_LINEAR, RTree::RV_RSTAR};
+    const char* baseline_names[2] = {"LINEAR", "RSTAR"};
+    for (int b = 0; b < 2; ++b) {
+        TreeConfig tree_config = config;
+        tree_config.tree_variant = baselines[b];
+        tree_config.build_mode = "INCREMENTAL";
+        TreeResources resources = setupTree(tree_config);
+        measure(baseline_names[b], *resources.tree, [&] { resources.tree->flush(); },
+                TreeDescription{resources});
+        cleanupTree(resources);
+    }
+
+    {
+        LsmIndex lsm(config, options);
+        measure("LSM", lsm, [&] { lsm.drain(); }, LsmDescription{lsm});
+        if (lsm.insertStalls() > 0) {
+            log << "    " << lsm.insertStalls() << " insert stalls waiting for flushes ("
+                << lsm.stallNs() / 1e6 << " ms)" << std::endl;
+        }
+    }
+
+    f.close();
+    log << "LSM benchmark finished for " << output_csv << "." << std::endl;
+}
+
+} // namespace SpatialIndex
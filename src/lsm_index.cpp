@@ -0,0 +1,632 @@
+#include "lsm_index.h"
+#include "bulk_load.h"
+#include "query_runner.h"
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace SpatialIndex {
+
+namespace {
+
+// Sum of the per-component tree statistics
+class LsmStatistics : public IStatistics {
+public:
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint32_t nodes = 0;
+    uint64_t data = 0;
+
+    uint64_t getReads() const override { return reads; }
+    uint64_t getWrites() const override { return writes; }
+    uint32_t getNumberOfNodes() const override { return nodes; }
+    uint64_t getNumberOfData() const override { return data; }
+};
+
+// Bulk load input over points gathered for a flush or merge
+template <typename Entry>
+class EntrySource : public PointSource {
+public:
+    explicit EntrySource(const std::vector<Entry>& points) : points_(points), pos_(0) {}
+
+    bool next(double coords[2], id_type& id) override {
+        if (pos_ == points_.size()) return false;
+        const Entry& e = points_[pos_++];
+        coords[0] = e.coords[0];
+        coords[1] = e.coords[1];
+        id = e.id;
+        return true;
+    }
+    void rewind() override { pos_ = 0; }
+
+private:
+    const std::vector<Entry>& points_;
+    size_t pos_;
+};
+
+// Centre of a data entry (the point itself for point data)
+void entryCoords(const IData& d, double coords[2]) {
+    IShape* shape = nullptr;
+    d.getShape(&shape);
+    Point centre;
+    shape->getCenter(centre);
+    delete shape;
+    coords[0] = centre.m_pCoords[0];
+    coords[1] = centre.m_pCoords[1];
+}
+
+std::string upper(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::toupper);
+    return s;
+}
+
+// Hides as many copies of each point as it has tombstones, forwards the rest
+// (templated on LsmIndex's private key type)
+template <typename Key>
+class TombstoneFilter : public IVisitor {
+public:
+    TombstoneFilter(const std::map<Key, uint32_t>& tombstones, IVisitor& forward)
+        : tombstones_(tombstones), forward_(forward) {}
+
+    // True if the caller should drop this copy
+    bool hide(id_type id, const double coords[2]) {
+        if (tombstones_.empty()) return false;
+        const Key key{id, coords[0], coords[1]};
+        auto it = tombstones_.find(key);
+        if (it == tombstones_.end()) return false;
+        uint32_t& hidden = hidden_[key];
+        if (hidden >= it->second) return false;
+        ++hidden;
+        return true;
+    }
+
+    void visitNode(const INode& n) override { forward_.visitNode(n); }
+    void visitData(const IData& d) override {
+        if (!tombstones_.empty()) {
+            double coords[2];
+            entryCoords(d, coords);
+            if (hide(d.getIdentifier(), coords)) return;
+        }
+        forward_.visitData(d);
+    }
+    void visitData(std::vector<const IData*>& v) override {
+        for (const IData* d : v) visitData(*d);
+    }
+
+private:
+    const std::map<Key, uint32_t>& tombstones_;
+    IVisitor& forward_;
+    std::map<Key, uint32_t> hidden_;
+};
+
+// Counts the stored copies of one point
+template <typename Key>
+class CopyCounter : public IVisitor {
+public:
+    explicit CopyCounter(const Key& key) : key_(key) {}
+
+    uint64_t copies = 0;
+
+    void visitNode(const INode&) override {}
+    void visitData(const IData& d) override {
+        if (d.getIdentifier() != key_.id) return;
+        double coords[2];
+        entryCoords(d, coords);
+        if (coords[0] == key_.x && coords[1] == key_.y) ++copies;
+    }
+    void visitData(std::vector<const IData*>& v) override {
+        for (const IData* d : v) visitData(*d);
+    }
+
+private:
+    Key key_;
+};
+
+} // namespace
+
+LsmIndex::Component::~Component() {
+    cleanupTree(resources);
+    if (!base_name.empty()) {
+        std::remove((base_name + ".dat").c_str());
+        std::remove((base_name + ".idx").c_str());
+        std::remove((base_name + ".pts").c_str());
+    }
+}
+
+bool LsmIndex::Component::mayMatch(const IShape& query) const {
+    if (count == 0) return false;
+    Region mbr(low, high, 2);
+    return query.intersectsShape(mbr);
+}
+
+LsmIndex::LsmIndex(const TreeConfig& config, const LsmOptions& options)
+    : config_(config), options_(options), tombstone_total_(0), stop_(false),
+      next_run_(0), insert_stalls_(0), stall_ns_(0), flushes_(0), compactions_(0),
+      points_written_(0), bytes_written_(0), components_probed_(0) {
+    if (config_.dims != 2) {
+        throw std::invalid_argument("LsmIndex: runs are bulk loaded, which supports 2-D points only.");
+    }
+    options_.memtable_items = std::max<size_t>(1, options_.memtable_items);
+    options_.fanout = std::max<uint32_t>(2, options_.fanout);
+    options_.max_immutable = std::max<uint32_t>(1, options_.max_immutable);
+    base_name_ = (config.disk_base_name.empty() ? "disk_tree_data" : config.disk_base_name) + "_lsm";
+
+    memtable_ = newMemtable();
+    if (options_.background) worker_ = std::thread(&LsmIndex::workerLoop, this);
+}
+
+LsmIndex::~LsmIndex() {
+    {
+        std::unique_lock<std::shared_mutex> lock(state_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+std::unique_ptr<LsmIndex::Component> LsmIndex::newMemtable() const {
+    TreeConfig mem_config = config_;
+    mem_config.run_type = "mem";
+    mem_config.storage = upper(config_.storage) == "ARENA" ? "ARENA" : "DEFAULT";
+    mem_config.build_mode = "INCREMENTAL";
+    mem_config.quiet = true;
+
+    std::unique_ptr<Component> c(new Component());
+    c->resources = setupTree(mem_config);
+    c->points.reserve(options_.memtable_items);
+    return c;
+}
+
+void LsmIndex::extend(Component& c, const double coords[2]) const {
+    for (int d = 0; d < 2; ++d) {
+        c.low[d] = c.count == 0 ? coords[d] : std::min(c.low[d], coords[d]);
+        c.high[d] = c.count == 0 ? coords[d] : std::max(c.high[d], coords[d]);
+    }
+    ++c.count;
+}
+
+size_t LsmIndex::runCount() const {
+    std::shared_lock<std::shared_mutex> lock(state_);
+    return runs_.size();
+}
+
+uint64_t LsmIndex::tombstoneCount() const {
+    std::shared_lock<std::shared_mutex> lock(state_);
+    return tombstone_total_;
+}
+
+void LsmIndex::rethrowWorkerError() {
+    std::exception_ptr error;
+    {
+        std::shared_lock<std::shared_mutex> lock(state_);
+        error = worker_error_;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void LsmIndex::freeze() {
+    std::unique_ptr<Component> fresh = newMemtable();
+    {
+        std::unique_lock<std::shared_mutex> lock(state_);
+        if (options_.background && immutable_.size() >= options_.max_immutable && !worker_error_) {
+            // The flusher is behind: wait instead of letting frozen memtables pile up
+            ++insert_stalls_;
+            const uint64_t t0 = nowNs();
+            done_cv_.wait(lock, [this] {
+                return immutable_.size() < options_.max_immutable || worker_error_;
+            });
+            stall_ns_ += nowNs() - t0;
+        }
+        immutable_.push_back(std::move(memtable_));
+        memtable_ = std::move(fresh);
+    }
+    rethrowWorkerError();
+    if (options_.background) {
+        work_cv_.notify_one();
+    } else {
+        while (doWork()) {}
+    }
+}
+
+bool LsmIndex::pendingWork() const {
+    if (!immutable_.empty()) return true;
+    std::map<uint32_t, uint32_t> per_tier;
+    for (const auto& r : runs_) {
+        if (++per_tier[r->tier] >= options_.fanout) return true;
+    }
+    return false;
+}
+
+void LsmIndex::workerLoop() {
+    for (;;) {
+        {
+            std::unique_lock<std::shared_mutex> lock(state_);
+            work_cv_.wait(lock, [this] { return stop_ || pendingWork(); });
+            if (stop_) return;
+        }
+        try {
+            doWork();
+        } catch (...) {
+            {
+                std::unique_lock<std::shared_mutex> lock(state_);
+                worker_error_ = std::current_exception();
+            }
+            done_cv_.notify_all();
+            return;
+        }
+    }
+}
+
+void LsmIndex::drain() {
+    if (options_.background) {
+        std::unique_lock<std::shared_mutex> lock(state_);
+        done_cv_.wait(lock, [this] { return !pendingWork() || worker_error_; });
+    }
+    rethrowWorkerError();
+}
+
+void LsmIndex::readPoints(const Component& c, TombstoneMap& drop, TombstoneMap& dropped,
+                          std::vector<Entry>& out) const {
+    TombstoneMap removed = c.removed;
+    auto take = [&](const Entry& e) {
+        const Key key{e.id, e.coords[0], e.coords[1]};
+        if (!removed.empty()) {
+            auto it = removed.find(key);
+            if (it != removed.end() && it->second > 0) {
+                --it->second;
+                return;
+            }
+        }
+        if (!drop.empty()) {
+            auto it = drop.find(key);
+            if (it != drop.end() && it->second > 0) {
+                --it->second;
+                ++dropped[key];
+                return;
+            }
+        }
+        out.push_back(e);
+    };
+
+    if (c.base_name.empty()) {
+        for (const Entry& e : c.points) take(e);
+        return;
+    }
+    const std::string path = c.base_name + ".pts";
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) throw std::runtime_error("LsmIndex: cannot read " + path);
+    std::vector<Entry> chunk(4096);
+    while (in) {
+        in.read(reinterpret_cast<char*>(chunk.data()), chunk.size() * sizeof(Entry));
+        const size_t n = static_cast<size_t>(in.gcount()) / sizeof(Entry);
+        for (size_t i = 0; i < n; ++i) take(chunk[i]);
+    }
+}
+
+std::unique_ptr<LsmIndex::Component> LsmIndex::buildRun(std::vector<Entry>& points, uint32_t tier) {
+    std::unique_ptr<Component> run(new Component());
+    run->memtable = false;
+    run->tier = tier;
+    for (const Entry& e : points) extend(*run, e.coords);
+
+    TreeConfig run_config = config_;
+    run_config.build_mode = upper(config_.build_mode) == "HILBERT" ? "HILBERT" : "STR";
+    run_config.quiet = true;
+    if (run_config.buffer_pages > 0) {
+        run_config.buffer_pages = std::max<int>(1, config_.buffer_pages / static_cast<int>(options_.fanout));
+    }
+    const bool disk = upper(config_.run_type) == "DISK";
+    if (disk) {
+        run->base_name = base_name_ + std::to_string(next_run_++);
+        run_config.disk_base_name = run->base_name;
+    }
+
+    EntrySource<Entry> source(points);
+    run->resources = setupTree(run_config, source);
+    run->resources.tree->flush();
+    uint64_t bytes = run->resources.io_stats->snapshot().bytes_written;
+
+    if (disk) {
+        const std::string path = run->base_name + ".pts";
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(Entry));
+        if (!out) throw std::runtime_error("LsmIndex: cannot write " + path);
+        bytes += points.size() * sizeof(Entry);
+    } else {
+        run->points = std::move(points);
+    }
+    points_written_.fetch_add(run->count, std::memory_order_relaxed);
+    bytes_written_.fetch_add(bytes, std::memory_order_relaxed);
+    return run;
+}
+
+bool LsmIndex::doWork() {
+    // Pick the oldest frozen memtable, else the lowest full tier
+    std::vector<Component*> inputs;
+    uint32_t tier = 0;
+    bool is_flush = false;
+    TombstoneMap drop;
+    {
+        std::shared_lock<std::shared_mutex> lock(state_);
+        if (!immutable_.empty()) {
+            inputs.push_back(immutable_.front().get());
+            is_flush = true;
+        } else {
+            std::map<uint32_t, std::vector<Component*>> tiers;
+            for (const auto& r : runs_) tiers[r->tier].push_back(r.get());
+            for (const auto& t : tiers) {
+                if (t.second.size() < options_.fanout) continue;
+                inputs.assign(t.second.begin(), t.second.begin() + options_.fanout);
+                tier = t.first + 1;
+                break;
+            }
+        }
+        if (inputs.empty()) return false;
+        drop = tombstones_;
+    }
+
+    // Inputs are immutable and only this thread retires them, so no lock while rewriting
+    std::vector<Entry> points;
+    TombstoneMap dropped;
+    for (Component* c : inputs) readPoints(*c, drop, dropped, points);
+    std::unique_ptr<Component> run;
+    if (!points.empty()) run = buildRun(points, tier);
+
+    std::vector<std::unique_ptr<Component>> retired;
+    {
+        std::unique_lock<std::shared_mutex> lock(state_);
+        auto& list = is_flush ? immutable_ : runs_;
+        for (auto it = list.begin(); it != list.end();) {
+            if (std::find(inputs.begin(), inputs.end(), it->get()) != inputs.end()) {
+                retired.push_back(std::move(*it));
+                it = list.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (run) runs_.push_back(std::move(run));
+        for (const auto& d : dropped) {
+            auto it = tombstones_.find(d.first);
+            it->second -= d.second;
+            tombstone_total_ -= d.second;
+            if (it->second == 0) tombstones_.erase(it);
+        }
+    }
+    (is_flush ? flushes_ : compactions_).fetch_add(1, std::memory_order_relaxed);
+    done_cv_.notify_all();
+    return true;
+}
+
+template <typename Fn>
+void LsmIndex::forEachComponent(const IShape& query, Fn fn) {
+    auto visit = [&](Component& c) {
+        if (!c.mayMatch(query)) return;
+        components_probed_.fetch_add(1, std::memory_order_relaxed);
+        fn(c);
+    };
+    visit(*memtable_);
+    for (auto& c : immutable_) visit(*c);
+    for (auto& c : runs_) visit(*c);
+}
+
+void LsmIndex::insertData(uint32_t, const uint8_t*, const IShape& shape, id_type shapeIdentifier) {
+    Region mbr;
+    shape.getMBR(mbr);
+    if (mbr.m_dimension != 2 || mbr.m_pLow[0] != mbr.m_pHigh[0] || mbr.m_pLow[1] != mbr.m_pHigh[1]) {
+        throw std::invalid_argument("LsmIndex: only 2-D points can be inserted.");
+    }
+    Entry e;
+    e.coords[0] = mbr.m_pLow[0];
+    e.coords[1] = mbr.m_pLow[1];
+    e.id = shapeIdentifier;
+
+    memtable_->resources.tree->insertData(0, nullptr, shape, shapeIdentifier);
+    memtable_->points.push_back(e);
+    extend(*memtable_, e.coords);
+    if (memtable_->points.size() >= options_.memtable_items) freeze();
+}
+
+bool LsmIndex::deleteData(const IShape& shape, id_type shapeIdentifier) {
+    Region mbr;
+    shape.getMBR(mbr);
+    if (mbr.m_dimension != 2) return false;
+    const Key key{shapeIdentifier, mbr.m_pLow[0], mbr.m_pLow[1]};
+
+    // Still in the memtable: delete in place, the flush skips it
+    if (memtable_->resources.tree->deleteData(shape, shapeIdentifier)) {
+        ++memtable_->removed[key];
+        return true;
+    }
+
+    // Otherwise tombstone one copy, if one is still visible
+    std::unique_lock<std::shared_mutex> lock(state_);
+    const Point p(mbr.m_pLow, 2);
+    CopyCounter<Key> counter(key);
+    for (auto& c : immutable_) {
+        if (c->mayMatch(p)) c->resources.tree->intersectsWithQuery(p, counter);
+    }
+    for (auto& c : runs_) {
+        if (c->mayMatch(p)) c->resources.tree->intersectsWithQuery(p, counter);
+    }
+    auto it = tombstones_.find(key);
+    const uint32_t dead = it == tombstones_.end() ? 0 : it->second;
+    if (counter.copies <= dead) return false;
+    ++tombstones_[key];
+    ++tombstone_total_;
+    return true;
+}
+
+void LsmIndex::filteredQuery(const IShape& query, IVisitor& v,
+                             void (ISpatialIndex::*op)(const IShape&, IVisitor&)) {
+    std::shared_lock<std::shared_mutex> lock(state_);
+    TombstoneFilter<Key> filter(tombstones_, v);
+    forEachComponent(query, [&](Component& c) { (c.resources.tree->*op)(query, filter); });
+}
+
+void LsmIndex::containsWhatQuery(const IShape& query, IVisitor& v) {
+    filteredQuery(query, v, &ISpatialIndex::containsWhatQuery);
+}
+
+void LsmIndex::intersectsWithQuery(const IShape& query, IVisitor& v) {
+    filteredQuery(query, v, &ISpatialIndex::intersectsWithQuery);
+}
+
+void LsmIndex::pointLocationQuery(const Point& query, IVisitor& v) {
+    // Point data: the entries located at a point are the ones it intersects
+    filteredQuery(query, v, &ISpatialIndex::intersectsWithQuery);
+}
+
+void LsmIndex::componentNeighbors(Component& c, uint32_t k, const IShape& query, IVisitor& v,
+                                  INearestNeighborComparator* nnc, std::vector<Neighbor>& out) {
+    components_probed_.fetch_add(1, std::memory_order_relaxed);
+    uint32_t want = k;
+    for (;;) {
+        NeighborCollector collector(query, v, nnc);
+        if (nnc) {
+            c.resources.tree->nearestNeighborQuery(want, query, collector, *nnc);
+        } else {
+            c.resources.tree->nearestNeighborQuery(want, query, collector);
+        }
+
+        // Copies of this answer that tombstones could hide
+        uint32_t dead = 0;
+        if (!tombstones_.empty()) {
+            TombstoneFilter<Key> filter(tombstones_, v);
+            for (const Neighbor& nb : collector.found) {
+                if (filter.hide(nb.id, nb.coords)) ++dead;
+            }
+        }
+        const size_t got = collector.found.size();
+        if (got < want || got - dead >= k) {
+            out.insert(out.end(), collector.found.begin(), collector.found.end());
+            return;
+        }
+        // Ask again past the hidden copies, at least doubling
+        want = std::max(k + dead, 2 * want);
+    }
+}
+
+void LsmIndex::reportNeighbors(std::vector<Neighbor>& candidates, uint32_t k, IVisitor& v) const {
+    // Nearest first, as the tree reports, skipping tombstoned copies
+    std::sort(candidates.begin(), candidates.end());
+    TombstoneFilter<Key> filter(tombstones_, v);
+    uint32_t reported = 0;
+    for (const Neighbor& nb : candidates) {
+        if (reported == k) break;
+        if (filter.hide(nb.id, nb.coords)) continue;
+        PointData data(nb.id, nb.coords);
+        v.visitData(data);
+        ++reported;
+    }
+}
+
+void LsmIndex::nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc) {
+    // Custom distances cannot be bounded by component MBRs: ask every non-empty component
+    if (k == 0) return;
+    std::shared_lock<std::shared_mutex> lock(state_);
+    std::vector<Neighbor> candidates;
+    auto ask = [&](Component& c) {
+        if (c.count > 0) componentNeighbors(c, k, query, v, &nnc, candidates);
+    };
+    ask(*memtable_);
+    for (auto& c : immutable_) ask(*c);
+    for (auto& c : runs_) ask(*c);
+    reportNeighbors(candidates, k, v);
+}
+
+void LsmIndex::nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v) {
+    if (k == 0) return;
+    std::shared_lock<std::shared_mutex> lock(state_);
+
+    // Components closest-first by the distance to their data MBR
+    std::vector<std::pair<double, Component*>> order;
+    auto add = [&](Component& c) {
+        if (c.count == 0) return;
+        Region mbr(c.low, c.high, 2);
+        order.emplace_back(query.getMinimumDistance(mbr), &c);
+    };
+    add(*memtable_);
+    for (auto& c : immutable_) add(*c);
+    for (auto& c : runs_) add(*c);
+    std::sort(order.begin(), order.end());
+
+    // Every component contributes its k nearest copies that survive the
+    // tombstones; stop once k survivors are nearer than the next component
+    std::vector<Neighbor> candidates;
+    for (const auto& entry : order) {
+        if (candidates.size() >= k) {
+            std::sort(candidates.begin(), candidates.end());
+            TombstoneFilter<Key> filter(tombstones_, v);
+            uint32_t alive = 0;
+            double kth = 0.0;
+            for (const Neighbor& nb : candidates) {
+                if (filter.hide(nb.id, nb.coords)) continue;
+                if (++alive == k) {
+                    kth = nb.dist;
+                    break;
+                }
+            }
+            if (alive == k && entry.first > kth) break;
+        }
+        componentNeighbors(*entry.second, k, query, v, nullptr, candidates);
+    }
+    reportNeighbors(candidates, k, v);
+}
+
+void LsmIndex::selfJoinQuery(const IShape&, IVisitor&) {
+    throw std::runtime_error("LsmIndex: self joins across runs are not supported.");
+}
+
+void LsmIndex::queryStrategy(IQueryStrategy&) {
+    throw std::runtime_error("LsmIndex: query strategies span a single tree and are not supported.");
+}
+
+void LsmIndex::getIndexProperties(Tools::PropertySet& out) const {
+    // The memtable has the configured shape; runs are packed versions of it
+    memtable_->resources.tree->getIndexProperties(out);
+}
+
+void LsmIndex::addCommand(ICommand*, CommandType) {
+    throw std::runtime_error("LsmIndex: commands are not supported (runs are rebuilt in the background).");
+}
+
+bool LsmIndex::isIndexValid() {
+    std::shared_lock<std::shared_mutex> lock(state_);
+    if (!memtable_->resources.tree->isIndexValid()) return false;
+    for (auto& c : immutable_) {
+        if (!c->resources.tree->isIndexValid()) return false;
+    }
+    for (auto& c : runs_) {
+        if (!c->resources.tree->isIndexValid()) return false;
+    }
+    return true;
+}
+
+void LsmIndex::getStatistics(IStatistics** out) const {
+    LsmStatistics* sum = new LsmStatistics();
+    auto add = [sum](const Component& c) {
+        IStatistics* st = nullptr;
+        c.resources.tree->getStatistics(&st);
+        sum->reads += st->getReads();
+        sum->writes += st->getWrites();
+        sum->nodes += st->getNumberOfNodes();
+        sum->data += st->getNumberOfData();
+        delete st;
+    };
+    std::shared_lock<std::shared_mutex> lock(state_);
+    add(*memtable_);
+    for (const auto& c : immutable_) add(*c);
+    for (const auto& c : runs_) add(*c);
+    *out = sum;
+}
+
+void LsmIndex::flush() {
+    if (!memtable_->points.empty()) freeze();
+    drain();
+}
+
+} // namespace SpatialIndex
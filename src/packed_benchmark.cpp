@@ -0,0 +1,256 @@
+#include "packed_benchmark.h"
+#include "packed_rtree.h"
+#include "bulk_load.h"
+#include "query_runner.h"
+#include "latency_histogram.h"
+#include "rtree_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+
+namespace SpatialIndex {
+
+namespace {
+
+// Collects the ids a window query returns
+class IdVisitor : public IVisitor {
+public:
+    std::vector<id_type> ids;
+
+    void visitNode(const INode&) override {}
+    void visitData(const IData& d) override { ids.push_back(d.getIdentifier()); }
+    void visitData(std::vector<const IData*>& v) override {
+        for (const IData* d : v) ids.push_back(d->getIdentifier());
+    }
+};
+
+// Latency and node counts of one engine over the query sequence
+struct EngineStats {
+    LatencyHistogram latency[3];
+    uint64_t nodes[3] = {0, 0, 0};
+    uint64_t results[3] = {0, 0, 0};
+
+    void add(OpType type, uint64_t ns, uint64_t node_count, uint64_t result_count) {
+        const int t = static_cast<int>(type);
+        latency[t].record(ns);
+        nodes[t] += node_count;
+        results[t] += result_count;
+    }
+};
+
+} // namespace
+
+void runPackedBenchmark(
+    const TreeConfig& base_config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const WorkloadMix& query_mix,
+    int num_queries,
+    const std::string& output_csv
+) {
+    std::ostream& log = *base_config.log;
+    std::ofstream f(output_csv);
+    if (!f.is_open()) {
+        log << "Error: Could not open output file: " << output_csv << std::endl;
+        return;
+    }
+
+    // Both engines are bulk loaded; anything but HILBERT packs with STR
+    TreeConfig config = base_config;
+    if (config.build_mode != "HILBERT") config.build_mode = "STR";
+    const PackOrder order = config.build_mode == "HILBERT" ? PackOrder::HILBERT : PackOrder::STR;
+
+    log << "Starting packed R-tree benchmark: "
+        << (config.bulk_data_file.empty() ? std::to_string(config.bulk_points) + " points ("
+                                                   + gen.getDataType() + " data)"
+                                                 : config.bulk_data_file)
+              << ", " << config.build_mode << " packing -> " << output_csv << std::endl;
+
+    // libspatialindex tree
+    gen.reset();
+    const uint64_t lib_t0 = nowNs();
+    TreeResources resources = setupTree(config, &gen);
+    resources.tree->flush();
+    const uint64_t lib_build_ns = nowNs() - lib_t0;
+    const TreeShape shape = rtree_shape(*resources.tree);
+
+    // Packed tree over the same points; reading them is part of the build, as above
+    gen.reset();
+    const uint64_t packed_t0 = nowNs();
+    std::unique_ptr<PointSource> source;
+    if (!config.bulk_data_file.empty()) {
+        source.reset(new CsvPointSource(config.bulk_data_file));
+    } else {
+        source.reset(new GeneratorPointSource(gen, config.bulk_points));
+    }
+    std::vector<double> coords;
+    std::vector<id_type> ids;
+    double point[2];
+    id_type id;
+    while (source->next(point, id)) {
+        coords.push_back(point[0]);
+        coords.push_back(point[1]);
+        ids.push_back(id);
+    }
+    PackedRTree packed(coords.data(), ids.data(), ids.size(), static_cast<uint32_t>(config.M_capacity), order);
+    const uint64_t packed_build_ns = nowNs() - packed_t0;
+
+    // Identical query sequence for every engine, spread over the data extent
+    double range_w = query_mix.range_ratio;
+    double knn_w = query_mix.knn_ratio;
+    if (range_w <= 0.0 && knn_w <= 0.0) range_w = knn_w = 1.0;
+    std::mt19937 qgen(seed ^ 0x5bd1e995u);
+    std::uniform_real_distribution<double> pick(0.0, range_w + knn_w);
+    const double side_frac = std::sqrt(std::max(0.0, query_mix.range_selectivity));
+    std::vector<Operation> queries;
+    for (int q = 0; q < num_queries && shape.data > 0; ++q) {
+        Operation op;
+        op.type = pick(qgen) < range_w ? OpType::RANGE_QUERY : OpType::KNN_QUERY;
+        op.id = 0;
+        for (int d = 0; d < 2; ++d) {
+            op.coords[d] = std::uniform_real_distribution<double>(shape.low[d], shape.high[d])(qgen);
+            op.half_extent[d] = 0.5 * side_frac * (shape.high[d] - shape.low[d]);
+        }
+        queries.push_back(op);
+    }
+    const uint32_t k = query_mix.knn_k;
+
+    // libspatialindex's answers (untimed), checked against every packed kernel below:
+    // the same window ids, the same k-th neighbour distance
+    struct Expected {
+        std::vector<id_type> ids;  // Range: sorted ids
+        size_t want = 0;           // kNN: neighbours expected, and the k-th distance
+        double kth = 0.0;
+    };
+    std::vector<Expected> expected(queries.size());
+    for (size_t q = 0; q < queries.size(); ++q) {
+        const Operation& op = queries[q];
+        if (op.type == OpType::RANGE_QUERY) {
+            Region window = queryWindow(op);
+            IdVisitor visitor;
+            resources.tree->intersectsWithQuery(window, visitor);
+            std::sort(visitor.ids.begin(), visitor.ids.end());
+            expected[q].ids.swap(visitor.ids);
+        } else {
+            Point p(op.coords, 2);
+            CountingVisitor ignore;
+            NeighborCollector collector(p, ignore);
+            resources.tree->nearestNeighborQuery(k, p, collector);
+            std::sort(collector.found.begin(), collector.found.end());
+            // libspatialindex also returns ties with the k-th neighbour
+            expected[q].want = std::min<size_t>(k, collector.found.size());
+            if (expected[q].want > 0) expected[q].kth = collector.found[expected[q].want - 1].dist;
+        }
+    }
+    // Wrong answers of the packed tree's current kernel set
+    auto countMismatches = [&]() {
+        uint64_t bad = 0;
+        std::vector<id_type> got;
+        std::vector<Neighbor> nn;
+        for (size_t q = 0; q < queries.size(); ++q) {
+            const Operation& op = queries[q];
+            if (op.type == OpType::RANGE_QUERY) {
+                Region window = queryWindow(op);
+                got.clear();
+                packed.rangeQuery(window.m_pLow, window.m_pHigh, got);
+                std::sort(got.begin(), got.end());
+                if (got != expected[q].ids) ++bad;
+            } else {
+                nn.clear();
+                packed.nearestNeighbors(op.coords, k, nn);
+                const size_t want = expected[q].want;
+                if (nn.size() != want ||
+                    (want > 0 && std::fabs(nn.back().dist - expected[q].kth) >
+                                     1e-9 * std::max(1.0, nn.back().dist))) {
+                    ++bad;
+                }
+            }
+        }
+        return bad;
+    };
+
+    f << "Engine,Kernel,Points,NodeCapacity,BuildTime_ms,Nodes,Height,"
+         "RangeQueries,AvgRange_us,P50Range_us,P99Range_us,AvgRangeNodes,AvgRangeResults,"
+         "KnnQueries,AvgKnn_us,P50Knn_us,P99Knn_us,AvgKnnNodes,Mismatches\n";
+
+    auto writeRow = [&](const std::string& engine, const char* kernel, uint32_t capacity, uint64_t build_ns,
+                        uint64_t nodes, uint32_t height, const EngineStats& s, uint64_t bad) {
+        auto avg = [](uint64_t total, uint64_t count) {
+            return count ? static_cast<double>(total) / count : 0.0;
+        };
+        const int r = static_cast<int>(OpType::RANGE_QUERY);
+        const int n = static_cast<int>(OpType::KNN_QUERY);
+        f << engine << "," << kernel << "," << ids.size() << "," << capacity << ","
+          << build_ns / 1e6 << "," << nodes << "," << height << ","
+          << s.latency[r].count() << "," << s.latency[r].mean() / 1000.0 << ","
+          << s.latency[r].percentile(50.0) / 1000.0 << "," << s.latency[r].percentile(99.0) / 1000.0 << ","
+          << avg(s.nodes[r], s.latency[r].count()) << "," << avg(s.results[r], s.latency[r].count()) << ","
+          << s.latency[n].count() << "," << s.latency[n].mean() / 1000.0 << ","
+          << s.latency[n].percentile(50.0) / 1000.0 << "," << s.latency[n].percentile(99.0) / 1000.0 << ","
+          << avg(s.nodes[n], s.latency[n].count()) << "," << bad << "\n";
+        log << "  " << engine << (kernel[0] != '-' ? std::string(" (") + kernel + ")" : std::string())
+            << ": built in " << build_ns / 1e6 << " ms, " << nodes << " nodes, height " << height
+            << "; range avg " << s.latency[r].mean() / 1000.0 << " us, kNN avg "
+            << s.latency[n].mean() / 1000.0 << " us" << std::endl;
+    };
+
+    EngineStats lib;
+    for (const Operation& op : queries) {
+        const QueryResult qr = runQuery(resources.tree, op, k);
+        lib.add(op.type, qr.time_ns, qr.nodes_visited, qr.results);
+    }
+    writeRow("LIBSPATIALINDEX", "-", static_cast<uint32_t>(config.M_capacity), lib_build_ns,
+             shape.totalNodes(), shape.height(), lib, 0);
+    cleanupTree(resources);
+
+    // Packed tree once per kernel set, fastest last so it reports the best case
+    std::vector<id_type> out;
+    std::vector<Neighbor> nn;
+    const SimdLevel levels[3] = {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2};
+    for (SimdLevel level : levels) {
+        if (!simdSupported(level)) continue;
+        packed.setSimd(level);
+        const uint64_t mismatches = countMismatches();
+        EngineStats s;
+        for (const Operation& op : queries) {
+            uint64_t nodes = 0, results = 0, t0 = 0, t1 = 0;
+            if (op.type == OpType::RANGE_QUERY) {
+                double low[2], high[2];
+                for (int d = 0; d < 2; ++d) {
+                    low[d] = op.coords[d] - op.half_extent[d];
+                    high[d] = op.coords[d] + op.half_extent[d];
+                }
+                out.clear();
+                t0 = nowNs();
+                results = packed.rangeQuery(low, high, out, &nodes);
+                t1 = nowNs();
+            } else {
+                nn.clear();
+                t0 = nowNs();
+                packed.nearestNeighbors(op.coords, k, nn, &nodes);
+                t1 = nowNs();
+                results = nn.size();
+            }
+            s.add(op.type, t1 - t0, nodes, results);
+        }
+        writeRow("PACKED", simdLevelName(level), packed.nodeSize(), packed_build_ns,
+                 packed.nodes(), packed.height(), s, mismatches);
+
+        const int r = static_cast<int>(OpType::RANGE_QUERY);
+        const int n = static_cast<int>(OpType::KNN_QUERY);
+        auto speedup = [](double base, double mean) { return mean > 0.0 ? base / mean : 0.0; };
+        log << "    speedup over libspatialindex: range "
+            << speedup(lib.latency[r].mean(), s.latency[r].mean()) << "x, kNN "
+            << speedup(lib.latency[n].mean(), s.latency[n].mean()) << "x; "
+            << mismatches << " mismatching answers out of " << queries.size() << " queries" << std::endl;
+    }
+
+    log << "  Packed tree: " << packed.memoryBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+    f.close();
+    log << "Packed R-tree benchmark finished for " << output_csv << "." << std::endl;
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,464 @@
+#include "packed_rtree.h"
+#include "space_filling_curve.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACKED_HAVE_AVX2 1
+#endif
+
+namespace SpatialIndex {
+
+// Per-node kernels. n <= 64 entries; the arrays are readable up to n rounded
+// up to a multiple of 8, so vector loops never need a scalar tail.
+struct PackedKernels {
+    // Bit i set for every box i < n that intersects [lo, hi]
+    uint64_t (*boxes)(const double* minx, const double* miny, const double* maxx, const double* maxy,
+                      uint32_t n, const double lo[2], const double hi[2]);
+    // Bit i set for every point i < n inside [lo, hi]
+    uint64_t (*points)(const double* x, const double* y, uint32_t n, const double lo[2], const double hi[2]);
+    // Squared minimum distance from q to every box / point i < n
+    void (*boxDist)(const double* minx, const double* miny, const double* maxx, const double* maxy,
+                    uint32_t n, const double q[2], double* out);
+    void (*pointDist)(const double* x, const double* y, uint32_t n, const double q[2], double* out);
+};
+
+namespace {
+
+inline uint64_t lowMask(uint32_t n) {
+    return n >= 64 ? ~0ull : ((1ull << n) - 1);
+}
+
+// --- Scalar ---
+
+uint64_t boxesScalar(const double* minx, const double* miny, const double* maxx, const double* maxy,
+                     uint32_t n, const double lo[2], const double hi[2]) {
+    uint64_t m = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        const bool hit = (minx[i] <= hi[0]) & (maxx[i] >= lo[0]) & (miny[i] <= hi[1]) & (maxy[i] >= lo[1]);
+        m |= static_cast<uint64_t>(hit) << i;
+    }
+    return m;
+}
+
+uint64_t pointsScalar(const double* x, const double* y, uint32_t n, const double lo[2], const double hi[2]) {
+    uint64_t m = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        const bool hit = (x[i] >= lo[0]) & (x[i] <= hi[0]) & (y[i] >= lo[1]) & (y[i] <= hi[1]);
+        m |= static_cast<uint64_t>(hit) << i;
+    }
+    return m;
+}
+
+void boxDistScalar(const double* minx, const double* miny, const double* maxx, const double* maxy,
+                   uint32_t n, const double q[2], double* out) {
+    for (uint32_t i = 0; i < n; ++i) {
+        const double dx = std::max(std::max(minx[i] - q[0], q[0] - maxx[i]), 0.0);
+        const double dy = std::max(std::max(miny[i] - q[1], q[1] - maxy[i]), 0.0);
+        out[i] = dx * dx + dy * dy;
+    }
+}
+
+void pointDistScalar(const double* x, const double* y, uint32_t n, const double q[2], double* out) {
+    for (uint32_t i = 0; i < n; ++i) {
+        const double dx = x[i] - q[0];
+        const double dy = y[i] - q[1];
+        out[i] = dx * dx + dy * dy;
+    }
+}
+
+const PackedKernels kScalarKernels = {boxesScalar, pointsScalar, boxDistScalar, pointDistScalar};
+
+// --- SSE2: two entries per instruction ---
+
+#ifdef __SSE2__
+uint64_t boxesSse2(const double* minx, const double* miny, const double* maxx, const double* maxy,
+                   uint32_t n, const double lo[2], const double hi[2]) {
+    const __m128d lx = _mm_set1_pd(lo[0]), ly = _mm_set1_pd(lo[1]);
+    const __m128d hx = _mm_set1_pd(hi[0]), hy = _mm_set1_pd(hi[1]);
+    uint64_t m = 0;
+    for (uint32_t i = 0; i < n; i += 2) {
+        __m128d c = _mm_and_pd(_mm_cmple_pd(_mm_load_pd(minx + i), hx), _mm_cmpge_pd(_mm_load_pd(maxx + i), lx));
+        c = _mm_and_pd(c, _mm_and_pd(_mm_cmple_pd(_mm_load_pd(miny + i), hy),
+                                     _mm_cmpge_pd(_mm_load_pd(maxy + i), ly)));
+        m |= static_cast<uint64_t>(_mm_movemask_pd(c)) << i;
+    }
+    return m & lowMask(n);
+}
+
+uint64_t pointsSse2(const double* x, const double* y, uint32_t n, const double lo[2], const double hi[2]) {
+    const __m128d lx = _mm_set1_pd(lo[0]), ly = _mm_set1_pd(lo[1]);
+    const __m128d hx = _mm_set1_pd(hi[0]), hy = _mm_set1_pd(hi[1]);
+    uint64_t m = 0;
+    for (uint32_t i = 0; i < n; i += 2) {
+        const __m128d vx = _mm_load_pd(x + i), vy = _mm_load_pd(y + i);
+        __m128d c = _mm_and_pd(_mm_cmpge_pd(vx, lx), _mm_cmple_pd(vx, hx));
+        c = _mm_and_pd(c, _mm_and_pd(_mm_cmpge_pd(vy, ly), _mm_cmple_pd(vy, hy)));
+        m |= static_cast<uint64_t>(_mm_movemask_pd(c)) << i;
+    }
+    return m & lowMask(n);
+}
+
+void boxDistSse2(const double* minx, const double* miny, const double* maxx, const double* maxy,
+                 uint32_t n, const double q[2], double* out) {
+    const __m128d qx = _mm_set1_pd(q[0]), qy = _mm_set1_pd(q[1]), zero = _mm_setzero_pd();
+    for (uint32_t i = 0; i < n; i += 2) {
+        const __m128d dx = _mm_max_pd(_mm_max_pd(_mm_sub_pd(_mm_load_pd(minx + i), qx),
+                                                 _mm_sub_pd(qx, _mm_load_pd(maxx + i))), zero);
+        const __m128d dy = _mm_max_pd(_mm_max_pd(_mm_sub_pd(_mm_load_pd(miny + i), qy),
+                                                 _mm_sub_pd(qy, _mm_load_pd(maxy + i))), zero);
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+    }
+}
+
+void pointDistSse2(const double* x, const double* y, uint32_t n, const double q[2], double* out) {
+    const __m128d qx = _mm_set1_pd(q[0]), qy = _mm_set1_pd(q[1]);
+    for (uint32_t i = 0; i < n; i += 2) {
+        const __m128d dx = _mm_sub_pd(_mm_load_pd(x + i), qx);
+        const __m128d dy = _mm_sub_pd(_mm_load_pd(y + i), qy);
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+    }
+}
+
+const PackedKernels kSse2Kernels = {boxesSse2, pointsSse2, boxDistSse2, pointDistSse2};
+#endif
+
+// --- AVX2: four entries per instruction, compiled for AVX2 regardless of
+// the build flags and only called when the CPU reports it ---
+
+#ifdef PACKED_HAVE_AVX2
+#define PACKED_AVX2 __attribute__((target("avx2")))
+
+PACKED_AVX2 uint64_t boxesAvx2(const double* minx, const double* miny, const double* maxx, const double* maxy,
+                               uint32_t n, const double lo[2], const double hi[2]) {
+    const __m256d lx = _mm256_set1_pd(lo[0]), ly = _mm256_set1_pd(lo[1]);
+    const __m256d hx = _mm256_set1_pd(hi[0]), hy = _mm256_set1_pd(hi[1]);
+    uint64_t m = 0;
+    for (uint32_t i = 0; i < n; i += 4) {
+        __m256d c = _mm256_and_pd(_mm256_cmp_pd(_mm256_load_pd(minx + i), hx, _CMP_LE_OQ),
+                                  _mm256_cmp_pd(_mm256_load_pd(maxx + i), lx, _CMP_GE_OQ));
+        c = _mm256_and_pd(c, _mm256_and_pd(_mm256_cmp_pd(_mm256_load_pd(miny + i), hy, _CMP_LE_OQ),
+                                           _mm256_cmp_pd(_mm256_load_pd(maxy + i), ly, _CMP_GE_OQ)));
+        m |= static_cast<uint64_t>(_mm256_movemask_pd(c)) << i;
+    }
+    return m & lowMask(n);
+}
+
+PACKED_AVX2 uint64_t pointsAvx2(const double* x, const double* y, uint32_t n,
+                                const double lo[2], const double hi[2]) {
+    const __m256d lx = _mm256_set1_pd(lo[0]), ly = _mm256_set1_pd(lo[1]);
+    const __m256d hx = _mm256_set1_pd(hi[0]), hy = _mm256_set1_pd(hi[1]);
+    uint64_t m = 0;
+    for (uint32_t i = 0; i < n; i += 4) {
+        const __m256d vx = _mm256_load_pd(x + i), vy = _mm256_load_pd(y + i);
+        __m256d c = _mm256_and_pd(_mm256_cmp_pd(vx, lx, _CMP_GE_OQ), _mm256_cmp_pd(vx, hx, _CMP_LE_OQ));
+        c = _mm256_and_pd(c, _mm256_and_pd(_mm256_cmp_pd(vy, ly, _CMP_GE_OQ), _mm256_cmp_pd(vy, hy, _CMP_LE_OQ)));
+        m |= static_cast<uint64_t>(_mm256_movemask_pd(c)) << i;
+    }
+    return m & lowMask(n);
+}
+
+PACKED_AVX2 void boxDistAvx2(const double* minx, const double* miny, const double* maxx, const double* maxy,
+                             uint32_t n, const double q[2], double* out) {
+    const __m256d qx = _mm256_set1_pd(q[0]), qy = _mm256_set1_pd(q[1]), zero = _mm256_setzero_pd();
+    for (uint32_t i = 0; i < n; i += 4) {
+        const __m256d dx = _mm256_max_pd(_mm256_max_pd(_mm256_sub_pd(_mm256_load_pd(minx + i), qx),
+                                                       _mm256_sub_pd(qx, _mm256_load_pd(maxx + i))), zero);
+        const __m256d dy = _mm256_max_pd(_mm256_max_pd(_mm256_sub_pd(_mm256_load_pd(miny + i), qy),
+                                                       _mm256_sub_pd(qy, _mm256_load_pd(maxy + i))), zero);
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+    }
+}
+
+PACKED_AVX2 void pointDistAvx2(const double* x, const double* y, uint32_t n, const double q[2], double* out) {
+    const __m256d qx = _mm256_set1_pd(q[0]), qy = _mm256_set1_pd(q[1]);
+    for (uint32_t i = 0; i < n; i += 4) {
+        const __m256d dx = _mm256_sub_pd(_mm256_load_pd(x + i), qx);
+        const __m256d dy = _mm256_sub_pd(_mm256_load_pd(y + i), qy);
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+    }
+}
+
+#undef PACKED_AVX2
+
+const PackedKernels kAvx2Kernels = {boxesAvx2, pointsAvx2, boxDistAvx2, pointDistAvx2};
+#endif
+
+const PackedKernels& kernelsFor(SimdLevel level) {
+    switch (level) {
+#ifdef PACKED_HAVE_AVX2
+    case SimdLevel::AVX2:
+        return kAvx2Kernels;
+#endif
+#ifdef __SSE2__
+    case SimdLevel::SSE2:
+        return kSse2Kernels;
+#endif
+    default:
+        return kScalarKernels;
+    }
+}
+
+} // namespace
+
+bool simdSupported(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX2:
+#ifdef PACKED_HAVE_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    case SimdLevel::SSE2:
+#ifdef __SSE2__
+        return true;
+#else
+        return false;
+#endif
+    default:
+        return true;
+    }
+}
+
+SimdLevel bestSimdLevel() {
+    if (simdSupported(SimdLevel::AVX2)) return SimdLevel::AVX2;
+    if (simdSupported(SimdLevel::SSE2)) return SimdLevel::SSE2;
+    return SimdLevel::SCALAR;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::SSE2: return "SSE2";
+    default: return "SCALAR";
+    }
+}
+
+template <typename T>
+PackedRTree::AlignedArray<T> PackedRTree::allocate(size_t count) {
+    // Whole cache lines, at least one
+    const size_t bytes = std::max<size_t>((count * sizeof(T) + 63) & ~size_t(63), 64);
+    void* p = std::aligned_alloc(64, bytes);
+    if (!p) throw std::bad_alloc();
+    return AlignedArray<T>(static_cast<T*>(p));
+}
+
+PackedRTree::PackedRTree(const double* coords, const id_type* ids, size_t n,
+                         uint32_t node_size, PackOrder order)
+    : n_(n), b_(std::min<uint32_t>(64, (std::max<uint32_t>(node_size, 2) + 7) & ~7u)),
+      simd_(SimdLevel::SCALAR), kernels_(&kScalarKernels) {
+    setSimd(bestSimdLevel());
+    pack(coords, ids, order);
+}
+
+void PackedRTree::setSimd(SimdLevel level) {
+    while (!simdSupported(level)) {
+        level = level == SimdLevel::AVX2 ? SimdLevel::SSE2 : SimdLevel::SCALAR;
+    }
+    simd_ = level;
+    kernels_ = &kernelsFor(level);
+}
+
+void PackedRTree::pack(const double* coords, const id_type* ids, PackOrder order) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // Leaf order
+    std::vector<size_t> perm(n_);
+    std::iota(perm.begin(), perm.end(), size_t(0));
+    if (order == PackOrder::HILBERT && n_ > 0) {
+        double low[2] = {coords[0], coords[1]}, high[2] = {coords[0], coords[1]};
+        for (size_t i = 1; i < n_; ++i) {
+            for (int d = 0; d < 2; ++d) {
+                low[d] = std::min(low[d], coords[2 * i + d]);
+                high[d] = std::max(high[d], coords[2 * i + d]);
+            }
+        }
+        std::vector<uint64_t> keys(n_);
+        for (size_t i = 0; i < n_; ++i) {
+            keys[i] = hilbertKey(quantizeCoord(coords[2 * i], low[0], high[0]),
+                                 quantizeCoord(coords[2 * i + 1], low[1], high[1]));
+        }
+        std::sort(perm.begin(), perm.end(), [&](size_t a, size_t b) {
+            return keys[a] != keys[b] ? keys[a] < keys[b] : a < b;
+        });
+    } else if (order == PackOrder::STR && n_ > 0) {
+        // Sort-Tile-Recursive: sqrt(leaves) vertical slices, each sorted by y
+        const size_t leaves = (n_ + b_ - 1) / b_;
+        const size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(leaves))));
+        const size_t slice_points = ((leaves + slices - 1) / slices) * b_;
+        auto by = [&](int d) {
+            return [&, d](size_t a, size_t b) {
+                return coords[2 * a + d] != coords[2 * b + d] ? coords[2 * a + d] < coords[2 * b + d] : a < b;
+            };
+        };
+        std::sort(perm.begin(), perm.end(), by(0));
+        for (size_t s = 0; s < n_; s += slice_points) {
+            std::sort(perm.begin() + s, perm.begin() + std::min(n_, s + slice_points), by(1));
+        }
+    }
+
+    auto padded = [&](size_t count) { return std::max<size_t>(b_, (count + b_ - 1) / b_ * b_); };
+
+    levels_.clear();
+    levels_.emplace_back();
+    Level& points = levels_.back();
+    points.count = n_;
+    const size_t cap = padded(n_);
+    points.minx = allocate<double>(cap);
+    points.miny = allocate<double>(cap);
+    ids_ = allocate<id_type>(cap);
+    for (size_t i = 0; i < cap; ++i) {
+        if (i < n_) {
+            points.minx[i] = coords[2 * perm[i]];
+            points.miny[i] = coords[2 * perm[i] + 1];
+            ids_[i] = ids ? ids[perm[i]] : static_cast<id_type>(perm[i]);
+        } else {
+            points.minx[i] = points.miny[i] = nan;
+            ids_[i] = 0;
+        }
+    }
+
+    // Group B consecutive entries per node until one node's worth is left for the root
+    while (levels_.back().count > b_) {
+        const Level& below = levels_.back();
+        const bool leaf = levels_.size() == 1;
+        Level up;
+        up.count = (below.count + b_ - 1) / b_;
+        const size_t up_cap = padded(up.count);
+        up.minx = allocate<double>(up_cap);
+        up.miny = allocate<double>(up_cap);
+        up.maxx = allocate<double>(up_cap);
+        up.maxy = allocate<double>(up_cap);
+        for (size_t j = 0; j < up_cap; ++j) {
+            double lx = nan, ly = nan, hx = nan, hy = nan;
+            if (j < up.count) {
+                lx = ly = std::numeric_limits<double>::infinity();
+                hx = hy = -std::numeric_limits<double>::infinity();
+                const size_t end = std::min(below.count, (j + 1) * b_);
+                for (size_t i = j * b_; i < end; ++i) {
+                    lx = std::min(lx, below.minx[i]);
+                    ly = std::min(ly, below.miny[i]);
+                    hx = std::max(hx, leaf ? below.minx[i] : below.maxx[i]);
+                    hy = std::max(hy, leaf ? below.miny[i] : below.maxy[i]);
+                }
+            }
+            up.minx[j] = lx;
+            up.miny[j] = ly;
+            up.maxx[j] = hx;
+            up.maxy[j] = hy;
+        }
+        levels_.push_back(std::move(up));
+    }
+}
+
+uint64_t PackedRTree::nodes() const {
+    uint64_t n = 1;
+    for (size_t l = 1; l < levels_.size(); ++l) n += levels_[l].count;
+    return n;
+}
+
+uint64_t PackedRTree::memoryBytes() const {
+    uint64_t bytes = 0;
+    for (size_t l = 0; l < levels_.size(); ++l) {
+        const uint64_t cap = std::max<size_t>(b_, (levels_[l].count + b_ - 1) / b_ * b_);
+        bytes += cap * sizeof(double) * (l == 0 ? 2 : 4);
+        if (l == 0) bytes += cap * sizeof(id_type);
+    }
+    return bytes;
+}
+
+uint64_t PackedRTree::rangeQuery(const double low[2], const double high[2], std::vector<id_type>& out,
+                                 uint64_t* nodes_visited) const {
+    // (level, first entry) of the nodes still to scan
+    std::vector<std::pair<uint32_t, size_t>> stack;
+    stack.reserve(static_cast<size_t>(b_) * levels_.size());
+    stack.emplace_back(static_cast<uint32_t>(levels_.size() - 1), size_t(0));
+    uint64_t found = 0, visited = 0;
+
+    while (!stack.empty()) {
+        const uint32_t level = stack.back().first;
+        const size_t first = stack.back().second;
+        stack.pop_back();
+        const Level& lv = levels_[level];
+        const uint32_t cnt = static_cast<uint32_t>(std::min<size_t>(b_, lv.count - first));
+        ++visited;
+
+        if (level == 0) {
+            uint64_t m = kernels_->points(&lv.minx[first], &lv.miny[first], cnt, low, high);
+            while (m) {
+                out.push_back(ids_[first + __builtin_ctzll(m)]);
+                ++found;
+                m &= m - 1;
+            }
+        } else {
+            uint64_t m = kernels_->boxes(&lv.minx[first], &lv.miny[first], &lv.maxx[first], &lv.maxy[first],
+                                         cnt, low, high);
+            while (m) {
+                stack.emplace_back(level - 1, (first + __builtin_ctzll(m)) * b_);
+                m &= m - 1;
+            }
+        }
+    }
+    if (nodes_visited) *nodes_visited = visited;
+    return found;
+}
+
+void PackedRTree::nearestNeighbors(const double q[2], uint32_t k, std::vector<Neighbor>& out,
+                                   uint64_t* nodes_visited) const {
+    // Best-first search. Level 0 items are points, level l items are level-l nodes.
+    struct Item {
+        double d2;
+        uint32_t level;
+        size_t index;
+        bool operator>(const Item& o) const { return d2 > o.d2; }
+    };
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+    // k smallest point distances queued so far: anything farther can never be reported
+    std::priority_queue<double> kbest;
+    uint64_t visited = 0;
+    alignas(64) double dist[64];
+
+    auto scan = [&](uint32_t level, size_t first) {
+        const Level& lv = levels_[level];
+        const uint32_t cnt = static_cast<uint32_t>(std::min<size_t>(b_, lv.count - first));
+        ++visited;
+        if (level == 0) {
+            kernels_->pointDist(&lv.minx[first], &lv.miny[first], cnt, q, dist);
+        } else {
+            kernels_->boxDist(&lv.minx[first], &lv.miny[first], &lv.maxx[first], &lv.maxy[first], cnt, q, dist);
+        }
+        for (uint32_t i = 0; i < cnt; ++i) {
+            if (kbest.size() == k && dist[i] > kbest.top()) continue;
+            queue.push(Item{dist[i], level, first + i});
+            if (level == 0) {
+                kbest.push(dist[i]);
+                if (kbest.size() > k) kbest.pop();
+            }
+        }
+    };
+
+    const size_t start = out.size();
+    if (k > 0 && n_ > 0) scan(static_cast<uint32_t>(levels_.size() - 1), 0);
+    while (!queue.empty() && out.size() - start < k) {
+        const Item top = queue.top();
+        queue.pop();
+        if (top.level == 0) {
+            Neighbor nb;
+            nb.dist = std::sqrt(top.d2);
+            nb.id = ids_[top.index];
+            nb.coords[0] = levels_[0].minx[top.index];
+            nb.coords[1] = levels_[0].miny[top.index];
+            out.push_back(nb);
+        } else {
+            scan(top.level - 1, top.index * b_);
+        }
+    }
+    if (nodes_visited) *nodes_visited = visited;
+}
+
+} // namespace SpatialIndex
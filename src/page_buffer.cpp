@@ -0,0 +1,654 @@
+#include "page_buffer.h"
+#include "tree_counters.h"
+#include "direct_storage.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+
+namespace SpatialIndex {
+
+bool getBufferPolicy(const std::string& buffer_type, BufferPolicy& out) {
+    std::string upper = buffer_type;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "CLOCK") out = BufferPolicy::CLOCK;
+    else if (upper == "2Q") out = BufferPolicy::TWO_Q;
+    else if (upper == "ARC") out = BufferPolicy::ARC;
+    else if (upper == "LRUK" || upper == "LRU-K" || upper == "LRU_K") out = BufferPolicy::LRU_K;
+    else if (upper == "LEVEL") out = BufferPolicy::LEVEL;
+    else return false;
+    return true;
+}
+
+const char* bufferPolicyName(BufferPolicy policy) {
+    switch (policy) {
+        case BufferPolicy::CLOCK: return "CLOCK";
+        case BufferPolicy::TWO_Q: return "2Q";
+        case BufferPolicy::ARC: return "ARC";
+        case BufferPolicy::LRU_K: return "LRU-K";
+        case BufferPolicy::LEVEL: return "LEVEL";
+    }
+    return "UNKNOWN";
+}
+
+PageBuffer::PageBuffer(IStorageManager& inner, uint32_t capacity, bool write_through)
+    : inner_(inner), capacity_(capacity), write_through_(write_through),
+      hits_(0), misses_(0), evictions_(0), write_backs_(0) {
+    if (capacity_ == 0) {
+        throw std::runtime_error("PageBuffer capacity must be at least one page.");
+    }
+}
+
+// Derived policies are gone by now, so write back without consulting them
+PageBuffer::~PageBuffer() {
+    for (auto& entry : pages_) {
+        if (entry.second.dirty) writeBack(entry.first, entry.second);
+    }
+}
+
+void PageBuffer::writeBack(id_type page, Page& p) {
+    id_type id = page;
+    inner_.storeByteArray(id, static_cast<uint32_t>(p.data.size()), p.data.data());
+    p.dirty = false;
+    ++write_backs_;
+}
+
+void PageBuffer::evictOne() {
+    const id_type victim = chooseVictim();
+    auto it = pages_.find(victim);
+    if (it == pages_.end()) {
+        throw std::runtime_error("PageBuffer policy chose a page that is not cached.");
+    }
+    if (it->second.dirty) writeBack(victim, it->second);
+    onRemove(victim, true);
+    pages_.erase(it);
+    ++evictions_;
+}
+
+void PageBuffer::admit(id_type page, const uint8_t* data, uint32_t len, bool dirty) {
+    onMiss(page);
+    while (pages_.size() >= capacity_) evictOne();
+    Page& p = pages_[page];
+    p.data.assign(data, data + len);
+    p.dirty = dirty;
+    onAdmit(page, data, len);
+}
+
+void PageBuffer::loadByteArray(const id_type page, uint32_t& len, uint8_t** data) {
+    auto it = pages_.find(page);
+    if (it != pages_.end()) {
+        ++hits_;
+        onHit(page);
+        len = static_cast<uint32_t>(it->second.data.size());
+        *data = new uint8_t[len];
+        std::memcpy(*data, it->second.data.data(), len);
+        return;
+    }
+
+    ++misses_;
+    inner_.loadByteArray(page, len, data);
+    admit(page, *data, len, false);
+}
+
+void PageBuffer::prefetch(size_t n, const id_type* pages) {
+    std::vector<id_type> missing;
+    for (size_t i = 0; i < n && missing.size() < capacity_; ++i) {
+        if (pages_.count(pages[i]) == 0) missing.push_back(pages[i]);
+    }
+    if (missing.empty()) return;
+
+    std::vector<uint32_t> lens(missing.size());
+    std::vector<uint8_t*> data(missing.size(), nullptr);
+    loadPages(inner_, missing.size(), missing.data(), lens.data(), data.data());
+    for (size_t i = 0; i < missing.size(); ++i) {
+        ++misses_;
+        admit(missing[i], data[i], lens[i], false);
+        delete[] data[i];
+    }
+}
+
+void PageBuffer::storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) {
+    if (page == StorageManager::NewPage) {
+        // The inner manager assigns the id; the page is cached clean
+        inner_.storeByteArray(page, len, data);
+        admit(page, data, len, false);
+        return;
+    }
+
+    if (write_through_) inner_.storeByteArray(page, len, data);
+
+    auto it = pages_.find(page);
+    if (it != pages_.end()) {
+        ++hits_;
+        it->second.data.assign(data, data + len);
+        it->second.dirty = !write_through_;
+        onUpdate(page, data, len);
+        return;
+    }
+    admit(page, data, len, !write_through_);
+}
+
+void PageBuffer::deleteByteArray(const id_type page) {
+    auto it = pages_.find(page);
+    if (it != pages_.end()) {
+        onRemove(page, false);
+        pages_.erase(it);
+    } else {
+        onForget(page);
+    }
+    inner_.deleteByteArray(page);
+}
+
+// Dirty pages go down as one batch, in page-id order
+void PageBuffer::flush() {
+    std::vector<id_type> pages;
+    for (auto& entry : pages_) {
+        if (entry.second.dirty) pages.push_back(entry.first);
+    }
+    std::sort(pages.begin(), pages.end());
+    std::vector<uint32_t> lens;
+    std::vector<const uint8_t*> data;
+    for (id_type page : pages) {
+        Page& p = pages_[page];
+        lens.push_back(static_cast<uint32_t>(p.data.size()));
+        data.push_back(p.data.data());
+    }
+    storePages(inner_, pages.size(), pages.data(), lens.data(), data.data());
+    for (id_type page : pages) pages_[page].dirty = false;
+    write_backs_ += pages.size();
+    inner_.flush();
+}
+
+void PageBuffer::clear() {
+    for (auto& entry : pages_) {
+        if (entry.second.dirty) writeBack(entry.first, entry.second);
+    }
+    pages_.clear();
+    resetPolicy();
+    hits_ = 0;
+    misses_ = 0;
+}
+
+namespace {
+
+// Second chance: a hand sweeps the frames, clearing reference bits, and
+// evicts the first frame whose bit is already clear.
+class ClockBuffer : public PageBuffer {
+public:
+    ClockBuffer(IStorageManager& inner, uint32_t capacity, bool write_through)
+        : PageBuffer(inner, capacity, write_through), hand_(0) {}
+
+protected:
+    void onAdmit(id_type page, const uint8_t*, uint32_t) override {
+        size_t slot;
+        if (!free_.empty()) {
+            slot = free_.back();
+            free_.pop_back();
+        } else {
+            slot = frames_.size();
+            frames_.push_back(Frame());
+        }
+        frames_[slot].page = page;
+        frames_[slot].referenced = true;
+        slots_[page] = slot;
+    }
+
+    void onHit(id_type page) override { frames_[slots_.at(page)].referenced = true; }
+
+    id_type chooseVictim() override {
+        while (true) {
+            Frame& f = frames_[hand_];
+            hand_ = (hand_ + 1) % frames_.size();
+            if (f.page == StorageManager::NewPage) continue;
+            if (!f.referenced) return f.page;
+            f.referenced = false;
+        }
+    }
+
+    void onRemove(id_type page, bool) override {
+        auto it = slots_.find(page);
+        frames_[it->second].page = StorageManager::NewPage;
+        frames_[it->second].referenced = false;
+        free_.push_back(it->second);
+        slots_.erase(it);
+    }
+
+    void resetPolicy() override {
+        frames_.clear();
+        free_.clear();
+        slots_.clear();
+        hand_ = 0;
+    }
+
+private:
+    struct Frame {
+        id_type page = StorageManager::NewPage;  // NewPage marks an empty frame
+        bool referenced = false;
+    };
+
+    std::vector<Frame> frames_;
+    std::vector<size_t> free_;
+    std::unordered_map<id_type, size_t> slots_;
+    size_t hand_;
+};
+
+// LRU-K (O'Neil et al.): evict the page whose K-th most recent reference is
+// oldest; pages referenced fewer than K times go first, in LRU order.
+// Reference histories of evicted pages are retained for up to `capacity`
+// pages so a page that comes back is not treated as cold.
+class LruKBuffer : public PageBuffer {
+public:
+    LruKBuffer(IStorageManager& inner, uint32_t capacity, bool write_through, uint32_t k)
+        : PageBuffer(inner, capacity, write_through), k_(std::max<uint32_t>(k, 1)), clock_(0) {}
+
+protected:
+    void onAdmit(id_type page, const uint8_t*, uint32_t) override {
+        History& h = history_[page];
+        if (h.retained) {
+            retained_.erase(h.retained_pos);
+            h.retained = false;
+        }
+        touch(page, h, false);
+    }
+
+    void onHit(id_type page) override { touch(page, history_.at(page), true); }
+
+    id_type chooseVictim() override { return std::get<2>(*order_.begin()); }
+
+    void onRemove(id_type page, bool evicted) override {
+        auto it = history_.find(page);
+        order_.erase(key(page, it->second));
+        if (!evicted) {
+            history_.erase(it);
+            return;
+        }
+        it->second.retained = true;
+        it->second.retained_pos = retained_.insert(retained_.end(), page);
+        if (retained_.size() > capacity()) {
+            history_.erase(retained_.front());
+            retained_.pop_front();
+        }
+    }
+
+    void onForget(id_type page) override {
+        auto it = history_.find(page);
+        if (it == history_.end()) return;
+        retained_.erase(it->second.retained_pos);
+        history_.erase(it);
+    }
+
+    void resetPolicy() override {
+        history_.clear();
+        order_.clear();
+        retained_.clear();
+        clock_ = 0;
+    }
+
+private:
+    struct History {
+        std::vector<uint64_t> refs;  // Most recent first, at most K
+        bool retained = false;
+        std::list<id_type>::iterator retained_pos;
+    };
+    // (K-th most recent reference or 0, most recent reference, page)
+    typedef std::tuple<uint64_t, uint64_t, id_type> Key;
+
+    Key key(id_type page, const History& h) const {
+        const uint64_t kth = h.refs.size() >= k_ ? h.refs[k_ - 1] : 0;
+        return Key(kth, h.refs.front(), page);
+    }
+
+    void touch(id_type page, History& h, bool cached) {
+        if (cached) order_.erase(key(page, h));
+        h.refs.insert(h.refs.begin(), ++clock_);
+        if (h.refs.size() > k_) h.refs.pop_back();
+        order_.insert(key(page, h));
+    }
+
+    uint32_t k_;
+    uint64_t clock_;
+    std::unordered_map<id_type, History> history_;
+    std::set<Key> order_;           // Cached pages, eviction candidate first
+    std::list<id_type> retained_;   // Evicted pages whose history is kept, oldest first
+};
+
+// Full 2Q (Johnson & Shasha): first-time pages enter the FIFO A1in; pages
+// evicted from A1in are remembered in the ghost FIFO A1out, and a miss on a
+// remembered page promotes it straight into the LRU queue Am.
+class TwoQBuffer : public PageBuffer {
+public:
+    TwoQBuffer(IStorageManager& inner, uint32_t capacity, bool write_through,
+               double in_fraction, double out_fraction)
+        : PageBuffer(inner, capacity, write_through),
+          kin_(std::max<size_t>(1, static_cast<size_t>(capacity * in_fraction))),
+          kout_(std::max<size_t>(1, static_cast<size_t>(capacity * out_fraction))),
+          promote_(false) {}
+
+protected:
+    void onMiss(id_type page) override {
+        auto it = ghosts_.find(page);
+        promote_ = it != ghosts_.end();
+        if (promote_) {
+            a1out_.erase(it->second);
+            ghosts_.erase(it);
+        }
+    }
+
+    void onAdmit(id_type page, const uint8_t*, uint32_t) override {
+        Entry& e = entries_[page];
+        e.in_am = promote_;
+        std::list<id_type>& queue = promote_ ? am_ : a1in_;
+        e.pos = queue.insert(queue.begin(), page);
+        promote_ = false;
+    }
+
+    void onHit(id_type page) override {
+        Entry& e = entries_.at(page);
+        if (e.in_am) am_.splice(am_.begin(), am_, e.pos);
+    }
+
+    id_type chooseVictim() override {
+        if (am_.empty() || (a1in_.size() > kin_ && !a1in_.empty())) return a1in_.back();
+        return am_.back();
+    }
+
+    void onRemove(id_type page, bool evicted) override {
+        auto it = entries_.find(page);
+        (it->second.in_am ? am_ : a1in_).erase(it->second.pos);
+        const bool remember = evicted && !it->second.in_am;
+        entries_.erase(it);
+        if (!remember) return;
+
+        ghosts_[page] = a1out_.insert(a1out_.begin(), page);
+        if (a1out_.size() > kout_) {
+            ghosts_.erase(a1out_.back());
+            a1out_.pop_back();
+        }
+    }
+
+    void onForget(id_type page) override {
+        auto it = ghosts_.find(page);
+        if (it == ghosts_.end()) return;
+        a1out_.erase(it->second);
+        ghosts_.erase(it);
+    }
+
+    void resetPolicy() override {
+        a1in_.clear();
+        am_.clear();
+        a1out_.clear();
+        entries_.clear();
+        ghosts_.clear();
+        promote_ = false;
+    }
+
+private:
+    struct Entry {
+        bool in_am;
+        std::list<id_type>::iterator pos;
+    };
+
+    size_t kin_;
+    size_t kout_;
+    std::list<id_type> a1in_;   // Most recent first
+    std::list<id_type> am_;
+    std::list<id_type> a1out_;
+    std::unordered_map<id_type, Entry> entries_;
+    std::unordered_map<id_type, std::list<id_type>::iterator> ghosts_;
+    bool promote_;              // The page being admitted was found in A1out
+};
+
+// ARC (Megiddo & Modha): T1 holds pages seen once recently, T2 pages seen
+// at least twice; B1/B2 remember pages evicted from each. Ghost hits move
+// the target size p of T1 towards whichever list would have kept the page.
+class ArcBuffer : public PageBuffer {
+public:
+    ArcBuffer(IStorageManager& inner, uint32_t capacity, bool write_through)
+        : PageBuffer(inner, capacity, write_through), p_(0), incoming_(NONE), drop_next_(false) {}
+
+protected:
+    void onMiss(id_type page) override {
+        const double c = capacity();
+        incoming_ = NONE;
+        drop_next_ = false;
+        auto it = entries_.find(page);
+        if (it != entries_.end() && it->second.list == B1) {
+            const double delta = std::max(1.0, static_cast<double>(b2_.size()) / b1_.size());
+            p_ = std::min(c, p_ + delta);
+            incoming_ = B1;
+            forget(it);
+            return;
+        }
+        if (it != entries_.end() && it->second.list == B2) {
+            const double delta = std::max(1.0, static_cast<double>(b1_.size()) / b2_.size());
+            p_ = std::max(0.0, p_ - delta);
+            incoming_ = B2;
+            forget(it);
+            return;
+        }
+
+        // Completely new page: keep |T1| + |B1| <= c and the directory <= 2c
+        const size_t l1 = t1_.size() + b1_.size();
+        const size_t total = l1 + t2_.size() + b2_.size();
+        if (l1 >= capacity()) {
+            if (t1_.size() < capacity()) {
+                forget(entries_.find(b1_.back()));
+            } else {
+                drop_next_ = true;  // T1 fills the cache: evict its LRU page outright
+            }
+        } else if (total >= 2 * static_cast<size_t>(capacity())) {
+            forget(entries_.find(b2_.back()));
+        }
+    }
+
+    void onAdmit(id_type page, const uint8_t*, uint32_t) override {
+        place(page, incoming_ == NONE ? T1 : T2);
+        incoming_ = NONE;
+    }
+
+    void onHit(id_type page) override {
+        Entry& e = entries_.at(page);
+        listOf(e.list).erase(e.pos);
+        e.list = T2;
+        e.pos = t2_.insert(t2_.begin(), page);
+    }
+
+    // REPLACE(x, p)
+    id_type chooseVictim() override {
+        const double t1 = static_cast<double>(t1_.size());
+        if (!t1_.empty() && (drop_next_ || t1 > p_ || (incoming_ == B2 && t1 == p_) || t2_.empty())) {
+            return t1_.back();
+        }
+        return t2_.back();
+    }
+
+    void onRemove(id_type page, bool evicted) override {
+        auto it = entries_.find(page);
+        const List from = it->second.list;
+        if (!evicted || drop_next_) {
+            drop_next_ = false;
+            forget(it);
+            return;
+        }
+        listOf(from).erase(it->second.pos);
+        entries_.erase(it);
+        place(page, from == T1 ? B1 : B2);
+    }
+
+    void onForget(id_type page) override {
+        auto it = entries_.find(page);
+        if (it != entries_.end()) forget(it);  // B1 or B2: the page is not cached
+    }
+
+    void resetPolicy() override {
+        t1_.clear();
+        t2_.clear();
+        b1_.clear();
+        b2_.clear();
+        entries_.clear();
+        p_ = 0;
+        incoming_ = NONE;
+        drop_next_ = false;
+    }
+
+private:
+    enum List { NONE, T1, T2, B1, B2 };
+    struct Entry {
+        List list;
+        std::list<id_type>::iterator pos;
+    };
+
+    std::list<id_type>& listOf(List l) {
+        switch (l) {
+            case T1: return t1_;
+            case T2: return t2_;
+            case B1: return b1_;
+            default: return b2_;
+        }
+    }
+
+    void place(id_type page, List l) {
+        std::list<id_type>& target = listOf(l);
+        entries_[page] = Entry{l, target.insert(target.begin(), page)};
+    }
+
+    void forget(std::unordered_map<id_type, Entry>::iterator it) {
+        listOf(it->second.list).erase(it->second.pos);
+        entries_.erase(it);
+    }
+
+    std::list<id_type> t1_, t2_, b1_, b2_;  // Most recent first
+    std::unordered_map<id_type, Entry> entries_;
+    double p_;          // Target size of T1
+    List incoming_;     // Ghost list the page being admitted came from
+    bool drop_next_;    // Next victim leaves no ghost (T1 alone filled the cache)
+};
+
+// Tree-level aware: pages are kept in one LRU list per node level (read from
+// the page header). With pin_levels = 0 the lowest cached level is always
+// evicted first, so inner nodes are only dropped when no leaf is cached.
+// With pin_levels = k the top k levels (relative to the highest level seen)
+// are pinned and the rest is evicted in global LRU order; pinned pages go
+// only if nothing else is left. Non-node pages (the tree header) rank above
+// every level.
+class LevelBuffer : public PageBuffer {
+public:
+    LevelBuffer(IStorageManager& inner, uint32_t capacity, bool write_through, uint32_t pin_levels)
+        : PageBuffer(inner, capacity, write_through), pin_levels_(pin_levels), clock_(0), top_level_(0) {}
+
+protected:
+    void onAdmit(id_type page, const uint8_t* data, uint32_t len) override {
+        place(page, levelOf(data, len));
+    }
+
+    void onHit(id_type page) override {
+        Entry& e = entries_.at(page);
+        Level& l = levels_.at(e.level);
+        l.lru.splice(l.lru.begin(), l.lru, e.pos);
+        e.stamp = ++clock_;
+    }
+
+    // The root is rewritten one level higher after a root split
+    void onUpdate(id_type page, const uint8_t* data, uint32_t len) override {
+        const int64_t level = levelOf(data, len);
+        if (level == entries_.at(page).level) {
+            onHit(page);
+            return;
+        }
+        onRemove(page, false);
+        place(page, level);
+    }
+
+    id_type chooseVictim() override {
+        if (pin_levels_ > 0) {
+            const int64_t first_pinned = top_level_ - static_cast<int64_t>(pin_levels_) + 1;
+            const std::list<id_type>* best = nullptr;
+            uint64_t best_stamp = std::numeric_limits<uint64_t>::max();
+            for (auto& entry : levels_) {
+                if (entry.first >= first_pinned) break;
+                const uint64_t stamp = entries_.at(entry.second.lru.back()).stamp;
+                if (stamp < best_stamp) {
+                    best_stamp = stamp;
+                    best = &entry.second.lru;
+                }
+            }
+            if (best != nullptr) return best->back();
+        }
+        return levels_.begin()->second.lru.back();
+    }
+
+    void onRemove(id_type page, bool) override {
+        auto it = entries_.find(page);
+        auto level = levels_.find(it->second.level);
+        level->second.lru.erase(it->second.pos);
+        if (level->second.lru.empty()) levels_.erase(level);
+        entries_.erase(it);
+    }
+
+    void resetPolicy() override {
+        levels_.clear();
+        entries_.clear();
+        clock_ = 0;
+        top_level_ = 0;
+    }
+
+private:
+    static constexpr int64_t kHeaderLevel = std::numeric_limits<int64_t>::max();
+
+    struct Level {
+        std::list<id_type> lru;  // Most recent first
+    };
+    struct Entry {
+        int64_t level;
+        uint64_t stamp;
+        std::list<id_type>::iterator pos;
+    };
+
+    int64_t levelOf(const uint8_t* data, uint32_t len) {
+        const int64_t level = nodeLevel(data, len);
+        if (level < 0) return kHeaderLevel;
+        top_level_ = std::max(top_level_, level);
+        return level;
+    }
+
+    void place(id_type page, int64_t level) {
+        Level& l = levels_[level];
+        Entry& e = entries_[page];
+        e.level = level;
+        e.stamp = ++clock_;
+        e.pos = l.lru.insert(l.lru.begin(), page);
+    }
+
+    uint32_t pin_levels_;
+    uint64_t clock_;
+    int64_t top_level_;
+    std::map<int64_t, Level> levels_;  // Lowest level first, header last
+    std::unordered_map<id_type, Entry> entries_;
+};
+
+} // namespace
+
+PageBuffer* createPageBuffer(BufferPolicy policy, IStorageManager& inner, uint32_t capacity,
+                             bool write_through, const PageBufferOptions& options) {
+    switch (policy) {
+        case BufferPolicy::CLOCK:
+            return new ClockBuffer(inner, capacity, write_through);
+        case BufferPolicy::TWO_Q:
+            return new TwoQBuffer(inner, capacity, write_through,
+                                  options.two_q_in_fraction, options.two_q_out_fraction);
+        case BufferPolicy::ARC:
+            return new ArcBuffer(inner, capacity, write_through);
+        case BufferPolicy::LRU_K:
+            return new LruKBuffer(inner, capacity, write_through, options.lru_k);
+        case BufferPolicy::LEVEL:
+            return new LevelBuffer(inner, capacity, write_through, options.pin_levels);
+    }
+    throw std::runtime_error("Unknown buffer policy.");
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,257 @@
+#include "perf_counters.h"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace SpatialIndex {
+
+const char* perfEventName(PerfEvent event) {
+    switch (event) {
+        case PerfEvent::TASK_CLOCK: return "TaskClock_ns";
+        case PerfEvent::CYCLES: return "Cycles";
+        case PerfEvent::INSTRUCTIONS: return "Instructions";
+        case PerfEvent::L1D_MISSES: return "L1dMisses";
+        case PerfEvent::LLC_MISSES: return "LlcMisses";
+        case PerfEvent::DTLB_MISSES: return "DtlbMisses";
+        case PerfEvent::BRANCH_MISSES: return "BranchMisses";
+        default: return "UNKNOWN";
+    }
+}
+
+#ifdef __linux__
+
+namespace {
+
+struct EventSpec {
+    PerfEvent event;
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t cacheMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// Opened in this order (the first one that opens leads the group); when the
+// PMU cannot fit the whole group, the last ones are dropped first
+const EventSpec kEvents[] = {
+    {PerfEvent::CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PerfEvent::INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PerfEvent::TASK_CLOCK, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PerfEvent::BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PerfEvent::LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PerfEvent::L1D_MISSES, PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D)},
+    {PerfEvent::DTLB_MISSES, PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+// Group read layout for PERF_FORMAT_GROUP | TOTAL_TIME_ENABLED | TOTAL_TIME_RUNNING
+struct GroupRead {
+    uint64_t nr;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[kPerfEventCount];
+};
+
+} // namespace
+
+PerfCounters::PerfCounters() : leader_fd_(-1), opened_(0), kernel_(false) {
+    for (int e = 0; e < kPerfEventCount; ++e) fds_[e] = slot_[e] = -1;
+
+    bool kernel = true;
+    int max_events = kPerfEventCount;
+    while (max_events > 0) {
+        if (open(kernel, max_events)) return;
+        if (opened_ == 0) {
+            // perf_event_paranoid >= 2 only allows user-space counting
+            if (kernel && (errno == EACCES || errno == EPERM)) {
+                kernel = false;
+                continue;
+            }
+            return;
+        }
+        max_events = opened_ - 1;
+    }
+}
+
+bool PerfCounters::open(bool kernel, int max_events) {
+    close();
+    int first_errno = 0;
+    for (const EventSpec& spec : kEvents) {
+        if (opened_ == max_events) break;
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = spec.type;
+        attr.config = spec.config;
+        attr.disabled = leader_fd_ < 0 ? 1 : 0;
+        attr.exclude_kernel = kernel ? 0 : 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, leader_fd_, 0));
+        if (fd < 0) {
+            if (first_errno == 0) first_errno = errno;
+            continue;
+        }
+        if (leader_fd_ < 0) leader_fd_ = fd;
+        fds_[static_cast<int>(spec.event)] = fd;
+        slot_[static_cast<int>(spec.event)] = opened_++;
+    }
+    if (leader_fd_ < 0) {
+        status_ = std::string("perf_event_open failed: ") + std::strerror(first_errno);
+        errno = first_errno;
+        return false;
+    }
+
+    ioctl(leader_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    // A group larger than the PMU never runs and reads as zeros
+    volatile uint64_t spin = 0;
+    for (uint64_t i = 0; i < 100000; ++i) spin = spin + i;
+    GroupRead data;
+    if (::read(leader_fd_, &data, sizeof(data)) <= 0 || data.time_running == 0) {
+        const int opened = opened_;
+        close();
+        opened_ = opened;
+        status_ = "counter group could not be scheduled";
+        return false;
+    }
+
+    kernel_ = kernel;
+    status_.clear();
+    for (int e = 0; e < kPerfEventCount; ++e) {
+        if (fds_[e] >= 0) continue;
+        status_ += (status_.empty() ? "unavailable: " : ", ") + std::string(perfEventName(static_cast<PerfEvent>(e)));
+    }
+    if (!kernel_) status_ += std::string(status_.empty() ? "" : "; ") + "user space only";
+    return true;
+}
+
+void PerfCounters::close() {
+    for (int e = 0; e < kPerfEventCount; ++e) {
+        if (fds_[e] >= 0) ::close(fds_[e]);
+        fds_[e] = slot_[e] = -1;
+    }
+    leader_fd_ = -1;
+    opened_ = 0;
+}
+
+void PerfCounters::read(PerfSample& out) const {
+    GroupRead data;
+    if (leader_fd_ < 0 || ::read(leader_fd_, &data, sizeof(data)) <= 0) {
+        out = PerfSample();
+        return;
+    }
+    // Scale up when the kernel time-shared the PMU with other groups
+    const double scale = data.time_running > 0 && data.time_running < data.time_enabled
+        ? static_cast<double>(data.time_enabled) / data.time_running : 1.0;
+    for (int e = 0; e < kPerfEventCount; ++e) {
+        const int slot = slot_[e];
+        out.values[e] = slot >= 0 && static_cast<uint64_t>(slot) < data.nr
+            ? static_cast<uint64_t>(data.values[slot] * scale) : 0;
+    }
+}
+
+#else
+
+PerfCounters::PerfCounters() : leader_fd_(-1), opened_(0), kernel_(false) {
+    for (int e = 0; e < kPerfEventCount; ++e) fds_[e] = slot_[e] = -1;
+    status_ = "perf counters need Linux";
+}
+
+bool PerfCounters::open(bool, int) {
+    return false;
+}
+
+void PerfCounters::close() {}
+
+void PerfCounters::read(PerfSample& out) const {
+    out = PerfSample();
+}
+
+#endif
+
+PerfCounters::~PerfCounters() {
+    close();
+}
+
+PerfProfiler::PerfProfiler() : ops_(), wall_ns_(), totals_() {}
+
+void PerfProfiler::record(LatencyPhase phase, uint64_t wall_ns) {
+    const int p = static_cast<int>(phase);
+    ++ops_[p];
+    wall_ns_[p] += wall_ns;
+    for (int e = 0; e < kPerfEventCount; ++e) {
+        // Scaled counts can step back slightly; clamp instead of wrapping
+        if (stop_.values[e] > start_.values[e]) totals_[p][e] += stop_.values[e] - start_.values[e];
+    }
+}
+
+bool PerfProfiler::writeSummary(const std::string& csv_path) const {
+    std::ofstream f(csv_path);
+    if (!f.is_open()) return false;
+    f << "Phase,Ops,Wall_ns";
+    for (int e = 0; e < kPerfEventCount; ++e) f << "," << perfEventName(static_cast<PerfEvent>(e));
+    f << ",IPC,OffCpu_pct\n";
+
+    const bool ipc = counters_.has(PerfEvent::CYCLES) && counters_.has(PerfEvent::INSTRUCTIONS);
+    const bool off_cpu = counters_.has(PerfEvent::TASK_CLOCK);
+    for (int p = 0; p < static_cast<int>(LatencyPhase::COUNT); ++p) {
+        if (ops_[p] == 0) continue;
+        const uint64_t* t = totals_[p];
+        f << latencyPhaseName(static_cast<LatencyPhase>(p)) << "," << ops_[p] << "," << wall_ns_[p];
+        for (int e = 0; e < kPerfEventCount; ++e) {
+            f << ",";
+            if (counters_.has(static_cast<PerfEvent>(e))) f << t[e];
+        }
+        f << ",";
+        const uint64_t cycles = t[static_cast<int>(PerfEvent::CYCLES)];
+        if (ipc && cycles > 0) f << static_cast<double>(t[static_cast<int>(PerfEvent::INSTRUCTIONS)]) / cycles;
+        f << ",";
+        const uint64_t on_cpu = t[static_cast<int>(PerfEvent::TASK_CLOCK)];
+        if (off_cpu && wall_ns_[p] > 0) {
+            f << (wall_ns_[p] > on_cpu ? 100.0 * (wall_ns_[p] - on_cpu) / wall_ns_[p] : 0.0);
+        }
+        f << "\n";
+    }
+    return true;
+}
+
+void PerfProfiler::printSummary(std::ostream& os) const {
+    for (int p = 0; p < static_cast<int>(LatencyPhase::COUNT); ++p) {
+        if (ops_[p] == 0) continue;
+        const uint64_t* t = totals_[p];
+        const double n = static_cast<double>(ops_[p]);
+        os << "  " << latencyPhaseName(static_cast<LatencyPhase>(p)) << ": " << ops_[p] << " ops";
+        if (counters_.has(PerfEvent::CYCLES)) {
+            os << ", " << t[static_cast<int>(PerfEvent::CYCLES)] / n << " cycles/op";
+            if (counters_.has(PerfEvent::INSTRUCTIONS) && t[static_cast<int>(PerfEvent::CYCLES)] > 0) {
+                os << ", IPC " << static_cast<double>(t[static_cast<int>(PerfEvent::INSTRUCTIONS)]) /
+                                  t[static_cast<int>(PerfEvent::CYCLES)];
+            }
+        }
+        const char* sep = "; misses/op:";
+        for (PerfEvent e : {PerfEvent::L1D_MISSES, PerfEvent::LLC_MISSES, PerfEvent::DTLB_MISSES,
+                            PerfEvent::BRANCH_MISSES}) {
+            if (!counters_.has(e)) continue;
+            os << sep << " " << perfEventName(e) << " " << t[static_cast<int>(e)] / n;
+            sep = ",";
+        }
+        const uint64_t on_cpu = t[static_cast<int>(PerfEvent::TASK_CLOCK)];
+        if (counters_.has(PerfEvent::TASK_CLOCK) && wall_ns_[p] > 0) {
+            os << "; " << (wall_ns_[p] > on_cpu ? 100.0 * (wall_ns_[p] - on_cpu) / wall_ns_[p] : 0.0)
+               << "% off CPU";
+        }
+        os << "\n";
+    }
+    if (!counters_.status().empty()) os << "  (" << counters_.status() << ")\n";
+}
+
+} // namespace SpatialIndex
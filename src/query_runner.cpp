@@ -0,0 +1,76 @@
+#include "query_runner.h"
+#include <algorithm>
+#include "latency_histogram.h"
+
+namespace SpatialIndex {
+
+void OpTypeStats::add(uint64_t ns, uint64_t nodes, uint64_t res) {
+    const auto us = static_cast<int64_t>(ns / 1000);
+    ++count;
+    total_us += us;
+    total_ns += ns;
+    max_us = std::max(max_us, us);
+    total_nodes += nodes;
+    total_results += res;
+}
+
+Region queryWindow(const Operation& op, uint32_t dims) {
+    double low[kMaxDims], high[kMaxDims];
+    for (uint32_t d = 0; d < dims; ++d) {
+        low[d] = op.coords[d] - op.half_extent[d];
+        high[d] = op.coords[d] + op.half_extent[d];
+    }
+    return Region(low, high, dims);
+}
+
+QueryResult runQuery(ISpatialIndex* tree, const Operation& op, uint32_t knn_k, uint32_t dims) {
+    CountingVisitor visitor;
+    QueryResult res;
+
+    if (op.type == OpType::RANGE_QUERY) {
+        Region window = queryWindow(op, dims);
+        const uint64_t t0 = nowNs();
+        tree->intersectsWithQuery(window, visitor);
+        res.time_ns = nowNs() - t0;
+    } else if (op.type == OpType::KNN_QUERY) {
+        Point q(op.coords, dims);
+        const uint64_t t0 = nowNs();
+        tree->nearestNeighborQuery(knn_k, q, visitor);
+        res.time_ns = nowNs() - t0;
+    }
+    res.time_us = static_cast<int64_t>(res.time_ns / 1000);
+
+    res.nodes_visited = visitor.nodes_visited;
+    res.results = visitor.results;
+    return res;
+}
+
+std::string derivedCsvName(const std::string& output_csv, const std::string& suffix) {
+    const std::string ext = ".csv";
+    if (output_csv.size() > ext.size() &&
+        output_csv.compare(output_csv.size() - ext.size(), ext.size(), ext) == 0) {
+        return output_csv.substr(0, output_csv.size() - ext.size()) + suffix + ext;
+    }
+    return output_csv + suffix + ext;
+}
+
+std::string queryCsvName(const std::string& output_csv) {
+    return derivedCsvName(output_csv, "_queries");
+}
+
+void printOpSummary(std::ostream& os, const OpTypeStats stats[3]) {
+    const OpType types[3] = {OpType::INSERT, OpType::RANGE_QUERY, OpType::KNN_QUERY};
+    for (int t = 0; t < 3; ++t) {
+        const OpTypeStats& s = stats[t];
+        if (s.count == 0) continue;
+        os << "  " << opTypeName(types[t]) << ": " << s.count << " ops, avg "
+           << static_cast<double>(s.total_us) / s.count << " us, max " << s.max_us << " us";
+        if (types[t] != OpType::INSERT) {
+            os << ", avg nodes visited " << static_cast<double>(s.total_nodes) / s.count
+               << ", avg results " << static_cast<double>(s.total_results) / s.count;
+        }
+        os << "\n";
+    }
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,221 @@
+#include "restart_benchmark.h"
+#include "query_runner.h"
+#include "latency_histogram.h"
+#include "rtree_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace SpatialIndex {
+
+RestartMode getRestartMode(const std::string& name) {
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "BUILD") return RestartMode::BUILD;
+    if (upper == "REOPEN") return RestartMode::REOPEN;
+    throw std::invalid_argument("Unknown restart mode: " + name + " (BUILD or REOPEN)");
+}
+
+const char* restartModeName(RestartMode mode) {
+    switch (mode) {
+        case RestartMode::REOPEN: return "REOPEN";
+        default: return "BUILD";
+    }
+}
+
+namespace {
+
+// Write back and evict a file's pages from the OS page cache. Best effort:
+// clean pages are dropped unless another process maps them.
+bool dropFileCache(const std::string& path) {
+#ifdef __linux__
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    const bool ok = ::fdatasync(fd) == 0 && ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+// Reads the root only and keeps its MBR (the data extent)
+class RootMbrStrategy : public IQueryStrategy {
+public:
+    Region mbr;
+
+    void getNextEntry(const IEntry& entry, id_type&, bool& fetch_next) override {
+        IShape* shape = nullptr;
+        entry.getShape(&shape);
+        shape->getMBR(mbr);
+        delete shape;
+        fetch_next = false;
+    }
+};
+
+void writePhase(std::ostream& f, const char* phase, double time_ms, uint64_t ops,
+                const LatencyHistogram* latency, const IoSnapshot& io) {
+    f << phase << "," << time_ms << "," << ops << ",";
+    if (latency && latency->count() > 0) {
+        f << latency->mean() / 1000.0 << "," << latency->percentile(50) / 1000.0 << ","
+          << latency->percentile(99) / 1000.0 << "," << latency->max() / 1000.0;
+    } else {
+        f << ",,,";
+    }
+    writeIoCsvFields(f, io);
+    f << "\n";
+}
+
+} // namespace
+
+void runRestartBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const RestartOptions& options,
+    int num_insertions,
+    const std::string& output_csv
+) {
+    std::ostream& log = *config.log;
+    if (config.run_type != "disk") throw std::invalid_argument("The restart benchmark needs run_type 'disk'.");
+
+    std::ofstream f(output_csv);
+    if (!f.is_open()) {
+        log << "Error: Could not open output file: " << output_csv << std::endl;
+        return;
+    }
+    std::ofstream qf(queryCsvName(output_csv));
+    if (!qf.is_open()) {
+        log << "Error: Could not open output file: " << queryCsvName(output_csv) << std::endl;
+        return;
+    }
+
+    const std::string base_name = config.disk_base_name.empty() ? "disk_tree_data" : config.disk_base_name;
+    const uint32_t dims = gen.dims();
+    log << "Starting restart benchmark (" << restartModeName(options.mode) << "): " << base_name
+        << ".dat, " << options.queries << " queries per pass, prewarm " << options.prewarm_levels
+        << " levels -> " << output_csv << std::endl;
+
+    f << "Phase,Time_ms,Ops,AvgLatency_us,P50_us,P99_us,Max_us";
+    writeIoCsvHeader(f);
+    f << "\n";
+    qf << "Pass,OpIdx,OpType,Time_us,NodesVisited,Results,PageReads,Time_ns\n";
+
+    if (options.mode == RestartMode::BUILD) {
+        TreeConfig build = config;
+        build.open_existing = false;
+        build.prewarm_levels = 0;
+        gen.reset();
+        const uint64_t t0 = nowNs();
+        TreeResources resources = setupTree(build, &gen);
+        uint64_t points = build.build_mode == "INCREMENTAL" ? 0 : build.bulk_points;
+        if (build.build_mode == "INCREMENTAL") {
+            PointInserter inserter(*resources.tree, dims);
+            double coords[kMaxDims];
+            for (int i = 0; i < num_insertions; ++i) {
+                gen.generateNextPoint(coords);
+                inserter.insert(coords, static_cast<id_type>(i));
+            }
+            points = static_cast<uint64_t>(std::max(0, num_insertions));
+        }
+        resources.tree->flush();
+        const double build_ms = (nowNs() - t0) / 1e6;
+        writePhase(f, "BUILD", build_ms, points, nullptr, ioMonitor(resources).snapshot());
+        cleanupTree(resources);
+        log << "  BUILD: " << points << " points in " << build_ms << " ms" << std::endl;
+    }
+
+    if (options.drop_cache) {
+        const bool dat = dropFileCache(base_name + ".dat");
+        const bool idx = dropFileCache(base_name + ".idx");
+        if (!dat || !idx) log << "  (could not drop " << base_name << " from the page cache; OPEN may be warm)\n";
+    }
+
+    // OPEN: storage manager, page index and tree header
+    TreeConfig reopen = config;
+    reopen.open_existing = true;
+    reopen.prewarm_levels = 0;
+    const uint64_t t0 = nowNs();
+    TreeResources resources = setupTree(reopen);
+    const IoMonitor io = ioMonitor(resources);
+    const IoSnapshot opened = io.snapshot();
+    const double open_ms = (nowNs() - t0) / 1e6;
+    writePhase(f, "OPEN", open_ms, 1, nullptr, opened);
+
+    ISpatialIndex& tree = *resources.tree;
+    if (options.prewarm_levels > 0) {
+        const IoSnapshot before = io.snapshot();
+        const PrewarmStats warm = prewarmTree(tree, options.prewarm_levels, resources.buffer);
+        writePhase(f, "PREWARM", warm.time_us / 1000.0, warm.pages, nullptr, ioDelta(io.snapshot(), before));
+        log << "  PREWARM: top " << warm.levels << " levels, " << warm.pages << " pages in "
+            << warm.time_us / 1000.0 << " ms" << std::endl;
+    }
+
+    // Same query set for both passes, spread over the root MBR
+    RootMbrStrategy root;
+    tree.queryStrategy(root);
+    const WorkloadMix& mix = gen.getMix();
+    double range_w = mix.range_ratio;
+    double knn_w = mix.knn_ratio;
+    if (range_w <= 0.0 && knn_w <= 0.0) range_w = 1.0;
+    std::mt19937 qgen(seed ^ 0x5bd1e995u);
+    std::uniform_real_distribution<double> pick(0.0, range_w + knn_w);
+    const double side_frac = std::sqrt(std::max(0.0, mix.range_selectivity));
+    std::vector<Operation> queries(options.queries);
+    for (Operation& op : queries) {
+        op.type = pick(qgen) < range_w ? OpType::RANGE_QUERY : OpType::KNN_QUERY;
+        op.id = 0;
+        for (uint32_t d = 0; d < dims; ++d) {
+            const double lo = root.mbr.getLow(d), hi = root.mbr.getHigh(d);
+            op.coords[d] = std::uniform_real_distribution<double>(lo, hi)(qgen);
+            op.half_extent[d] = 0.5 * side_frac * (hi - lo);
+        }
+    }
+
+    const char* passes[2] = {"COLD", "WARM"};
+    for (int pass = 0; pass < 2; ++pass) {
+        LatencyHistogram latency;
+        const IoSnapshot before = io.snapshot();
+        const uint64_t pass_t0 = nowNs();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const IoSnapshot q0 = io.snapshot();
+            const QueryResult qr = runQuery(&tree, queries[i], mix.knn_k, dims);
+            const IoSnapshot q1 = io.snapshot();
+            latency.record(qr.time_ns);
+            qf << passes[pass] << "," << i << "," << opTypeName(queries[i].type) << "," << qr.time_us << ","
+               << qr.nodes_visited << "," << qr.results << "," << q1.page_reads - q0.page_reads << ","
+               << qr.time_ns << "\n";
+
+            if (pass == 0 && i == 0) {
+                // Time to the first answer, counted from the start of OPEN
+                LatencyHistogram first;
+                first.record(qr.time_ns);
+                writePhase(f, "FIRST_QUERY", (nowNs() - t0) / 1e6, 1, &first, q1);
+                log << "  First answer " << (nowNs() - t0) / 1e6 << " ms after OPEN started ("
+                    << open_ms << " ms opening)" << std::endl;
+            }
+        }
+        const double pass_ms = (nowNs() - pass_t0) / 1e6;
+        const IoSnapshot delta = ioDelta(io.snapshot(), before);
+        writePhase(f, passes[pass], pass_ms, latency.count(), &latency, delta);
+        log << "  " << passes[pass] << ": " << latency.count() << " queries in " << pass_ms << " ms, avg "
+            << latency.mean() / 1000.0 << " us, p99 " << latency.percentile(99) / 1000.0 << " us\n";
+        printIoSummary(log, delta);
+    }
+
+    cleanupTree(resources);
+    log << "  Index: " << (fileBytes(base_name + ".dat") + fileBytes(base_name + ".idx")) / 1e9
+        << " GB in " << base_name << ".dat / .idx" << std::endl;
+}
+
+} // namespace SpatialIndex
@@ -1,123 +1,159 @@
 #include <iostream>
 #include <string>
-#include <chrono>
 #include <stdexcept>
+#include <map>
+#include <sys/resource.h>
 
-#include "rtree_helpers.h"
-#include "workload_generator.h"
-#include "tree_setup.h"
-#include "benchmark_runner.h"
-#include "sware_benchmark.h"
+#include "experiment.h"
 
 using namespace SpatialIndex;
 
+// Optional trailing "key=value" arguments
+static std::map<std::string, std::string> parseOptions(int argc, char* argv[], int first) {
+    std::map<std::string, std::string> opts;
+    for (int i = first; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto eq = arg.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            throw std::invalid_argument("Expected key=value option, got: " + arg);
+        }
+        opts[arg.substr(0, eq)] = arg.substr(eq + 1);
+    }
+    return opts;
+}
+
+// Peak resident set size of this process so far
+static double peakRssMb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return usage.ru_maxrss / 1024.0; // ru_maxrss is in KB on Linux
+}
+
 int main(int argc, char* argv[]) {
     // Expected arguments:
-    // 1: <run_type: "mem" or "disk">
+    // 1: <run_type: "mem", "disk", or "generate" to write <Num_Insertions> operations
+    //    of <Data_Type> (with the operation mix) to <Output_CSV_File> as a binary workload>
     // 2: <M_Capacity>
     // 3: <Fill_Factor>
     // 4: <Num_Insertions>
-    // 5: <Buffer_Type: "NONE", "RANDOM", "LRU">
+    // 5: <Buffer_Type: "NONE", "RANDOM", "FIFO", "LRU", "CLOCK", "2Q", "ARC", "LRUK", "LEVEL", "SWARE">
     // 6: <Buffer_Pages> (0 for none)
     // 7: <Tree_Variant: "LINEAR", "RSTAR", "QUADRATIC">
-    // 8: <Data_Type: "RANDOM" or "WALK">
+    // 8: <Data_Type: "RANDOM", "WALK", "SORTED", "NEARLY_SORTED", "CLUSTERED", "ZIPF">
     // 9: <Page_Size_Bytes>
     // 10: <Output_CSV_File>
-
-    if (argc != 11) {
-        std::cerr << "Error: Invalid number of arguments. Expected 10.\n";
+    // Optional key=value options after the positional arguments:
+    //   insert_ratio, range_ratio, knn_ratio  (operation mix weights, default insert only)
+    //   selectivity  (window area as a fraction of the data extent, default 0.001)
+    //   knn_k        (neighbours per kNN query, default 10)
+    //   seed         (workload seed, default 42)
+    //   dims         (point dimension 2, 3 or 4, default 2; 3-/4-D runs use the default
+    //                 index with incremental builds, optionally with the SWARE buffer)
+    //   sort_k, sort_l            (NEARLY_SORTED: % out of order, max displacement)
+    //   clusters, cluster_stddev  (CLUSTERED)
+    //   hotspots, zipf_s, hotspot_radius  (ZIPF)
+    //   lru_k        (LRUK buffer: references tracked per page, default 2)
+    //   storage      (DEFAULT libspatialindex managers; mem: ARENA slab-allocated pages;
+    //                 disk: DIRECT for O_DIRECT page I/O)
+    //   io_engine, io_depth, io_threads  (DIRECT: AUTO/URING/THREADS, io_uring entries, pread threads)
+    //   async_dirty_pages (disk: write dirty pages back on a background thread, parking at most
+    //                 this many; 0 = synchronous write-back, default)
+    //   pin_levels   (LEVEL buffer: pin the top k tree levels, default 0 = evict lowest level first)
+    //   sware_order  (SWARE buffer order: X, HILBERT or MORTON, default X)
+    //   sware_items, sware_page_items, sware_flush_fraction  (SWARE buffer sizing)
+    //   sware_budget_kb (SWARE: size the buffer from this memory budget instead of sware_items)
+    //   sware_policy (SWARE flushes: FIXED at capacity, default; ADAPTIVE also flushes early
+    //                 when the observed arrival runs and key overlap predict no fewer node
+    //                 touches from waiting; before the first flush only while input is in order)
+    //   sware_min_gain (ADAPTIVE: share of node touches waiting must save, default 0.1)
+    //   sware_page_buffer (SWARE: page buffer under the tree, e.g. LRU or FIFO, sized by
+    //                 Buffer_Capacity; default NONE)
+    //   build        (INCREMENTAL, STR, HILBERT, or COMPARE to benchmark all three builds)
+    //   bulk_points, bulk_file, bulk_fill  (bulk load source and node fill)
+    //   sort_memory_items, sort_threads    (external sort budget for bulk loads)
+    //   build_queries (follow-up queries per build in COMPARE mode, default 1000)
+    //   timing       (CSV: one line per operation, default; HDR: per-phase latency histograms)
+    //   trace_file   (HDR: also write a binary per-operation trace; trace_to_csv --inserts
+    //                 turns it into the per-insert rows HDR leaves out of the CSV)
+    //   perf         (1: per-phase hardware counters of the serial and SWARE runners in
+    //                 <output>_perf.csv via perf_event_open; skipped when unavailable)
+    //   workload_file (replay a file written by "generate" instead of generating inline)
+    //   import_csv   (generate: convert a point file "x,y" / "id,x,y" instead of generating;
+    //                 <Num_Insertions> caps the points read, 0 = all)
+    //   index        (SINGLE, default; SHARDED for the partitioned multi-writer benchmark;
+    //                 CONCURRENT for readers querying while writers insert;
+    //                 PACKED to compare a read-only packed SoA R-tree with libspatialindex;
+    //                 LSM to compare a log-structured index with incremental LINEAR / RSTAR trees)
+    //   shard_threads (SHARDED: writer thread counts to sweep, default 1,2,4,8)
+    //   shards       (SHARDED: shard count, default 0 = one per thread)
+    //   shard_partition, shard_queue_items, shard_queries  (GRID/KD/HILBERT, queue size, queries)
+    //   concurrency  (CONCURRENT: GLOBAL_LOCK, default, one lock around one tree, so queries
+    //                 are fully serialised with inserts; SHARDED_LATCH, per-partition latches;
+    //                 SNAPSHOT, readers on a read-only packed copy republished during ingest)
+    //   snapshot_inserts (SNAPSHOT: new points before a snapshot is republished, default 10000)
+    //   writers, readers  (CONCURRENT: writer threads, default 1; reader counts, default 0,1,2,4,8;
+    //                 the reader-free baseline always runs first)
+    //   packed_queries (PACKED: queries per engine, default 10000; build=HILBERT packs in Hilbert order)
+    //   lsm_memtable, lsm_fanout  (LSM: memtable points, default 100000; runs per tier, default 4;
+    //                 build=HILBERT packs runs in Hilbert order, otherwise STR)
+    //   lsm_background, lsm_queries (LSM: 1 = flush / merge on a background thread, default; queries, default 1000)
+    //   ingest       (default benchmark: SERIAL, default, or PIPELINE to generate, insert and log
+    //                 on three threads connected by SPSC rings)
+    //   ingest_ring, ingest_batch  (PIPELINE: operation ring size, default 65536; batch, default 256)
+    //   updates      (moving objects: <Num_Insertions> objects moved every tick with DELETE_INSERT,
+    //                 IN_PLACE leaf updates (bottom-up, delete + insert fallback) or COMPARE for both)
+    //   update_ticks, update_fraction, update_step, update_probes  (ticks, default 10; share moving
+    //                 per tick, default 1.0; step std. deviation, default 5; quality probes, default 200)
+    //   open_existing (disk: 1 = reopen the tree an earlier run left in <disk_base_name>.dat
+    //                 instead of building a new one)
+    //   disk_base_name (prefix of the index files, default disk_tree_data)
+    //   prewarm      (disk: read the top k tree levels into the buffer after setup, default 0)
+    //   restart      (warm restart: BUILD the tree, close it and reopen it, or REOPEN the files
+    //                 of an earlier BUILD; times OPEN, PREWARM, the first answer and cold / warm queries)
+    //   restart_queries, drop_cache  (restart: queries per pass, default 1000; 1 = evict the index
+    //                 files from the OS page cache before reopening, default)
+    //   leaf_codec   (leaf page format: NONE, default; Q16 / Q32 store point coordinates as 16- / 32-bit
+    //                 cells of the leaf MBR with delta-encoded ids and run the leaf codec benchmark,
+    //                 which refines answers against the exact points; COMPARE runs NONE, Q16 and Q32
+    //                 on the same points and queries. Other runners need NONE)
+    //   leaf_capacity (leaf entries per node, default M_Capacity; codec benchmark default: a full page)
+    //   codec_queries (COMPARE: queries per codec, default 1000; uses the range/knn ratios)
+
+    if (argc < 11) {
+        std::cerr << "Error: Invalid number of arguments. Expected at least 10.\n";
         std::cerr << "Usage: " << argv[0] 
-                  << " <run_type> <M> <Fill> <N> <BufferType> <BufferPages> <Variant> <DataType> <PageSize> <OutFile>\n";
+                  << " <run_type> <M> <Fill> <N> <BufferType> <BufferPages> <Variant> <DataType> <PageSize> <OutFile> [key=value ...]\n";
         std::cerr << "Example: " << argv[0] 
-                  << " disk 16 0.5 100000 LRU 25600 LINEAR RANDOM 4096 output.csv\n";
+                  << " disk 16 0.5 100000 LRU 25600 LINEAR RANDOM 4096 output.csv range_ratio=0.5 knn_ratio=0.2 insert_ratio=0.3\n";
         return 1; 
     }
 
     try {
-        std::string run_type = argv[1];
-        int M = std::stoi(argv[2]);
-        double fill_factor = std::stod(argv[3]);
-        int num_insertions = std::stoi(argv[4]);
-        std::string buffer_type = argv[5];
-        int buffer_capacity = std::stoi(argv[6]);
-        std::string tree_variant_str = argv[7];
-        std::string data_type = argv[8];
-        int page_size = std::stoi(argv[9]);
-        std::string output_file = argv[10];
-
-        RTree::RTreeVariant tree_variant = getRTreeVariant(tree_variant_str);
-
-        TreeConfig config;
-        config.run_type = run_type;
-        config.M_capacity = M;
-        config.fill_factor = fill_factor;
-        config.buffer_type = buffer_type;
-        config.buffer_pages = buffer_capacity;
-        config.tree_variant = tree_variant;
-        config.page_size = page_size;
-        config.disk_base_name = "disk_tree_data";
-
-        WorkloadGenerator workload_gen(data_type, 42);
-
-        // auto t_start = std::chrono::high_resolution_clock::now();
-        // TreeResources resources = setupTree(config);
-
-        if (config.buffer_type == "SWARE") {
-            std::cout << "--- Setting up SWARE Benchmark ---" << std::endl;
-            // SWARE must be on-disk to be meaningful
-            config.run_type = "disk"; 
-            
-            // SWARE can use a page buffer (LRU/FIFO) *underneath* it
-            // For now, let's keep it simple and use an unbuffered disk
-            config.buffer_pages = 0; 
-            
-            int sware_buffer_items = 10000; // You can make this a config param
-            
-            TreeResources resources = setupTree(config);
-            WorkloadGenerator workload_gen(data_type, 42);
-
-            auto t_start = std::chrono::high_resolution_clock::now();
-            run_sware_benchmark(
-                resources.tree, 
-                workload_gen, 
-                num_insertions, 
-                sware_buffer_items, // Pass in batch size
-                output_file
-            );
-            auto t_end = std::chrono::high_resolution_clock::now();
-            
-            auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
-            std::cout << "Total time for SWARE " << output_file << ": " << dur_s << " seconds.\n\n";
-
-            cleanupTree(resources);
-
-        } else {
-            TreeResources resources = setupTree(config);
-            // WorkloadGenerator workload_gen(data_type, 42);
-
-            auto t_start = std::chrono::high_resolution_clock::now();
-            runBenchmark(resources.tree, workload_gen, num_insertions, output_file);
-            auto t_end = std::chrono::high_resolution_clock::now();
-
-            cleanupTree(resources);
-            
-            auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
-            std::cout << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
+        ExperimentArgs args;
+        args.run_type = argv[1];
+        args.M = std::stoi(argv[2]);
+        args.fill_factor = std::stod(argv[3]);
+        args.num_insertions = std::stoi(argv[4]);
+        args.buffer_type = argv[5];
+        args.buffer_pages = std::stoi(argv[6]);
+        args.tree_variant = argv[7];
+        args.data_type = argv[8];
+        args.page_size = std::stoi(argv[9]);
+        args.output_file = argv[10];
+        args.options = parseOptions(argc, argv, 11);
+        auto base_name = args.options.find("disk_base_name");
+        if (base_name != args.options.end()) {
+            args.disk_base_name = base_name->second;
+            args.options.erase(base_name);
         }
-        
-        // WorkloadGenerator workload_gen(data_type, 42);
-        // runBenchmark(resources.tree, workload_gen, num_insertions, output_file);
-        // cleanupTree(resources);
-
-        // auto t_end = std::chrono::high_resolution_clock::now();
-        // auto dur_s = std::chrono::duration_cast<std::chrono::seconds>(t_end - t_start).count();
-        // std::cout << "Total time for " << output_file << ": " << dur_s << " seconds.\n\n";
-
+        runExperiment(args);
+        if (args.run_type == "generate") return 0;
     } catch (const std::exception& e) {
         std::cerr << "Error during benchmark execution: " << e.what() << std::endl;
         return 1;
     }
 
+    std::cout << "Peak RSS: " << peakRssMb() << " MB" << std::endl;
     std::cout << "Benchmark run completed." << std::endl;
     return 0;
 }
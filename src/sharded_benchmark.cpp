@@ -0,0 +1,133 @@
+#include "sharded_benchmark.h"
+#include "query_runner.h"
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace SpatialIndex {
+
+void runShardedBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    const ShardedIndexOptions& options,
+    const std::vector<uint32_t>& thread_counts,
+    int num_insertions,
+    int num_queries,
+    const std::string& output_csv
+) {
+    std::ostream& log = *config.log;
+    std::ofstream f(output_csv);
+    if (!f.is_open()) {
+        log << "Error: Could not open output file: " << output_csv << std::endl;
+        return;
+    }
+
+    // Materialise the insert stream once so generation stays out of the timed ingest
+    gen.reset();
+    const size_t n = static_cast<size_t>(std::max(0, num_insertions));
+    std::vector<double> points(2 * n);
+    double low[2] = {0.0, 0.0}, high[2] = {0.0, 0.0};
+    for (size_t i = 0; i < n; ++i) {
+        gen.generateNextPoint(&points[2 * i]);
+        for (int d = 0; d < 2; ++d) {
+            low[d] = i == 0 ? points[2 * i + d] : std::min(low[d], points[2 * i + d]);
+            high[d] = i == 0 ? points[2 * i + d] : std::max(high[d], points[2 * i + d]);
+        }
+    }
+
+    // Strided sample for the KD / Hilbert boundaries (covers sorted streams evenly)
+    const size_t sample_n = std::min<size_t>(n, 100000);
+    std::vector<double> sample;
+    sample.reserve(2 * sample_n);
+    for (size_t s = 0; s < sample_n; ++s) {
+        const size_t i = s * n / sample_n;
+        sample.push_back(points[2 * i]);
+        sample.push_back(points[2 * i + 1]);
+    }
+
+    log << "Starting sharded benchmark: " << n << " insertions ("
+        << gen.getDataType() << " data, " << shardPartitionName(options.partition)
+        << " partition) -> " << output_csv << std::endl;
+
+    // RouterBusy: share of the ingest the routing thread spent routing (not waiting
+    // on a full queue or for the final drain); near 1 the single router, not the
+    // writers, limits inserts/s
+    f << "Threads,Shards,Partition,Points,InsertTime_ms,InsertsPerSec,Imbalance,QueueStalls,RouterBusy,Splits,"
+         "RangeQueries,AvgRange_us,P99Range_us,AvgRangeShards,"
+         "KnnQueries,AvgKnn_us,P99Knn_us,AvgKnnShards\n";
+
+    // Queries only; an insert-only mix falls back to half window, half kNN
+    const WorkloadMix& mix = gen.getMix();
+    double range_w = mix.range_ratio;
+    double knn_w = mix.knn_ratio;
+    if (range_w <= 0.0 && knn_w <= 0.0) range_w = knn_w = 1.0;
+    const double side_frac = std::sqrt(std::max(0.0, mix.range_selectivity));
+
+    for (uint32_t threads : thread_counts) {
+        ShardedIndexOptions opts = options;
+        opts.threads = std::max<uint32_t>(1, threads);
+        if (opts.shards == 0) opts.shards = opts.threads;
+
+        ShardedIndex index(config, opts, sample);
+
+        const uint64_t t0 = nowNs();
+        for (size_t i = 0; i < n; ++i) {
+            index.enqueue(&points[2 * i], static_cast<id_type>(i));
+        }
+        const uint64_t routed_ns = nowNs() - t0;
+        index.drain();
+        const uint64_t ingest_ns = nowNs() - t0;
+        const double ingest_s = ingest_ns / 1e9;
+
+        // Identical query sequence for every thread count
+        std::mt19937 qgen(0x5bd1e995u);
+        std::uniform_real_distribution<double> pick(0.0, range_w + knn_w);
+        LatencyHistogram latency[3];
+        uint64_t shards_touched[3] = {0, 0, 0};
+        for (int q = 0; q < num_queries && n > 0; ++q) {
+            Operation op;
+            op.type = pick(qgen) < range_w ? OpType::RANGE_QUERY : OpType::KNN_QUERY;
+            op.id = 0;
+            for (int d = 0; d < 2; ++d) {
+                op.coords[d] = std::uniform_real_distribution<double>(low[d], high[d])(qgen);
+                op.half_extent[d] = 0.5 * side_frac * (high[d] - low[d]);
+            }
+            const uint64_t probed_before = index.shardsProbed();
+            const QueryResult qr = runQuery(&index, op, mix.knn_k);
+            const int t = static_cast<int>(op.type);
+            latency[t].record(qr.time_ns);
+            shards_touched[t] += index.shardsProbed() - probed_before;
+        }
+
+        const LatencyHistogram& rl = latency[static_cast<int>(OpType::RANGE_QUERY)];
+        const LatencyHistogram& kl = latency[static_cast<int>(OpType::KNN_QUERY)];
+        auto avg = [](uint64_t total, uint64_t count) {
+            return count ? static_cast<double>(total) / count : 0.0;
+        };
+        const double inserts_per_s = ingest_s > 0.0 ? n / ingest_s : 0.0;
+        const double router_busy = ingest_ns > 0
+            ? static_cast<double>(routed_ns - std::min(index.queueStallNs(), routed_ns)) / ingest_ns : 0.0;
+
+        f << opts.threads << "," << index.shardCount() << "," << shardPartitionName(opts.partition) << ","
+          << n << "," << ingest_ns / 1e6 << "," << inserts_per_s << ","
+          << index.imbalance() << "," << index.queueStalls() << "," << router_busy << "," << index.counters().splits << ","
+          << rl.count() << "," << rl.mean() / 1000.0 << "," << rl.percentile(99.0) / 1000.0 << ","
+          << avg(shards_touched[static_cast<int>(OpType::RANGE_QUERY)], rl.count()) << ","
+          << kl.count() << "," << kl.mean() / 1000.0 << "," << kl.percentile(99.0) / 1000.0 << ","
+          << avg(shards_touched[static_cast<int>(OpType::KNN_QUERY)], kl.count()) << "\n";
+
+        log << "  " << opts.threads << " threads / " << index.shardCount() << " shards: "
+            << static_cast<uint64_t>(inserts_per_s) << " inserts/s, imbalance "
+            << index.imbalance() << ", router busy " << router_busy * 100.0 << "%"
+            << (router_busy > 0.9 ? " (router-bound)" : "") << ", range p99 " << rl.percentile(99.0) / 1000.0
+            << " us, kNN p99 " << kl.percentile(99.0) / 1000.0 << " us" << std::endl;
+    }
+
+    f.close();
+    log << "Sharded benchmark finished for " << output_csv << "." << std::endl;
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,524 @@
+#include "sharded_index.h"
+#include "query_runner.h"
+#include "latency_histogram.h"
+#include "space_filling_curve.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+namespace SpatialIndex {
+
+ShardPartition getShardPartition(const std::string& partition_str) {
+    std::string upper = partition_str;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "KD") return ShardPartition::KD;
+    if (upper == "HILBERT") return ShardPartition::HILBERT;
+    return ShardPartition::GRID; // Default
+}
+
+const char* shardPartitionName(ShardPartition partition) {
+    switch (partition) {
+        case ShardPartition::KD: return "KD";
+        case ShardPartition::HILBERT: return "HILBERT";
+        default: return "GRID";
+    }
+}
+
+namespace {
+
+// Sum of the per-shard tree statistics
+class ShardedStatistics : public IStatistics {
+public:
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint32_t nodes = 0;
+    uint64_t data = 0;
+
+    uint64_t getReads() const override { return reads; }
+    uint64_t getWrites() const override { return writes; }
+    uint32_t getNumberOfNodes() const override { return nodes; }
+    uint64_t getNumberOfData() const override { return data; }
+};
+
+} // namespace
+
+ShardedIndex::ShardedIndex(const TreeConfig& config, const ShardedIndexOptions& options,
+                           const std::vector<double>& sample)
+    : options_(options), stop_(false), grid_cols_(1), grid_rows_(1),
+      queue_stalls_(0), queue_stall_ns_(0), shards_probed_(0) {
+    if (options_.shards == 0) options_.shards = 1;
+    options_.threads = std::min(options_.threads, options_.shards);
+
+    buildPartition(sample);
+
+    // Every shard is a complete tree with its own storage (and buffer share)
+    TreeConfig shard_config = config;
+    shard_config.build_mode = "INCREMENTAL";
+    if (shard_config.buffer_pages > 0) {
+        shard_config.buffer_pages = std::max<int>(1, config.buffer_pages / static_cast<int>(options_.shards));
+    }
+    const std::string base_name = config.disk_base_name.empty() ? "disk_tree_data" : config.disk_base_name;
+    // Owned here until every shard is set up, so a failing setupTree frees the earlier ones
+    std::vector<std::unique_ptr<Shard>> built;
+    try {
+        for (uint32_t s = 0; s < options_.shards; ++s) {
+            shard_config.disk_base_name = base_name + "_shard" + std::to_string(s);
+            built.emplace_back(new Shard(options_.queue_items));
+            built.back()->resources = setupTree(shard_config);
+        }
+    } catch (...) {
+        for (auto& s : built) cleanupTree(s->resources);
+        throw;
+    }
+    for (auto& s : built) shards_.push_back(s.release());
+
+    try {
+        for (uint32_t t = 0; t < options_.threads; ++t) {
+            writers_.emplace_back(&ShardedIndex::writerLoop, this, t);
+        }
+    } catch (...) {
+        stop_.store(true, std::memory_order_release);
+        for (auto& w : writers_) w.join();
+        for (Shard* s : shards_) {
+            cleanupTree(s->resources);
+            delete s;
+        }
+        throw;
+    }
+}
+
+ShardedIndex::~ShardedIndex() {
+    drain();
+    stop_.store(true, std::memory_order_release);
+    for (auto& w : writers_) w.join();
+    for (Shard* s : shards_) {
+        cleanupTree(s->resources);
+        delete s;
+    }
+}
+
+void ShardedIndex::buildPartition(const std::vector<double>& sample) {
+    const uint32_t n = options_.shards;
+    const size_t m = sample.size() / 2;
+
+    // Partition over the sample extent; routing clamps points that fall outside
+    domain_low_[0] = domain_low_[1] = 0.0;
+    domain_high_[0] = domain_high_[1] = 1000.0;
+    if (m > 0) {
+        for (int d = 0; d < 2; ++d) {
+            domain_low_[d] = domain_high_[d] = sample[d];
+            for (size_t i = 1; i < m; ++i) {
+                domain_low_[d] = std::min(domain_low_[d], sample[2 * i + d]);
+                domain_high_[d] = std::max(domain_high_[d], sample[2 * i + d]);
+            }
+            if (domain_high_[d] <= domain_low_[d]) domain_high_[d] = domain_low_[d] + 1.0;
+        }
+    }
+
+    switch (options_.partition) {
+        case ShardPartition::GRID:
+            // Most square cols x rows factorisation of n
+            grid_cols_ = static_cast<uint32_t>(std::sqrt(static_cast<double>(n)));
+            while (n % grid_cols_ != 0) --grid_cols_;
+            grid_rows_ = n / grid_cols_;
+            break;
+        case ShardPartition::KD: {
+            std::vector<double> pts(sample.begin(), sample.begin() + 2 * m);
+            kd_nodes_.clear();
+            buildKd(pts, 0, m, 0, n);
+            break;
+        }
+        case ShardPartition::HILBERT: {
+            std::vector<uint64_t> keys(m);
+            for (size_t i = 0; i < m; ++i) {
+                keys[i] = hilbertKey(quantizeCoord(sample[2 * i], domain_low_[0], domain_high_[0]),
+                                     quantizeCoord(sample[2 * i + 1], domain_low_[1], domain_high_[1]));
+            }
+            std::sort(keys.begin(), keys.end());
+            hilbert_bounds_.assign(n - 1, ~0ULL);
+            for (uint32_t s = 0; s + 1 < n && m > 0; ++s) {
+                hilbert_bounds_[s] = keys[std::min(m - 1, (s + 1) * m / n)];
+            }
+            break;
+        }
+    }
+}
+
+// Split pts[begin, end) (flattened x, y) between `count` shards starting at first_shard
+int ShardedIndex::buildKd(std::vector<double>& pts, size_t begin, size_t end,
+                          uint32_t first_shard, uint32_t count) {
+    const int idx = static_cast<int>(kd_nodes_.size());
+    kd_nodes_.push_back(KdNode{-1, 0.0, -1, -1, first_shard});
+    if (count == 1) return idx;
+
+    // Split the wider axis so the left side holds left_count/count of the sample
+    double lo[2] = {domain_low_[0], domain_low_[1]};
+    double hi[2] = {domain_high_[0], domain_high_[1]};
+    if (end > begin) {
+        for (int d = 0; d < 2; ++d) {
+            lo[d] = hi[d] = pts[2 * begin + d];
+            for (size_t i = begin + 1; i < end; ++i) {
+                lo[d] = std::min(lo[d], pts[2 * i + d]);
+                hi[d] = std::max(hi[d], pts[2 * i + d]);
+            }
+        }
+    }
+    const int axis = (hi[1] - lo[1]) > (hi[0] - lo[0]) ? 1 : 0;
+    const uint32_t left_count = count / 2;
+
+    size_t mid = begin;
+    double split = 0.5 * (lo[axis] + hi[axis]);
+    if (end > begin) {
+        // Sort point pairs by the split axis, then cut at the proportional rank
+        std::vector<std::pair<double, double>> sub;
+        sub.reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) sub.emplace_back(pts[2 * i + axis], pts[2 * i + 1 - axis]);
+        mid = begin + (end - begin) * left_count / count;
+        std::nth_element(sub.begin(), sub.begin() + (mid - begin), sub.end());
+        if (mid < end) split = sub[mid - begin].first;
+        for (size_t i = begin; i < end; ++i) {
+            pts[2 * i + axis] = sub[i - begin].first;
+            pts[2 * i + 1 - axis] = sub[i - begin].second;
+        }
+    }
+
+    kd_nodes_[idx].axis = axis;
+    kd_nodes_[idx].split = split;
+    const int left = buildKd(pts, begin, mid, first_shard, left_count);
+    const int right = buildKd(pts, mid, end, first_shard + left_count, count - left_count);
+    kd_nodes_[idx].left = left;
+    kd_nodes_[idx].right = right;
+    return idx;
+}
+
+uint32_t ShardedIndex::shardOf(const double coords[2]) const {
+    switch (options_.partition) {
+        case ShardPartition::GRID: {
+            uint32_t cell[2];
+            const uint32_t dims[2] = {grid_cols_, grid_rows_};
+            for (int d = 0; d < 2; ++d) {
+                const double t = (coords[d] - domain_low_[d]) / (domain_high_[d] - domain_low_[d]);
+                const double c = std::floor(t * dims[d]);
+                cell[d] = c <= 0.0 ? 0 : (c >= dims[d] ? dims[d] - 1 : static_cast<uint32_t>(c));
+            }
+            return cell[1] * grid_cols_ + cell[0];
+        }
+        case ShardPartition::KD: {
+            int node = 0;
+            while (kd_nodes_[node].axis >= 0) {
+                const KdNode& k = kd_nodes_[node];
+                node = coords[k.axis] < k.split ? k.left : k.right;
+            }
+            return kd_nodes_[node].shard;
+        }
+        case ShardPartition::HILBERT: {
+            const uint64_t key = hilbertKey(quantizeCoord(coords[0], domain_low_[0], domain_high_[0]),
+                                            quantizeCoord(coords[1], domain_low_[1], domain_high_[1]));
+            return static_cast<uint32_t>(std::upper_bound(hilbert_bounds_.begin(), hilbert_bounds_.end(), key) -
+                                         hilbert_bounds_.begin());
+        }
+    }
+    return 0;
+}
+
+void ShardedIndex::extendMbr(Shard& s, const double coords[2]) {
+    if (s.low[0] > s.high[0]) {
+        for (int d = 0; d < 2; ++d) s.low[d] = s.high[d] = coords[d];
+        return;
+    }
+    for (int d = 0; d < 2; ++d) {
+        s.low[d] = std::min(s.low[d], coords[d]);
+        s.high[d] = std::max(s.high[d], coords[d]);
+    }
+}
+
+std::unique_lock<std::mutex> ShardedIndex::lockShard(Shard& s) const {
+    return latched() ? std::unique_lock<std::mutex>(s.latch) : std::unique_lock<std::mutex>();
+}
+
+// Copy of the shard's data MBR; false while the shard is empty
+bool ShardedIndex::shardMbr(Shard& s, Region& out) const {
+    std::unique_lock<std::mutex> guard = lockShard(s);
+    if (s.low[0] > s.high[0]) return false;
+    out = Region(s.low, s.high, 2);
+    return true;
+}
+
+void ShardedIndex::enqueue(const double coords[2], id_type id) {
+    Shard& s = *shards_[shardOf(coords)];
+    if (latched()) {
+        std::lock_guard<std::mutex> guard(s.latch);
+        s.resources.tree->insertData(0, nullptr, Point(coords, 2), id);
+        ++s.enqueued;
+        s.applied.fetch_add(1, std::memory_order_relaxed);
+        extendMbr(s, coords);
+        return;
+    }
+    const InsertItem item{{coords[0], coords[1]}, id};
+    if (!s.queue.tryPush(item)) {
+        const uint64_t t0 = nowNs();
+        do {
+            ++queue_stalls_;
+            std::this_thread::yield();
+        } while (!s.queue.tryPush(item));
+        queue_stall_ns_ += nowNs() - t0;
+    }
+    ++s.enqueued;
+    extendMbr(s, coords);
+}
+
+void ShardedIndex::drain() {
+    if (latched()) return;
+    for (Shard* s : shards_) {
+        while (s->applied.load(std::memory_order_acquire) < s->enqueued) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ShardedIndex::writerLoop(uint32_t thread_idx) {
+    std::vector<InsertItem> batch(256);
+    const uint32_t n = shardCount();
+    uint32_t idle_rounds = 0;
+    for (;;) {
+        const bool stopping = stop_.load(std::memory_order_acquire);
+        bool worked = false;
+        for (uint32_t s = thread_idx; s < n; s += options_.threads) {
+            Shard& sh = *shards_[s];
+            const size_t got = sh.queue.popBatch(batch.data(), batch.size());
+            if (got == 0) continue;
+            for (size_t i = 0; i < got; ++i) {
+                sh.resources.tree->insertData(0, nullptr, Point(batch[i].coords, 2), batch[i].id);
+            }
+            sh.applied.fetch_add(got, std::memory_order_release);
+            worked = true;
+        }
+        if (worked) {
+            idle_rounds = 0;
+            continue;
+        }
+        if (stopping) break;
+        // Spin briefly, then back off so idle writers do not steal query cores
+        if (++idle_rounds < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+double ShardedIndex::imbalance() const {
+    uint64_t total = 0, largest = 0;
+    for (const Shard* s : shards_) {
+        total += s->enqueued;
+        largest = std::max(largest, s->enqueued);
+    }
+    if (total == 0) return 1.0;
+    return static_cast<double>(largest) * shards_.size() / total;
+}
+
+TreeCounterSnapshot ShardedIndex::counters() const {
+    TreeCounterSnapshot sum;
+    for (const Shard* s : shards_) {
+        const TreeCounterSnapshot c = s->resources.counters->snapshot();
+        sum.node_reads += c.node_reads;
+        sum.node_writes += c.node_writes;
+        sum.node_allocs += c.node_allocs;
+        sum.node_deletes += c.node_deletes;
+        sum.splits += c.splits;
+        sum.root_splits += c.root_splits;
+        sum.nodes += c.nodes;
+        sum.height = std::max(sum.height, c.height);
+    }
+    return sum;
+}
+
+bool ShardedIndex::shardMayMatch(const Shard& s, const IShape& query) const {
+    if (s.low[0] > s.high[0]) return false;
+    Region mbr(s.low, s.high, 2);
+    return query.intersectsShape(mbr);
+}
+
+void ShardedIndex::insertData(uint32_t len, const uint8_t* pData, const IShape& shape, id_type shapeIdentifier) {
+    const Point* pt = dynamic_cast<const Point*>(&shape);
+    if (pt != nullptr && pt->m_dimension == 2 && len == 0) {
+        enqueue(pt->m_pCoords, shapeIdentifier);
+        return;
+    }
+    // Anything else goes straight into the shard owning its centre, with the writers idle
+    drain();
+    Point centre;
+    shape.getCenter(centre);
+    Shard& s = *shards_[shardOf(centre.m_pCoords)];
+    std::unique_lock<std::mutex> guard = lockShard(s);
+    s.resources.tree->insertData(len, pData, shape, shapeIdentifier);
+    Region mbr;
+    shape.getMBR(mbr);
+    extendMbr(s, mbr.m_pLow);
+    extendMbr(s, mbr.m_pHigh);
+}
+
+bool ShardedIndex::deleteData(const IShape& shape, id_type shapeIdentifier) {
+    drain();
+    for (Shard* s : shards_) {
+        std::unique_lock<std::mutex> guard = lockShard(*s);
+        if (!shardMayMatch(*s, shape)) continue;
+        if (s->resources.tree->deleteData(shape, shapeIdentifier)) return true;
+    }
+    return false;
+}
+
+void ShardedIndex::containsWhatQuery(const IShape& query, IVisitor& v) {
+    drain();
+    for (Shard* s : shards_) {
+        std::unique_lock<std::mutex> guard = lockShard(*s);
+        if (!shardMayMatch(*s, query)) continue;
+        shards_probed_.fetch_add(1, std::memory_order_relaxed);
+        s->resources.tree->containsWhatQuery(query, v);
+    }
+}
+
+void ShardedIndex::intersectsWithQuery(const IShape& query, IVisitor& v) {
+    drain();
+    for (Shard* s : shards_) {
+        std::unique_lock<std::mutex> guard = lockShard(*s);
+        if (!shardMayMatch(*s, query)) continue;
+        shards_probed_.fetch_add(1, std::memory_order_relaxed);
+        s->resources.tree->intersectsWithQuery(query, v);
+    }
+}
+
+void ShardedIndex::pointLocationQuery(const Point& query, IVisitor& v) {
+    drain();
+    for (Shard* s : shards_) {
+        std::unique_lock<std::mutex> guard = lockShard(*s);
+        if (!shardMayMatch(*s, query)) continue;
+        shards_probed_.fetch_add(1, std::memory_order_relaxed);
+        s->resources.tree->pointLocationQuery(query, v);
+    }
+}
+
+void ShardedIndex::nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc) {
+    // Custom distances cannot be bounded by shard MBRs: ask every non-empty shard
+    if (k == 0) return;
+    drain();
+    NeighborCollector collector(query, v, &nnc);
+    for (Shard* s : shards_) {
+        std::unique_lock<std::mutex> guard = lockShard(*s);
+        if (s->low[0] > s->high[0]) continue;
+        shards_probed_.fetch_add(1, std::memory_order_relaxed);
+        s->resources.tree->nearestNeighborQuery(k, query, collector, nnc);
+    }
+    std::sort(collector.found.begin(), collector.found.end());
+    if (collector.found.size() > k) collector.found.resize(k);
+    for (const Neighbor& nb : collector.found) {
+        PointData data(nb.id, nb.coords);
+        v.visitData(data);
+    }
+}
+
+void ShardedIndex::nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v) {
+    if (k == 0) return;
+    drain();
+
+    // Shards closest-first by the distance to their data MBR
+    std::vector<std::pair<double, uint32_t>> order;
+    order.reserve(shards_.size());
+    for (uint32_t s = 0; s < shardCount(); ++s) {
+        Region mbr;
+        if (!shardMbr(*shards_[s], mbr)) continue;
+        order.emplace_back(query.getMinimumDistance(mbr), s);
+    }
+    std::sort(order.begin(), order.end());
+
+    // Max-heap of the k best candidates seen so far
+    std::priority_queue<Neighbor> best;
+    for (const auto& entry : order) {
+        if (best.size() == k && entry.first > best.top().dist) break;
+        shards_probed_.fetch_add(1, std::memory_order_relaxed);
+        NeighborCollector collector(query, v);
+        {
+            Shard& s = *shards_[entry.second];
+            std::unique_lock<std::mutex> guard = lockShard(s);
+            s.resources.tree->nearestNeighborQuery(k, query, collector);
+        }
+        for (const Neighbor& nb : collector.found) {
+            best.push(nb);
+            if (best.size() > k) best.pop();
+        }
+    }
+
+    // Report nearest first, as the tree does
+    std::vector<Neighbor> result;
+    result.reserve(best.size());
+    while (!best.empty()) {
+        result.push_back(best.top());
+        best.pop();
+    }
+    for (auto it = result.rbegin(); it != result.rend(); ++it) {
+        PointData data(it->id, it->coords);
+        v.visitData(data);
+    }
+}
+
+void ShardedIndex::selfJoinQuery(const IShape&, IVisitor&) {
+    throw std::runtime_error("ShardedIndex: self joins across shards are not supported.");
+}
+
+void ShardedIndex::queryStrategy(IQueryStrategy&) {
+    throw std::runtime_error("ShardedIndex: query strategies span a single tree and are not supported.");
+}
+
+void ShardedIndex::getIndexProperties(Tools::PropertySet& out) const {
+    // All shards share one configuration
+    Shard& s = *shards_.front();
+    std::unique_lock<std::mutex> guard = lockShard(s);
+    s.resources.tree->getIndexProperties(out);
+}
+
+void ShardedIndex::addCommand(ICommand* in, CommandType ct) {
+    for (Shard* s : shards_) {
+        std::unique_lock<std::mutex> guard = lockShard(*s);
+        s->resources.tree->addCommand(in, ct);
+    }
+}
+
+bool ShardedIndex::isIndexValid() {
+    drain();
+    for (Shard* s : shards_) {
+        std::unique_lock<std::mutex> guard = lockShard(*s);
+        if (!s->resources.tree->isIndexValid()) return false;
+    }
+    return true;
+}
+
+void ShardedIndex::getStatistics(IStatistics** out) const {
+    ShardedStatistics* sum = new ShardedStatistics();
+    for (Shard* s : shards_) {
+        std::unique_lock<std::mutex> guard = lockShard(*s);
+        IStatistics* st = nullptr;
+        s->resources.tree->getStatistics(&st);
+        sum->reads += st->getReads();
+        sum->writes += st->getWrites();
+        sum->nodes += st->getNumberOfNodes();
+        sum->data += st->getNumberOfData();
+        delete st;
+    }
+    *out = sum;
+}
+
+void ShardedIndex::flush() {
+    drain();
+    for (Shard* s : shards_) {
+        std::unique_lock<std::mutex> guard = lockShard(*s);
+        s->resources.tree->flush();
+    }
+}
+
+} // namespace SpatialIndex
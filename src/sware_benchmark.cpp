@@ -1,109 +1,222 @@
 #include "sware_benchmark.h"
-#include "rtree_helpers.h" 
+#include "query_runner.h"
 #include <fstream>
 #include <iostream>
-#include <chrono>
-#include <vector>
-#include <algorithm> // For std::sort
 
 namespace SpatialIndex {
 
-struct SwareItem {
-    Point p;
-    id_type id;
-    
-    SwareItem() : p(), id(0) {} 
-    
-    SwareItem(const Point& pt, id_type i) : p(pt), id(i) {}
+namespace {
 
-    bool operator<(const SwareItem& other) const {
-        return p.m_pCoords[0] < other.p.m_pCoords[0];
-    }
-};
-
-void run_sware_benchmark(
+template <uint32_t D>
+RunSummary runSwareBenchmarkDims(
     ISpatialIndex* tree,
+    const CountingStorageManager& counters,
+    const IoMonitor& io,
     WorkloadGenerator& workload_gen,
     int num_insertions,
-    int items_per_batch,
-    const std::string& output_csv
+    const SwareBufferOptions& buffer_options,
+    const std::string& output_csv,
+    LatencyRecorder* recorder,
+    PerfProfiler* profiler,
+    std::ostream& log
 ) {
     std::ofstream f(output_csv);
     if (!f.is_open()) {
-        std::cerr << "Error: Could not open SWARE output file: " << output_csv << std::endl;
-        return;
+        log << "Error: Could not open SWARE output file: " << output_csv << std::endl;
+        return RunSummary();
     }
     
-    std::cout << "Starting SWARE benchmark: " << num_insertions << " insertions (" 
-              << workload_gen.getDataType() << " data) -> " << output_csv << std::endl;
-    std::cout << "  Batch size: " << items_per_batch << " items" << std::endl;
-    
-    // Log batch stats, not per-item stats
-    f << "BatchIdx,ItemsInBatch,Time_us,HeightBefore,HeightAfter,SplitsBefore,SplitsAfter\n";
+    const WorkloadMix& mix = workload_gen.getMix();
+    std::ofstream fq;
+    if (!recorder && !mix.insertOnly()) {
+        fq.open(queryCsvName(output_csv));
+        if (!fq.is_open()) {
+            log << "Error: Could not open SWARE query output file: " << queryCsvName(output_csv) << std::endl;
+            return RunSummary();
+        }
+        fq << "OpIdx,OpType,Time_us,NodesVisited,Results,Time_ns\n";
+    }
 
-    // This is our object buffer
-    std::vector<SwareItem> buffer;
-    buffer.reserve(items_per_batch);
+    log << "Starting SWARE benchmark: " << num_insertions
+        << (mix.insertOnly() ? " insertions (" : " operations (")
+        << workload_gen.getDataType() << " data, " << D << "-D) -> " << output_csv << std::endl;
+
+    // Sortedness-aware buffer in front of the tree; queries go through it
+    BasicSwareBuffer<D> sware(*tree, buffer_options);
+    const SwareBufferOptions& options = sware.getOptions();
+    log << "  Buffer: " << options.capacity << " items";
+    if (options.budget_bytes > 0) log << " (" << options.budget_bytes / 1024 << " KB budget)";
+    log << ", " << options.page_items << " items/page, flush fraction "
+        << options.flush_fraction << ", order: " << swareOrderName(options.order)
+        << ", policy: " << swareFlushPolicyName(options.policy) << std::endl;
+    
+    // Log batch stats, not per-item stats; every flush decision with the model's view
+    f << "BatchIdx,ItemsInBatch,Time_us,HeightBefore,HeightAfter,SplitsBefore,SplitsAfter,"
+         "SortTime_us,NodeReads,NodeWrites,UnsortedItems,ItemsRemaining,"
+         "Reason,Buffered,RunLength,Overlap,PredTouches,PredTouchesFull";
+    writeIoCsvHeader(f);
+    f << "\n";
     
     int batch_index = 0;
+    RunSummary summary;
+    OpTypeStats* const op_stats = summary.stats;
+    uint64_t total_splits = 0;
+    uint64_t total_reads = 0;
+    uint64_t total_writes = 0;
+    uint64_t total_items = 0;
+    uint64_t flushes[3] = {0, 0, 0};
+    const IoSnapshot io_start = io.snapshot();
+
+    auto flush_and_log = [&](bool everything, int items_done) {
+        const TreeCounterSnapshot before = counters.snapshot();
+        const IoSnapshot io_before = io.snapshot();
+        if (profiler) profiler->start();
+        const uint64_t t0 = nowNs();
+        const SwareFlushStats st = sware.flushBatch(everything);
+        const uint64_t flush_ns = nowNs() - t0;
+        if (profiler) {
+            profiler->stop();
+            profiler->record(LatencyPhase::FLUSH, flush_ns);
+        }
+        const TreeCounterSnapshot after = counters.snapshot();
+        const IoSnapshot io_batch = ioDelta(io.snapshot(), io_before);
+
+        const uint64_t reads = after.node_reads - before.node_reads;
+        const uint64_t writes = after.node_writes + after.node_allocs -
+                                before.node_writes - before.node_allocs;
+        total_splits += after.splits - before.splits;
+        total_reads += reads;
+        total_writes += writes;
+        total_items += st.items;
+        ++flushes[static_cast<int>(st.decision.reason)];
+
+        const auto total_dur_us = st.sort_us + st.insert_us;
+        op_stats[static_cast<int>(OpType::INSERT)].add(flush_ns, 0, 0);
+        if (recorder) {
+            const bool did_split = after.splits > before.splits;
+            const bool root_split = after.height > before.height;
+            const uint8_t flags = (did_split ? kTraceDidSplit : 0) | (root_split ? kTraceRootSplit : 0);
+            recorder->record(LatencyPhase::FLUSH, batch_index, flush_ns,
+                             static_cast<uint32_t>(writes), flags);
+        }
+
+        // Log stats for the whole batch
+        f << batch_index << "," << st.items << "," << total_dur_us << ","
+          << before.height << "," << after.height << ","
+          << before.splits << "," << after.splits << ","
+          << st.sort_us << "," << reads << "," << writes << ","
+          << st.unsorted_items << "," << st.remaining << ","
+          << swareFlushReasonName(st.decision.reason) << "," << st.decision.buffered << ","
+          << st.decision.run_length << "," << st.decision.overlap << ","
+          << st.decision.touches_now << "," << st.decision.touches_full;
+        writeIoCsvFields(f, io_batch);
+        f << "\n";
+
+        if (batch_index % 10 == 0) {
+             log << "  ... Flushed batch " << batch_index 
+                 << " (" << swareFlushReasonName(st.decision.reason) << ", "
+                 << items_done << "/" << num_insertions << " items)"
+                 << " in " << total_dur_us << " us (" 
+                 << st.sort_us << " us sorting " << st.unsorted_items << " unsorted, " 
+                 << st.insert_us << " us inserting)\n";
+        }
+        batch_index++;
+    };
     
     for (int i = 0; i < num_insertions; ++i) {
-        // 1. Generate point
-        double coords[2];
-        workload_gen.generateNextPoint(coords);
-        
-        // 2. Add to buffer
-        buffer.emplace_back(SwareItem(Point(coords, 2), static_cast<id_type>(i)));
-        
-        // 3. If buffer is full (or it's the very last insertion), flush the batch
-        if (buffer.size() == items_per_batch || i == num_insertions - 1) {
-            
-            // Get stats before the batch
-            const uint32_t h_before  = rtree_height(*tree);
-            const uint64_t sp_before = rtree_splits(*tree);
-            
-            // --- This is the SWARE/Bulk-Load idea ---
-            // 3a. Sort the buffer (e.g., by X-coordinate)
-            auto sort_start = std::chrono::high_resolution_clock::now();
-            std::sort(buffer.begin(), buffer.end());
-            auto sort_end = std::chrono::high_resolution_clock::now();
-            
-            // 3b. Insert the sorted batch
-            auto insert_start = std::chrono::high_resolution_clock::now();
-            for (const auto& item : buffer) {
-                tree->insertData(0, nullptr, item.p, item.id);
-            }
-            auto insert_end = std::chrono::high_resolution_clock::now();
-            // ------------------------------------------
-
-            // Get stats after the batch
-            const uint32_t h_after  = rtree_height(*tree);
-            const uint64_t sp_after = rtree_splits(*tree);
-            
-            auto sort_dur_us = std::chrono::duration_cast<std::chrono::microseconds>(sort_end - sort_start).count();
-            auto insert_dur_us = std::chrono::duration_cast<std::chrono::microseconds>(insert_end - insert_start).count();
-            auto total_dur_us = sort_dur_us + insert_dur_us;
+        // 1. Generate the next operation
+        const Operation op = workload_gen.nextOperation();
 
-            // Log stats for the whole batch
-            f << batch_index << "," << buffer.size() << "," << total_dur_us << ","
-              << h_before << "," << h_after << ","
-              << sp_before << "," << sp_after << "\n";
-              
-            if (batch_index % 10 == 0) {
-                 std::cout << "  ... Flushed batch " << batch_index 
-                           << " (" << i + 1 << "/" << num_insertions << " items)"
-                           << " in " << total_dur_us << " us (" 
-                           << sort_dur_us << " us sorting, " 
-                           << insert_dur_us << " us inserting)\n";
+        if (op.type != OpType::INSERT) {
+            // Queries merge results from the buffer pages and the tree
+            const LatencyPhase phase = op.type == OpType::RANGE_QUERY ? LatencyPhase::RANGE_QUERY
+                                                                      : LatencyPhase::KNN_QUERY;
+            if (profiler) profiler->start();
+            const QueryResult qr = runQuery(&sware, op, mix.knn_k, D);
+            if (profiler) {
+                profiler->stop();
+                profiler->record(phase, qr.time_ns);
+            }
+            op_stats[static_cast<int>(op.type)].add(qr.time_ns, qr.nodes_visited, qr.results);
+            if (recorder) {
+                recorder->record(phase, i, qr.time_ns, static_cast<uint32_t>(qr.nodes_visited));
+            } else {
+                fq << i << "," << opTypeName(op.type) << "," << qr.time_us << ","
+                   << qr.nodes_visited << "," << qr.results << "," << qr.time_ns << "\n";
             }
-            
-            buffer.clear();
-            batch_index++;
+        } else {
+            // 2. Add to buffer (in-order arrivals take the append fast path)
+            sware.append(op.coords, static_cast<id_type>(op.id));
+
+            // 3. If the flush policy says so, move the sorted prefix into the tree
+            if (sware.flushDue()) flush_and_log(false, i + 1);
         }
     }
+    // Drain whatever is left
+    if (sware.size() > 0) flush_and_log(true, num_insertions);
     
     f.close();
-    std::cout << "SWARE benchmark finished for " << output_csv << "." << std::endl;
+    if (fq.is_open()) fq.close();
+    if (batch_index > 0) {
+        log << "  Per batch (" << swareOrderName(buffer_options.order) << " order): "
+            << static_cast<double>(total_splits) / batch_index << " splits, "
+            << static_cast<double>(total_reads) / batch_index << " node reads, "
+            << static_cast<double>(total_writes) / batch_index << " node writes\n";
+        log << "  Flushes: " << flushes[static_cast<int>(SwareFlushReason::FULL)] << " full, "
+            << flushes[static_cast<int>(SwareFlushReason::EARLY)] << " early, "
+            << flushes[static_cast<int>(SwareFlushReason::DRAIN)] << " drain; "
+            << (total_items > 0 ? static_cast<double>(total_writes) / total_items : 0.0)
+            << " node writes per insert\n";
+    }
+    const uint64_t appends = sware.inOrderAppends() + sware.outOfOrderAppends();
+    if (appends > 0) {
+        log << "  In-order appends: "
+            << (100.0 * sware.inOrderAppends()) / appends << "%, buffer pages scanned/skipped by queries: "
+            << sware.pagesScanned() << "/" << sware.pagesSkipped() << "\n";
+    }
+    log << "  (INSERT latency is per flushed batch)\n";
+    printOpSummary(log, op_stats);
+    printIoSummary(log, ioDelta(io.snapshot(), io_start));
+    if (recorder) {
+        recorder->finish();
+        const std::string latency_csv = derivedCsvName(output_csv, "_latency");
+        if (!recorder->writeSummary(latency_csv)) {
+            log << "Error: Could not open latency output file: " << latency_csv << std::endl;
+        }
+        log << "  Latency percentiles (" << latency_csv << "):\n";
+        recorder->printSummary(log);
+    }
+    if (profiler) {
+        const std::string perf_csv = derivedCsvName(output_csv, "_perf");
+        if (!profiler->writeSummary(perf_csv)) {
+            log << "Error: Could not open perf output file: " << perf_csv << std::endl;
+        }
+        log << "  Hardware counters (" << perf_csv << "):\n";
+        profiler->printSummary(log);
+    }
+    log << "SWARE benchmark finished for " << output_csv << "." << std::endl;
+    summary.inserts = total_items;
+    return summary;
+}
+
+} // namespace
+
+RunSummary run_sware_benchmark(
+    ISpatialIndex* tree,
+    const CountingStorageManager& counters,
+    const IoMonitor& io,
+    WorkloadGenerator& workload_gen,
+    int num_insertions,
+    const SwareBufferOptions& buffer_options,
+    const std::string& output_csv,
+    LatencyRecorder* recorder,
+    PerfProfiler* profiler,
+    std::ostream& log
+) {
+    return dispatchDims(workload_gen.dims(), [&](auto dim) {
+        return runSwareBenchmarkDims<decltype(dim)::value>(tree, counters, io, workload_gen, num_insertions,
+                                                           buffer_options, output_csv, recorder, profiler, log);
+    });
 }
 
 } // namespace SpatialIndex
@@ -0,0 +1,464 @@
+#include "sware_buffer.h"
+#include "space_filling_curve.h"
+#include "query_runner.h"
+#include "rtree_helpers.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+namespace SpatialIndex {
+
+SwareOrder getSwareOrder(const std::string& order_str) {
+    std::string upper = order_str;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "HILBERT") return SwareOrder::HILBERT;
+    if (upper == "MORTON" || upper == "ZORDER") return SwareOrder::MORTON;
+    return SwareOrder::X; // Default
+}
+
+const char* swareOrderName(SwareOrder order) {
+    switch (order) {
+        case SwareOrder::HILBERT: return "HILBERT";
+        case SwareOrder::MORTON: return "MORTON";
+        default: return "X";
+    }
+}
+
+SwareFlushPolicy getSwareFlushPolicy(const std::string& policy_str) {
+    std::string upper = policy_str;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "ADAPTIVE") return SwareFlushPolicy::ADAPTIVE;
+    return SwareFlushPolicy::FIXED; // Default
+}
+
+const char* swareFlushPolicyName(SwareFlushPolicy policy) {
+    return policy == SwareFlushPolicy::ADAPTIVE ? "ADAPTIVE" : "FIXED";
+}
+
+const char* swareFlushReasonName(SwareFlushReason reason) {
+    switch (reason) {
+        case SwareFlushReason::EARLY: return "EARLY";
+        case SwareFlushReason::DRAIN: return "DRAIN";
+        default: return "FULL";
+    }
+}
+
+namespace {
+
+// Expected leaf touches per item for a batch of `batch` items, `overlap` of
+// which fall into `leaves` existing leaves and the rest are appended. Items
+// arriving in in-order runs of `run_length` fill leaves sequentially, so up to
+// a leaf's worth of consecutive items share one touch
+double predictedTouches(double batch, double overlap, double run_length, double leaves, double leaf_items) {
+    if (batch <= 0.0) return 0.0;
+    const double inside = batch * overlap;
+    const double group = std::min(leaf_items, std::max(1.0, run_length));
+    double touched = (batch - inside) / leaf_items;
+    if (leaves > 0.0) touched += leaves * -std::expm1(-(inside / group) / leaves);
+    return touched / batch;
+}
+
+template <uint32_t D>
+inline bool pointInBox(const double* c, const Region& box) {
+    for (uint32_t d = 0; d < D; ++d) {
+        if (c[d] < box.m_pLow[d] || c[d] > box.m_pHigh[d]) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+template <uint32_t D>
+BasicSwareBuffer<D>::BasicSwareBuffer(ISpatialIndex& tree, const SwareBufferOptions& options)
+    : tree_(tree), options_(options), sorted_prefix_(0),
+      last_key_(0), appends_since_flush_(0), runs_since_flush_(0), overlap_items_(0),
+      flushed_items_(0), flushed_low_key_(0), flushed_high_key_(0),
+      pages_scanned_(0), pages_skipped_(0),
+      in_order_appends_(0), out_of_order_appends_(0) {
+    if (options_.page_items == 0) options_.page_items = 1;
+    if (options_.leaf_items == 0) options_.leaf_items = 1;
+    if (options_.budget_bytes > 0) {
+        // Every page_items entries also carry one zonemap
+        const double item_bytes = sizeof(Entry) + static_cast<double>(sizeof(Zone)) / options_.page_items;
+        options_.capacity = static_cast<size_t>(options_.budget_bytes / item_bytes);
+    }
+    if (options_.capacity == 0) options_.capacity = 1;
+    items_.reserve(options_.capacity);
+    zones_.reserve(options_.capacity / options_.page_items + 1);
+}
+
+template <uint32_t D>
+BasicSwareBuffer<D>::~BasicSwareBuffer() {
+    // Do not lose buffered points; errors cannot propagate out of a destructor
+    try {
+        if (!items_.empty()) flushBatch(true);
+    } catch (...) {
+    }
+}
+
+template <uint32_t D>
+uint64_t BasicSwareBuffer<D>::sortKey(const double* coords) const {
+    if (options_.order == SwareOrder::X) return orderedDoubleKey(coords[0]);
+
+    uint32_t q[D];
+    for (uint32_t d = 0; d < D; ++d) {
+        q[d] = quantizeCoord(coords[d], options_.domain_low[d], options_.domain_high[d]);
+    }
+    return options_.order == SwareOrder::HILBERT ? hilbertKeyN<D>(q) : mortonKeyN<D>(q);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::extendZone(size_t idx) {
+    const Entry& e = items_[idx];
+    if (idx % options_.page_items == 0) {
+        Zone z;
+        for (uint32_t d = 0; d < D; ++d) z.low[d] = z.high[d] = e.coords[d];
+        zones_.push_back(z);
+        return;
+    }
+    Zone& z = zones_.back();
+    for (uint32_t d = 0; d < D; ++d) {
+        z.low[d] = std::min(z.low[d], e.coords[d]);
+        z.high[d] = std::max(z.high[d], e.coords[d]);
+    }
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::rebuildZones() {
+    zones_.clear();
+    for (size_t i = 0; i < items_.size(); ++i) extendZone(i);
+}
+
+template <uint32_t D>
+bool BasicSwareBuffer<D>::inFlushedRange(uint64_t key) const {
+    return flushed_items_ > 0 && key >= flushed_low_key_ && key <= flushed_high_key_;
+}
+
+template <uint32_t D>
+SwareFlushDecision BasicSwareBuffer<D>::evaluate(SwareFlushReason reason) const {
+    SwareFlushDecision decision;
+    decision.reason = reason;
+    decision.buffered = items_.size();
+    if (items_.empty()) return decision;
+
+    decision.run_length = runs_since_flush_ > 0
+        ? static_cast<double>(appends_since_flush_) / runs_since_flush_ : 0.0;
+    decision.overlap = static_cast<double>(overlap_items_) / items_.size();
+    const double leaf_items = static_cast<double>(options_.leaf_items);
+    const double leaves = std::ceil(flushed_items_ / leaf_items);
+    decision.touches_now = predictedTouches(static_cast<double>(items_.size()), decision.overlap,
+                                            decision.run_length, leaves, leaf_items);
+    // Assume the arrivals still to come look like the buffered ones
+    decision.touches_full = predictedTouches(static_cast<double>(std::max(items_.size(), options_.capacity)),
+                                             decision.overlap, decision.run_length, leaves, leaf_items);
+    return decision;
+}
+
+template <uint32_t D>
+bool BasicSwareBuffer<D>::flushDue() const {
+    if (full()) return true;
+    if (options_.policy != SwareFlushPolicy::ADAPTIVE) return false;
+    // Decide once per buffer page, so batches never shrink below a page
+    if (items_.empty() || items_.size() % options_.page_items != 0) return false;
+    // Cold start: with nothing flushed there is no key range to measure overlap
+    // against, so the model cannot tell sorted from random input. Only a buffer
+    // that is still one in-order run is flushed early; anything else waits for capacity
+    if (flushed_items_ == 0) return runs_since_flush_ == 1;
+    const SwareFlushDecision decision = evaluate(SwareFlushReason::EARLY);
+    return decision.touches_now - decision.touches_full <= options_.min_gain * decision.touches_now;
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::append(const double* coords, id_type id) {
+    Entry e;
+    e.key = sortKey(coords);
+    for (uint32_t d = 0; d < D; ++d) e.coords[d] = coords[d];
+    e.id = id;
+
+    if (appends_since_flush_ == 0 || e.key < last_key_) ++runs_since_flush_;
+    ++appends_since_flush_;
+    last_key_ = e.key;
+    if (inFlushedRange(e.key)) ++overlap_items_;
+
+    // Fast path: the buffer is still one sorted run and the new key extends it
+    const bool in_order = sorted_prefix_ == items_.size() &&
+                          (items_.empty() || e.key >= items_.back().key);
+    items_.push_back(e);
+    if (in_order) {
+        ++sorted_prefix_;
+        ++in_order_appends_;
+    } else {
+        ++out_of_order_appends_;
+    }
+    extendZone(items_.size() - 1);
+}
+
+template <uint32_t D>
+SwareFlushStats BasicSwareBuffer<D>::flushBatch(bool everything) {
+    SwareFlushStats stats;
+    const size_t n = items_.size();
+    stats.unsorted_items = n - sorted_prefix_;
+    stats.decision = evaluate(everything ? SwareFlushReason::DRAIN
+                                         : full() ? SwareFlushReason::FULL : SwareFlushReason::EARLY);
+    if (n == 0) return stats;
+
+    auto by_key = [](const Entry& a, const Entry& b) { return a.key < b.key; };
+
+    // Only the out-of-order tail needs sorting; it is then merged into the prefix
+    auto sort_start = std::chrono::high_resolution_clock::now();
+    if (sorted_prefix_ < n) {
+        std::sort(items_.begin() + sorted_prefix_, items_.end(), by_key);
+        std::inplace_merge(items_.begin(), items_.begin() + sorted_prefix_, items_.end(), by_key);
+    }
+    auto sort_end = std::chrono::high_resolution_clock::now();
+
+    size_t count = n;
+    // A buffer that is one sorted run expects no stragglers: ADAPTIVE moves all of it
+    const bool one_run = options_.policy == SwareFlushPolicy::ADAPTIVE && stats.unsorted_items == 0;
+    if (!everything && !one_run) {
+        const double frac = std::min(1.0, std::max(0.0, options_.flush_fraction));
+        count = std::min(n, std::max<size_t>(1, static_cast<size_t>(std::ceil(frac * n))));
+    }
+
+    // Ordered insert stream of the smallest keys
+    auto insert_start = std::chrono::high_resolution_clock::now();
+    PointInserter inserter(tree_, D);
+    for (size_t i = 0; i < count; ++i) inserter.insert(items_[i].coords, items_[i].id);
+    auto insert_end = std::chrono::high_resolution_clock::now();
+
+    flushed_low_key_ = flushed_items_ > 0 ? std::min(flushed_low_key_, items_[0].key) : items_[0].key;
+    flushed_high_key_ = flushed_items_ > 0 ? std::max(flushed_high_key_, items_[count - 1].key) : items_[count - 1].key;
+    flushed_items_ += count;
+
+    items_.erase(items_.begin(), items_.begin() + count);
+    sorted_prefix_ = items_.size();
+    rebuildZones();
+    appends_since_flush_ = runs_since_flush_ = 0;
+    overlap_items_ = 0;
+    for (const Entry& e : items_) {
+        if (inFlushedRange(e.key)) ++overlap_items_;
+    }
+
+    stats.items = count;
+    stats.remaining = items_.size();
+    stats.sort_us = std::chrono::duration_cast<std::chrono::microseconds>(sort_end - sort_start).count();
+    stats.insert_us = std::chrono::duration_cast<std::chrono::microseconds>(insert_end - insert_start).count();
+    return stats;
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::queryBuffer(const IShape& query, bool contains, IVisitor& v) {
+    Region mbr;
+    query.getMBR(mbr);
+    // For boxes and points the MBR test is exact; other shapes are refined per point
+    const bool exact = dynamic_cast<const Region*>(&query) != nullptr ||
+                       dynamic_cast<const Point*>(&query) != nullptr;
+
+    for (size_t p = 0; p < zones_.size(); ++p) {
+        const Zone& z = zones_[p];
+        bool overlaps = true;
+        for (uint32_t d = 0; d < D; ++d) {
+            overlaps = overlaps && z.high[d] >= mbr.m_pLow[d] && z.low[d] <= mbr.m_pHigh[d];
+        }
+        if (!overlaps) {
+            ++pages_skipped_;
+            continue;
+        }
+        ++pages_scanned_;
+
+        const size_t end = std::min(items_.size(), (p + 1) * options_.page_items);
+        for (size_t i = p * options_.page_items; i < end; ++i) {
+            const Entry& e = items_[i];
+            if (!pointInBox<D>(e.coords, mbr)) continue;
+            if (!exact) {
+                Point pt(e.coords, D);
+                if (!(contains ? query.containsShape(pt) : query.intersectsShape(pt))) continue;
+            }
+            PointData data(e.id, e.coords, D);
+            v.visitData(data);
+        }
+    }
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::insertData(uint32_t len, const uint8_t* pData, const IShape& shape, id_type shapeIdentifier) {
+    const Point* pt = dynamic_cast<const Point*>(&shape);
+    if (pt == nullptr || pt->m_dimension != D || len != 0) {
+        // The buffer only holds bare D-dimensional points
+        flushBatch(true);
+        tree_.insertData(len, pData, shape, shapeIdentifier);
+        return;
+    }
+    append(pt->m_pCoords, shapeIdentifier);
+    if (flushDue()) flushBatch();
+}
+
+template <uint32_t D>
+bool BasicSwareBuffer<D>::deleteData(const IShape& shape, id_type shapeIdentifier) {
+    const Point* pt = dynamic_cast<const Point*>(&shape);
+    if (pt != nullptr && pt->m_dimension == D) {
+        const double* c = pt->m_pCoords;
+        for (size_t p = 0; p < zones_.size(); ++p) {
+            const Zone& z = zones_[p];
+            bool inside = true;
+            for (uint32_t d = 0; d < D; ++d) inside = inside && c[d] >= z.low[d] && c[d] <= z.high[d];
+            if (!inside) continue;
+
+            const size_t end = std::min(items_.size(), (p + 1) * options_.page_items);
+            for (size_t i = p * options_.page_items; i < end; ++i) {
+                const Entry& e = items_[i];
+                bool same = e.id == shapeIdentifier;
+                for (uint32_t d = 0; d < D; ++d) same = same && e.coords[d] == c[d];
+                if (same) {
+                    // Erasing keeps relative order, so the sorted prefix only shrinks
+                    if (inFlushedRange(e.key)) --overlap_items_;
+                    items_.erase(items_.begin() + i);
+                    if (i < sorted_prefix_) --sorted_prefix_;
+                    rebuildZones();
+                    return true;
+                }
+            }
+        }
+    }
+    return tree_.deleteData(shape, shapeIdentifier);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::containsWhatQuery(const IShape& query, IVisitor& v) {
+    queryBuffer(query, true, v);
+    tree_.containsWhatQuery(query, v);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::intersectsWithQuery(const IShape& query, IVisitor& v) {
+    queryBuffer(query, false, v);
+    tree_.intersectsWithQuery(query, v);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::pointLocationQuery(const Point& query, IVisitor& v) {
+    queryBuffer(query, false, v);
+    tree_.pointLocationQuery(query, v);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v, INearestNeighborComparator& nnc) {
+    // Custom distance functions are evaluated by the tree only
+    flushBatch(true);
+    tree_.nearestNeighborQuery(k, query, v, nnc);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::nearestNeighborQuery(uint32_t k, const IShape& query, IVisitor& v) {
+    if (k == 0) return;
+
+    NeighborCollector collector(query, v);
+    tree_.nearestNeighborQuery(k, query, collector);
+
+    // Max-heap of the k best candidates seen so far
+    std::priority_queue<Neighbor> best;
+    for (const Neighbor& nb : collector.found) {
+        best.push(nb);
+        if (best.size() > k) best.pop();
+    }
+
+    // Visit buffer pages closest-first and stop once no page can beat the k-th distance
+    std::vector<std::pair<double, size_t>> pages;
+    pages.reserve(zones_.size());
+    for (size_t p = 0; p < zones_.size(); ++p) {
+        Region zone(zones_[p].low, zones_[p].high, D);
+        pages.emplace_back(query.getMinimumDistance(zone), p);
+    }
+    std::sort(pages.begin(), pages.end());
+
+    const Point* qpt = dynamic_cast<const Point*>(&query);
+    for (const auto& page : pages) {
+        if (best.size() == k && page.first > best.top().dist) {
+            ++pages_skipped_;
+            continue;
+        }
+        ++pages_scanned_;
+
+        const size_t end = std::min(items_.size(), (page.second + 1) * options_.page_items);
+        for (size_t i = page.second * options_.page_items; i < end; ++i) {
+            const Entry& e = items_[i];
+            Neighbor nb;
+            if (qpt != nullptr) {
+                double sum = 0.0;
+                for (uint32_t d = 0; d < D; ++d) {
+                    const double diff = e.coords[d] - qpt->m_pCoords[d];
+                    sum += diff * diff;
+                }
+                nb.dist = std::sqrt(sum);
+            } else {
+                nb.dist = query.getMinimumDistance(Point(e.coords, D));
+            }
+            if (best.size() == k && nb.dist >= best.top().dist) continue;
+            nb.id = e.id;
+            for (uint32_t d = 0; d < D; ++d) nb.coords[d] = e.coords[d];
+            best.push(nb);
+            if (best.size() > k) best.pop();
+        }
+    }
+
+    // Report nearest first, as the tree does
+    std::vector<Neighbor> result;
+    result.reserve(best.size());
+    while (!best.empty()) {
+        result.push_back(best.top());
+        best.pop();
+    }
+    for (auto it = result.rbegin(); it != result.rend(); ++it) {
+        PointData data(it->id, it->coords, D);
+        v.visitData(data);
+    }
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::selfJoinQuery(const IShape& s, IVisitor& v) {
+    flushBatch(true);
+    tree_.selfJoinQuery(s, v);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::queryStrategy(IQueryStrategy& qs) {
+    flushBatch(true);
+    tree_.queryStrategy(qs);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::getIndexProperties(Tools::PropertySet& out) const {
+    tree_.getIndexProperties(out);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::addCommand(ICommand* in, CommandType ct) {
+    tree_.addCommand(in, ct);
+}
+
+template <uint32_t D>
+bool BasicSwareBuffer<D>::isIndexValid() {
+    return tree_.isIndexValid();
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::getStatistics(IStatistics** out) const {
+    tree_.getStatistics(out);
+}
+
+template <uint32_t D>
+void BasicSwareBuffer<D>::flush() {
+    flushBatch(true);
+    tree_.flush();
+}
+
+template class BasicSwareBuffer<2>;
+template class BasicSwareBuffer<3>;
+template class BasicSwareBuffer<4>;
+
+} // namespace SpatialIndex
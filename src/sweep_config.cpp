@@ -0,0 +1,253 @@
+#include "sweep_config.h"
+#include <algorithm>
+#include <cctype>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <toml++/toml.hpp>
+
+namespace SpatialIndex {
+
+namespace {
+
+using ValueMap = std::map<std::string, std::string>;
+
+// Keys that fill ExperimentArgs fields rather than key=value options
+const std::set<std::string> kPositionalKeys = {
+    "num_insertions", "tree_variant", "data_type", "page_size_bytes",
+    "M_capacity", "fill_factor", "buffer_type", "buffer_size_mb", "disk_base_name"
+};
+
+// Swept keys the run_experiments.py file name already encodes
+const std::set<std::string> kNamedKeys = {
+    "num_insertions", "data_type", "M_capacity", "fill_factor", "buffer_type", "buffer_size_mb"
+};
+
+std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+std::string upper(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::toupper);
+    return s;
+}
+
+// Scalars as run_rtree parses them (booleans as 1 / 0)
+std::string scalarString(const toml::node& node, const std::string& key) {
+    if (const auto* s = node.as_string()) return s->get();
+    if (const auto* i = node.as_integer()) return std::to_string(i->get());
+    if (const auto* b = node.as_boolean()) return b->get() ? "1" : "0";
+    if (const auto* f = node.as_floating_point()) {
+        std::ostringstream os;
+        os.precision(15);
+        os << f->get();
+        return os.str();
+    }
+    throw std::invalid_argument("Unsupported value for " + key + " (expected a string, number or boolean)");
+}
+
+// A scalar, or every element of an array
+std::vector<std::string> valuesOf(const toml::node& node, const std::string& key) {
+    std::vector<std::string> values;
+    if (const auto* arr = node.as_array()) {
+        for (const toml::node& element : *arr) values.push_back(scalarString(element, key));
+        if (values.empty()) throw std::invalid_argument("Empty value list for " + key);
+    } else {
+        values.push_back(scalarString(node, key));
+    }
+    return values;
+}
+
+std::string get(const ValueMap& values, const std::string& key, const std::string& def) {
+    auto it = values.find(key);
+    return it == values.end() ? def : it->second;
+}
+
+// The output name run_experiments.py gives this combination
+std::string experimentName(const std::string& run_type, const ValueMap& v) {
+    const std::string data_type = get(v, "data_type", "RANDOM");
+    std::string name = run_type + "_M" + get(v, "M_capacity", "16") + "_fill" +
+                       std::to_string(static_cast<int>(std::stod(get(v, "fill_factor", "0.5")) * 100)) +
+                       "_N" + get(v, "num_insertions", "100000") + "_" + lower(data_type);
+    if (upper(data_type) == "NEARLY_SORTED") {
+        name += "_K" + get(v, "sort_k", "10") + "_L" + get(v, "sort_l", "100");
+    }
+    if (std::stoul(get(v, "dims", "2")) != 2) name += "_d" + get(v, "dims", "2");
+    const std::string storage = upper(get(v, "storage", "DEFAULT"));
+    if (run_type == "mem" && storage == "ARENA") name += "_arena";
+    if (run_type == "disk") {
+        const std::string buffer_type = upper(get(v, "buffer_type", "NONE"));
+        name += "_buf" + buffer_type + "_" + get(v, "buffer_size_mb", "0") + "MB";
+        if (buffer_type == "SWARE") {
+            name += "_" + lower(get(v, "sware_order", "X"));
+            if (upper(get(v, "sware_policy", "FIXED")) == "ADAPTIVE") name += "_adaptive";
+            const std::string page_buffer = upper(get(v, "sware_page_buffer", "NONE"));
+            if (page_buffer != "NONE") name += "_" + lower(page_buffer);
+        }
+        if (storage == "DIRECT") name += "_direct_" + lower(get(v, "io_engine", "AUTO"));
+        const std::string leaf_codec = upper(get(v, "leaf_codec", "NONE"));
+        if (leaf_codec != "NONE") name += "_leaf" + lower(leaf_codec);
+        if (std::stoul(get(v, "async_dirty_pages", "0")) > 0) name += "_async" + get(v, "async_dirty_pages", "0");
+        if (buffer_type == "LRUK") {
+            name += "_k" + get(v, "lru_k", "2");
+        } else if (buffer_type == "LEVEL" && std::stoul(get(v, "pin_levels", "0")) > 0) {
+            name += "_pin" + get(v, "pin_levels", "0");
+        }
+    }
+    const std::string build = upper(get(v, "build", "INCREMENTAL"));
+    if (build != "INCREMENTAL") name += "_build" + build;
+    const std::string index = upper(get(v, "index", "SINGLE"));
+    if (index == "SHARDED") {
+        name += "_sharded_" + lower(get(v, "shard_partition", "GRID"));
+    } else if (index == "CONCURRENT") {
+        name += "_concurrent_" + lower(get(v, "concurrency", "GLOBAL_LOCK"));
+    } else if (index == "PACKED") {
+        name += "_packed";
+    } else if (index == "LSM") {
+        name += "_lsm_f" + get(v, "lsm_fanout", "4");
+    } else if (!get(v, "restart", "").empty()) {
+        name += "_restart_" + lower(get(v, "restart", ""));
+        if (std::stoul(get(v, "prewarm", "0")) > 0) name += "_prewarm" + get(v, "prewarm", "0");
+    } else if (!get(v, "updates", "").empty()) {
+        name += "_updates_" + lower(get(v, "updates", ""));
+    } else if (upper(get(v, "ingest", "SERIAL")) == "PIPELINE") {
+        name += "_pipeline";
+    }
+    if (std::stod(get(v, "range_ratio", "0")) > 0 || std::stod(get(v, "knn_ratio", "0")) > 0) name += "_mixed";
+    const std::string workload_file = get(v, "workload_file", "");
+    if (!workload_file.empty()) {
+        std::string stem = workload_file.substr(workload_file.find_last_of('/') + 1);
+        stem = stem.substr(0, stem.find_last_of('.'));
+        name += "_replay_" + stem;
+    }
+    return name;
+}
+
+// File-name friendly form of a swept value
+std::string nameToken(const std::string& value) {
+    std::string token;
+    for (char c : value) {
+        if (std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '-') token += static_cast<char>(::tolower(c));
+    }
+    return token;
+}
+
+} // namespace
+
+SweepConfig loadSweepConfig(const std::string& path) {
+    toml::table config;
+    try {
+        config = toml::parse_file(path);
+    } catch (const toml::parse_error& e) {
+        std::ostringstream os;
+        os << "Could not parse " << path << ": " << e.description() << " (" << e.source().begin << ")";
+        throw std::runtime_error(os.str());
+    }
+
+    SweepConfig sweep;
+    if (const toml::table* settings = config["sweep"].as_table()) {
+        for (const auto& [key, node] : *settings) {
+            sweep.settings[std::string(key.str())] = scalarString(node, std::string(key.str()));
+        }
+    }
+
+    // Top-level values apply to every section; M, fill and the buffer are per section
+    std::map<std::string, std::vector<std::string>> globals;
+    for (const auto& [key, node] : config) {
+        const std::string k(key.str());
+        if (node.is_table() || k == "M_capacity" || k == "fill_factor" ||
+            k == "buffer_type" || k == "buffer_size_mb") {
+            continue;
+        }
+        globals[k] = valuesOf(node, k);
+    }
+
+    std::set<std::string> names;
+    for (const auto& [key, node] : config) {
+        const std::string section(key.str());
+        const toml::table* settings = node.as_table();
+        if (!settings || section == "sweep" || !(*settings)["run"].value_or(false)) continue;
+
+        std::string run_type;
+        if (section.find("on_disk") != std::string::npos) {
+            run_type = "disk";
+        } else if (section.find("in_memory") != std::string::npos) {
+            run_type = "mem";
+        } else {
+            sweep.skipped.push_back(section);
+            continue;
+        }
+
+        std::map<std::string, std::vector<std::string>> values = globals;
+        for (const auto& [skey, snode] : *settings) {
+            const std::string k(skey.str());
+            if (k != "run") values[k] = valuesOf(snode, k);
+        }
+
+        // Walk the cartesian product like an odometer, last key fastest
+        std::vector<size_t> pos(values.size(), 0);
+        for (;;) {
+            SweepExperiment exp;
+            exp.index = sweep.experiments.size();
+            exp.section = section;
+            ValueMap v;
+            size_t i = 0;
+            for (const auto& [k, list] : values) {
+                v[k] = list[pos[i++]];
+                if (list.size() > 1) exp.grid.emplace_back(k, v[k]);
+            }
+
+            ExperimentArgs& args = exp.args;
+            args.run_type = run_type;
+            args.M = std::stoi(get(v, "M_capacity", "16"));
+            args.fill_factor = std::stod(get(v, "fill_factor", "0.5"));
+            args.num_insertions = std::stoi(get(v, "num_insertions", "100000"));
+            args.tree_variant = get(v, "tree_variant", "LINEAR");
+            args.data_type = get(v, "data_type", "RANDOM");
+            args.page_size = std::stoi(get(v, "page_size_bytes", "4096"));
+            if (run_type == "disk") {
+                args.buffer_type = upper(get(v, "buffer_type", "NONE"));
+                const double buffer_mb = std::stod(get(v, "buffer_size_mb", "0"));
+                if (buffer_mb > 0 && args.page_size > 0) {
+                    args.buffer_pages = static_cast<int>(buffer_mb * 1024 * 1024 / args.page_size);
+                }
+            }
+            for (const auto& [k, value] : v) {
+                if (!kPositionalKeys.count(k)) args.options[k] = value;
+            }
+
+            std::string name = experimentName(run_type, v);
+            for (const auto& [k, value] : exp.grid) {
+                if (kNamedKeys.count(k)) continue;
+                name += "_" + (k == "tree_variant" ? std::string() : nameToken(k)) + nameToken(value);
+            }
+            if (names.count(name)) name += "_" + nameToken(section);
+            const std::string base = name;
+            for (size_t n = 2; names.count(name); ++n) name = base + "_" + std::to_string(n);
+            names.insert(name);
+            args.output_file = name + ".csv";
+            // Runs that reuse index files default to run_rtree's base name, so a
+            // REOPEN finds what a BUILD (or an earlier run_rtree) left behind
+            const bool reuses_files = !get(v, "restart", "").empty() ||
+                                      std::stoi(get(v, "open_existing", "0")) != 0;
+            const std::string base_name = get(v, "disk_base_name", "");
+            exp.keep_files = reuses_files || !base_name.empty();
+            args.disk_base_name = !base_name.empty() ? base_name
+                                : reuses_files ? std::string("disk_tree_data")
+                                : "disk_tree_data_sweep" + std::to_string(exp.index);
+            sweep.experiments.push_back(std::move(exp));
+
+            size_t k = pos.size();
+            auto list = values.rbegin();
+            while (k > 0 && ++pos[k - 1] == list->second.size()) {
+                pos[--k] = 0;
+                ++list;
+            }
+            if (k == 0) break;
+        }
+    }
+    return sweep;
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <spatialindex/SpatialIndex.h>
+
+#include "experiment.h"
+#include "sweep_config.h"
+
+using namespace SpatialIndex;
+
+static std::string getOpt(const std::map<std::string, std::string>& opts,
+                          const std::string& key, const std::string& def) {
+    auto it = opts.find(key);
+    return it == opts.end() ? def : it->second;
+}
+
+// CSV field, quoted when it holds a separator or a quote
+static std::string csvField(const std::string& s) {
+    if (s.find_first_of(",\"\n") == std::string::npos) return s;
+    std::string quoted = "\"";
+    for (char c : s) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// CPUs this process may run on
+static std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; ++c) {
+            if (CPU_ISSET(c, &set)) cpus.push_back(c);
+        }
+    }
+    if (cpus.empty()) cpus.push_back(0);
+    return cpus;
+}
+
+// Files of one experiment's trees, sort runs and LSM components
+static void removeDiskFiles(const std::string& base_name) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(".", ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, base_name.size(), base_name) == 0 && name.size() > base_name.size() &&
+            (name[base_name.size()] == '.' || name[base_name.size()] == '_')) {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Usage: sweep_rtree [config.toml] [key=value ...]
+    // Settings (also read from a [sweep] table in the config; arguments win):
+    //   threads  experiments run at once (default: allowed CPUs / cpus)
+    //   cpus     CPUs pinned to each experiment, default 1; raise it for
+    //            multi-threaded modes (SHARDED, CONCURRENT, PIPELINE, LSM)
+    //   pin      1 = pin each worker to its CPUs (default), 0 = leave it to the scheduler
+    //   out_dir  directory for result CSVs and per-experiment logs (default .)
+    //   results  consolidated table (default sweep_results.csv in out_dir)
+    //   only     run sections whose name contains this text
+    //   dry_run  1 = list the expanded experiments without running them
+    // The results table has the wall time of each experiment (setup included) and,
+    // for the serial, pipelined and SWARE runners, the throughput and latency they
+    // measured inside their timed operations; other runners keep those in their CSVs.
+    std::string config_path = "config.toml";
+    std::map<std::string, std::string> cli;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto eq = arg.find('=');
+        if (eq == std::string::npos) {
+            config_path = arg;
+        } else if (eq > 0) {
+            cli[arg.substr(0, eq)] = arg.substr(eq + 1);
+        }
+    }
+
+    SweepConfig sweep;
+    try {
+        sweep = loadSweepConfig(config_path);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::map<std::string, std::string> settings = sweep.settings;
+    for (const auto& [key, value] : cli) settings[key] = value;
+    for (const std::string& section : sweep.skipped) {
+        std::cout << "Skipping unknown experiment type: " << section << std::endl;
+    }
+
+    std::vector<SweepExperiment> experiments;
+    const std::string only = getOpt(settings, "only", "");
+    for (SweepExperiment& exp : sweep.experiments) {
+        if (only.empty() || exp.section.find(only) != std::string::npos) experiments.push_back(std::move(exp));
+    }
+
+    // Experiments sharing a disk_base_name run in order on one worker
+    std::vector<std::vector<size_t>> jobs;
+    std::map<std::string, size_t> job_of;
+    for (size_t i = 0; i < experiments.size(); ++i) {
+        const auto it = job_of.emplace(experiments[i].args.disk_base_name, jobs.size()).first;
+        if (it->second == jobs.size()) jobs.emplace_back();
+        jobs[it->second].push_back(i);
+    }
+
+    const std::vector<int> cpus = allowedCpus();
+    size_t cpus_per, threads;
+    bool pin, dry_run;
+    std::filesystem::path out_dir;
+    std::string results_path;
+    try {
+        cpus_per = std::max<size_t>(1, std::stoul(getOpt(settings, "cpus", "1")));
+        threads = std::stoul(getOpt(settings, "threads", std::to_string(std::max<size_t>(1, cpus.size() / cpus_per))));
+        threads = std::max<size_t>(1, std::min(threads, jobs.size()));
+        pin = std::stoi(getOpt(settings, "pin", "1")) != 0;
+        dry_run = std::stoi(getOpt(settings, "dry_run", "0")) != 0;
+        out_dir = getOpt(settings, "out_dir", ".");
+        std::filesystem::create_directories(out_dir);
+        results_path = (out_dir / getOpt(settings, "results", "sweep_results.csv")).lexically_normal().string();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid sweep setting: " << e.what() << std::endl;
+        return 1;
+    }
+    for (SweepExperiment& exp : experiments) {
+        exp.args.output_file = (out_dir / exp.args.output_file).lexically_normal().string();
+    }
+
+    std::cout << "Loaded " << experiments.size() << " experiments from " << config_path << "; running "
+              << threads << " at a time" << (pin ? ", " + std::to_string(cpus_per) + " CPU(s) each" : "")
+              << " -> " << results_path << std::endl;
+    if (dry_run) {
+        for (const SweepExperiment& exp : experiments) {
+            std::cout << "  [" << exp.section << "] " << exp.args.output_file;
+            for (const auto& [key, value] : exp.grid) std::cout << " " << key << "=" << value;
+            std::cout << "\n";
+        }
+        return 0;
+    }
+
+    std::ofstream results(results_path);
+    if (!results.is_open()) {
+        std::cerr << "Error: Could not open results file: " << results_path << std::endl;
+        return 1;
+    }
+    results << "Experiment,Section,RunType,Variant,DataType,M,Fill,N,BufferType,BufferPages,PageSize,"
+               "Options,Cpus,Status,WallTime_s,Ops,Timed_s,OpsPerSec,AvgInsert_us,AvgQuery_us,OutputCsv,Log,Error\n";
+
+    std::mutex results_mutex;
+    std::atomic<size_t> next(0);
+    size_t finished = 0, failed = 0;
+    const auto sweep_start = std::chrono::steady_clock::now();
+
+    auto worker = [&](size_t w) {
+        std::string cpu_list;
+        if (pin) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (size_t c = 0; c < cpus_per; ++c) {
+                const int cpu = cpus[(w * cpus_per + c) % cpus.size()];
+                CPU_SET(cpu, &set);
+                cpu_list += (cpu_list.empty() ? "" : " ") + std::to_string(cpu);
+            }
+            // Threads the experiments start inherit this mask
+            if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+                std::lock_guard<std::mutex> lock(results_mutex);
+                std::cerr << "Warning: could not pin worker " << w << " to CPUs " << cpu_list << std::endl;
+                cpu_list.clear();
+            }
+        }
+
+        for (size_t j = next++; j < jobs.size(); j = next++) {
+            for (size_t i : jobs[j]) {
+                const SweepExperiment& exp = experiments[i];
+                const ExperimentArgs& args = exp.args;
+                std::string log_path = args.output_file;
+                if (log_path.size() > 4 && log_path.compare(log_path.size() - 4, 4, ".csv") == 0) log_path.resize(log_path.size() - 4);
+                log_path += ".log";
+
+                std::string error;
+                ExperimentResult result;
+                const auto t_start = std::chrono::steady_clock::now();
+                {
+                    // Each experiment writes to its own log; workers share the console only under results_mutex
+                    std::ofstream log(log_path);
+                    if (!log.is_open()) {
+                        error = "Could not open log file: " + log_path;
+                    } else {
+                        try {
+                            result = runExperiment(args, log);
+                        } catch (const std::exception& e) {
+                            error = e.what();
+                        } catch (Tools::Exception& e) {
+                            error = e.what();
+                        } catch (...) {
+                            error = "unknown exception";
+                        }
+                        if (!error.empty()) log << "Error during benchmark execution: " << error << std::endl;
+                    }
+                }
+                const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+                if (!exp.keep_files) removeDiskFiles(args.disk_base_name);
+
+                // Runner measurements; empty for runners that report one row per configuration
+                std::ostringstream measured;
+                if (result.ops > 0) {
+                    measured << result.ops << "," << result.timed_s << "," << result.opsPerSec() << ","
+                             << result.avg_insert_us << "," << result.avg_query_us;
+                } else {
+                    measured << ",,,,";
+                }
+
+                std::string options;
+                for (const auto& [key, value] : args.options) options += (options.empty() ? "" : ";") + key + "=" + value;
+
+                std::lock_guard<std::mutex> lock(results_mutex);
+                results << exp.index << "," << csvField(exp.section) << "," << args.run_type << ","
+                        << args.tree_variant << "," << args.data_type << "," << args.M << "," << args.fill_factor << ","
+                        << args.num_insertions << "," << args.buffer_type << "," << args.buffer_pages << ","
+                        << args.page_size << "," << csvField(options) << "," << cpu_list << ","
+                        << (error.empty() ? "OK" : "FAILED") << "," << wall_s << "," << measured.str() << ","
+                        << csvField(args.output_file) << ","
+                        << csvField(log_path) << "," << csvField(error) << std::endl;
+                ++finished;
+                if (!error.empty()) ++failed;
+                std::cout << "[" << finished << "/" << experiments.size() << "] " << (error.empty() ? "Finished " : "FAILED ")
+                          << "[" << exp.section << "] " << args.output_file << " in " << wall_s << " s" << std::endl;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t w = 0; w < threads; ++w) pool.emplace_back(worker, w);
+    for (std::thread& t : pool) t.join();
+
+    results.close();
+
+    const double total_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - sweep_start).count();
+    std::cout << "Sweep completed: " << finished - failed << " of " << experiments.size() << " experiments in "
+              << total_s << " s (" << failed << " failed). Results in " << results_path << std::endl;
+    return failed == 0 ? 0 : 1;
+}
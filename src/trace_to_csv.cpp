@@ -0,0 +1,75 @@
+// Converts a binary op trace written by run_rtree (trace_file=...) to CSV.
+// With --inserts the output uses the insert CSV columns read by
+// scripts/examine_insert_csv.ipynb (InsertIdx,Time_us,DidSplit,IsRootSplit).
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "instrumentation.h"
+
+using namespace SpatialIndex;
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc > 4 || (argc == 4 && std::string(argv[3]) != "--inserts")) {
+        std::cerr << "Usage: " << argv[0] << " <trace.bin> <out.csv> [--inserts]\n";
+        return 1;
+    }
+    const bool inserts_only = (argc == 4);
+
+    std::FILE* in = std::fopen(argv[1], "rb");
+    if (!in) {
+        std::cerr << "Error: Could not open trace file: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    char magic[sizeof(kTraceMagic)];
+    uint32_t version = 0, record_size = 0;
+    if (std::fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+        std::memcmp(magic, kTraceMagic, sizeof(magic)) != 0 ||
+        std::fread(&version, sizeof(version), 1, in) != 1 ||
+        std::fread(&record_size, sizeof(record_size), 1, in) != 1 ||
+        version != kTraceVersion || record_size != sizeof(TraceRecord)) {
+        std::cerr << "Error: " << argv[1] << " is not a version " << kTraceVersion << " trace." << std::endl;
+        std::fclose(in);
+        return 1;
+    }
+
+    std::ofstream out(argv[2]);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open output file: " << argv[2] << std::endl;
+        std::fclose(in);
+        return 1;
+    }
+    if (inserts_only) {
+        out << "InsertIdx,Time_us,DidSplit,IsRootSplit,Time_ns,NodeWrites\n";
+    } else {
+        out << "OpIdx,Phase,Time_ns,Time_us,DidSplit,IsRootSplit,Nodes\n";
+    }
+
+    std::vector<TraceRecord> batch(4096);
+    uint64_t rows = 0;
+    size_t n;
+    while ((n = std::fread(batch.data(), sizeof(TraceRecord), batch.size(), in)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            const TraceRecord& r = batch[i];
+            const auto phase = static_cast<LatencyPhase>(r.phase);
+            const int did_split = (r.flags & kTraceDidSplit) ? 1 : 0;
+            const int root_split = (r.flags & kTraceRootSplit) ? 1 : 0;
+            if (inserts_only) {
+                if (phase != LatencyPhase::INSERT && phase != LatencyPhase::SPLIT) continue;
+                out << r.op_idx << "," << r.latency_ns / 1000.0 << "," << did_split << ","
+                    << root_split << "," << r.latency_ns << "," << r.nodes << "\n";
+            } else {
+                out << r.op_idx << "," << latencyPhaseName(phase) << "," << r.latency_ns << ","
+                    << r.latency_ns / 1000.0 << "," << did_split << "," << root_split << ","
+                    << r.nodes << "\n";
+            }
+            ++rows;
+        }
+    }
+    std::fclose(in);
+    std::cout << "Wrote " << rows << " rows to " << argv[2] << std::endl;
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "tree_counters.h"
+#include "rtree_helpers.h"
+#include "leaf_codec.h"
+#include <cstring>
+
+namespace SpatialIndex {
+
+int64_t nodeLevel(const uint8_t* data, uint32_t len) {
+    if (len < 2 * sizeof(uint32_t)) return -1;
+    uint32_t type, level;
+    std::memcpy(&type, data, sizeof(uint32_t));
+    std::memcpy(&level, data + sizeof(uint32_t), sizeof(uint32_t));
+    // PersistentIndex = 1 (level > 0), PersistentLeaf = 2 (level 0), compact leaves
+    if ((type == 2 && level == 0) || (type == 1 && level > 0) || (type == kCompactLeafType && level == 0)) {
+        return level;
+    }
+    return -1;
+}
+
+CountingStorageManager::CountingStorageManager(IStorageManager& inner)
+    : inner_(inner), header_page_(StorageManager::NewPage),
+      node_reads_(0), node_writes_(0), node_allocs_(0), node_deletes_(0),
+      root_splits_(0), height_(1), nodes_base_(0), splits_base_(0) {
+    for (uint32_t l = 0; l < kMaxLevels; ++l) {
+        allocs_per_level_[l].store(0, std::memory_order_relaxed);
+        root_splits_per_level_[l].store(0, std::memory_order_relaxed);
+    }
+}
+
+void CountingStorageManager::attach(ISpatialIndex& tree, id_type header_page) {
+    header_page_ = header_page;
+    nodes_base_ = rtree_nodes(tree);
+    splits_base_ = rtree_splits(tree);
+    height_.store(rtree_height(tree), std::memory_order_relaxed);
+
+    node_reads_.store(0, std::memory_order_relaxed);
+    node_writes_.store(0, std::memory_order_relaxed);
+    node_allocs_.store(0, std::memory_order_relaxed);
+    node_deletes_.store(0, std::memory_order_relaxed);
+    root_splits_.store(0, std::memory_order_relaxed);
+    for (uint32_t l = 0; l < kMaxLevels; ++l) {
+        allocs_per_level_[l].store(0, std::memory_order_relaxed);
+        root_splits_per_level_[l].store(0, std::memory_order_relaxed);
+    }
+}
+
+TreeCounterSnapshot CountingStorageManager::snapshot() const {
+    TreeCounterSnapshot s;
+    s.node_reads = nodeReads();
+    s.node_writes = nodeWrites();
+    s.node_allocs = node_allocs_.load(std::memory_order_relaxed);
+    s.node_deletes = node_deletes_.load(std::memory_order_relaxed);
+    s.root_splits = root_splits_.load(std::memory_order_relaxed);
+    s.splits = splits_base_ + s.node_allocs - s.root_splits;
+    s.nodes = nodes_base_ + s.node_allocs - s.node_deletes;
+    s.height = height();
+    return s;
+}
+
+uint64_t CountingStorageManager::splitsAtLevel(uint32_t level) const {
+    if (level >= kMaxLevels) return 0;
+    return allocs_per_level_[level].load(std::memory_order_relaxed) -
+           root_splits_per_level_[level].load(std::memory_order_relaxed);
+}
+
+void CountingStorageManager::loadByteArray(const id_type page, uint32_t& len, uint8_t** data) {
+    inner_.loadByteArray(page, len, data);
+    if (page != header_page_) node_reads_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CountingStorageManager::storeByteArray(id_type& page, const uint32_t len, const uint8_t* const data) {
+    const bool is_new = (page == StorageManager::NewPage);
+    const bool is_header = !is_new && page == header_page_;
+    inner_.storeByteArray(page, len, data);
+    if (is_header) return;
+
+    const int64_t level = nodeLevel(data, len);
+    if (is_new) {
+        node_allocs_.fetch_add(1, std::memory_order_relaxed);
+        if (level >= 0 && level < kMaxLevels) {
+            allocs_per_level_[level].fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    node_writes_.fetch_add(1, std::memory_order_relaxed);
+    // The root page rewritten one level up means the old root was split
+    const uint32_t h = height_.load(std::memory_order_relaxed);
+    if (level >= 0 && static_cast<uint32_t>(level) + 1 > h) {
+        height_.store(static_cast<uint32_t>(level) + 1, std::memory_order_relaxed);
+        root_splits_.fetch_add(1, std::memory_order_relaxed);
+        if (level - 1 < kMaxLevels) {
+            root_splits_per_level_[level - 1].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void CountingStorageManager::deleteByteArray(const id_type page) {
+    inner_.deleteByteArray(page);
+    node_deletes_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CountingStorageManager::flush() {
+    inner_.flush();
+}
+
+} // namespace SpatialIndex
@@ -1,9 +1,19 @@
 // src/tree_setup.cpp
 #include "tree_setup.h"
+#include "bulk_load.h"
+#include "page_buffer.h"
+#include "direct_storage.h"
+#include "arena_storage.h"
+#include "workload_generator.h"
+#include "rtree_helpers.h"
+#include "latency_histogram.h"
 #include <iostream>
+#include <fstream>
 #include <cstdio>
+#include <memory>
 #include <algorithm>
 #include <stdexcept>
+#include <vector>
 
 namespace SpatialIndex {
 
@@ -16,109 +26,336 @@ RTree::RTreeVariant getRTreeVariant(const std::string& variant_str) {
     return RTree::RV_LINEAR; // Default
 }
 
+// Create the tree on top of `sm`, either empty or bulk loaded from `points`,
+// else from config.bulk_data_file, else from the generator
+static ISpatialIndex* createTree(const TreeConfig& config, IStorageManager& sm,
+                                 WorkloadGenerator* source, PointSource* points, id_type& index_id) {
+    std::string build_upper = config.build_mode;
+    std::transform(build_upper.begin(), build_upper.end(), build_upper.begin(), ::toupper);
 
-TreeResources setupTree(const TreeConfig& config) {
+    if (build_upper.empty() || build_upper == "INCREMENTAL") {
+        return RTree::createNewRTree(
+            sm, config.fill_factor, config.M_capacity,
+            config.leafCapacity(), config.dims, config.tree_variant, index_id
+        );
+    }
+    if (config.dims != 2) {
+        throw std::runtime_error("Bulk loading supports 2-D points only (dims=" +
+                                 std::to_string(config.dims) + ").");
+    }
+    if (points) return bulkLoadTree(config, sm, *points, index_id);
+
+    std::unique_ptr<PointSource> owned;
+    if (!config.bulk_data_file.empty()) {
+        if (!config.quiet) {
+            *config.log << "  Bulk loading (" << build_upper << ") from " << config.bulk_data_file << std::endl;
+        }
+        owned.reset(new CsvPointSource(config.bulk_data_file));
+    } else {
+        if (source == nullptr) {
+            throw std::runtime_error("Bulk load requested without a data file or workload generator.");
+        }
+        if (!config.quiet) {
+            *config.log << "  Bulk loading (" << build_upper << ") " << config.bulk_points
+                        << " generated points" << std::endl;
+        }
+        owned.reset(new GeneratorPointSource(*source, config.bulk_points));
+    }
+    return bulkLoadTree(config, sm, *owned, index_id);
+}
+
+// What the tree writes to: the counters, or a leaf directory on top of them
+static IStorageManager& treeStorage(const TreeConfig& config, TreeResources& resources) {
+    if (!config.leaf_directory) return *resources.counters;
+    resources.directory = new LeafDirectory(*resources.counters, config.dims);
+    return *resources.directory;
+}
+
+// What the counters write to: a leaf codec over `target`, or `target` itself
+static IStorageManager& codecStorage(const TreeConfig& config, TreeResources& resources, IStorageManager& target) {
+    const LeafCodec codec = getLeafCodec(config.leaf_codec);
+    if (codec == LeafCodec::NONE) return target;
+    if (!config.quiet) {
+        *config.log << "  Using " << leafCodecName(codec) << " leaf pages, leaf capacity "
+                    << config.leafCapacity() << "." << std::endl;
+    }
+    // A reopened tree's header page is known before loadRTree reads it
+    resources.codec = new LeafCodecStorageManager(target, codec, config.dims,
+                                                  config.open_existing ? resources.index_id : id_type(StorageManager::NewPage));
+    return *resources.codec;
+}
+
+// "<base>.tree" keeps the header page id, dimension and leaf codec of the tree in "<base>.dat"
+static std::string indexIdFile(const std::string& base_name) {
+    return base_name + ".tree";
+}
+
+static void writeIndexId(const std::string& base_name, id_type index_id, const TreeConfig& config) {
+    std::ofstream f(indexIdFile(base_name));
+    if (!f.is_open()) throw std::runtime_error("Cannot write " + indexIdFile(base_name));
+    f << index_id << " " << config.dims << " " << leafCodecName(getLeafCodec(config.leaf_codec)) << "\n";
+}
+
+static id_type readIndexId(const std::string& base_name, const TreeConfig& config) {
+    std::ifstream f(indexIdFile(base_name));
+    id_type index_id;
+    uint32_t stored_dims;
+    std::string stored_codec;
+    const uint32_t dims = config.dims;
+    if (!std::ifstream(base_name + ".dat").good() || !(f >> index_id >> stored_dims)) {
+        throw std::runtime_error("No index to reopen in " + base_name + ".dat / " + indexIdFile(base_name) +
+                                 " (build it first without open_existing).");
+    }
+    if (stored_dims != dims) {
+        throw std::runtime_error(base_name + " holds a " + std::to_string(stored_dims) +
+                                 "-D tree, not dims=" + std::to_string(dims) + ".");
+    }
+    // Sidecars from before leaf codecs hold no codec
+    if (!(f >> stored_codec)) stored_codec = "NONE";
+    if (getLeafCodec(stored_codec) != getLeafCodec(config.leaf_codec)) {
+        throw std::runtime_error(base_name + " was built with leaf_codec=" + stored_codec + ".");
+    }
+    return index_id;
+}
+
+// Level-order walk over the nodes down to min_level. Each level's pages are
+// visited in ascending id order once the level above has been read, after
+// the buffer (if any) prefetched the whole level.
+class PrewarmStrategy : public IQueryStrategy {
+public:
+    PrewarmStrategy(uint32_t min_level, PageBuffer* buffer)
+        : min_level_(min_level), buffer_(buffer), pos_(0), pages_(0) {}
+
+    void getNextEntry(const IEntry& entry, id_type& next, bool& fetch_next) override {
+        ++pages_;
+        const INode* node = dynamic_cast<const INode*>(&entry);
+        if (node && node->getLevel() > min_level_) {
+            for (uint32_t c = 0; c < node->getChildrenCount(); ++c) below_.push_back(node->getChildIdentifier(c));
+        }
+        if (pos_ == level_.size()) {
+            std::sort(below_.begin(), below_.end());
+            level_.swap(below_);
+            below_.clear();
+            pos_ = 0;
+            if (buffer_ && !level_.empty()) buffer_->prefetch(level_.size(), level_.data());
+        }
+        fetch_next = pos_ < level_.size();
+        if (fetch_next) next = level_[pos_++];
+    }
+
+    uint64_t pages() const { return pages_; }
+
+private:
+    uint32_t min_level_;
+    PageBuffer* buffer_;
+    std::vector<id_type> level_;  // Level being read
+    std::vector<id_type> below_;  // Children collected for the next level
+    size_t pos_;
+    uint64_t pages_;
+};
+
+PrewarmStats prewarmTree(ISpatialIndex& tree, uint32_t levels, StorageManager::IBuffer* buffer) {
+    PrewarmStats stats;
+    const uint32_t height = rtree_height(tree);
+    stats.levels = std::min(levels, height);
+    if (stats.levels == 0) return stats;
+
+    // The root is on level height - 1
+    PrewarmStrategy strategy(height - stats.levels, dynamic_cast<PageBuffer*>(buffer));
+    const uint64_t t0 = nowNs();
+    tree.queryStrategy(strategy);
+    stats.time_us = (nowNs() - t0) / 1000;
+    stats.pages = strategy.pages();
+    return stats;
+}
+
+static TreeResources setupTreeFrom(const TreeConfig& config, WorkloadGenerator* source, PointSource* points) {
     TreeResources resources;
+    // Progress messages go nowhere for quiet setups
+    std::ostream null_out(nullptr);
+    std::ostream& log = config.quiet ? null_out : *config.log;
     
     std::string run_type_upper = config.run_type;
     std::transform(run_type_upper.begin(), run_type_upper.end(), 
                    run_type_upper.begin(), ::toupper);
     
+    std::string storage_upper = config.storage;
+    std::transform(storage_upper.begin(), storage_upper.end(), storage_upper.begin(), ::toupper);
+
     if (run_type_upper == "MEM") {
-        std::cout << "--- Setting up In-Memory Tree ---" << std::endl;
-        resources.storage_manager = StorageManager::createNewMemoryStorageManager();
-        resources.tree = RTree::createNewRTree(
-            *resources.storage_manager,
-            config.fill_factor,
-            config.M_capacity,
-            config.M_capacity,
-            2, // dimension
-            config.tree_variant,
-            resources.index_id
-        );
+        if (config.open_existing) {
+            throw std::runtime_error("open_existing needs run_type 'disk'.");
+        }
+        log << "--- Setting up In-Memory Tree ---" << std::endl;
+        if (storage_upper == "ARENA") {
+            log << "  Using ARENA memory storage." << std::endl;
+            resources.storage_manager = new ArenaStorageManager(rtreeNodeBytes(config.M_capacity, config.dims));
+        } else {
+            resources.storage_manager = StorageManager::createNewMemoryStorageManager();
+        }
+        resources.io_stats = new IoStatsStorageManager(*resources.storage_manager);
+        resources.counters = new CountingStorageManager(codecStorage(config, resources, *resources.io_stats));
+        resources.tree = createTree(config, treeStorage(config, resources), source, points, resources.index_id);
         
     } else if (run_type_upper == "DISK") {
-        std::cout << "--- Setting up On-Disk Tree ---" << std::endl;
+        log << "--- Setting up On-Disk Tree ---" << std::endl;
         
         std::string base_name = config.disk_base_name.empty() ? 
                                 "disk_tree_data" : config.disk_base_name;
-        std::remove((base_name + ".dat").c_str());
-        std::remove((base_name + ".idx").c_str());
+        if (config.open_existing) {
+            resources.index_id = readIndexId(base_name, config);
+            log << "  Reopening the tree in " << base_name << ".dat (index id "
+                << resources.index_id << ")." << std::endl;
+        } else {
+            std::remove((base_name + ".dat").c_str());
+            std::remove((base_name + ".idx").c_str());
+            std::remove(indexIdFile(base_name).c_str());
+        }
         
-        resources.storage_manager = StorageManager::createNewDiskStorageManager(
-            base_name, 
-            config.page_size
-        );
+        if (storage_upper == "DIRECT") {
+            DirectStorageOptions direct_options;
+            direct_options.page_size = static_cast<uint32_t>(config.page_size);
+            direct_options.engine = getIoEngine(config.io_engine);
+            direct_options.queue_depth = config.io_queue_depth;
+            direct_options.io_threads = config.io_threads;
+            direct_options.log = config.log;
+            DirectStorageManager* direct = new DirectStorageManager(base_name, direct_options, config.open_existing);
+            log << "  Using DIRECT storage (" << (direct->direct() ? "O_DIRECT" : "page cache")
+                << ", " << ioEngineName(direct->engine()) << " I/O)." << std::endl;
+            resources.storage_manager = direct;
+        } else if (config.open_existing) {
+            // The page size comes from the file header
+            resources.storage_manager = StorageManager::loadDiskStorageManager(base_name);
+        } else {
+            resources.storage_manager = StorageManager::createNewDiskStorageManager(
+                base_name, 
+                config.page_size
+            );
+        }
+        resources.io_stats = new IoStatsStorageManager(*resources.storage_manager);
+        if (config.async_dirty_pages > 0) {
+            log << "  Using asynchronous write-back, dirty limit: "
+                << config.async_dirty_pages << " pages." << std::endl;
+            resources.write_back = new AsyncWriteBackStorageManager(*resources.io_stats, config.async_dirty_pages);
+            // Write-backs coalesced in the dirty set never reach io_stats; count them above it
+            resources.buffer_io = new IoStatsStorageManager(*resources.write_back);
+        }
+        IStorageManager& base = resources.buffer_io ?
+            static_cast<IStorageManager&>(*resources.buffer_io) : *resources.io_stats;
         
         // Setup buffer if needed
         std::string buffer_type_upper = config.buffer_type;
         std::transform(buffer_type_upper.begin(), buffer_type_upper.end(),
                       buffer_type_upper.begin(), ::toupper);
+        BufferPolicy policy;
         
         if (buffer_type_upper == "RANDOM" && config.buffer_pages > 0) {
-            std::cout << "  Using RANDOM Evictions Buffer with capacity: " 
-                      << config.buffer_pages << " pages." << std::endl;
+            log << "  Using RANDOM Evictions Buffer with capacity: " 
+                << config.buffer_pages << " pages." << std::endl;
             resources.buffer = StorageManager::createNewRandomEvictionsBuffer(
-                *resources.storage_manager, config.buffer_pages, false
-            );
-            resources.tree = RTree::createNewRTree(
-                *resources.buffer, config.fill_factor, config.M_capacity,
-                config.M_capacity, 2, config.tree_variant, resources.index_id
+                base, config.buffer_pages, false
             );
         } else if (buffer_type_upper == "FIFO" && config.buffer_pages > 0) {
-            std::cout << "  Using FIFO Evictions Buffer with capacity: " 
-                      << config.buffer_pages << " pages." << std::endl;
-            // resources.buffer = StorageManager::createNewFIFOEvictionsBuffer(
-            //     *resources.storage_manager, config.buffer_pages, false
-            // );
+            log << "  Using FIFO Evictions Buffer with capacity: " 
+                << config.buffer_pages << " pages." << std::endl;
             resources.buffer = SpatialIndex::StorageManager::createNewFIFOEvictionsBuffer(
-                *resources.storage_manager, config.buffer_pages, false
+                base, config.buffer_pages, false
             );
-            resources.tree = RTree::createNewRTree(
-                *resources.buffer, config.fill_factor, config.M_capacity,
-                config.M_capacity, 2, config.tree_variant, resources.index_id
-            );
-        // ---------------------
-
         } else if (buffer_type_upper == "LRU" && config.buffer_pages > 0) {
-            std::cout << "  Using LRU Evictions Buffer with capacity: " 
-                      << config.buffer_pages << " pages." << std::endl;
-            // resources.buffer = StorageManager::createNewLRUEvictionsBuffer(
-            //     *resources.storage_manager, config.buffer_pages, false
-            // );
+            log << "  Using LRU Evictions Buffer with capacity: " 
+                << config.buffer_pages << " pages." << std::endl;
             resources.buffer = SpatialIndex::StorageManager::createNewLRUEvictionsBuffer(
-                *resources.storage_manager, config.buffer_pages, false
+                base, config.buffer_pages, false
             );
-            resources.tree = RTree::createNewRTree(
-                *resources.buffer, config.fill_factor, config.M_capacity,
-                config.M_capacity, 2, config.tree_variant, resources.index_id
+        } else if (getBufferPolicy(buffer_type_upper, policy) && config.buffer_pages > 0) {
+            log << "  Using " << bufferPolicyName(policy) << " Buffer with capacity: "
+                << config.buffer_pages << " pages." << std::endl;
+            PageBufferOptions options;
+            options.lru_k = config.buffer_lru_k;
+            options.pin_levels = config.buffer_pin_levels;
+            resources.buffer = createPageBuffer(
+                policy, base, config.buffer_pages, false, options
             );
         } else {
-            std::cout << "  Using NO Buffer (Raw Disk I/O)." << std::endl;
-            resources.tree = RTree::createNewRTree(
-                *resources.storage_manager, config.fill_factor, config.M_capacity,
-                config.M_capacity, 2, config.tree_variant, resources.index_id
-            );
+            log << "  Using NO Buffer (Raw Disk I/O)." << std::endl;
+        }
+
+        IStorageManager& target = resources.buffer ?
+            static_cast<IStorageManager&>(*resources.buffer) : base;
+        resources.counters = new CountingStorageManager(codecStorage(config, resources, target));
+        if (config.open_existing) {
+            resources.tree = RTree::loadRTree(treeStorage(config, resources), resources.index_id);
+        } else {
+            resources.tree = createTree(config, treeStorage(config, resources), source, points, resources.index_id);
+            writeIndexId(base_name, resources.index_id, config);
         }
     } else {
         throw std::runtime_error("Unknown run_type: " + config.run_type + 
                                 ". Use 'mem' or 'disk'.");
     }
+
+    if (config.prewarm_levels > 0) {
+        const PrewarmStats warm = prewarmTree(*resources.tree, config.prewarm_levels, resources.buffer);
+        log << "  Prewarmed the top " << warm.levels << " levels (" << warm.pages << " pages) in "
+            << warm.time_us / 1000.0 << " ms." << std::endl;
+    }
+
+    // Start counting from the freshly built (or reopened) tree
+    resources.counters->attach(*resources.tree, resources.index_id);
+    if (resources.directory) resources.directory->attach(resources.index_id);
+    if (resources.codec) resources.codec->attach(resources.index_id);
     
     return resources;
 }
 
-// ... (cleanupTree function is unchanged) ...
+TreeResources setupTree(const TreeConfig& config, WorkloadGenerator* source) {
+    return setupTreeFrom(config, source, nullptr);
+}
+
+TreeResources setupTree(const TreeConfig& config, PointSource& bulk_source) {
+    return setupTreeFrom(config, nullptr, &bulk_source);
+}
+
+IoMonitor ioMonitor(const TreeResources& resources) {
+    return IoMonitor(resources.io_stats, resources.buffer, resources.write_back, resources.buffer_io);
+}
+
 void cleanupTree(TreeResources& resources) {
     if (resources.tree) {
         resources.tree->flush();
         delete resources.tree;
         resources.tree = nullptr;
     }
+    if (resources.directory) {
+        delete resources.directory;
+        resources.directory = nullptr;
+    }
+    if (resources.counters) {
+        delete resources.counters;
+        resources.counters = nullptr;
+    }
+    if (resources.codec) {
+        delete resources.codec;
+        resources.codec = nullptr;
+    }
     if (resources.buffer) {
         delete resources.buffer;
         resources.buffer = nullptr;
     }
+    if (resources.buffer_io) {
+        delete resources.buffer_io;
+        resources.buffer_io = nullptr;
+    }
+    if (resources.write_back) {
+        // Barrier: every page the buffer wrote back reaches the disk
+        resources.write_back->flush();
+        delete resources.write_back;
+        resources.write_back = nullptr;
+    }
+    if (resources.io_stats) {
+        delete resources.io_stats;
+        resources.io_stats = nullptr;
+    }
     if (resources.storage_manager) {
         delete resources.storage_manager;
         resources.storage_manager = nullptr;
@@ -0,0 +1,294 @@
+#include "update_benchmark.h"
+#include "bulk_load.h"
+#include "leaf_directory.h"
+#include "query_runner.h"
+#include "latency_histogram.h"
+#include "rtree_helpers.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace SpatialIndex {
+
+std::vector<UpdatePath> getUpdatePaths(const std::string& name) {
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+
+    if (upper == "DELETE_INSERT") return {UpdatePath::DELETE_INSERT};
+    if (upper == "IN_PLACE") return {UpdatePath::IN_PLACE};
+    if (upper == "COMPARE") return {UpdatePath::DELETE_INSERT, UpdatePath::IN_PLACE};
+    throw std::invalid_argument("Unknown update path: " + name + " (DELETE_INSERT, IN_PLACE or COMPARE)");
+}
+
+const char* updatePathName(UpdatePath path) {
+    switch (path) {
+        case UpdatePath::IN_PLACE: return "IN_PLACE";
+        default: return "DELETE_INSERT";
+    }
+}
+
+namespace {
+
+// The fleet's starting positions, ids 0..n-1
+class FleetSource : public PointSource {
+public:
+    explicit FleetSource(const std::vector<double>& xy) : xy_(xy), pos_(0) {}
+
+    bool next(double coords[2], id_type& id) override {
+        if (2 * pos_ >= xy_.size()) return false;
+        coords[0] = xy_[2 * pos_];
+        coords[1] = xy_[2 * pos_ + 1];
+        id = static_cast<id_type>(pos_++);
+        return true;
+    }
+    void rewind() override { pos_ = 0; }
+
+private:
+    const std::vector<double>& xy_;
+    size_t pos_;
+};
+
+// Leaf MBRs against the tight MBRs of their entries, from one walk over the tree
+struct TreeQuality {
+    uint64_t leaves = 0;
+    uint64_t leaf_entries = 0;
+    uint64_t data = 0;
+    double leaf_area = 0.0;
+    double tight_area = 0.0;
+};
+
+class QualityVisitor : public IVisitor {
+public:
+    TreeQuality quality;
+
+    void visitNode(const INode& n) override {
+        if (!n.isLeaf() || n.getChildrenCount() == 0) return;
+        IShape* s = nullptr;
+        n.getShape(&s);
+        Region mbr;
+        s->getMBR(mbr);
+        delete s;
+
+        Region tight;
+        for (uint32_t c = 0; c < n.getChildrenCount(); ++c) {
+            n.getChildShape(c, &s);
+            Region entry;
+            s->getMBR(entry);
+            delete s;
+            if (c == 0) {
+                tight = entry;
+            } else {
+                tight.combineRegion(entry);
+            }
+        }
+        ++quality.leaves;
+        quality.leaf_entries += n.getChildrenCount();
+        quality.leaf_area += mbr.getArea();
+        quality.tight_area += tight.getArea();
+    }
+    void visitData(const IData&) override { ++quality.data; }
+    void visitData(std::vector<const IData*>& v) override { quality.data += v.size(); }
+};
+
+TreeQuality measureQuality(ISpatialIndex& tree) {
+    const double lo[2] = {-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
+    const double hi[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    Region everything(lo, hi, 2);
+    QualityVisitor v;
+    tree.intersectsWithQuery(everything, v);
+    return v.quality;
+}
+
+// Fold v back into [lo, hi] as if it bounced off the edges
+double reflect(double v, double lo, double hi) {
+    const double w = hi - lo;
+    if (w <= 0.0) return lo;
+    double t = std::fmod(v - lo, 2.0 * w);
+    if (t < 0.0) t += 2.0 * w;
+    return lo + (t <= w ? t : 2.0 * w - t);
+}
+
+} // namespace
+
+void runUpdateBenchmark(
+    const TreeConfig& config,
+    WorkloadGenerator& gen,
+    unsigned int seed,
+    const std::vector<UpdatePath>& paths,
+    const UpdateOptions& options,
+    int num_objects,
+    const std::string& output_csv
+) {
+    std::ostream& log = *config.log;
+    if (gen.dims() != 2) throw std::invalid_argument("The update benchmark supports 2-D points only.");
+
+    std::ofstream f(output_csv);
+    if (!f.is_open()) {
+        log << "Error: Could not open output file: " << output_csv << std::endl;
+        return;
+    }
+
+    // Starting positions and the extent the objects stay in
+    gen.reset();
+    const size_t n = static_cast<size_t>(std::max(0, num_objects));
+    std::vector<double> start(2 * n);
+    double low[2] = {0.0, 0.0}, high[2] = {0.0, 0.0};
+    for (size_t i = 0; i < n; ++i) {
+        gen.generateNextPoint(&start[2 * i]);
+        for (int d = 0; d < 2; ++d) {
+            low[d] = i == 0 ? start[2 * i + d] : std::min(low[d], start[2 * i + d]);
+            high[d] = i == 0 ? start[2 * i + d] : std::max(high[d], start[2 * i + d]);
+        }
+    }
+
+    // Fixed probe windows over the extent
+    std::vector<Operation> probes(options.probes);
+    std::mt19937 probe_gen(seed ^ 0x9e3779b9u);
+    const double side_frac = std::sqrt(std::max(0.0, gen.getMix().range_selectivity));
+    for (Operation& op : probes) {
+        op.type = OpType::RANGE_QUERY;
+        op.id = 0;
+        for (int d = 0; d < 2; ++d) {
+            op.coords[d] = std::uniform_real_distribution<double>(low[d], high[d])(probe_gen);
+            op.half_extent[d] = 0.5 * side_frac * (high[d] - low[d]);
+        }
+    }
+
+    log << "Starting update benchmark: " << n << " moving objects (" << gen.getDataType()
+        << " start), " << options.ticks << " ticks, " << options.fraction * 100.0 << "% moving per tick, step "
+        << options.step << " -> " << output_csv << std::endl;
+
+    f << "Path,Tick,Objects,Updates,Time_ms,UpdatesPerSec,AvgUpdate_us,P99Update_us,InLeaf,Enlarged,"
+         "Reinserted,NodeReads,NodeWrites,Nodes,Height,Leaves,AvgLeafFill,LeafArea,LeafSlack,"
+         "ProbeNodes,ProbeResults\n";
+
+    std::vector<std::vector<uint64_t>> probe_results;
+    for (UpdatePath path : paths) {
+        const char* name = updatePathName(path);
+        TreeConfig tree_config = config;
+        tree_config.leaf_directory = path == UpdatePath::IN_PLACE;
+
+        std::vector<double> xy = start;
+        const uint64_t load_t0 = nowNs();
+        TreeResources resources;
+        if (tree_config.build_mode == "INCREMENTAL") {
+            resources = setupTree(tree_config);
+            PointInserter inserter(*resources.tree, 2);
+            for (size_t i = 0; i < n; ++i) inserter.insert(&xy[2 * i], static_cast<id_type>(i));
+        } else {
+            FleetSource source(xy);
+            resources = setupTree(tree_config, source);
+        }
+        log << "  " << name << ": loaded in " << (nowNs() - load_t0) / 1e6 << " ms" << std::endl;
+
+        ISpatialIndex& tree = *resources.tree;
+        LeafDirectory* directory = resources.directory;
+        PointInserter inserter(tree, 2);
+        const double origin[2] = {0.0, 0.0};
+        Point old_point(origin, 2);
+
+        // Same moves for every path
+        std::mt19937 move_gen(seed);
+        std::normal_distribution<double> step(0.0, options.step);
+        std::bernoulli_distribution moves(std::min(1.0, std::max(0.0, options.fraction)));
+
+        probe_results.emplace_back();
+        uint64_t total_updates = 0, total_ns = 0, first_probe_nodes = 0, probe_nodes = 0;
+        double first_slack = 0.0, slack = 0.0;
+        uint64_t total_outcomes[3] = {0, 0, 0};
+        for (uint32_t tick = 0; tick <= options.ticks; ++tick) {
+            LatencyHistogram latency;
+            uint64_t outcomes[3] = {0, 0, 0};  // In leaf, enlarged, reinserted
+            const TreeCounterSnapshot before = resources.counters->snapshot();
+            const uint64_t t0 = nowNs();
+            for (size_t i = 0; tick > 0 && i < n; ++i) {
+                if (!moves(move_gen)) continue;
+                double to[2];
+                for (int d = 0; d < 2; ++d) to[d] = reflect(xy[2 * i + d] + step(move_gen), low[d], high[d]);
+
+                const uint64_t s = nowNs();
+                const MoveResult r = directory ? directory->movePoint(static_cast<id_type>(i), &xy[2 * i], to)
+                                               : MoveResult::MISSED;
+                if (r == MoveResult::MISSED) {
+                    std::copy(&xy[2 * i], &xy[2 * i] + 2, old_point.m_pCoords);
+                    if (!tree.deleteData(old_point, static_cast<id_type>(i))) {
+                        throw std::runtime_error("Moving object " + std::to_string(i) + " is missing from the tree.");
+                    }
+                    inserter.insert(to, static_cast<id_type>(i));
+                }
+                latency.record(nowNs() - s);
+                ++outcomes[static_cast<int>(r)];
+                xy[2 * i] = to[0];
+                xy[2 * i + 1] = to[1];
+            }
+            const uint64_t tick_ns = nowNs() - t0;
+            const TreeCounterSnapshot after = resources.counters->snapshot();
+
+            // Quality after the tick (outside the timed part)
+            const TreeQuality quality = measureQuality(tree);
+            if (quality.data != n) {
+                throw std::runtime_error(std::string(name) + ": tree holds " + std::to_string(quality.data) +
+                                         " objects after tick " + std::to_string(tick) + ", expected " +
+                                         std::to_string(n) + ".");
+            }
+            uint64_t nodes_visited = 0, results = 0;
+            for (const Operation& op : probes) {
+                const QueryResult qr = runQuery(&tree, op, 0);
+                nodes_visited += qr.nodes_visited;
+                results += qr.results;
+            }
+            probe_results.back().push_back(results);
+
+            const uint64_t updates = latency.count();
+            const double tick_s = tick_ns / 1e9;
+            slack = quality.tight_area > 0.0 ? quality.leaf_area / quality.tight_area : 1.0;
+            probe_nodes = nodes_visited;
+            if (tick == 0) {
+                first_slack = slack;
+                first_probe_nodes = nodes_visited;
+            }
+            total_updates += updates;
+            total_ns += tick_ns;
+            for (int o = 0; o < 3; ++o) total_outcomes[o] += outcomes[o];
+
+            f << name << "," << tick << "," << n << "," << updates << "," << tick_ns / 1e6 << ","
+              << (updates && tick_s > 0.0 ? updates / tick_s : 0.0) << ","
+              << latency.mean() / 1000.0 << "," << latency.percentile(99.0) / 1000.0 << ","
+              << outcomes[0] << "," << outcomes[1] << "," << outcomes[2] << ","
+              << after.node_reads - before.node_reads << ","
+              << after.node_writes + after.node_allocs - before.node_writes - before.node_allocs << ","
+              << after.nodes << "," << after.height << "," << quality.leaves << ","
+              << (quality.leaves ? static_cast<double>(quality.leaf_entries) / (quality.leaves * config.M_capacity) : 0.0) << ","
+              << quality.leaf_area << "," << slack << ","
+              << (probes.empty() ? 0.0 : static_cast<double>(nodes_visited) / probes.size()) << ","
+              << results << "\n";
+        }
+
+        const double total_s = total_ns / 1e9;
+        const double share = total_updates ? 100.0 / total_updates : 0.0;
+        log << "  " << name << ": " << static_cast<uint64_t>(total_s > 0.0 ? total_updates / total_s : 0.0)
+            << " updates/s (" << total_outcomes[0] * share << "% in leaf, " << total_outcomes[1] * share
+            << "% enlarged, " << total_outcomes[2] * share << "% reinserted); leaf slack "
+            << first_slack << " -> " << slack << ", probe nodes "
+            << (probes.empty() ? 0.0 : static_cast<double>(first_probe_nodes) / probes.size()) << " -> "
+            << (probes.empty() ? 0.0 : static_cast<double>(probe_nodes) / probes.size()) << std::endl;
+        cleanupTree(resources);
+    }
+
+    // Every path saw the same positions, so the probes must agree
+    for (size_t p = 1; p < probe_results.size(); ++p) {
+        if (probe_results[p] != probe_results[0]) {
+            log << "Warning: probe results of " << updatePathName(paths[p]) << " differ from "
+                << updatePathName(paths[0]) << "." << std::endl;
+        }
+    }
+
+    f.close();
+    log << "Update benchmark finished for " << output_csv << "." << std::endl;
+}
+
+} // namespace SpatialIndex
@@ -0,0 +1,176 @@
+#include "workload_file.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bulk_load.h"
+
+namespace SpatialIndex {
+
+namespace {
+
+WorkloadFileHeader makeHeader(const std::string& data_type, const WorkloadMix& mix) {
+    WorkloadFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kWorkloadMagic, sizeof(h.magic));
+    h.version = kWorkloadVersion;
+    h.record_size = sizeof(WorkloadRecord);
+    std::strncpy(h.data_type, data_type.c_str(), sizeof(h.data_type) - 1);
+    h.insert_ratio = mix.insert_ratio;
+    h.range_ratio = mix.range_ratio;
+    h.knn_ratio = mix.knn_ratio;
+    h.range_selectivity = mix.range_selectivity;
+    h.knn_k = mix.knn_k;
+    return h;
+}
+
+// Buffered record writer; the header is rewritten with the final count on close
+class WorkloadWriter {
+public:
+    WorkloadWriter(const std::string& path, const WorkloadFileHeader& header)
+        : path_(path), file_(std::fopen(path.c_str(), "wb")), header_(header) {
+        if (!file_) throw std::runtime_error("Could not open workload file: " + path);
+        put(&header_, sizeof(header_));
+        batch_.reserve(4096);
+    }
+
+    ~WorkloadWriter() {
+        if (file_) std::fclose(file_);
+    }
+
+    void add(const WorkloadRecord& rec) {
+        batch_.push_back(rec);
+        if (batch_.size() == batch_.capacity()) drain();
+    }
+
+    uint64_t close() {
+        drain();
+        if (std::fseek(file_, 0, SEEK_SET) != 0) fail();
+        put(&header_, sizeof(header_));
+        if (std::fclose(file_) != 0) {
+            file_ = nullptr;
+            fail();
+        }
+        file_ = nullptr;
+        return header_.count;
+    }
+
+private:
+    void drain() {
+        if (batch_.empty()) return;
+        put(batch_.data(), batch_.size() * sizeof(WorkloadRecord));
+        header_.count += batch_.size();
+        batch_.clear();
+    }
+
+    void put(const void* data, size_t bytes) {
+        if (std::fwrite(data, 1, bytes, file_) != bytes) fail();
+    }
+
+    [[noreturn]] void fail() {
+        throw std::runtime_error("Error writing workload file: " + path_);
+    }
+
+    std::string path_;
+    std::FILE* file_;
+    WorkloadFileHeader header_;
+    std::vector<WorkloadRecord> batch_;
+};
+
+} // namespace
+
+uint64_t writeWorkloadFile(const std::string& path, WorkloadGenerator& gen, uint64_t count) {
+    WorkloadWriter writer(path, makeHeader(gen.getDataType(), gen.getMix()));
+    WorkloadRecord rec;
+    std::memset(&rec, 0, sizeof(rec));
+    for (uint64_t i = 0; i < count; ++i) {
+        const Operation op = gen.nextOperation();
+        rec.type = static_cast<uint8_t>(op.type);
+        rec.id = op.type == OpType::INSERT ? op.id : i;
+        for (int d = 0; d < 2; ++d) {
+            rec.coords[d] = op.coords[d];
+            rec.half_extent[d] = op.half_extent[d];
+        }
+        writer.add(rec);
+    }
+    return writer.close();
+}
+
+uint64_t importCsvWorkload(const std::string& csv_path, const std::string& path, uint64_t max_points) {
+    CsvPointSource source(csv_path);
+    WorkloadWriter writer(path, makeHeader("CSV", WorkloadMix()));
+    WorkloadRecord rec;
+    std::memset(&rec, 0, sizeof(rec));
+    rec.type = static_cast<uint8_t>(OpType::INSERT);
+    id_type id;
+    uint64_t n = 0;
+    while ((max_points == 0 || n < max_points) && source.next(rec.coords, id)) {
+        rec.id = static_cast<uint64_t>(id);
+        writer.add(rec);
+        ++n;
+    }
+    return writer.close();
+}
+
+MappedWorkload::MappedWorkload(const std::string& path)
+    : base_(nullptr), length_(0), records_(nullptr) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open workload file: " + path);
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(WorkloadFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a workload file: " + path);
+    }
+    length_ = static_cast<size_t>(st.st_size);
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    base_ = ::mmap(nullptr, length_, PROT_READ, flags, fd, 0);
+    ::close(fd);
+    if (base_ == MAP_FAILED) {
+        base_ = nullptr;
+        throw std::runtime_error("Could not map workload file: " + path);
+    }
+    ::madvise(base_, length_, MADV_SEQUENTIAL);
+
+    const WorkloadFileHeader& h = header();
+    if (std::memcmp(h.magic, kWorkloadMagic, sizeof(h.magic)) != 0 ||
+        h.version != kWorkloadVersion || h.record_size != sizeof(WorkloadRecord) ||
+        h.count > (length_ - sizeof(WorkloadFileHeader)) / sizeof(WorkloadRecord)) {
+        ::munmap(base_, length_);
+        base_ = nullptr;
+        throw std::runtime_error("Not a version " + std::to_string(kWorkloadVersion) +
+                                 " workload file (or truncated): " + path);
+    }
+    records_ = reinterpret_cast<const WorkloadRecord*>(
+        static_cast<const char*>(base_) + sizeof(WorkloadFileHeader));
+}
+
+MappedWorkload::~MappedWorkload() {
+    if (base_) ::munmap(base_, length_);
+}
+
+std::string MappedWorkload::dataType() const {
+    const WorkloadFileHeader& h = header();
+    return std::string(h.data_type, strnlen(h.data_type, sizeof(h.data_type)));
+}
+
+WorkloadMix MappedWorkload::mix() const {
+    const WorkloadFileHeader& h = header();
+    WorkloadMix m;
+    m.insert_ratio = h.insert_ratio;
+    m.range_ratio = h.range_ratio;
+    m.knn_ratio = h.knn_ratio;
+    m.range_selectivity = h.range_selectivity;
+    m.knn_k = h.knn_k;
+    return m;
+}
+
+} // namespace SpatialIndex
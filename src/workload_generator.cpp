@@ -2,16 +2,42 @@
 #include <random>
 #include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include "space_filling_curve.h"
+#include "workload_file.h"
 
 namespace SpatialIndex {
 
-WorkloadGenerator::WorkloadGenerator(const std::string& data_type, unsigned int seed)
-    : data_type_(data_type), gen_(seed), 
-      uni_rand_(0.0, 1000.0), 
+const char* opTypeName(OpType type) {
+    switch (type) {
+        case OpType::INSERT: return "INSERT";
+        case OpType::RANGE_QUERY: return "RANGE";
+        case OpType::KNN_QUERY: return "KNN";
+    }
+    return "UNKNOWN";
+}
+
+WorkloadGenerator::WorkloadGenerator(const std::string& data_type, unsigned int seed,
+                                     const DistributionParams& params)
+    : data_type_(data_type), dist_(Distribution::RANDOM), params_(params), seed_(seed),
+      gen_(seed), op_gen_(seed ^ 0x9e3779b9u),
+      uni_rand_(0.0, 1000.0),
       walk_dist_(0.0, 5.0),
-      initialized_(false) {
-    current_coords_[0] = 500.0;
-    current_coords_[1] = 500.0;
+      initialized_(false),
+      stream_pos_(0),
+      replay_pos_(0),
+      replay_inserts_(0),
+      inserts_(0),
+      has_data_(false) {
+    dispatchDims(params_.dims, [this](auto dim) {
+        constexpr uint32_t D = decltype(dim)::value;
+        next_point_ = &WorkloadGenerator::nextPoint<D>;
+        next_query_ = &WorkloadGenerator::nextQuery<D>;
+        build_sorted_stream_ = &WorkloadGenerator::buildSortedStream<D>;
+    });
+    for (uint32_t d = 0; d < kMaxDims; ++d) current_coords_[d] = 500.0;
     initialize();
 }
 
@@ -19,34 +45,284 @@ void WorkloadGenerator::initialize() {
     // Convert data_type to uppercase for comparison
     std::string upper_type = data_type_;
     std::transform(upper_type.begin(), upper_type.end(), upper_type.begin(), ::toupper);
-    
-    if (upper_type != "WALK" && upper_type != "RANDOM") {
+
+    if (upper_type == "WALK") {
+        dist_ = Distribution::WALK;
+    } else if (upper_type == "SORTED") {
+        dist_ = Distribution::SORTED;
+    } else if (upper_type == "NEARLY_SORTED") {
+        dist_ = Distribution::NEARLY_SORTED;
+    } else if (upper_type == "CLUSTERED") {
+        dist_ = Distribution::CLUSTERED;
+    } else if (upper_type == "ZIPF") {
+        dist_ = Distribution::ZIPF;
+    } else if (upper_type != "RANDOM") {
         // Default to RANDOM if unknown type
-        data_type_ = "RANDOM";
+        upper_type = "RANDOM";
     }
-    
+    data_type_ = upper_type;
+
+    setupDistribution();
     initialized_ = true;
 }
 
-void WorkloadGenerator::generateNextPoint(double coords[2]) {
-    if (data_type_ == "WALK") {
-        // Random walk: update current position with normal distribution step
-        current_coords_[0] += walk_dist_(gen_);
-        current_coords_[1] += walk_dist_(gen_);
-        coords[0] = current_coords_[0];
-        coords[1] = current_coords_[1];
-    } else {
-        // Random uniform distribution
-        coords[0] = uni_rand_(gen_);
-        coords[1] = uni_rand_(gen_);
+// Draw whatever per-distribution state comes from the seed (centres, sorted stream)
+void WorkloadGenerator::setupDistribution() {
+    stream_coords_.clear();
+    stream_pos_ = 0;
+    centres_.clear();
+
+    if (dist_ == Distribution::SORTED || dist_ == Distribution::NEARLY_SORTED) {
+        (this->*build_sorted_stream_)();
+    } else if (dist_ == Distribution::CLUSTERED || dist_ == Distribution::ZIPF) {
+        const uint32_t n = std::max<uint32_t>(1, dist_ == Distribution::CLUSTERED ?
+                                                 params_.clusters : params_.hotspots);
+        centres_.resize(params_.dims * static_cast<size_t>(n));
+        for (auto& c : centres_) c = uni_rand_(gen_);
+
+        if (dist_ == Distribution::ZIPF) {
+            // P(rank r) proportional to 1 / r^s, r = 1..n
+            std::vector<double> weights(n);
+            for (uint32_t r = 0; r < n; ++r) {
+                weights[r] = 1.0 / std::pow(static_cast<double>(r + 1), params_.zipf_s);
+            }
+            zipf_rank_ = std::discrete_distribution<uint32_t>(weights.begin(), weights.end());
+        }
+    }
+}
+
+// Uniform points ordered along a Hilbert curve; NEARLY_SORTED then perturbs
+// the order with K/L swaps: ceil(K% * n / 2) swaps of distinct positions, each
+// displacing its two items by at most L, so K% of the items end up out of place.
+template <uint32_t D>
+void WorkloadGenerator::buildSortedStream() {
+    const size_t n = static_cast<size_t>(std::max<uint64_t>(1, params_.stream_length));
+    std::vector<double> raw(D * n);
+    for (auto& c : raw) c = uni_rand_(gen_);
+
+    std::vector<uint64_t> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t q[D];
+        for (uint32_t d = 0; d < D; ++d) q[d] = quantizeCoord(raw[D * i + d], 0.0, 1000.0);
+        keys[i] = hilbertKeyN<D>(q);
+    }
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+    if (dist_ == Distribution::NEARLY_SORTED && n > 1 && params_.sort_l > 0) {
+        const double k_frac = std::min(100.0, std::max(0.0, params_.sort_k_pct)) / 100.0;
+        const size_t num_swaps = static_cast<size_t>(std::ceil(k_frac * n / 2.0));
+        const uint64_t max_l = std::min<uint64_t>(params_.sort_l, n - 1);
+        std::uniform_int_distribution<uint64_t> shift(1, max_l);
+        // Visit positions in random order and pair each unused one with an
+        // unused partner within L, so no item is swapped twice
+        std::vector<size_t> candidates(n);
+        std::iota(candidates.begin(), candidates.end(), 0);
+        std::shuffle(candidates.begin(), candidates.end(), gen_);
+        std::vector<bool> used(n, false);
+        size_t swaps = 0;
+        for (size_t c = 0; c < n && swaps < num_swaps; ++c) {
+            const size_t i = candidates[c];
+            if (used[i]) continue;
+            // A few random distances, both directions each; give up on i if all are taken
+            for (int attempt = 0; attempt < 8; ++attempt) {
+                const size_t l = static_cast<size_t>(shift(gen_));
+                const bool forward_first = gen_() & 1u;
+                size_t j = n;
+                for (int side = 0; side < 2 && j == n; ++side) {
+                    if ((side == 0) == forward_first) {
+                        if (i + l < n && !used[i + l]) j = i + l;
+                    } else {
+                        if (i >= l && !used[i - l]) j = i - l;
+                    }
+                }
+                if (j == n) continue;
+                std::swap(order[i], order[j]);
+                used[i] = used[j] = true;
+                ++swaps;
+                break;
+            }
+        }
+    }
+
+    stream_coords_.resize(D * n);
+    for (size_t i = 0; i < n; ++i) {
+        for (uint32_t d = 0; d < D; ++d) stream_coords_[D * i + d] = raw[D * order[i] + d];
+    }
+}
+
+void WorkloadGenerator::replay(std::shared_ptr<const MappedWorkload> workload) {
+    if (!workload || workload->size() == 0) {
+        throw std::invalid_argument("Cannot replay an empty workload file.");
+    }
+    if (params_.dims != 2) {
+        throw std::invalid_argument("Workload files hold 2-D operations; cannot replay with dims=" +
+                                    std::to_string(params_.dims) + ".");
+    }
+    replay_ = std::move(workload);
+    replay_pos_ = 0;
+    replay_inserts_ = 0;
+    for (uint64_t i = 0; i < replay_->size(); ++i) {
+        if ((*replay_)[i].type == static_cast<uint8_t>(OpType::INSERT)) ++replay_inserts_;
+    }
+    dist_ = Distribution::REPLAY;
+    data_type_ = replay_->dataType();
+    mix_ = replay_->mix();
+}
+
+const WorkloadRecord& WorkloadGenerator::nextReplayRecord() {
+    // Wrapping would insert the recorded ids a second time
+    if (replay_pos_ == replay_->size()) {
+        throw std::runtime_error("Replayed workload exhausted after " + std::to_string(replay_->size()) +
+                                 " operations.");
+    }
+    return (*replay_)[replay_pos_++];
+}
+
+template <uint32_t D>
+void WorkloadGenerator::nextPoint(double* coords) {
+    switch (dist_) {
+        case Distribution::REPLAY: {
+            // Points only: skip the recorded queries (replay is 2-D only)
+            if (replay_inserts_ == 0) {
+                throw std::runtime_error("Replayed workload contains no inserts.");
+            }
+            const WorkloadRecord* rec;
+            do {
+                rec = &nextReplayRecord();
+            } while (rec->type != static_cast<uint8_t>(OpType::INSERT));
+            coords[0] = rec->coords[0];
+            coords[1] = rec->coords[1];
+            break;
+        }
+        case Distribution::WALK:
+            // Random walk: update current position with normal distribution step
+            for (uint32_t d = 0; d < D; ++d) {
+                current_coords_[d] += walk_dist_(gen_);
+                coords[d] = current_coords_[d];
+            }
+            break;
+        case Distribution::SORTED:
+        case Distribution::NEARLY_SORTED:
+            // Replay the pre-ordered stream (wraps around past stream_length)
+            for (uint32_t d = 0; d < D; ++d) coords[d] = stream_coords_[D * stream_pos_ + d];
+            stream_pos_ = (stream_pos_ + 1) % (stream_coords_.size() / D);
+            break;
+        case Distribution::CLUSTERED: {
+            const size_t c = std::uniform_int_distribution<size_t>(0, centres_.size() / D - 1)(gen_);
+            std::normal_distribution<double> spread(0.0, params_.cluster_stddev);
+            for (uint32_t d = 0; d < D; ++d) coords[d] = centres_[D * c + d] + spread(gen_);
+            break;
+        }
+        case Distribution::ZIPF: {
+            const size_t h = zipf_rank_(gen_);
+            std::normal_distribution<double> spread(0.0, params_.hotspot_radius);
+            for (uint32_t d = 0; d < D; ++d) coords[d] = centres_[D * h + d] + spread(gen_);
+            break;
+        }
+        default:
+            // Random uniform distribution
+            for (uint32_t d = 0; d < D; ++d) coords[d] = uni_rand_(gen_);
+            break;
+    }
+    trackPoint<D>(coords);
+}
+
+template <uint32_t D>
+void WorkloadGenerator::trackPoint(const double* coords) {
+    if (!has_data_) {
+        for (uint32_t d = 0; d < D; ++d) data_low_[d] = data_high_[d] = coords[d];
+        has_data_ = true;
+        return;
+    }
+    for (uint32_t d = 0; d < D; ++d) {
+        data_low_[d] = std::min(data_low_[d], coords[d]);
+        data_high_[d] = std::max(data_high_[d], coords[d]);
+    }
+}
+
+// Queries are centred uniformly over the extent of the data seen so far
+template <uint32_t D>
+void WorkloadGenerator::nextQuery(Operation& op) {
+    for (uint32_t d = 0; d < D; ++d) {
+        op.coords[d] = std::uniform_real_distribution<double>(data_low_[d], data_high_[d])(op_gen_);
+    }
+    if (op.type == OpType::RANGE_QUERY) {
+        // A cube-ish window whose volume is range_selectivity of the data extent
+        const double sel = std::max(0.0, mix_.range_selectivity);
+        const double side_frac = D == 2 ? std::sqrt(sel) : std::pow(sel, 1.0 / D);
+        for (uint32_t d = 0; d < D; ++d) {
+            op.half_extent[d] = 0.5 * side_frac * (data_high_[d] - data_low_[d]);
+        }
+    }
+}
+
+Operation WorkloadGenerator::nextOperation() {
+    Operation op;
+    op.type = OpType::INSERT;
+    op.id = 0;
+    for (uint32_t d = 0; d < kMaxDims; ++d) op.coords[d] = op.half_extent[d] = 0.0;
+
+    if (dist_ == Distribution::REPLAY) {
+        const WorkloadRecord& rec = nextReplayRecord();
+        op.type = static_cast<OpType>(rec.type);
+        op.id = rec.id;
+        for (int d = 0; d < 2; ++d) {
+            op.coords[d] = rec.coords[d];
+            op.half_extent[d] = rec.half_extent[d];
+        }
+        return op;
+    }
+
+    const double total = mix_.insert_ratio + mix_.range_ratio + mix_.knn_ratio;
+    if (has_data_ && !mix_.insertOnly() && total > 0.0) {
+        const double r = std::uniform_real_distribution<double>(0.0, total)(op_gen_);
+        if (r >= mix_.insert_ratio + mix_.range_ratio) {
+            op.type = OpType::KNN_QUERY;
+        } else if (r >= mix_.insert_ratio) {
+            op.type = OpType::RANGE_QUERY;
+        }
+    }
+
+    if (op.type == OpType::INSERT) {
+        generateNextPoint(op.coords);
+        op.id = inserts_++;
+        return op;
+    }
+
+    (this->*next_query_)(op);
+    return op;
+}
+
+id_type WorkloadGenerator::nextInsert(double* coords) {
+    if (dist_ == Distribution::REPLAY) {
+        // Recorded ids; queries before the next insert are skipped
+        Operation op;
+        do {
+            op = nextOperation();
+        } while (op.type != OpType::INSERT);
+        for (uint32_t d = 0; d < params_.dims; ++d) coords[d] = op.coords[d];
+        return static_cast<id_type>(op.id);
     }
+    generateNextPoint(coords);
+    return static_cast<id_type>(inserts_++);
 }
 
 void WorkloadGenerator::reset() {
-    current_coords_[0] = 500.0;
-    current_coords_[1] = 500.0;
-    gen_.seed(42); // Reset to default seed
+    for (uint32_t d = 0; d < kMaxDims; ++d) current_coords_[d] = 500.0;
+    gen_.seed(seed_);
+    op_gen_.seed(seed_ ^ 0x9e3779b9u);
+    uni_rand_.reset();
+    walk_dist_.reset();
+    has_data_ = false;
+    inserts_ = 0;
+    if (dist_ == Distribution::REPLAY) {
+        replay_pos_ = 0;
+        return;
+    }
+    setupDistribution();
 }
 
 } // namespace SpatialIndex
-